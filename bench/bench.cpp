@@ -0,0 +1,572 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+extern "C"
+{
+#include "btree.h"
+#include "export.h"
+#include "generator.h"
+#include "hitcount.h"
+#include "lookupcache.h"
+#include "multilist.h"
+#include "perfcount.h"
+#include "prefilter.h"
+}
+
+/*
+Benchmarks for tree building, lookups, counting and dumping.
+
+Generated lists hold IP_BENCH_MAX_PREFIXES prefixes at most
+(default 1000000); larger sizes are skipped, since a random list of
+10M+ host entries needs several GB of nodes.
+*/
+
+namespace
+{
+
+const int64_t DEFAULT_MAX_PREFIXES = 1000000;
+
+struct TestList
+{
+    ~TestList()
+    {
+        if (generated)
+        {
+            remove(filename.c_str());
+        }
+    }
+
+    bool generated = false;
+    std::string filename;
+    std::vector<std::string> entries;
+    std::vector<std::string> hits;
+    std::vector<std::string> misses;
+    bnode_t *tree = nullptr;
+    uint64_t nodes = 0;
+};
+
+int64_t maxPrefixes()
+{
+    const char *value = getenv("IP_BENCH_MAX_PREFIXES");
+    return value ? atoll(value) : DEFAULT_MAX_PREFIXES;
+}
+
+std::vector<std::string> formatIPv4(const std::vector<ipv4_t> &ips)
+{
+    std::vector<std::string> lines;
+    char s[IPSTRLENV4];
+
+    lines.reserve(ips.size());
+    for (const ipv4_t &ip : ips)
+    {
+        ipv4tostring(s, ip);
+        lines.push_back(s);
+    }
+    return lines;
+}
+
+std::vector<std::string> formatIPv6(const std::vector<ipv6_t> &ips)
+{
+    std::vector<std::string> lines;
+    char s[IPSTRLENV6];
+
+    lines.reserve(ips.size());
+    for (const ipv6_t &ip : ips)
+    {
+        ipv6tostring(s, ip);
+        lines.push_back(s);
+    }
+    return lines;
+}
+
+std::vector<std::string> readLines(const std::string &filename)
+{
+    std::vector<std::string> lines;
+    FILE *fp = fopen(filename.c_str(), "r");
+    char buffer[128];
+
+    while ((fp != nullptr) && fgets(buffer, sizeof(buffer), fp))
+    {
+        std::string line(buffer);
+        while (!line.empty() && isspace((unsigned char)line.back()))
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            lines.push_back(line);
+        }
+    }
+    if (fp != nullptr)
+    {
+        fclose(fp);
+    }
+    return lines;
+}
+
+void writeLines(const std::string &filename, const std::vector<std::string> &lines)
+{
+    FILE *fp = fopen(filename.c_str(), "w");
+    for (const std::string &line : lines)
+    {
+        fputs(line.c_str(), fp);
+        fputc('\n', fp);
+    }
+    fclose(fp);
+}
+
+std::vector<std::string> generateEntries(int family, int64_t count, uint64_t seed)
+{
+    if (family == 4)
+    {
+        std::vector<ipv4_t> list(count);
+        generateIPv4List(list.data(), list.size(), seed);
+        return formatIPv4(list);
+    }
+    std::vector<ipv6_t> list(count);
+    generateIPv6List(list.data(), list.size(), seed);
+    return formatIPv6(list);
+}
+
+// Queries are all hits or all misses; a skew of 0 spreads them evenly over the list.
+std::vector<std::string> generateQueries(int family, const TestList &list, double hit_rate)
+{
+    const size_t count = 4096;
+
+    if (family == 4)
+    {
+        std::vector<ipv4_t> entries;
+        std::vector<ipv4_t> queries(count);
+        for (const std::string &entry : list.entries)
+        {
+            entries.push_back(read_ipv4(entry.c_str()));
+        }
+        generateIPv4Queries(entries.data(), entries.size(), queries.data(), count, hit_rate, 0.0, 0x9E3779B97F4A7C15ULL);
+        return formatIPv4(queries);
+    }
+    std::vector<ipv6_t> entries;
+    std::vector<ipv6_t> queries(count);
+    for (const std::string &entry : list.entries)
+    {
+        entries.push_back(read_ipv6(entry.c_str()));
+    }
+    generateIPv6Queries(entries.data(), entries.size(), queries.data(), count, hit_rate, 0.0, 0x9E3779B97F4A7C15ULL);
+    return formatIPv6(queries);
+}
+
+void buildQueries(int family, TestList &list)
+{
+    list.hits = generateQueries(family, list, 1.0);
+    list.misses = generateQueries(family, list, 0.0);
+}
+
+/*
+Returns a list, loaded and with its queries prepared, for a data file
+(size == 0) or for a generated list of the given size.
+*/
+TestList *getList(int family, int64_t size)
+{
+    static std::map<std::pair<int, int64_t>, TestList> cache;
+    auto key = std::make_pair(family, size);
+    auto found = cache.find(key);
+
+    if (found != cache.end())
+    {
+        return &found->second;
+    }
+
+    TestList &list = cache[key];
+    if (size == 0)
+    {
+        list.filename = std::string(IP_BENCH_DATA_DIR) + ((family == 4) ? "outbound.txt" : "inbound_v6.txt");
+        list.entries = readLines(list.filename);
+    }
+    else
+    {
+        char filename[] = "/tmp/ip-bench-XXXXXX";
+        close(mkstemp(filename));
+        list.filename = filename;
+        list.generated = true;
+        list.entries = generateEntries(family, size, 0xC0FFEE + (uint64_t)size * family);
+        writeLines(list.filename, list.entries);
+    }
+    list.tree = (family == 4) ? createIPv4TreeFromFile(list.filename.c_str()) : createIPv6TreeFromFile(list.filename.c_str());
+    btreestats_t stats;
+    getTreeStats(list.tree, &stats);
+    list.nodes = stats.nodes;
+    buildQueries(family, list);
+    return &list;
+}
+
+bool skipOversized(benchmark::State &state)
+{
+    if (state.range(1) > maxPrefixes())
+    {
+        state.SkipWithError("larger than IP_BENCH_MAX_PREFIXES");
+        return true;
+    }
+    return false;
+}
+
+void reportMemory(benchmark::State &state, const TestList *list)
+{
+    state.counters["entries"] = (double)list->entries.size();
+    state.counters["nodes"] = (double)list->nodes;
+    state.counters["bytes/entry"] = (double)(list->nodes * sizeof(bnode_t)) / (double)list->entries.size();
+}
+
+/*
+Adds hardware events per operation, e.g. "cycles/op", when ip-bench is
+built with -DENABLE_PERF_COUNTERS=ON and the kernel allows counting.
+*/
+void reportPerfCounters(benchmark::State &state, perfoperation_t operation)
+{
+    perfstats_t stats;
+
+    getPerfStats(operation, &stats);
+    if (stats.operations == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        if (stats.available & (1 << i))
+        {
+            state.counters[std::string(perfEventName((perfevent_t)i)) + "/op"] = (double)stats.events[i] / (double)stats.operations;
+        }
+    }
+}
+
+void BM_CreateTreeFromFile(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+
+    resetPerfStats();
+    for (auto _ : state)
+    {
+        bnode_t *tree = (family == 4) ? createIPv4TreeFromFile(list->filename.c_str()) : createIPv6TreeFromFile(list->filename.c_str());
+        state.PauseTiming();
+        deleteSubtree(tree);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)list->entries.size());
+    reportMemory(state, list);
+    reportPerfCounters(state, PERF_LOAD);
+}
+
+template <bool hit>
+void BM_Find(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+    const std::vector<std::string> &queries = hit ? list->hits : list->misses;
+    size_t i = 0;
+
+    if (queries.empty())
+    {
+        state.SkipWithError("no queries");
+        return;
+    }
+    resetPerfStats();
+    PERF_BATCH_BEGIN(PERF_FIND);
+    for (auto _ : state)
+    {
+        const char *query = queries[i].c_str();
+        benchmark::DoNotOptimize((family == 4) ? findIPv4(list->tree, query) : findIPv6(list->tree, query));
+        i = (i + 1 == queries.size()) ? 0 : i + 1;
+    }
+    PERF_BATCH_END(PERF_FIND);
+    state.SetItemsProcessed(state.iterations());
+    reportMemory(state, list);
+    reportPerfCounters(state, PERF_FIND);
+}
+
+// Hits with per-entry hit counting, to compare with BM_FindHit.
+void BM_FindCounted(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+    hitcounter_t *counter = createHitCounter(list->tree, (uint8_t)family, 1);
+    size_t i = 0;
+
+    if (list->hits.empty())
+    {
+        deleteHitCounter(counter);
+        state.SkipWithError("no queries");
+        return;
+    }
+    for (auto _ : state)
+    {
+        const char *query = list->hits[i].c_str();
+        benchmark::DoNotOptimize((family == 4) ? findIPv4Counted(counter, 0, read_ipv4(query))
+                                               : findIPv6Counted(counter, 0, read_ipv6(query)));
+        i = (i + 1 == list->hits.size()) ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+    deleteHitCounter(counter);
+}
+
+/*
+Repeated lookups of the same 1024 parsed addresses, as with skewed
+client traffic, with and without a lookup cache in front of the tree.
+*/
+template <bool cached>
+void BM_FindRepeated(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+    lookupcache_t *cache = createLookupCache((family == 4) ? list->tree : NULL, (family == 6) ? list->tree : NULL, 4096);
+    std::vector<ipv4_t> ipv4s;
+    std::vector<ipv6_t> ipv6s;
+    size_t count = std::min<size_t>(list->hits.size(), 1024);
+    size_t i = 0;
+
+    for (size_t j = 0; j < count; j++)
+    {
+        if (family == 4)
+        {
+            ipv4s.push_back(read_ipv4(list->hits[j].c_str()));
+        }
+        else
+        {
+            ipv6s.push_back(read_ipv6(list->hits[j].c_str()));
+        }
+    }
+    if (count == 0)
+    {
+        deleteLookupCache(cache);
+        state.SkipWithError("no queries");
+        return;
+    }
+    for (auto _ : state)
+    {
+        if (family == 4)
+        {
+            benchmark::DoNotOptimize(cached ? findIPv4Cached(cache, ipv4s[i]) : findIPv4Address(list->tree, ipv4s[i]));
+        }
+        else
+        {
+            benchmark::DoNotOptimize(cached ? findIPv6Cached(cache, ipv6s[i]) : findIPv6Address(list->tree, ipv6s[i]));
+        }
+        i = (i + 1 == count) ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+    deleteLookupCache(cache);
+}
+
+// Same as BM_Find, with a Bloom filter prefilter in front of the tree.
+template <bool hit>
+void BM_FindFiltered(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+    const std::vector<std::string> &queries = hit ? list->hits : list->misses;
+    prefilter_t *filter = createPrefilter(list->tree, (uint8_t)family, PREFILTER_DEFAULT_BITS);
+    size_t i = 0;
+
+    if (queries.empty())
+    {
+        deletePrefilter(filter);
+        state.SkipWithError("no queries");
+        return;
+    }
+    for (auto _ : state)
+    {
+        const char *query = queries[i].c_str();
+        benchmark::DoNotOptimize((family == 4) ? findIPv4Filtered(filter, read_ipv4(query))
+                                               : findIPv6Filtered(filter, read_ipv6(query)));
+        i = (i + 1 == queries.size()) ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["filter_bytes/entry"] = (double)filter->block_count * 64 / (double)(filter->entry_count ? filter->entry_count : 1);
+    deletePrefilter(filter);
+}
+
+void BM_CountTree(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize((family == 4) ? countIPv4Tree(list->tree) : countIPv6Tree(list->tree));
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)list->entries.size());
+    reportMemory(state, list);
+}
+
+void BM_DumpTree(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+    int null_fd = open("/dev/null", O_WRONLY);
+    int stdout_fd = dup(STDOUT_FILENO);
+
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize((family == 4) ? dumpIPv4Tree(list->tree) : dumpIPv6Tree(list->tree));
+    }
+    fflush(stdout);
+    dup2(stdout_fd, STDOUT_FILENO);
+    close(stdout_fd);
+    close(null_fd);
+    state.SetItemsProcessed(state.iterations() * (int64_t)list->entries.size());
+    reportMemory(state, list);
+}
+
+void BM_ExportTree(benchmark::State &state)
+{
+    int family = (int)state.range(0);
+    if (skipOversized(state))
+    {
+        return;
+    }
+    TestList *list = getList(family, state.range(1));
+    int null_fd = open("/dev/null", O_WRONLY);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(exportTreeToFd(list->tree, (uint8_t)family, EXPORT_TEXT, null_fd));
+    }
+    close(null_fd);
+    state.SetItemsProcessed(state.iterations() * (int64_t)list->entries.size());
+    reportMemory(state, list);
+}
+
+// Twenty 10K-entry IPv4 lists, with queries that hit list 0 half of the time.
+struct ListSet
+{
+    ListSet()
+    {
+        std::vector<ipv4_t> list(10000);
+
+        multi = createMultiNode();
+        for (uint8_t i = 0; i < 20; i++)
+        {
+            bnode_t *tree = createNode();
+            generateIPv4List(list.data(), list.size(), 1000 + i);
+            for (const ipv4_t &entry : list)
+            {
+                insertIPv4Address(tree, entry);
+                insertMultiIPv4Address(multi, entry, i);
+            }
+            trees.push_back(tree);
+            if (i == 0)
+            {
+                queries.resize(4096);
+                generateIPv4Queries(list.data(), list.size(), queries.data(), queries.size(), 0.5, 0.0, 7);
+            }
+        }
+    }
+
+    std::vector<bnode_t *> trees;
+    mnode_t *multi;
+    std::vector<ipv4_t> queries;
+};
+
+ListSet &getListSet()
+{
+    static ListSet lists;
+    return lists;
+}
+
+void BM_SeparateTreesLookup(benchmark::State &state)
+{
+    ListSet &lists = getListSet();
+    size_t i = 0;
+
+    for (auto _ : state)
+    {
+        uint64_t mask = 0;
+        for (size_t t = 0; t < lists.trees.size(); t++)
+        {
+            mask |= (uint64_t)findIPv4Address(lists.trees[t], lists.queries[i]) << t;
+        }
+        benchmark::DoNotOptimize(mask);
+        i = (i + 1 == lists.queries.size()) ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_MultiListLookup(benchmark::State &state)
+{
+    ListSet &lists = getListSet();
+    size_t i = 0;
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(lookupMultiIPv4Address(lists.multi, lists.queries[i]));
+        i = (i + 1 == lists.queries.size()) ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Arguments: {family, list size}; size 0 is the data file of that family.
+void sizes(benchmark::internal::Benchmark *b)
+{
+    for (int family : {4, 6})
+    {
+        b->Args({family, 0});
+        for (int64_t size : {10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL})
+        {
+            b->Args({family, size});
+        }
+    }
+    b->ArgNames({"family", "size"});
+}
+
+} // namespace
+
+BENCHMARK(BM_CreateTreeFromFile)->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Find, true)->Name("BM_FindHit")->Apply(sizes);
+BENCHMARK_TEMPLATE(BM_Find, false)->Name("BM_FindMiss")->Apply(sizes);
+BENCHMARK_TEMPLATE(BM_FindFiltered, true)->Name("BM_FindFilteredHit")->Apply(sizes);
+BENCHMARK_TEMPLATE(BM_FindFiltered, false)->Name("BM_FindFilteredMiss")->Apply(sizes);
+BENCHMARK(BM_FindCounted)->Apply(sizes);
+BENCHMARK_TEMPLATE(BM_FindRepeated, false)->Name("BM_FindRepeated")->Apply(sizes);
+BENCHMARK_TEMPLATE(BM_FindRepeated, true)->Name("BM_FindRepeatedCached")->Apply(sizes);
+BENCHMARK(BM_CountTree)->Apply(sizes)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_DumpTree)->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ExportTree)->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SeparateTreesLookup);
+BENCHMARK(BM_MultiListLookup);
+
+BENCHMARK_MAIN();
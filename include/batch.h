@@ -0,0 +1,68 @@
+/**
+ * @file batch.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Parallel batch classification public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "btree.h"
+
+/**
+ * @brief Number of addresses in one unit of work.
+ * Must be a multiple of 8, so that no two chunks share a bitmap byte.
+ */
+#define BATCH_CHUNK_SIZE 4096
+
+/**
+ * @brief Classifies an array of IPv4 strings against an IPv4 tree,
+ * using all worker threads.
+ *
+ * The input is cut into chunks of BATCH_CHUNK_SIZE addresses.
+ * Each worker starts on its own share of the chunks; a worker that
+ * runs out of work steals chunks from the other workers.
+ *
+ * @param root        Root of the IPv4 tree.
+ * @param ip_strings  Array of null-terminated IPv4 strings.
+ * @param count       Number of strings in the array.
+ * @param bitmap      Output; must hold at least (count + 7) / 8 bytes.
+ *                    Bit (i % 8) of byte (i / 8) is set if string i is found.
+ * @param threads     Number of worker threads; 0 uses all online cores.
+ * @return uint64_t   Number of strings found in the tree.
+ */
+uint64_t classifyIPv4Batch(bnode_t *root, const char *const *ip_strings, uint64_t count, uint8_t *bitmap, uint16_t threads);
+
+/**
+ * @brief Classifies an array of IPv6 strings against an IPv6 tree.
+ * See classifyIPv4Batch() for details.
+ *
+ * @return uint64_t  Number of strings found in the tree.
+ */
+uint64_t classifyIPv6Batch(bnode_t *root, const char *const *ip_strings, uint64_t count, uint8_t *bitmap, uint16_t threads);
+
+/**
+ * @brief Classifies every line of a text file against an IPv4 tree
+ * and writes the matching lines, in their original order, to a stream.
+ *
+ * @param root       Root of the IPv4 tree.
+ * @param filename   Text file with one IPv4 address or range per line.
+ * @param out        Output stream for the matching lines; may be NULL
+ *                   if only the number of matches is needed.
+ * @param threads    Number of worker threads; 0 uses all online cores.
+ * @return uint64_t  Number of matching lines, 0 if the file cannot be read.
+ */
+uint64_t filterIPv4File(bnode_t *root, const char *filename, FILE *out, uint16_t threads);
+
+/**
+ * @brief Classifies every line of a text file against an IPv6 tree.
+ * See filterIPv4File() for details.
+ *
+ * @return uint64_t  Number of matching lines, 0 if the file cannot be read.
+ */
+uint64_t filterIPv6File(bnode_t *root, const char *filename, FILE *out, uint16_t threads);
+
+#endif
@@ -8,6 +8,7 @@
 #ifndef BTREE_H_
 #define BTREE_H_
 
+#include <stdio.h>
 #include "ip.h"
 
 /**
@@ -23,6 +24,95 @@ typedef struct node
     struct node *child[2];
 } bnode_t;
 
+/**
+ * @brief Maximum depth of a tree: the number of bits in an IPv6 address.
+ */
+#define BTREE_MAX_DEPTH 128
+
+/**
+ * @brief Shape and memory footprint of a tree, see getTreeStats().
+ * The depth of a node is the number of edges from the root to it,
+ * which is also the number of steps a lookup takes to reach it.
+ */
+typedef struct
+{
+    uint64_t nodes;                                 // All nodes, including the root.
+    uint64_t bytes;                                 // nodes * sizeof(bnode_t), without allocator overhead.
+    uint64_t leaves;                                // Stored addresses and ranges.
+    uint64_t single_child_nodes;                    // Inner nodes with exactly one child.
+    uint64_t depth_histogram[BTREE_MAX_DEPTH + 1];  // Number of nodes at every depth.
+    uint8_t max_depth;                              // Depth of the deepest node.
+    double average_leaf_depth;                      // Average lookup depth of a match.
+    double single_child_fraction;                   // single_child_nodes / inner nodes.
+} btreestats_t;
+
+/**
+ * @brief Where the time of a list load went, and what the entries did.
+ * See loadIPv4FileWithReport(). Times are in nanoseconds.
+ */
+typedef struct
+{
+    uint64_t lines;            // Non-empty entries read.
+    uint64_t added;            // Entries that added a new address or range.
+    uint64_t duplicates;       // Entries already in the tree.
+    uint64_t covered;          // Entries inside a wider range already in the tree.
+    uint64_t invalid;          // Entries that could not be parsed.
+    uint64_t other_family;     // Entries of the other family, skipped.
+    uint64_t absorbed_nodes;   // Nodes freed because a new range covered them.
+    uint64_t io_ns;            // Reading the file.
+    uint64_t tokenize_ns;      // Splitting it into entries.
+    uint64_t parse_ns;         // read_ipv4_n() or read_ipv6_n().
+    uint64_t insert_ns;        // Walking and growing the tree.
+    uint64_t delete_ns;        // Freeing absorbed subtrees.
+    uint64_t total_ns;
+} loadreport_t;
+
+/**
+ * @brief Position of a walk over the addresses and ranges in a tree.
+ * Holds the path from the root to the current entry, so it needs no
+ * allocation and no recursion; see initIPv4Iterator().
+ */
+typedef struct
+{
+    const bnode_t *root;
+    const bnode_t *path[BTREE_MAX_DEPTH + 1];  // path[d] is the node at depth d.
+    uint16_t ip[8];                            // Bits of the path, most significant first.
+    uint8_t depth;
+    uint8_t max_depth;                         // 32 or 128.
+    uint8_t state;
+} btreeiter_t;
+
+/**
+ * @brief Most trees that can be watched at the same time, see watchTree().
+ */
+#define BTREE_MAX_WATCHED_TREES 64
+
+/**
+ * @brief Starts counting the changes to one tree: inserts that add or
+ * widen an entry, removals, and deleteSubtree() of the root. Changes to
+ * other trees leave the counter alone. A lookup result cached under one
+ * generation is still valid as long as the generation has not changed;
+ * see lookupcache.h. Every watchTree() needs an unwatchTree().
+ *
+ * @param root  Root of the tree.
+ * @return const uint64_t*  The generation counter of the tree, to be read
+ *                          with getTreeGeneration(); NULL if root is NULL or
+ *                          BTREE_MAX_WATCHED_TREES trees are watched already.
+ */
+const uint64_t *watchTree(const bnode_t *root);
+
+/**
+ * @brief Stops one watchTree() of a tree.
+ */
+void unwatchTree(const bnode_t *root);
+
+/**
+ * @brief Reads a generation counter returned by watchTree().
+ *
+ * @return uint64_t  The current generation; 0 if counter is NULL.
+ */
+uint64_t getTreeGeneration(const uint64_t *counter);
+
 /**
  * @brief Returns a pointer to an empty bnode.
  *
@@ -30,23 +120,79 @@ typedef struct node
  */
 bnode_t *createNode();
 
+/**
+ * @brief Frees a node and everything below it.
+ * Passing NULL is allowed and does nothing.
+ */
+void deleteSubtree(bnode_t *);
+
 /**
  * @brief Adds an IPv4 string to a binary tree.
+ * Besides addresses and CIDR ranges, start-end ranges such as
+ * "1.2.3.4-1.2.5.200" are accepted; they are split into the fewest
+ * CIDR ranges that cover them.
  *
- * @return int 0 if successfully added, 1 if the address
+ * @return uint8_t 0 if successfully added, 1 if the address
  * (or an encompassing range) already figures in the tree,
  * 2 if the address could not be added.
  */
-void insertIPv4(bnode_t *, const char *);
+uint8_t insertIPv4(bnode_t *, const char *);
+
+/**
+ * @brief Same as insertIPv4(), for a string of known length.
+ *
+ * @param entry     Input string; need not be null-terminated.
+ * @param length    Number of characters to read.
+ * @return uint8_t  Same as insertIPv4(); for a start-end range, 0 if
+ *                  any part of it was added.
+ */
+uint8_t insertIPv4Entry(bnode_t *, const char *entry, size_t length);
+
+/**
+ * @brief Adds a parsed IPv4 address or range to a binary tree.
+ *
+ * @return uint8_t  Same as insertIPv4().
+ */
+uint8_t insertIPv4Address(bnode_t *, ipv4_t);
 
 /**
  * @brief Adds an IPv6 string to a binary tree.
  *
- * @return int 0 if successfully added, 1 if the address
+ * @return uint8_t 0 if successfully added, 1 if the address
  * (or an encompassing range) already figures in the tree,
  * 2 if the address could not be added.
  */
-void insertIPv6(bnode_t *, const char *);
+uint8_t insertIPv6(bnode_t *, const char *);
+
+/**
+ * @brief Same as insertIPv6(), for a string of known length.
+ * Start-end ranges are accepted, as in insertIPv4Entry().
+ */
+uint8_t insertIPv6Entry(bnode_t *, const char *entry, size_t length);
+
+/**
+ * @brief Adds a parsed IPv6 address or range to a binary tree.
+ *
+ * @return uint8_t  Same as insertIPv6().
+ */
+uint8_t insertIPv6Address(bnode_t *, ipv6_t);
+
+/**
+ * @brief Removes an IPv4 address or range that was added as such.
+ * Nodes left without children are freed. A part of a wider range
+ * cannot be removed on its own.
+ *
+ * @return uint8_t  0 if removed, 1 if the tree holds no entry with
+ *                  exactly this prefix, 2 if the address is invalid.
+ */
+uint8_t removeIPv4Address(bnode_t *, ipv4_t);
+
+/**
+ * @brief Removes an IPv6 address or range that was added as such.
+ *
+ * @return uint8_t  Same as removeIPv4Address().
+ */
+uint8_t removeIPv6Address(bnode_t *, ipv6_t);
 
 /**
  * @brief Prints all IP addresses in an IPv4 tree to stdout.
@@ -62,6 +208,26 @@ uint32_t dumpIPv4Tree(bnode_t *);
  */
 uint32_t countIPv4Tree(bnode_t *);
 
+/**
+ * @brief Adds the addresses read from a text file to an existing IPv4 tree.
+ * Entries are separated by whitespace; invalid entries are skipped.
+ * Start-end ranges are split into CIDR ranges, as in insertIPv4().
+ *
+ * @return uint8_t  0 if the file was read, 1 if it could not be opened.
+ */
+uint8_t loadIPv4File(bnode_t *, const char *);
+
+/**
+ * @brief Same as loadIPv4File(), but also fills in a load report.
+ * Every entry is timed, which makes the load itself somewhat slower;
+ * the report is meant to find out where the time goes, not for routine
+ * loading. Both load the same entries.
+ *
+ * @return uint8_t  0 if the file was read, 1 if it could not be opened
+ *                  or read.
+ */
+uint8_t loadIPv4FileWithReport(bnode_t *, const char *, loadreport_t *);
+
 /**
  * @brief Returns a pointer to the root of an IPv4 tree,
  * filled with the addresses read from a text file.
@@ -79,6 +245,41 @@ bnode_t *createIPv4TreeFromFile(const char *);
  */
 uint8_t findIPv4(bnode_t *, const char *);
 
+/**
+ * @brief Checks if a parsed IPv4 address occurs in an IPv4 tree.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv4Address(bnode_t *, ipv4_t);
+
+/**
+ * @brief Finds the list entry that an IPv4 address falls in.
+ * Since an entry absorbs the more specific entries below it, there is
+ * at most one; it is found in the same walk as with findIPv4Address().
+ *
+ * @param match     Output, may be NULL; the matching entry, whose .ps is
+ *                  also the depth at which the walk stopped. Set to
+ *                  .ip = 0 and .ps = 0 if nothing matched.
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t matchIPv4Address(bnode_t *, ipv4_t, ipv4_t *match);
+
+/**
+ * @brief Same as matchIPv4Address(), for an address string.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t matchIPv4(bnode_t *, const char *, ipv4_t *match);
+
+/**
+ * @brief Returns the leaf that an IPv4 address falls in. Leaves stay at
+ * the same address until the entry is removed or absorbed, so they can
+ * identify entries, e.g. for hit counting (see hitcount.h).
+ *
+ * @return const bnode_t*  The leaf, or NULL if the address is not listed.
+ */
+const bnode_t *findIPv4Leaf(const bnode_t *, ipv4_t);
+
 /**
  * @brief Prints all IP addresses in an IPv6 tree to stdout.
  *
@@ -88,6 +289,13 @@ uint32_t dumpIPv6Tree(bnode_t *);
 
 void bitshiftLeft(uint16_t *, const uint8_t);
 
+/**
+ * @brief Walks an IPv4 or IPv6 tree and fills in its statistics.
+ * The walk uses an explicit stack, so deep trees cannot overflow
+ * the call stack.
+ */
+void getTreeStats(const bnode_t *, btreestats_t *);
+
 /**
  * @brief Returns the number of addresses in an IPv6 tree.
  *
@@ -95,6 +303,107 @@ void bitshiftLeft(uint16_t *, const uint8_t);
  */
 uint32_t countIPv6Tree(bnode_t *);
 
+/**
+ * @brief Starts a walk over an IPv4 tree, before its first entry.
+ * The tree must not change while the iterator is in use.
+ */
+void initIPv4Iterator(btreeiter_t *, const bnode_t *root);
+
+/**
+ * @brief Starts a walk over an IPv6 tree, before its first entry.
+ */
+void initIPv6Iterator(btreeiter_t *, const bnode_t *root);
+
+/**
+ * @brief Moves an iterator back before the first entry of its tree.
+ */
+void resetIterator(btreeiter_t *);
+
+/**
+ * @brief Moves an IPv4 iterator to the first entry that contains
+ * or follows an address. The prefix size of the address is ignored.
+ */
+void seekIPv4Iterator(btreeiter_t *, ipv4_t);
+
+/**
+ * @brief Moves an IPv6 iterator to the first entry that contains
+ * or follows an address. See seekIPv4Iterator().
+ */
+void seekIPv6Iterator(btreeiter_t *, ipv6_t);
+
+/**
+ * @brief Returns the next entry of an IPv4 tree, in address order.
+ *
+ * @param ip        Output; the address or range.
+ * @return uint8_t  1 if an entry was returned, 0 at the end of the tree.
+ */
+uint8_t nextIPv4(btreeiter_t *, ipv4_t *ip);
+
+/**
+ * @brief Returns the next entry of an IPv6 tree, in address order.
+ *
+ * @return uint8_t  Same as nextIPv4().
+ */
+uint8_t nextIPv6(btreeiter_t *, ipv6_t *ip);
+
+/**
+ * @brief Returns up to max next entries of an IPv4 tree.
+ *
+ * @param ips        Output array of max entries.
+ * @return uint32_t  Number of entries returned; below max only at the end.
+ */
+uint32_t nextIPv4Batch(btreeiter_t *, ipv4_t *ips, uint32_t max);
+
+/**
+ * @brief Returns up to max next entries of an IPv6 tree.
+ * See nextIPv4Batch().
+ */
+uint32_t nextIPv6Batch(btreeiter_t *, ipv6_t *ips, uint32_t max);
+
+/**
+ * @brief Finds every entry of an IPv4 tree that overlaps a range:
+ * a wider range that contains it, or the addresses and ranges inside it.
+ * Only the part of the tree along and below the range is walked.
+ *
+ * @param range      The range to query; a single address is a /32.
+ * @param matches    Output array of max entries, in address order;
+ *                   may be NULL if max is 0.
+ * @param max        Size of matches.
+ * @param covered    Output, may be NULL; the number of addresses in the
+ *                   range that the tree contains.
+ * @return uint32_t  Number of overlapping entries, which may exceed max;
+ *                   0 if the range is invalid.
+ */
+uint32_t findIPv4Overlaps(bnode_t *, ipv4_t range, ipv4_t *matches, uint32_t max, double *covered);
+
+/**
+ * @brief IPv6 version of findIPv4Overlaps().
+ * The covered count is exact up to 2^53 addresses.
+ */
+uint32_t findIPv6Overlaps(bnode_t *, ipv6_t range, ipv6_t *matches, uint32_t max, double *covered);
+
+/**
+ * @brief Adds the addresses read from a text file to an existing IPv6 tree.
+ * Entries are separated by whitespace; invalid entries are skipped.
+ * Start-end ranges are split into CIDR ranges, as in insertIPv4().
+ *
+ * @return uint8_t  0 if the file was read, 1 if it could not be opened.
+ */
+uint8_t loadIPv6File(bnode_t *, const char *);
+
+/**
+ * @brief Same as loadIPv6File(), but also fills in a load report.
+ * See loadIPv4FileWithReport().
+ *
+ * @return uint8_t  Same as loadIPv4FileWithReport().
+ */
+uint8_t loadIPv6FileWithReport(bnode_t *, const char *, loadreport_t *);
+
+/**
+ * @brief Prints a load report in a human-readable form.
+ */
+void printLoadReport(FILE *, const loadreport_t *);
+
 /**
  * @brief Returns a pointer to the root of an IPv6 tree,
  * filled with the addresses read from a text file.
@@ -112,4 +421,37 @@ bnode_t *createIPv6TreeFromFile(const char *);
  */
 uint8_t findIPv6(bnode_t *, const char *);
 
+/**
+ * @brief Checks if a parsed IPv6 address occurs in an IPv6 tree.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv6Address(bnode_t *, ipv6_t);
+
+/**
+ * @brief Finds the list entry that an IPv6 address falls in.
+ * Since an entry absorbs the more specific entries below it, there is
+ * at most one; it is found in the same walk as with findIPv6Address().
+ *
+ * @param match     Output, may be NULL; the matching entry, whose .ps is
+ *                  also the depth at which the walk stopped. Set to
+ *                  .ip = 0 and .ps = 0 if nothing matched.
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t matchIPv6Address(bnode_t *, ipv6_t, ipv6_t *match);
+
+/**
+ * @brief Same as matchIPv6Address(), for an address string.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t matchIPv6(bnode_t *, const char *, ipv6_t *match);
+
+/**
+ * @brief Returns the leaf that an IPv6 address falls in, see findIPv4Leaf().
+ *
+ * @return const bnode_t*  The leaf, or NULL if the address is not listed.
+ */
+const bnode_t *findIPv6Leaf(const bnode_t *, ipv6_t);
+
 #endif
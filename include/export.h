@@ -0,0 +1,62 @@
+/**
+ * @file export.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Tree export public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef EXPORT_H_
+#define EXPORT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "btree.h"
+
+/**
+ * @brief Export formats.
+ *
+ * EXPORT_TEXT writes one entry per line, as dumpIPv4Tree() does.
+ * EXPORT_BINARY writes one packed record per entry: the first address
+ * in network byte order (4 or 16 bytes), then the prefix size (1 byte).
+ * EXPORT_CIDR writes text like EXPORT_TEXT, but first merges sibling
+ * ranges, so 1.2.3.0/25 and 1.2.3.128/25 come out as 1.2.3.0/24.
+ */
+#define EXPORT_TEXT 0
+#define EXPORT_BINARY 1
+#define EXPORT_CIDR 2
+
+/**
+ * @brief Size of the output buffer; sinks are written in blocks of this size.
+ */
+#define EXPORT_BUFFER_SIZE (1 << 16)
+
+/**
+ * @brief Writes all entries of a tree to a stream, in address order.
+ *
+ * @param family    4 or 6.
+ * @param format    EXPORT_TEXT, EXPORT_BINARY or EXPORT_CIDR.
+ * @return uint8_t  0 on success, 1 if writing failed, 2 if the family
+ *                  or the format is invalid.
+ */
+uint8_t exportTreeToFile(const bnode_t *, uint8_t family, uint8_t format, FILE *);
+
+/**
+ * @brief Writes all entries of a tree to a file descriptor.
+ * Partial writes and interrupted calls are retried.
+ *
+ * @return uint8_t  Same as exportTreeToFile().
+ */
+uint8_t exportTreeToFd(const bnode_t *, uint8_t family, uint8_t format, int fd);
+
+/**
+ * @brief Writes all entries of a tree to a new memory buffer.
+ *
+ * @param data      Output; the buffer, to be freed by the caller.
+ *                  Text output is null-terminated.
+ * @param length    Output; the number of bytes written, without the null byte.
+ * @return uint8_t  Same as exportTreeToFile().
+ */
+uint8_t exportTreeToMemory(const bnode_t *, uint8_t family, uint8_t format, char **data, size_t *length);
+
+#endif
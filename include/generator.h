@@ -0,0 +1,69 @@
+/**
+ * @file generator.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Synthetic list and traffic generator public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <stdint.h>
+#include "ip.h"
+
+/**
+ * @brief Fills an array with a synthetic IPv4 blacklist.
+ *
+ * The same seed always produces the same list. The prefix sizes follow
+ * a typical blacklist: 85% /32 hosts, 10% /24 networks, 3% /16 to /23
+ * and 2% /25 to /31. Most hosts and /24 networks lie in a pool of /16
+ * clusters, so entries share network prefixes the way real feeds do,
+ * while the wider ranges are spread out and seldom cover other entries.
+ * Host bits of ranges are cleared.
+ *
+ * @param list   Output array of count entries.
+ * @param count  Number of entries to generate.
+ * @param seed   Random seed.
+ */
+void generateIPv4List(ipv4_t *list, uint64_t count, uint64_t seed);
+
+/**
+ * @brief Fills an array with a synthetic IPv6 blacklist.
+ *
+ * Addresses lie in 2000::/3. The prefix sizes are 80% /128 hosts,
+ * 12% /48 networks, 5% /64 subnets and 3% /32 to /47, with most hosts,
+ * subnets and /48 networks clustered in a pool of /32 networks.
+ * See generateIPv4List() for details.
+ */
+void generateIPv6List(ipv6_t *list, uint64_t count, uint64_t seed);
+
+/**
+ * @brief Fills an array with single-address IPv4 queries against a list.
+ *
+ * A fraction hit_rate of the queries falls inside a list entry; the other
+ * queries are guaranteed misses. Both hits and misses are drawn from
+ * Zipf-distributed ranks with exponent skew, so a few addresses recur
+ * often, as in real traffic. A skew of 0 draws ranks uniformly.
+ *
+ * @param list        Entries produced by generateIPv4List() or read from a file.
+ * @param list_count  Number of list entries; if 0, every query is a miss.
+ * @param queries     Output array of count queries.
+ * @param count       Number of queries to generate.
+ * @param hit_rate    Fraction of hits, between 0 and 1.
+ * @param skew        Zipf exponent, 0 or more.
+ * @param seed        Random seed.
+ * @return uint8_t    0 on success, 1 if no miss could be found because the
+ *                    list covers (nearly) all addresses; the queries are
+ *                    then incomplete.
+ */
+uint8_t generateIPv4Queries(const ipv4_t *list, uint64_t list_count, ipv4_t *queries, uint64_t count, double hit_rate, double skew, uint64_t seed);
+
+/**
+ * @brief Fills an array with single-address IPv6 queries against a list.
+ * See generateIPv4Queries() for details.
+ *
+ * @return uint8_t  0 on success, 1 if no miss could be found.
+ */
+uint8_t generateIPv6Queries(const ipv6_t *list, uint64_t list_count, ipv6_t *queries, uint64_t count, double hit_rate, double skew, uint64_t seed);
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file heavyhit.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Heavy-hitter detection on lookup traffic public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef HEAVYHIT_H_
+#define HEAVYHIT_H_
+
+#include <stdint.h>
+#include "btree.h"
+#include "ip.h"
+
+/**
+ * @brief Prefix sizes of the networks that are counted next to single addresses.
+ */
+#define HEAVY_IPV4_NETWORK 24
+#define HEAVY_IPV6_NETWORK 64
+
+/**
+ * @brief Called once per window when an address or network reaches its threshold.
+ *
+ * @param context  Pointer given to setHeavyCallbacks().
+ * @param prefix   The address (/32 or /128) or network (/24 or /64).
+ * @param count    Estimated queries in the window, at least the threshold.
+ */
+typedef void (*ipv4heavy_t)(void *context, ipv4_t prefix, uint32_t count);
+typedef void (*ipv6heavy_t)(void *context, ipv6_t prefix, uint32_t count);
+
+/**
+ * @brief Count-min sketch of queried addresses and networks per time window.
+ *
+ * Every observed address is counted as itself and as its /24 (IPv4) or
+ * /64 (IPv6) network, in depth rows of width counters: constant memory,
+ * however many sources there are. Counts may be too high, never too low,
+ * and collisions can lift an estimate past a threshold in one step, so a
+ * key is reported on the first query at or above its threshold. The keys
+ * reported in the current window are kept in small trees, so each is
+ * reported once per window.
+ *
+ * Times are in seconds, on any clock that does not go backwards. When a
+ * window ends, all counts start again at 0.
+ *
+ * Not thread-safe: use one sketch per thread, or feed one sketch from a
+ * single thread.
+ */
+typedef struct
+{
+    uint32_t *counts;            // counts[row * width + column].
+    uint32_t width;              // Power of two.
+    uint8_t depth;
+    uint64_t window;
+    uint64_t window_start;
+    uint32_t host_threshold;     // 0 disables.
+    uint32_t network_threshold;  // 0 disables.
+    bnode_t *ipv4_target;        // Tree that heavy IPv4 prefixes are added to, or NULL.
+    bnode_t *ipv6_target;
+    ipv4heavy_t ipv4_callback;   // Or NULL.
+    ipv6heavy_t ipv6_callback;
+    void *context;
+    bnode_t *reported_hosts[2];    // Reported this window: IPv4, IPv6.
+    bnode_t *reported_networks[2];
+} heavysketch_t;
+
+/**
+ * @brief Returns an empty sketch with both thresholds disabled.
+ *
+ * @param width     Counters per row, rounded up to a power of two.
+ *                  The overcount is about 2 * queries / width.
+ * @param depth     Rows, 1 to 8; the overcount exceeds that bound with
+ *                  probability 2^-depth.
+ * @param window    Window length in seconds, at least 1.
+ * @param now       Start of the first window.
+ * @return heavysketch_t*  The sketch, or NULL if a parameter is invalid.
+ */
+heavysketch_t *createHeavySketch(uint32_t width, uint8_t depth, uint64_t window, uint64_t now);
+
+/**
+ * @brief Frees a sketch, not its target trees. Passing NULL is allowed.
+ */
+void deleteHeavySketch(heavysketch_t *);
+
+/**
+ * @brief Sets the number of queries per window at which an address or
+ * a network is reported. 0 disables either.
+ */
+void setHeavyThresholds(heavysketch_t *, uint32_t host, uint32_t network);
+
+/**
+ * @brief Sets the trees that heavy prefixes are inserted in. NULL
+ * disables either.
+ *
+ * observeIPv4() and observeIPv6() insert into these trees without any
+ * locking, so the thread that feeds the sketch needs exclusive access to
+ * them: no other thread may look them up or change them meanwhile. If the
+ * trees are looked up by other threads, e.g. a batch engine or sharded
+ * readers, leave the targets NULL and have the callbacks queue the
+ * prefixes for the thread that writes the trees.
+ */
+void setHeavyTargets(heavysketch_t *, bnode_t *ipv4_target, bnode_t *ipv6_target);
+
+/**
+ * @brief Sets the functions called for heavy prefixes. NULL disables either.
+ */
+void setHeavyCallbacks(heavysketch_t *, ipv4heavy_t, ipv6heavy_t, void *context);
+
+/**
+ * @brief Counts a query from an IPv4 address.
+ *
+ * @param now       Current time in seconds.
+ * @return uint8_t  Bit 0 set if the address was reported with this query,
+ *                  bit 1 if its network was; 0 otherwise, or if the
+ *                  address is invalid or not a /32.
+ */
+uint8_t observeIPv4(heavysketch_t *, ipv4_t, uint64_t now);
+
+/**
+ * @brief Counts a query from an IPv6 address, see observeIPv4().
+ */
+uint8_t observeIPv6(heavysketch_t *, ipv6_t, uint64_t now);
+
+/**
+ * @brief Returns the estimated queries of an IPv4 address (/32) or
+ * network (/24) in the window of the last observed query. Other prefix
+ * sizes give 0.
+ */
+uint32_t estimateIPv4(const heavysketch_t *, ipv4_t);
+
+/**
+ * @brief Returns the estimated queries of an IPv6 address (/128) or
+ * network (/64), see estimateIPv4().
+ */
+uint32_t estimateIPv6(const heavysketch_t *, ipv6_t);
+
+#endif
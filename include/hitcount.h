@@ -0,0 +1,138 @@
+/**
+ * @file hitcount.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Per-entry hit counters public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef HITCOUNT_H_
+#define HITCOUNT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "btree.h"
+#include "ip.h"
+
+/**
+ * @brief Entry ID of an address that is not listed.
+ */
+#define HIT_NO_ID UINT32_MAX
+
+/**
+ * @brief Hit counters for the entries of one tree.
+ *
+ * Every leaf of the tree gets an ID, in address order, which is found
+ * from the leaf pointer through a hash table. Every lookup thread counts
+ * in its own array of counters (its shard), padded to whole cache lines,
+ * so counting needs no atomic read-modify-write and no cache line is
+ * written by two threads. Reading a count adds up all shards.
+ *
+ * The IDs are taken when the counter is created: entries added to the
+ * tree later are not counted, and the tree must not lose entries while
+ * the counter is in use. Create a new counter after reloading a list.
+ */
+typedef struct
+{
+    const bnode_t *root;
+    uint8_t family;              // 4 or 6.
+    uint32_t entry_count;
+    ipv6_t *entries;             // entries[id]; IPv4 prefixes in .ip[0] and .ip[1].
+    const bnode_t **leaves;      // Hash table of leaf pointers, NULL for an empty slot.
+    uint32_t *ids;               // ids[slot] is the ID of leaves[slot].
+    uint32_t slot_count;         // Power of two.
+    uint16_t shard_count;
+    uint64_t **counts;           // counts[shard][id].
+} hitcounter_t;
+
+/**
+ * @brief An entry and its number of hits, see getTopHits().
+ */
+typedef struct
+{
+    uint32_t id;
+    uint64_t hits;
+} hitentry_t;
+
+/**
+ * @brief Numbers the entries of a tree and sets up zeroed counters.
+ *
+ * @param family        4 or 6.
+ * @param shards        Number of counter arrays, normally one per lookup thread.
+ * @return hitcounter_t*  The counter, or NULL if family or shards is invalid
+ *                        or the counts cannot be allocated.
+ */
+hitcounter_t *createHitCounter(const bnode_t *root, uint8_t family, uint16_t shards);
+
+/**
+ * @brief Frees a counter, not the tree. Passing NULL is allowed.
+ */
+void deleteHitCounter(hitcounter_t *);
+
+/**
+ * @brief Returns the ID of the entry an IPv4 address falls in.
+ *
+ * @return uint32_t  The ID, or HIT_NO_ID if the address is not listed.
+ */
+uint32_t getIPv4HitId(const hitcounter_t *, ipv4_t);
+
+/**
+ * @brief Returns the ID of the entry an IPv6 address falls in.
+ *
+ * @return uint32_t  The ID, or HIT_NO_ID if the address is not listed.
+ */
+uint32_t getIPv6HitId(const hitcounter_t *, ipv6_t);
+
+/**
+ * @brief Same as findIPv4Address(), counting a hit on the matching entry.
+ * Every shard must be used by one thread at a time.
+ *
+ * @param shard     Counter array of the calling thread, below the shard count.
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv4Counted(hitcounter_t *, uint16_t shard, ipv4_t);
+
+/**
+ * @brief Same as findIPv6Address(), counting a hit on the matching entry.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv6Counted(hitcounter_t *, uint16_t shard, ipv6_t);
+
+/**
+ * @brief Returns the hits of an entry, over all shards. May run while
+ * lookups count; the result then misses the hits still in flight.
+ */
+uint64_t getHitCount(const hitcounter_t *, uint32_t id);
+
+/**
+ * @brief Returns the prefix of an IPv4 entry ID.
+ */
+ipv4_t getHitIPv4Prefix(const hitcounter_t *, uint32_t id);
+
+/**
+ * @brief Returns the prefix of an IPv6 entry ID.
+ */
+ipv6_t getHitIPv6Prefix(const hitcounter_t *, uint32_t id);
+
+/**
+ * @brief Finds the entries with the most hits; entries without hits are left out.
+ *
+ * @param top        Output, room for max entries; most hits first, and
+ *                   entries with as many hits in address order.
+ * @return uint32_t  Number of entries written.
+ */
+uint32_t getTopHits(const hitcounter_t *, hitentry_t *top, uint32_t max);
+
+/**
+ * @brief Writes the max entries with the most hits, one "prefix hits" per line.
+ *
+ * @return uint32_t  Number of lines written.
+ */
+uint32_t printTopHits(FILE *, const hitcounter_t *, uint32_t max);
+
+/**
+ * @brief Sets all counts to 0. Hits counted at the same time may be lost.
+ */
+void resetHitCounts(hitcounter_t *);
+
+#endif
@@ -9,6 +9,7 @@
 #define IP_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 /**
  * @brief arpa/inet.h defines INET_ADDRSTRLEN and INET6_ADDRSTRLEN,
@@ -78,6 +79,94 @@ ipv4_t read_ipv4(const char *ipv4_string);
  */
 ipv6_t read_ipv6(const char *ipv6_string);
 
+/**
+ * @brief Converts a string of known length to ipv4_t.
+ *
+ * @param ipv4_string  Input string; need not be null-terminated.
+ * @param length       Number of characters to read.
+ * @return ipv4_t
+ *
+ * Accepts the same input as read_ipv4(), without copying it and without
+ * calling inet_pton(), so addresses can be parsed straight out of a large
+ * input buffer. Invalid prefix sizes are not reported on stderr.
+ * Use .ps == 0 to check for invalid input.
+ */
+ipv4_t read_ipv4_n(const char *ipv4_string, size_t length);
+
+/**
+ * @brief Converts a string of known length to ipv6_t.
+ *
+ * @param ipv6_string  Input string; need not be null-terminated.
+ * @param length       Number of characters to read.
+ * @return ipv6_t
+ *
+ * Accepts the same input as read_ipv6().
+ * Use .ps == 0 to check for invalid input.
+ */
+ipv6_t read_ipv6_n(const char *ipv6_string, size_t length);
+
+/**
+ * @brief Most prefixes that an IPv4 or IPv6 start-end range can take.
+ */
+#define IPV4_RANGE_MAX_PREFIXES 62
+#define IPV6_RANGE_MAX_PREFIXES 254
+
+/**
+ * @brief Parses an IPv4 start-end range such as "1.2.3.4-1.2.5.200".
+ *
+ * @param ipv4_string  Input string; need not be null-terminated.
+ * @param length       Number of characters to read.
+ * @param first        Output; the first address of the range.
+ * @param last         Output; the last address of the range.
+ * @return uint8_t     1 if valid, 0 if not. Both ends must be single
+ *                     addresses without whitespace, and first <= last.
+ */
+uint8_t read_ipv4_range_n(const char *ipv4_string, size_t length, uint32_t *first, uint32_t *last);
+
+/**
+ * @brief Parses an IPv6 start-end range such as "2001:db8::5-2001:db8::1:0".
+ * See read_ipv4_range_n().
+ *
+ * @param first  Output; 8 groups.
+ * @param last   Output; 8 groups.
+ */
+uint8_t read_ipv6_range_n(const char *ipv6_string, size_t length, uint16_t *first, uint16_t *last);
+
+/**
+ * @brief Splits an IPv4 range into the fewest prefixes that cover
+ * exactly the addresses from first to last, in address order.
+ *
+ * @param prefixes  Output array of IPV4_RANGE_MAX_PREFIXES entries.
+ * @return uint8_t  Number of prefixes; 0 if first > last.
+ */
+uint8_t ipv4_range_to_prefixes(uint32_t first, uint32_t last, ipv4_t *prefixes);
+
+/**
+ * @brief Splits an IPv6 range into the fewest covering prefixes.
+ * See ipv4_range_to_prefixes().
+ *
+ * @param prefixes  Output array of IPV6_RANGE_MAX_PREFIXES entries.
+ */
+uint8_t ipv6_range_to_prefixes(const uint16_t *first, const uint16_t *last, ipv6_t *prefixes);
+
+/**
+ * @brief Parses one list entry: an address, a CIDR range or a start-end
+ * range, as the prefixes that cover it.
+ *
+ * @param entry     Input string; need not be null-terminated.
+ * @param length    Number of characters to read.
+ * @param prefixes  Output array of IPV4_RANGE_MAX_PREFIXES entries.
+ * @return uint8_t  Number of prefixes; 0 if the entry is invalid.
+ */
+uint8_t read_ipv4_entry_n(const char *entry, size_t length, ipv4_t *prefixes);
+
+/**
+ * @brief Parses one IPv6 list entry. See read_ipv4_entry_n().
+ *
+ * @param prefixes  Output array of IPV6_RANGE_MAX_PREFIXES entries.
+ */
+uint8_t read_ipv6_entry_n(const char *entry, size_t length, ipv6_t *prefixes);
+
 /**
  * @brief Converts an ipv4_t type to a human-readable string.
  * 
@@ -94,4 +183,74 @@ void ipv4tostring(char *string_buffer, ipv4_t ip);
  */
 void ipv6tostring(char *string_buffer, ipv6_t ip);
 
+/**
+ * @brief Writes the same string as ipv4tostring(), without inet_ntop().
+ *
+ * @param string_buffer  Holds the resulting null-terminated string;
+ *                       IPSTRLENV4 bytes are enough.
+ * @param ip             Input.
+ * @return size_t        Length of the string, without the null byte.
+ */
+size_t format_ipv4(char *string_buffer, ipv4_t ip);
+
+/**
+ * @brief Writes the same string as ipv6tostring(), without inet_ntop().
+ * Like inet_ntop(), it compresses the longest run of zero groups and
+ * writes IPv4-mapped and IPv4-compatible addresses in dotted form.
+ *
+ * @param string_buffer  Holds the resulting null-terminated string;
+ *                       IPSTRLENV6 bytes are enough.
+ * @param ip             Input.
+ * @return size_t        Length of the string, without the null byte.
+ */
+size_t format_ipv6(char *string_buffer, ipv6_t ip);
+
+/**
+ * @brief Returns the network mask of an IPv4 prefix size: prefix_size
+ * leading one bits, 0 for a prefix size of 0.
+ */
+uint32_t ipv4_netmask(uint8_t prefix_size);
+
+/**
+ * @brief Returns the network mask of one group of an IPv6 address.
+ *
+ * @param group  0 to 7, most significant first.
+ */
+uint16_t ipv6_group_mask(uint8_t prefix_size, uint8_t group);
+
+/**
+ * @brief Clears the bits of an address past prefix_size.
+ *
+ * @return ipv4_t  The network, with .ps set to prefix_size.
+ */
+ipv4_t mask_ipv4(ipv4_t ip, uint8_t prefix_size);
+
+/**
+ * @brief Clears the bits of an address past prefix_size, see mask_ipv4().
+ */
+ipv6_t mask_ipv6(ipv6_t ip, uint8_t prefix_size);
+
+/**
+ * @brief Returns bit depth of an address kept as 16-bit groups, most
+ * significant group first: an IPv4 address is two groups, an IPv6
+ * address eight. Inline, as trie walks call it for every bit.
+ */
+static inline uint8_t group_bit(const uint16_t *groups, uint8_t depth)
+{
+    return (uint8_t)((groups[depth >> 4] >> (15 - (depth & 15))) & 1);
+}
+
+/**
+ * @brief Mixes all bits of a 64-bit key into all bits of the result
+ * (the splitmix64 finalizer), for hash tables and filters over addresses.
+ */
+static inline uint64_t mix_bits(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
 #endif
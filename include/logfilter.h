@@ -0,0 +1,65 @@
+/**
+ * @file logfilter.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Access log filter public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef LOGFILTER_H_
+#define LOGFILTER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "btree.h"
+
+/**
+ * @brief Field layout of the Common and Combined Log Formats:
+ * the client address is the first space-separated field.
+ */
+#define LOG_DELIMITER_CLF ' '
+#define LOG_FIELD_CLF 0
+
+/**
+ * @brief Locates a field in a log line without parsing the rest of it.
+ *
+ * Fields are separated by single delimiter characters; two adjacent
+ * delimiters enclose an empty field. The delimiters are searched 16 bytes
+ * at a time where SSE2 is available.
+ *
+ * @param line          Start of the line; need not be null-terminated.
+ * @param length        Length of the line, without the line terminator.
+ * @param delimiter     Field separator.
+ * @param field         Index of the field, starting at 0.
+ * @param field_length  Output; length of the field.
+ * @return const char*  Start of the field inside the line,
+ *                      or NULL if the line has too few fields.
+ */
+const char *findLogField(const char *line, size_t length, char delimiter, uint16_t field, size_t *field_length);
+
+/**
+ * @brief Writes the lines of an access log whose address field occurs
+ * in one of the trees.
+ *
+ * The address field is handed to the parser in place, without copying.
+ * Consecutive matching lines are written with a single fwrite().
+ *
+ * @param ipv4_root  IPv4 tree; may be NULL.
+ * @param ipv6_root  IPv6 tree; may be NULL.
+ * @param buffer     Log contents, e.g. a memory-mapped file.
+ * @param size       Size of the buffer.
+ * @param delimiter  Field separator.
+ * @param field      Index of the address field, starting at 0.
+ * @param out        Output stream for matching lines; may be NULL.
+ * @return uint64_t  Number of matching lines.
+ */
+uint64_t filterAccessLog(bnode_t *ipv4_root, bnode_t *ipv6_root, const char *buffer, size_t size, char delimiter, uint16_t field, FILE *out);
+
+/**
+ * @brief Memory-maps an access log and filters it with filterAccessLog().
+ *
+ * @return uint64_t  Number of matching lines, 0 if the file cannot be read.
+ */
+uint64_t filterAccessLogFile(bnode_t *ipv4_root, bnode_t *ipv6_root, const char *filename, char delimiter, uint16_t field, FILE *out);
+
+#endif
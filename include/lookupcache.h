@@ -0,0 +1,103 @@
+/**
+ * @file lookupcache.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Per-thread lookup result cache public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef LOOKUPCACHE_H_
+#define LOOKUPCACHE_H_
+
+#include <stdint.h>
+#include "btree.h"
+#include "ip.h"
+
+/**
+ * @brief Cached IPv4 result. Two of them share a set; with 8 bytes each,
+ * a 64-byte cache line holds four sets.
+ */
+typedef struct
+{
+    uint32_t ip;
+    uint8_t valid;
+    uint8_t found;
+} ipv4cacheentry_t;
+
+/**
+ * @brief Cached IPv6 result.
+ */
+typedef struct
+{
+    uint64_t high;
+    uint64_t low;
+    uint8_t valid;
+    uint8_t found;
+} ipv6cacheentry_t;
+
+/**
+ * @brief 2-way set-associative cache of lookup results for one IPv4 and
+ * one IPv6 tree, keyed by the full address.
+ *
+ * Meant for skewed traffic, where the same clients come back often: a
+ * cached result costs one hash and one cache line instead of a walk down
+ * the tree. Every lookup thread needs its own cache; a cache is not
+ * thread-safe, but any number of caches may share the trees.
+ *
+ * The cache watches its trees (see watchTree()): when one of them
+ * changes, the half of the cache for that family empties itself, so it
+ * never returns a stale result. Changes to other trees do not matter.
+ */
+typedef struct
+{
+    bnode_t *ipv4_root;          // Either may be NULL.
+    bnode_t *ipv6_root;
+    uint32_t set_count;          // Power of two.
+    uint8_t set_bits;
+    ipv4cacheentry_t (*ipv4_sets)[2];
+    ipv6cacheentry_t (*ipv6_sets)[2];
+    const uint64_t *ipv4_watch;  // Generations of the trees, see watchTree().
+    const uint64_t *ipv6_watch;
+    uint64_t ipv4_generation;    // Generation the IPv4 entries belong to.
+    uint64_t ipv6_generation;
+    uint64_t hits;
+    uint64_t misses;
+} lookupcache_t;
+
+/**
+ * @brief Returns an empty cache in front of the given trees.
+ *
+ * @param sets       Sets per family, rounded up to a power of two;
+ *                   every set holds two addresses.
+ * @return lookupcache_t*  The cache, or NULL if sets is 0 or above 2^24,
+ *                         or a tree cannot be watched.
+ */
+lookupcache_t *createLookupCache(bnode_t *ipv4_root, bnode_t *ipv6_root, uint32_t sets);
+
+/**
+ * @brief Frees a cache, not its trees. Passing NULL is allowed.
+ */
+void deleteLookupCache(lookupcache_t *);
+
+/**
+ * @brief Empties a cache.
+ */
+void clearLookupCache(lookupcache_t *);
+
+/**
+ * @brief Same as findIPv4Address() on the IPv4 tree of the cache.
+ * Only addresses (/32) are cached; ranges are looked up in the tree.
+ * Cached results are not counted in the lookup metrics.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv4Cached(lookupcache_t *, ipv4_t);
+
+/**
+ * @brief Same as findIPv6Address() on the IPv6 tree of the cache.
+ * Only addresses (/128) are cached.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv6Cached(lookupcache_t *, ipv6_t);
+
+#endif
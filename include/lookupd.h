@@ -0,0 +1,129 @@
+/**
+ * @file lookupd.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Lookup daemon and client public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef LOOKUPD_H_
+#define LOOKUPD_H_
+
+#include <stdint.h>
+#include "ip.h"
+#include "btree.h"
+
+/**
+ * @brief Wire protocol over a Unix domain stream socket.
+ *
+ * A request is a lookupd_header_t followed by .count addresses:
+ * 4 bytes per IPv4 address (the value of ipv4_t.ip) or 16 bytes per
+ * IPv6 address (the 8 groups of ipv6_t.ip), all in host byte order.
+ * Every address is looked up as a single host (/32 or /128).
+ *
+ * The response is a lookupd_header_t with the same .type and .count,
+ * followed by a bitmap of (.count + 7) / 8 bytes: bit (i % 8) of byte
+ * (i / 8) is set if address i was found.
+ *
+ * A request of type LOOKUPD_METRICS carries no addresses (.count is 0).
+ * Its response is a lookupd_header_t whose .count is the length of the
+ * text that follows: a Prometheus snapshot of the lookup metrics,
+ * see metrics.h.
+ *
+ * A client may pipeline several requests; responses come back in order.
+ * A malformed request closes the connection.
+ */
+#define LOOKUPD_MAGIC 0x4C49
+#define LOOKUPD_QUERY_IPV4 4
+#define LOOKUPD_QUERY_IPV6 6
+#define LOOKUPD_METRICS 'M'
+#define LOOKUPD_MAX_ADDRESSES 65536
+
+typedef struct
+{
+    uint16_t magic;
+    uint8_t type;
+    uint8_t reserved;
+    uint32_t count;
+} lookupd_header_t;
+
+/**
+ * @brief Server state. The trees are borrowed, not owned.
+ */
+typedef struct lookupd
+{
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    bnode_t *ipv4_root;
+    bnode_t *ipv6_root;
+    char *socket_path;
+    struct lookupdconn *connections;
+} lookupd_t;
+
+/**
+ * @brief Creates a server listening on a Unix domain socket.
+ * A stale socket file at the same path is replaced. If the path is
+ * another kind of file, or a server is listening on it, nothing is
+ * touched and NULL is returned.
+ *
+ * @param socket_path  File system path of the socket.
+ * @param ipv4_root    IPv4 tree to serve.
+ * @param ipv6_root    IPv6 tree to serve.
+ * @return lookupd_t*  NULL if the socket cannot be set up.
+ */
+lookupd_t *createLookupd(const char *socket_path, bnode_t *ipv4_root, bnode_t *ipv6_root);
+
+/**
+ * @brief Serves requests until stopLookupd() is called.
+ *
+ * @return int  0 on a regular stop, -1 if the event loop failed.
+ */
+int runLookupd(lookupd_t *);
+
+/**
+ * @brief Makes runLookupd() return. Safe to call from a signal handler
+ * or from another thread.
+ */
+void stopLookupd(lookupd_t *);
+
+/**
+ * @brief Closes all connections, removes the socket file and frees the server.
+ */
+void deleteLookupd(lookupd_t *);
+
+/**
+ * @brief Connects to a server.
+ *
+ * @return int  Connected socket, or -1 on failure.
+ */
+int connectLookupd(const char *socket_path);
+
+/**
+ * @brief Looks up a batch of IPv4 addresses in one round trip.
+ *
+ * @param fd         Socket returned by connectLookupd().
+ * @param addresses  Addresses to look up; the prefix sizes are ignored.
+ * @param count      Number of addresses, at most LOOKUPD_MAX_ADDRESSES.
+ * @param bitmap     Output; must hold at least (count + 7) / 8 bytes.
+ * @return int       0 on success, -1 on failure.
+ */
+int queryLookupdIPv4(int fd, const ipv4_t *addresses, uint32_t count, uint8_t *bitmap);
+
+/**
+ * @brief Looks up a batch of IPv6 addresses in one round trip.
+ * See queryLookupdIPv4() for details.
+ *
+ * @return int  0 on success, -1 on failure.
+ */
+int queryLookupdIPv6(int fd, const ipv6_t *addresses, uint32_t count, uint8_t *bitmap);
+
+/**
+ * @brief Fetches the server's metrics in the Prometheus text format.
+ *
+ * @param fd    Socket returned by connectLookupd().
+ * @param text  Output; null-terminated text, to be freed by the caller.
+ * @return int  0 on success, -1 on failure.
+ */
+int queryLookupdMetrics(int fd, char **text);
+
+#endif
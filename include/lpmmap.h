@@ -0,0 +1,122 @@
+/**
+ * @file lpmmap.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Longest-prefix-match map public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef LPMMAP_H_
+#define LPMMAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ip.h"
+
+/**
+ * @brief Value ID of a node or lookup without a value.
+ */
+#define LPM_NO_VALUE 0
+
+/**
+ * @brief Node in a longest-prefix-match tree.
+ * Like bnode_t, the value of a node follows from its parent. A node
+ * with .value != LPM_NO_VALUE ends an inserted prefix; unlike in a
+ * bnode_t tree, more specific prefixes with other values may lie below it.
+ */
+typedef struct lnode
+{
+    struct lnode *child[2];
+    uint32_t value;
+} lnode_t;
+
+/**
+ * @brief Map from IPv4 and IPv6 prefixes to values.
+ * Values are strings, interned in a table: every distinct string is
+ * stored once and known by a 32-bit ID, starting at 1. The trees only
+ * hold the IDs.
+ */
+typedef struct
+{
+    lnode_t *ipv4_root;
+    lnode_t *ipv6_root;
+    char **values;           // values[id - 1] is the string of ID id.
+    uint32_t value_count;
+    uint32_t value_capacity;
+    uint32_t *slots;         // Hash table of IDs, 0 for an empty slot.
+    uint32_t slot_count;     // Power of two.
+} lpmmap_t;
+
+/**
+ * @brief Returns an empty map.
+ */
+lpmmap_t *createLpmMap(void);
+
+/**
+ * @brief Frees a map, its trees and its values.
+ * Passing NULL is allowed and does nothing.
+ */
+void deleteLpmMap(lpmmap_t *);
+
+/**
+ * @brief Returns the ID of a value, adding it to the table if it is new.
+ *
+ * @param value     Value string; need not be null-terminated.
+ * @param length    Length of the value.
+ * @return uint32_t The ID, from 1 up.
+ */
+uint32_t internLpmValue(lpmmap_t *, const char *value, size_t length);
+
+/**
+ * @brief Returns the string of a value ID.
+ *
+ * @return const char*  The value, or NULL for LPM_NO_VALUE or an unknown ID.
+ */
+const char *getLpmValue(const lpmmap_t *, uint32_t id);
+
+/**
+ * @brief Maps an IPv4 prefix to a value ID.
+ *
+ * @param value     ID returned by internLpmValue().
+ * @return uint8_t  0 if added, 1 if the prefix was already in the map
+ *                  and its value was replaced, 2 if the prefix or the
+ *                  value is invalid.
+ */
+uint8_t insertLpmIPv4(lpmmap_t *, ipv4_t, uint32_t value);
+
+/**
+ * @brief Maps an IPv6 prefix to a value ID.
+ *
+ * @return uint8_t  Same as insertLpmIPv4().
+ */
+uint8_t insertLpmIPv6(lpmmap_t *, ipv6_t, uint32_t value);
+
+/**
+ * @brief Finds the most specific prefix that contains an IPv4 address.
+ *
+ * @param match      Output, may be NULL; the matching prefix,
+ *                   or .ip = 0 and .ps = 0 if none matched.
+ * @return uint32_t  Value ID of the prefix, or LPM_NO_VALUE.
+ */
+uint32_t lookupLpmIPv4(const lpmmap_t *, ipv4_t, ipv4_t *match);
+
+/**
+ * @brief Finds the most specific prefix that contains an IPv6 address.
+ * See lookupLpmIPv4().
+ */
+uint32_t lookupLpmIPv6(const lpmmap_t *, ipv6_t, ipv6_t *match);
+
+/**
+ * @brief Adds the entries of a CSV file to a map.
+ *
+ * Every line holds a prefix and a value, separated by the first comma,
+ * e.g. "1.2.3.0/24,AS1234" or "2001:db8::/32,AS64496". Spaces around
+ * both fields are ignored; the value is taken as is, without unquoting.
+ * Empty lines and lines starting with # are skipped, as are lines with
+ * an invalid prefix or without a value. A prefix that occurs twice keeps
+ * its last value.
+ *
+ * @return uint8_t  0 if the file was read, 1 if it could not be opened.
+ */
+uint8_t loadLpmMapFile(lpmmap_t *, const char *filename);
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file metrics.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Lookup counters and latency histogram public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * @brief Latency histogram layout, in the style of HdrHistogram:
+ * values below 16 ns get a bucket each; every further power of two
+ * is split into 16 equal buckets, so a bucket is at most 1/16 (6.25%)
+ * wider than its lower bound. Values of 2^40 ns (about 18 minutes)
+ * and more fall in the last bucket.
+ */
+#define METRICS_SUB_BUCKET_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_EXPONENT 40
+#define METRICS_HISTOGRAM_BUCKETS (METRICS_SUB_BUCKETS * (METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS + 1))
+
+/**
+ * @brief Number of counter shards. Threads are spread over the shards
+ * round robin, so up to this many threads update without sharing a
+ * cache line.
+ */
+#define METRICS_SHARDS 64
+
+#define METRICS_IPV4 0
+#define METRICS_IPV6 1
+
+/**
+ * @brief Snapshot of all counters, summed over the shards.
+ */
+typedef struct
+{
+    uint64_t hits[2];                                // Per family: METRICS_IPV4, METRICS_IPV6.
+    uint64_t misses[2];
+    uint64_t parse_failures[2];                      // Lookups of an address that could not be parsed.
+    uint64_t latency_sum;                            // In nanoseconds.
+    uint64_t histogram[METRICS_HISTOGRAM_BUCKETS];   // Lookup latencies.
+} metrics_t;
+
+/**
+ * @brief Turns the counting in findIPv4Address() and findIPv6Address()
+ * on or off. It is off by default; while off, a lookup only pays for
+ * one extra branch. While on, it also pays for two clock reads.
+ */
+void setMetricsEnabled(uint8_t enabled);
+
+/**
+ * @brief Checks if counting is on.
+ *
+ * @return uint8_t  1 if on, 0 if off.
+ */
+uint8_t metricsEnabled(void);
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+uint64_t metricsClock(void);
+
+/**
+ * @brief Counts a lookup that started at metricsClock() time start.
+ *
+ * @param family  METRICS_IPV4 or METRICS_IPV6.
+ * @param found   1 for a hit, 0 for a miss.
+ * @param start   Timestamp taken before the lookup.
+ */
+void recordLookup(uint8_t family, uint8_t found, uint64_t start);
+
+/**
+ * @brief Counts a lookup of an address that could not be parsed.
+ */
+void recordParseFailure(uint8_t family);
+
+/**
+ * @brief Sums the shards into a snapshot. Counters keep running, so
+ * the snapshot is not atomic as a whole, but every counter in it is.
+ */
+void getMetrics(metrics_t *);
+
+/**
+ * @brief Clears all counters.
+ */
+void resetMetrics(void);
+
+/**
+ * @brief Returns the latency below which a fraction q of the lookups fell.
+ *
+ * @param q          Quantile, between 0 and 1, e.g. 0.999.
+ * @return uint64_t  Upper bound of the histogram bucket, in nanoseconds;
+ *                   0 if no lookups were counted.
+ */
+uint64_t getMetricsQuantile(const metrics_t *, double q);
+
+/**
+ * @brief Writes a snapshot in the Prometheus text exposition format.
+ *
+ * @return uint8_t  0 on success, 1 on a write error.
+ */
+uint8_t writeMetrics(FILE *);
+
+/**
+ * @brief Writes a snapshot to a file, replacing it atomically, so that
+ * a collector never reads a half-written file.
+ *
+ * @return uint8_t  0 on success, 1 if the file could not be written.
+ */
+uint8_t writeMetricsFile(const char *filename);
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file multilist.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Multi-list membership tree public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef MULTILIST_H_
+#define MULTILIST_H_
+
+#include <stdint.h>
+#include "ip.h"
+
+/**
+ * @brief Maximum number of lists in one tree: one bit of a uint64_t each.
+ */
+#define MULTILIST_MAX_LISTS 64
+
+/**
+ * @brief Node in a binary tree that holds several lists at once.
+ * Like bnode_t, the value of a node follows from its parent. Bit i of
+ * .mask is set if list i contains the prefix that ends at this node.
+ *
+ * Unlike in a bnode_t tree, a prefix does not end the path: a more
+ * specific entry of another list may lie below it. Within one list, a
+ * prefix still absorbs the more specific entries of that list.
+ */
+typedef struct mnode
+{
+    struct mnode *child[2];
+    uint64_t mask;
+} mnode_t;
+
+/**
+ * @brief Returns a pointer to an empty mnode.
+ *
+ * @return mnode_t*
+ */
+mnode_t *createMultiNode(void);
+
+/**
+ * @brief Frees a node and everything below it.
+ * Passing NULL is allowed and does nothing.
+ */
+void deleteMultiTree(mnode_t *);
+
+/**
+ * @brief Adds a parsed IPv4 address or range to one list of a tree.
+ *
+ * @param list      List number, below MULTILIST_MAX_LISTS.
+ * @return uint8_t  0 if successfully added, 1 if the address (or an
+ *                  encompassing range) is already in that list,
+ *                  2 if the address or list number is invalid.
+ */
+uint8_t insertMultiIPv4Address(mnode_t *, ipv4_t, uint8_t list);
+
+/**
+ * @brief Adds a parsed IPv6 address or range to one list of a tree.
+ *
+ * @return uint8_t  Same as insertMultiIPv4Address().
+ */
+uint8_t insertMultiIPv6Address(mnode_t *, ipv6_t, uint8_t list);
+
+/**
+ * @brief Returns the lists that contain an IPv4 address, in one walk.
+ *
+ * @return uint64_t  Bit i is set if list i contains the address;
+ *                   0 if no list does or the address is invalid.
+ */
+uint64_t lookupMultiIPv4Address(mnode_t *, ipv4_t);
+
+/**
+ * @brief Same as lookupMultiIPv4Address(), for an address string.
+ */
+uint64_t lookupMultiIPv4(mnode_t *, const char *);
+
+/**
+ * @brief Returns the lists that contain an IPv6 address, in one walk.
+ * See lookupMultiIPv4Address().
+ */
+uint64_t lookupMultiIPv6Address(mnode_t *, ipv6_t);
+
+/**
+ * @brief Same as lookupMultiIPv6Address(), for an address string.
+ */
+uint64_t lookupMultiIPv6(mnode_t *, const char *);
+
+/**
+ * @brief Adds the IPv4 entries of a text file to one list of a tree.
+ * Entries are separated by whitespace; invalid entries are skipped.
+ *
+ * @return uint8_t  0 if the file was read, 1 if it could not be opened.
+ */
+uint8_t loadMultiIPv4File(mnode_t *, const char *filename, uint8_t list);
+
+/**
+ * @brief Adds the IPv6 entries of a text file to one list of a tree.
+ *
+ * @return uint8_t  0 if the file was read, 1 if it could not be opened.
+ */
+uint8_t loadMultiIPv6File(mnode_t *, const char *filename, uint8_t list);
+
+/**
+ * @brief Returns an IPv4 tree holding one list per file:
+ * the entries of filenames[i] make up list i.
+ * Files that cannot be opened leave their list empty.
+ *
+ * @param filenames  Array of count file names.
+ * @param count      Number of files, at most MULTILIST_MAX_LISTS.
+ * @return mnode_t*  Pointer to the root of the tree.
+ */
+mnode_t *createMultiIPv4TreeFromFiles(const char *const *filenames, uint8_t count);
+
+/**
+ * @brief Returns an IPv6 tree holding one list per file.
+ * See createMultiIPv4TreeFromFiles().
+ */
+mnode_t *createMultiIPv6TreeFromFiles(const char *const *filenames, uint8_t count);
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file perfcount.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Hardware performance counter instrumentation public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef PERFCOUNT_H_
+#define PERFCOUNT_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Hardware events counted per operation batch.
+ * Only user-space events of the calling thread are counted.
+ */
+typedef enum
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+} perfevent_t;
+
+/**
+ * @brief Instrumented operations: lookups and list loading.
+ */
+typedef enum
+{
+    PERF_FIND,
+    PERF_LOAD,
+    PERF_OPERATION_COUNT
+} perfoperation_t;
+
+/**
+ * @brief Totals of an operation over all finished batches of all threads.
+ */
+typedef struct
+{
+    uint64_t batches;                   // Finished batches.
+    uint64_t operations;                // Operations counted inside batches.
+    uint64_t events[PERF_EVENT_COUNT];  // Event totals, scaled if the kernel multiplexed the counters.
+    uint8_t available;                  // Bit i is set if event i could be counted.
+} perfstats_t;
+
+/**
+ * @brief Instrumentation hooks. They only do something if the library was
+ * built with -DENABLE_PERF_COUNTERS=ON, which defines IP_PERF_COUNTERS;
+ * otherwise they expand to nothing and cost nothing.
+ *
+ * Reading the counters takes system calls, so they are read at the start
+ * and end of a batch, not around every lookup. The lookup functions only
+ * count themselves in the batch that is open on their thread; lookups
+ * outside a batch are not counted. The loaders open their own batch.
+ * Batches of the same operation may be nested; only the outermost one
+ * reads the counters.
+ */
+#ifdef IP_PERF_COUNTERS
+#define PERF_BATCH_BEGIN(operation) perfBatchBegin(operation)
+#define PERF_BATCH_END(operation) perfBatchEnd(operation)
+#define PERF_COUNT_OPERATION(operation) perfCountOperation(operation)
+#else
+#define PERF_BATCH_BEGIN(operation) ((void)0)
+#define PERF_BATCH_END(operation) ((void)0)
+#define PERF_COUNT_OPERATION(operation) ((void)0)
+#endif
+
+/**
+ * @brief Checks if the instrumentation is compiled in and the kernel
+ * lets this process count at least one event.
+ *
+ * @return uint8_t  1 if events are counted, 0 if not.
+ */
+uint8_t perfCountersAvailable(void);
+
+/**
+ * @brief Starts a batch of operations on the calling thread.
+ */
+void perfBatchBegin(perfoperation_t);
+
+/**
+ * @brief Ends a batch and adds its events and operations to the totals.
+ */
+void perfBatchEnd(perfoperation_t);
+
+/**
+ * @brief Counts one operation in the batch open on the calling thread.
+ */
+void perfCountOperation(perfoperation_t);
+
+/**
+ * @brief Copies the totals of an operation.
+ */
+void getPerfStats(perfoperation_t, perfstats_t *);
+
+/**
+ * @brief Clears the totals of all operations.
+ */
+void resetPerfStats(void);
+
+/**
+ * @brief Returns a short name for an event, e.g. "cycles".
+ */
+const char *perfEventName(perfevent_t);
+
+#endif
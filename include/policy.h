@@ -0,0 +1,101 @@
+/**
+ * @file policy.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Allow/deny policy public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef POLICY_H_
+#define POLICY_H_
+
+#include <stdint.h>
+#include "ip.h"
+#include "lpmmap.h"
+
+/**
+ * @brief Policy actions. POLICY_NONE means no prefix matched;
+ * the caller picks the default.
+ */
+#define POLICY_NONE LPM_NO_VALUE
+#define POLICY_ALLOW 1
+#define POLICY_DENY 2
+
+/**
+ * @brief Allow and deny prefixes of both address families in one map.
+ * The most specific matching prefix decides. When the same prefix is
+ * both allowed and denied, .tie_break decides.
+ */
+typedef struct
+{
+    lpmmap_t *map;      // Value IDs are the actions.
+    uint8_t tie_break;  // POLICY_ALLOW or POLICY_DENY.
+} policy_t;
+
+/**
+ * @brief Returns an empty policy.
+ *
+ * @param tie_break  Action that wins when a prefix is listed with both,
+ *                   POLICY_ALLOW or POLICY_DENY; anything else means deny.
+ */
+policy_t *createPolicy(uint8_t tie_break);
+
+/**
+ * @brief Frees a policy. Passing NULL is allowed and does nothing.
+ */
+void deletePolicy(policy_t *);
+
+/**
+ * @brief Adds an IPv4 prefix with an action.
+ *
+ * @return uint8_t  0 if added, 1 if the prefix was already listed and
+ *                  kept its action after the tie-break, 2 if the prefix
+ *                  or the action is invalid.
+ */
+uint8_t insertPolicyIPv4(policy_t *, ipv4_t, uint8_t action);
+
+/**
+ * @brief Adds an IPv6 prefix with an action.
+ *
+ * @return uint8_t  Same as insertPolicyIPv4().
+ */
+uint8_t insertPolicyIPv6(policy_t *, ipv6_t, uint8_t action);
+
+/**
+ * @brief Returns the action of the most specific prefix that contains
+ * an IPv4 address, in one walk.
+ *
+ * @param match      Output, may be NULL; the deciding prefix.
+ * @return uint8_t   POLICY_ALLOW, POLICY_DENY or POLICY_NONE.
+ */
+uint8_t checkPolicyIPv4Address(const policy_t *, ipv4_t, ipv4_t *match);
+
+/**
+ * @brief Same as checkPolicyIPv4Address(), for an address string.
+ * Invalid addresses give POLICY_NONE.
+ */
+uint8_t checkPolicyIPv4(const policy_t *, const char *);
+
+/**
+ * @brief IPv6 version of checkPolicyIPv4Address().
+ */
+uint8_t checkPolicyIPv6Address(const policy_t *, ipv6_t, ipv6_t *match);
+
+/**
+ * @brief Same as checkPolicyIPv6Address(), for an address string.
+ */
+uint8_t checkPolicyIPv6(const policy_t *, const char *);
+
+/**
+ * @brief Adds the entries of a policy file.
+ *
+ * Every line holds a marker and a prefix, separated by whitespace:
+ * "deny 10.0.0.0/8", "allow 10.1.2.0/24", or the short forms "-" and
+ * "+". IPv4 and IPv6 prefixes may be mixed. Empty lines and lines
+ * starting with # are skipped, as are lines with an unknown marker or
+ * an invalid prefix.
+ *
+ * @return uint8_t  0 if the file was read, 1 if it could not be opened.
+ */
+uint8_t loadPolicyFile(policy_t *, const char *filename);
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file prefilter.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Bloom filter prefilter for lookups public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef PREFILTER_H_
+#define PREFILTER_H_
+
+#include <stdint.h>
+#include "btree.h"
+#include "ip.h"
+
+/**
+ * @brief Default filter size per entry, for about 1% false positives per probe.
+ */
+#define PREFILTER_DEFAULT_BITS 10
+
+/**
+ * @brief Blocked Bloom filter over the entries of one tree, to answer
+ * most misses without walking the tree.
+ *
+ * Every entry is a key (prefix, prefix size), set as a few bits within a
+ * single 64-byte block. The prefix sizes that occur are split in at most
+ * two groups of sizes close together, e.g. /16 to /23 and /24 to /32. A
+ * key goes to the block picked by its address cut to the shortest size
+ * of its group, so a lookup reads one cache line per group, at most two,
+ * and probes every size of the group in it. Only if a probe hits is the
+ * tree walked. Addresses under one such short prefix share a block: a
+ * list with thousands of hosts in one /24 fills that block, and lookups
+ * in that /24 then walk the tree.
+ *
+ * The filter is built from the tree as it is. Once that tree changes
+ * (see watchTree()), lookups go straight to the tree until
+ * rebuildPrefilter() is called, so the filter never gives a wrong answer.
+ * It is read-only during lookups and may be shared between threads.
+ */
+typedef struct
+{
+    bnode_t *root;
+    uint8_t family;              // 4 or 6.
+    uint8_t bits_per_entry;
+    uint64_t *blocks;            // block_count blocks of 8 words, 64-byte aligned.
+    uint32_t block_count;        // Power of two.
+    uint64_t lengths[2];         // Bit (ps - 1) set if entries of size ps exist.
+    uint8_t split;               // Sizes from split up are in the second group.
+    uint8_t block_sizes[2];      // Size that picks the block of each group; 0 if empty.
+    uint64_t entry_count;
+    const uint64_t *watch;       // Generation of the tree, see watchTree().
+    uint64_t generation;         // Tree generation the filter was built in.
+} prefilter_t;
+
+/**
+ * @brief Builds a filter for the entries of a tree.
+ *
+ * @param family          4 or 6.
+ * @param bits_per_entry  Filter bits per entry, 4 to 32; more bits, fewer
+ *                        false positives. PREFILTER_DEFAULT_BITS is a good start.
+ * @return prefilter_t*   The filter, or NULL if a parameter is invalid,
+ *                        the tree cannot be watched or memory runs out.
+ */
+prefilter_t *createPrefilter(bnode_t *root, uint8_t family, uint8_t bits_per_entry);
+
+/**
+ * @brief Frees a filter, not its tree. Passing NULL is allowed.
+ */
+void deletePrefilter(prefilter_t *);
+
+/**
+ * @brief Builds the filter again from the current tree, after changes.
+ * Must not run during lookups with this filter.
+ *
+ * @return uint8_t  0 if rebuilt, 1 if memory ran out. The old filter is
+ *                  then kept, and lookups bypass it if the tree changed.
+ */
+uint8_t rebuildPrefilter(prefilter_t *);
+
+/**
+ * @brief Checks the filter only.
+ *
+ * @return uint8_t  0 if the address is certainly not in the tree (as it was
+ *                  when the filter was built), 1 if it may be.
+ */
+uint8_t mayContainIPv4(const prefilter_t *, ipv4_t);
+
+/**
+ * @brief Checks the filter only, see mayContainIPv4().
+ */
+uint8_t mayContainIPv6(const prefilter_t *, ipv6_t);
+
+/**
+ * @brief Same as findIPv4Address(), but rejects most misses in the filter.
+ * Misses rejected there are not counted in the lookup metrics.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv4Filtered(const prefilter_t *, ipv4_t);
+
+/**
+ * @brief Same as findIPv6Address(), but rejects most misses in the filter.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findIPv6Filtered(const prefilter_t *, ipv6_t);
+
+#endif
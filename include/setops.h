@@ -0,0 +1,76 @@
+/**
+ * @file setops.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Set operations on trees public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef SETOPS_H_
+#define SETOPS_H_
+
+#include <stdint.h>
+#include "btree.h"
+#include "ip.h"
+
+/*
+All operations walk both trees at once, visiting every node at most
+once, and work for IPv4 and IPv6 trees alike. Both trees must hold
+the same address family. The input trees are not changed; results
+are new trees, to be freed with deleteSubtree().
+*/
+
+/**
+ * @brief Returns a tree with the addresses in a, in b, or in both.
+ */
+bnode_t *unionTrees(const bnode_t *a, const bnode_t *b);
+
+/**
+ * @brief Returns a tree with the addresses in both a and b.
+ */
+bnode_t *intersectTrees(const bnode_t *a, const bnode_t *b);
+
+/**
+ * @brief Returns a tree with the addresses in a that are not in b.
+ * Parts of a range in a are split into the ranges that remain.
+ */
+bnode_t *subtractTrees(const bnode_t *a, const bnode_t *b);
+
+/**
+ * @brief Returns whether two trees hold the same addresses.
+ * The shape may differ: a /24 range equals its two /25 halves.
+ * Stops at the first difference.
+ *
+ * @return uint8_t  1 if equal, 0 if not.
+ */
+uint8_t equalTrees(const bnode_t *a, const bnode_t *b);
+
+/**
+ * @brief Receives one difference found by diffIPv4Trees().
+ *
+ * @param context  Passed through from diffIPv4Trees().
+ * @param added    1 if the range is only in the new tree,
+ *                 0 if it is only in the old tree.
+ * @param ip       The range.
+ */
+typedef void (*ipv4diff_t)(void *context, uint8_t added, ipv4_t ip);
+
+/**
+ * @brief Receives one difference found by diffIPv6Trees().
+ * See ipv4diff_t.
+ */
+typedef void (*ipv6diff_t)(void *context, uint8_t added, ipv6_t ip);
+
+/**
+ * @brief Calls visit for every range that was added or removed between
+ * two IPv4 trees, in address order.
+ *
+ * @return uint32_t  Number of ranges passed to visit.
+ */
+uint32_t diffIPv4Trees(const bnode_t *old_tree, const bnode_t *new_tree, ipv4diff_t visit, void *context);
+
+/**
+ * @brief IPv6 version of diffIPv4Trees().
+ */
+uint32_t diffIPv6Trees(const bnode_t *old_tree, const bnode_t *new_tree, ipv6diff_t visit, void *context);
+
+#endif
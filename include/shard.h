@@ -0,0 +1,132 @@
+/**
+ * @file shard.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Sharded tree library public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include <stdint.h>
+#include "ip.h"
+#include "btree.h"
+
+/**
+ * @brief Maximum number of top bits used to select a shard.
+ */
+#define SHARD_MAX_BITS 16
+
+/**
+ * @brief A tree split into 2^bits independent subtrees.
+ *
+ * Shard i holds every prefix whose top .bits bits equal i, with those
+ * bits stripped off. A prefix shorter than .bits covers several shards
+ * and turns each of their roots into a leaf.
+ *
+ * Every shard is an ordinary bnode_t tree, so it can be built or
+ * replaced on its own thread. Its nodes are allocated by the thread that
+ * builds it, which keeps them local to that thread's memory node.
+ *
+ * .fingerprints holds an order-independent hash of the entries each
+ * shard was last built from; a reload only rebuilds shards whose
+ * fingerprint changed.
+ */
+typedef struct
+{
+    uint8_t family;
+    uint8_t bits;
+    uint32_t count;
+    bnode_t **roots;
+    uint64_t *fingerprints;
+} shardedtree_t;
+
+/**
+ * @brief Returns a sharded tree with all shards empty.
+ *
+ * @param family  4 for IPv4, 6 for IPv6.
+ * @param bits    Number of top bits that select a shard, 1 to SHARD_MAX_BITS.
+ * @return shardedtree_t*  NULL if the family or the number of bits is invalid.
+ */
+shardedtree_t *createShardedTree(uint8_t family, uint8_t bits);
+
+/**
+ * @brief Frees a sharded tree and all its shards.
+ */
+void deleteShardedTree(shardedtree_t *);
+
+/**
+ * @brief Returns a sharded tree filled with the addresses read from a
+ * text file. The shards are built in parallel.
+ * If there is an error opening the text file, a tree with all shards
+ * empty is returned.
+ *
+ * @param filename  Text file with IP addresses or ranges.
+ * @param family    4 for IPv4, 6 for IPv6.
+ * @param bits      Number of top bits that select a shard.
+ * @param threads   Number of builder threads; 0 uses all online cores.
+ * @return shardedtree_t*  NULL if the family or the number of bits is invalid.
+ */
+shardedtree_t *createShardedTreeFromFile(const char *filename, uint8_t family, uint8_t bits, uint16_t threads);
+
+/**
+ * @brief Replaces the contents of a sharded tree with those of a text file.
+ * Only shards whose entries changed are rebuilt; the others are left
+ * untouched. Lookups must not run on the tree during a reload.
+ * If there is an error opening the text file, the tree is not changed.
+ *
+ * @return uint32_t  Number of shards that were rebuilt.
+ */
+uint32_t reloadShardedTreeFromFile(shardedtree_t *, const char *filename, uint16_t threads);
+
+/**
+ * @brief Adds an IPv4 string to a sharded IPv4 tree.
+ *
+ * @return uint8_t  Same as insertIPv4().
+ */
+uint8_t insertShardedIPv4(shardedtree_t *, const char *);
+
+/**
+ * @brief Adds an IPv6 string to a sharded IPv6 tree.
+ *
+ * @return uint8_t  Same as insertIPv6().
+ */
+uint8_t insertShardedIPv6(shardedtree_t *, const char *);
+
+/**
+ * @brief Checks if an IPv4 address occurs in a sharded IPv4 tree.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findShardedIPv4(shardedtree_t *, const char *);
+
+/**
+ * @brief Checks if a parsed IPv4 address occurs in a sharded IPv4 tree.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findShardedIPv4Address(shardedtree_t *, ipv4_t);
+
+/**
+ * @brief Checks if an IPv6 address occurs in a sharded IPv6 tree.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findShardedIPv6(shardedtree_t *, const char *);
+
+/**
+ * @brief Checks if a parsed IPv6 address occurs in a sharded IPv6 tree.
+ *
+ * @return uint8_t  1 if found, 0 if not.
+ */
+uint8_t findShardedIPv6Address(shardedtree_t *, ipv6_t);
+
+/**
+ * @brief Returns the number of addresses in a sharded tree.
+ * A range that spans several shards is counted once per shard.
+ *
+ * @return uint32_t  Number of addresses.
+ */
+uint32_t countShardedTree(shardedtree_t *);
+
+#endif
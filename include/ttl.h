@@ -0,0 +1,122 @@
+/**
+ * @file ttl.h
+ * @author Aldo Verlinde (aldo.verlinde@gmail.com)
+ * @brief Expiring tree entries public header file.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+#ifndef TTL_H_
+#define TTL_H_
+
+#include <stdint.h>
+#include "btree.h"
+#include "ip.h"
+
+/**
+ * @brief Time to live of an entry that never expires.
+ */
+#define TTL_PERMANENT 0
+
+/**
+ * @brief Shape of the timer wheel: TTL_WHEEL_LEVELS levels of
+ * TTL_WHEEL_SLOTS slots each. A slot of level L spans 64^L seconds,
+ * so six levels reach further than any 32-bit time to live.
+ */
+#define TTL_WHEEL_BITS 6
+#define TTL_WHEEL_SLOTS (1 << TTL_WHEEL_BITS)
+#define TTL_WHEEL_LEVELS 6
+
+/**
+ * @brief An entry with its expiry time, in a wheel slot and a hash chain.
+ * IPv4 addresses are kept in .ip.ip[0] and .ip.ip[1].
+ */
+typedef struct ttlentry
+{
+    struct ttlentry *prev;        // Wheel slot list, for O(1) unlinking.
+    struct ttlentry *next;
+    struct ttlentry **wheel_slot; // Head of that list, to unlink the first entry.
+    struct ttlentry *hash_next;
+    uint64_t expires;             // 0 for a permanent entry, which is in no slot.
+    ipv6_t ip;
+    uint8_t family;
+} ttlentry_t;
+
+/**
+ * @brief IPv4 and IPv6 trees whose entries may expire.
+ *
+ * Lookups use the trees directly, e.g. findIPv4Address(ttl->ipv4_root, ip):
+ * expired entries are taken out of the trees by expireTtlTree(), so lookups
+ * never look at times. Time is counted in seconds, on any clock the caller
+ * likes, as long as it does not go backwards.
+ *
+ * Not thread-safe: lookups and changes must not run at the same time.
+ */
+typedef struct
+{
+    bnode_t *ipv4_root;
+    bnode_t *ipv6_root;
+    ttlentry_t *wheel[TTL_WHEEL_LEVELS][TTL_WHEEL_SLOTS];
+    ttlentry_t **buckets;        // Hash table of all entries, by prefix.
+    uint32_t bucket_count;       // Power of two.
+    uint32_t entry_count;
+    uint32_t timed_count;        // Entries that are not permanent, i.e. in the wheel.
+    uint64_t now;                // Time up to which entries have expired.
+} ttltree_t;
+
+/**
+ * @brief Returns empty trees.
+ *
+ * @param now  Current time in seconds.
+ */
+ttltree_t *createTtlTree(uint64_t now);
+
+/**
+ * @brief Frees the trees and all entries. Passing NULL is allowed.
+ */
+void deleteTtlTree(ttltree_t *);
+
+/**
+ * @brief Adds an IPv4 address or range that expires after ttl seconds.
+ * Adding a listed prefix again keeps the later of both expiry times.
+ *
+ * @param ttl       Seconds from the current time, or TTL_PERMANENT.
+ * @return uint8_t  0 if added, 1 if the prefix was listed already,
+ *                  2 if the address is invalid.
+ */
+uint8_t insertTtlIPv4(ttltree_t *, ipv4_t, uint32_t ttl);
+
+/**
+ * @brief Adds an IPv6 address or range that expires after ttl seconds.
+ *
+ * @return uint8_t  Same as insertTtlIPv4().
+ */
+uint8_t insertTtlIPv6(ttltree_t *, ipv6_t, uint32_t ttl);
+
+/**
+ * @brief Removes an IPv4 entry before it expires.
+ * Narrower entries that it covered are put back in the tree.
+ *
+ * @return uint8_t  0 if removed, 1 if not listed, 2 if invalid.
+ */
+uint8_t removeTtlIPv4(ttltree_t *, ipv4_t);
+
+/**
+ * @brief Removes an IPv6 entry before it expires.
+ *
+ * @return uint8_t  Same as removeTtlIPv4().
+ */
+uint8_t removeTtlIPv6(ttltree_t *, ipv6_t);
+
+/**
+ * @brief Advances the clock and removes every entry that expired.
+ * Call it regularly, e.g. once a second. After a removal, narrower
+ * entries that the removed ranges covered go back into the trees.
+ * The wheel is stepped second by second while entries are due to
+ * expire; once none are left, the clock jumps straight to now.
+ *
+ * @param now        Current time in seconds; earlier times are ignored.
+ * @return uint32_t  Number of entries that expired.
+ */
+uint32_t expireTtlTree(ttltree_t *, uint64_t now);
+
+#endif
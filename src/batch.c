@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "batch.h"
+#include "btree.h"
+
+#define BATCH_CACHE_LINE 64
+
+typedef uint8_t (*find_function_t)(bnode_t *, const char *);
+
+/*
+A worker's share of the chunks, [next, end).
+The owner and any thief both take chunks from the front by advancing
+.next atomically, so a chunk is handed out exactly once.
+The padding fills a cache line, and the queues are allocated on a cache
+line boundary, so each queue has a line of its own.
+*/
+typedef struct
+{
+    uint64_t next;
+    uint64_t end;
+    uint8_t padding[BATCH_CACHE_LINE - 2 * sizeof(uint64_t)];
+} chunkqueue_t;
+
+typedef struct
+{
+    bnode_t *root;
+    find_function_t find;
+    const char *const *ip_strings;
+    uint64_t count;
+    uint8_t *bitmap;
+    chunkqueue_t *queues;
+    uint16_t workers;
+} batchjob_t;
+
+typedef struct
+{
+    batchjob_t *job;
+    uint16_t id;
+    uint64_t matches;
+} batchworker_t;
+
+static uint64_t classifyChunk(const batchjob_t *job, uint64_t chunk)
+{
+    uint64_t first = chunk * BATCH_CHUNK_SIZE;
+    uint64_t last = first + BATCH_CHUNK_SIZE;
+    uint64_t matches = 0;
+    uint8_t byte = 0;
+
+    if (last > job->count)
+    {
+        last = job->count;
+    }
+    for (uint64_t i = first; i < last; i++)
+    {
+        if (job->find(job->root, job->ip_strings[i]))
+        {
+            byte |= (uint8_t)(1 << (i % 8));
+            matches++;
+        }
+        if ((i % 8 == 7) || (i == last - 1))
+        {
+            job->bitmap[i / 8] = byte;
+            byte = 0;
+        }
+    }
+    return matches;
+}
+
+static uint8_t takeChunk(chunkqueue_t *queue, uint64_t *chunk)
+{
+    if (__atomic_load_n(&queue->next, __ATOMIC_RELAXED) >= queue->end)
+    {
+        return 0;
+    }
+    *chunk = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+    return *chunk < queue->end;
+}
+
+static void *runWorker(void *arg)
+{
+    batchworker_t *worker = (batchworker_t *)arg;
+    batchjob_t *job = worker->job;
+    uint64_t chunk;
+
+    // Drain our own queue first, then steal from the others.
+    for (uint16_t i = 0; i < job->workers; i++)
+    {
+        chunkqueue_t *queue = &job->queues[(worker->id + i) % job->workers];
+        while (takeChunk(queue, &chunk))
+        {
+            worker->matches += classifyChunk(job, chunk);
+        }
+    }
+    return NULL;
+}
+
+static uint16_t countWorkers(uint16_t threads, uint64_t chunks)
+{
+    if (threads == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cores > 0) ? (uint16_t)cores : 1;
+    }
+    if (threads > chunks)
+    {
+        threads = (uint16_t)chunks;
+    }
+    return threads;
+}
+
+static uint64_t classifyBatch(bnode_t *root, find_function_t find, const char *const *ip_strings, uint64_t count, uint8_t *bitmap, uint16_t threads)
+{
+    uint64_t chunks = (count + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+    uint64_t matches = 0;
+    batchjob_t job;
+    batchworker_t *workers;
+    pthread_t *thread_ids;
+    uint8_t *started;
+    void *queues = NULL;
+    uint16_t w;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+    job.workers = countWorkers(threads, chunks);
+    if (posix_memalign(&queues, BATCH_CACHE_LINE, job.workers * sizeof(chunkqueue_t)) != 0)
+    {
+        fprintf(stderr, "Cannot allocate the work queues\n");
+        return 0;
+    }
+
+    job.root = root;
+    job.find = find;
+    job.ip_strings = ip_strings;
+    job.count = count;
+    job.bitmap = bitmap;
+    job.queues = (chunkqueue_t *)queues;
+    workers = (batchworker_t *)calloc(job.workers, sizeof(batchworker_t));
+    thread_ids = (pthread_t *)calloc(job.workers, sizeof(pthread_t));
+    started = (uint8_t *)calloc(job.workers, sizeof(uint8_t));
+
+    for (w = 0; w < job.workers; w++)
+    {
+        job.queues[w].next = chunks * w / job.workers;
+        job.queues[w].end = chunks * (w + 1) / job.workers;
+        workers[w].job = &job;
+        workers[w].id = w;
+    }
+
+    // Worker 0 runs on the calling thread. If a thread cannot be started,
+    // its queue is simply stolen by the workers that did start.
+    for (w = 1; w < job.workers; w++)
+    {
+        started[w] = (pthread_create(&thread_ids[w], NULL, runWorker, &workers[w]) == 0);
+    }
+    runWorker(&workers[0]);
+    for (w = 0; w < job.workers; w++)
+    {
+        if (started[w])
+        {
+            pthread_join(thread_ids[w], NULL);
+        }
+        matches += workers[w].matches;
+    }
+
+    free(started);
+    free(thread_ids);
+    free(workers);
+    free(job.queues);
+    return matches;
+}
+
+uint64_t classifyIPv4Batch(bnode_t *root, const char *const *ip_strings, uint64_t count, uint8_t *bitmap, uint16_t threads)
+{
+    return classifyBatch(root, findIPv4, ip_strings, count, bitmap, threads);
+}
+
+uint64_t classifyIPv6Batch(bnode_t *root, const char *const *ip_strings, uint64_t count, uint8_t *bitmap, uint16_t threads)
+{
+    return classifyBatch(root, findIPv6, ip_strings, count, bitmap, threads);
+}
+
+static char *readWholeFile(const char *filename, uint64_t *size)
+{
+    FILE *fp = fopen(filename, "rb");
+    char *buffer;
+    long length;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return NULL;
+    }
+    if ((fseek(fp, 0, SEEK_END) != 0) || ((length = ftell(fp)) < 0) || (fseek(fp, 0, SEEK_SET) != 0))
+    {
+        fprintf(stderr, "Error reading file %s\n", filename);
+        fclose(fp);
+        return NULL;
+    }
+    buffer = (char *)malloc((size_t)length + 1);
+    *size = fread(buffer, 1, (size_t)length, fp);
+    buffer[*size] = '\0';
+    fclose(fp);
+    return buffer;
+}
+
+/*
+Cuts the buffer into null-terminated lines in place, so the
+classifier can work on the file contents without copying them.
+*/
+static const char **splitLines(char *buffer, uint64_t size, uint64_t *count)
+{
+    const char **lines;
+    uint64_t i;
+    uint64_t n = 0;
+
+    *count = 0;
+    for (i = 0; i < size; i++)
+    {
+        *count += (buffer[i] == '\n');
+    }
+    if ((size > 0) && (buffer[size - 1] != '\n'))
+    {
+        (*count)++;
+    }
+
+    lines = (const char **)malloc((*count + 1) * sizeof(char *));
+    if (size > 0)
+    {
+        lines[n++] = buffer;
+    }
+    for (i = 0; i < size; i++)
+    {
+        if (buffer[i] == '\n')
+        {
+            buffer[i] = '\0';
+            if ((i > 0) && (buffer[i - 1] == '\r'))
+            {
+                buffer[i - 1] = '\0';
+            }
+            if (i + 1 < size)
+            {
+                lines[n++] = buffer + i + 1;
+            }
+        }
+    }
+    return lines;
+}
+
+static uint64_t filterFile(bnode_t *root, find_function_t find, const char *filename, FILE *out, uint16_t threads)
+{
+    uint64_t size;
+    uint64_t count;
+    uint64_t matches;
+    const char **lines;
+    uint8_t *bitmap;
+    char *buffer = readWholeFile(filename, &size);
+
+    if (buffer == NULL)
+    {
+        return 0;
+    }
+
+    lines = splitLines(buffer, size, &count);
+    bitmap = (uint8_t *)calloc((count + 7) / 8 + 1, sizeof(uint8_t));
+    matches = classifyBatch(root, find, lines, count, bitmap, threads);
+
+    if (out != NULL)
+    {
+        for (uint64_t i = 0; i < count; i++)
+        {
+            if (bitmap[i / 8] & (1 << (i % 8)))
+            {
+                fputs(lines[i], out);
+                fputc('\n', out);
+            }
+        }
+    }
+
+    free(bitmap);
+    free(lines);
+    free(buffer);
+    return matches;
+}
+
+uint64_t filterIPv4File(bnode_t *root, const char *filename, FILE *out, uint16_t threads)
+{
+    return filterFile(root, findIPv4, filename, out, threads);
+}
+
+uint64_t filterIPv6File(bnode_t *root, const char *filename, FILE *out, uint16_t threads)
+{
+    return filterFile(root, findIPv6, filename, out, threads);
+}
@@ -1,9 +1,114 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "btree.h"
+#include "perfcount.h"
+#include "metrics.h"
 #include "ip.h"
 
+/*
+Generations of the watched trees, see watchTree(). Writers scan the
+first watched_slots slots for their root without a lock; slots are
+claimed and released under watch_lock and never move, and a reused slot
+keeps counting up, so a counter never goes back.
+*/
+typedef struct
+{
+    const bnode_t *root;
+    uint32_t watchers;
+    uint64_t generation;
+} watchslot_t;
+
+static watchslot_t watched[BTREE_MAX_WATCHED_TREES];
+static uint32_t watched_slots;
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Called after every change that can alter a lookup result in the tree of root.
+static void bumpGeneration(const bnode_t *root)
+{
+    uint32_t slots = __atomic_load_n(&watched_slots, __ATOMIC_ACQUIRE);
+
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        if (__atomic_load_n(&watched[i].root, __ATOMIC_RELAXED) == root)
+        {
+            __atomic_fetch_add(&watched[i].generation, 1, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+}
+
+const uint64_t *watchTree(const bnode_t *root)
+{
+    watchslot_t *slot = NULL;
+
+    if (root == NULL)
+    {
+        return NULL;
+    }
+    pthread_mutex_lock(&watch_lock);
+    for (uint32_t i = 0; i < watched_slots; i++)
+    {
+        if (watched[i].root == root)
+        {
+            slot = &watched[i];
+            break;
+        }
+        if ((slot == NULL) && (watched[i].root == NULL))
+        {
+            slot = &watched[i];
+        }
+    }
+    if ((slot == NULL) && (watched_slots < BTREE_MAX_WATCHED_TREES))
+    {
+        slot = &watched[watched_slots];
+        __atomic_store_n(&slot->root, root, __ATOMIC_RELEASE);
+        __atomic_store_n(&watched_slots, watched_slots + 1, __ATOMIC_RELEASE);
+    }
+    else if ((slot != NULL) && (slot->root == NULL))
+    {
+        __atomic_store_n(&slot->root, root, __ATOMIC_RELEASE);
+    }
+    if (slot != NULL)
+    {
+        slot->watchers++;
+    }
+    pthread_mutex_unlock(&watch_lock);
+    if (slot == NULL)
+    {
+        fprintf(stderr, "Cannot watch more than %d trees\n", BTREE_MAX_WATCHED_TREES);
+        return NULL;
+    }
+    return &slot->generation;
+}
+
+void unwatchTree(const bnode_t *root)
+{
+    pthread_mutex_lock(&watch_lock);
+    for (uint32_t i = 0; i < watched_slots; i++)
+    {
+        if ((root != NULL) && (watched[i].root == root))
+        {
+            if (--watched[i].watchers == 0)
+            {
+                __atomic_store_n(&watched[i].root, NULL, __ATOMIC_RELEASE);
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&watch_lock);
+}
+
+uint64_t getTreeGeneration(const uint64_t *counter)
+{
+    return (counter == NULL) ? 0 : __atomic_load_n(counter, __ATOMIC_ACQUIRE);
+}
+
 bnode_t *createNode()
 {
     bnode_t *newNode = (bnode_t *)malloc(sizeof(bnode_t));
@@ -11,29 +116,81 @@ bnode_t *createNode()
     return newNode;
 }
 
+static void freeSubtree(bnode_t *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    if (node != node->child[0])
+    {
+        freeSubtree(node->child[0]);
+        freeSubtree(node->child[1]);
+    }
+    free(node);
+}
+
 void deleteSubtree(bnode_t *node)
 {
     if (node == NULL)
     {
         return;
     }
+    // A new tree may reuse the memory, so cached results of this one must go.
+    bumpGeneration(node);
+    freeSubtree(node);
+}
+
+static uint64_t deleteSubtreeCounted(bnode_t *node)
+{
+    uint64_t count;
+
+    if (node == NULL)
+    {
+        return 0;
+    }
+    count = 1;
     if (node != node->child[0])
     {
-        deleteSubtree(node->child[0]);
-        deleteSubtree(node->child[1]);
+        count += deleteSubtreeCounted(node->child[0]);
+        count += deleteSubtreeCounted(node->child[1]);
     }
     free(node);
+    return count;
+}
+
+/*
+Turns a node into a leaf, freeing the more specific entries below it.
+With a report, the freeing is timed and the freed nodes are counted.
+*/
+static void makeLeaf(const bnode_t *root, bnode_t *node, loadreport_t *report)
+{
+    if (report == NULL)
+    {
+        freeSubtree(node->child[0]);
+        freeSubtree(node->child[1]);
+    }
+    else if ((node->child[0] != NULL) || (node->child[1] != NULL))
+    {
+        uint64_t start = metricsClock();
+        report->absorbed_nodes += deleteSubtreeCounted(node->child[0]);
+        report->absorbed_nodes += deleteSubtreeCounted(node->child[1]);
+        report->delete_ns += metricsClock() - start;
+    }
+    node->child[0] = node;
+    node->child[1] = node;
+    bumpGeneration(root);
 }
 
-void insertIPv4(bnode_t *root, const char *s)
+// Returns the insertIPv4() codes, but 3 instead of 1 if a wider range covers ip.
+static uint8_t insertIPv4Node(bnode_t *root, ipv4_t ip, loadreport_t *report)
 {
     uint8_t byte;
     bnode_t *node_ptr;
 
-    ipv4_t ip = read_ipv4(s);
     if (ip.ps == 0)
     {
-        return;
+        return 2;
     }
 
     node_ptr = root;
@@ -41,7 +198,7 @@ void insertIPv4(bnode_t *root, const char *s)
     {
         if (node_ptr == node_ptr->child[0])
         {
-            return;
+            return 3;
         }
         byte = ip.ip >> 31;
         if (node_ptr->child[byte] == NULL)
@@ -52,25 +209,78 @@ void insertIPv4(bnode_t *root, const char *s)
         node_ptr = node_ptr->child[byte];
         ip.ip <<= 1;
     }
-    if (node_ptr->child[0] != node_ptr)
+    if (node_ptr->child[0] == node_ptr)
+    {
+        return 1;
+    }
+    makeLeaf(root, node_ptr, report);
+    return 0;
+}
+
+uint8_t insertIPv4Address(bnode_t *root, ipv4_t ip)
+{
+    uint8_t result = insertIPv4Node(root, ip, NULL);
+    return (result == 3) ? 1 : result;
+}
+
+/*
+Inserts every prefix of a start-end range. Returns 0 if any of them was
+added, else 1 if one was already there, else 3: covered by wider ranges.
+*/
+static uint8_t insertIPv4RangeNodes(bnode_t *root, uint32_t first, uint32_t last, loadreport_t *report)
+{
+    ipv4_t prefixes[IPV4_RANGE_MAX_PREFIXES];
+    uint8_t count = ipv4_range_to_prefixes(first, last, prefixes);
+    uint8_t result = 3;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t inserted = insertIPv4Node(root, prefixes[i], report);
+        if (inserted < result)
+        {
+            result = inserted;
+        }
+    }
+    return result;
+}
+
+static uint8_t insertIPv4EntryNode(bnode_t *root, const char *entry, size_t length, loadreport_t *report)
+{
+    uint32_t first;
+    uint32_t last;
+
+    if (memchr(entry, '-', length) == NULL)
+    {
+        return insertIPv4Node(root, read_ipv4_n(entry, length), report);
+    }
+    if (!read_ipv4_range_n(entry, length, &first, &last))
     {
-        deleteSubtree(node_ptr->child[0]);
-        deleteSubtree(node_ptr->child[1]);
-        node_ptr->child[0] = node_ptr;
-        node_ptr->child[1] = node_ptr;
+        return 2;
     }
+    return insertIPv4RangeNodes(root, first, last, report);
+}
+
+uint8_t insertIPv4Entry(bnode_t *root, const char *entry, size_t length)
+{
+    uint8_t result = insertIPv4EntryNode(root, entry, length, NULL);
+    return (result == 3) ? 1 : result;
 }
 
-void insertIPv6(bnode_t *root, const char *s)
+uint8_t insertIPv4(bnode_t *root, const char *s)
+{
+    return insertIPv4Entry(root, s, strlen(s));
+}
+
+// Returns the insertIPv6() codes, but 3 instead of 1 if a wider range covers ip.
+static uint8_t insertIPv6Node(bnode_t *root, ipv6_t ip, loadreport_t *report)
 {
     uint8_t byte;
     bnode_t *node_ptr;
     uint8_t group_index = 0;
 
-    ipv6_t ip = read_ipv6(s);
     if (ip.ps == 0)
     {
-        return;
+        return 2;
     }
 
     node_ptr = root;
@@ -78,7 +288,7 @@ void insertIPv6(bnode_t *root, const char *s)
     {
         if (node_ptr == node_ptr->child[0])
         {
-            return;
+            return 3;
         }
         byte = ip.ip[group_index] >> 15;
         if (node_ptr->child[byte] == NULL)
@@ -93,106 +303,227 @@ void insertIPv6(bnode_t *root, const char *s)
             group_index++;
         }
     }
-    if (node_ptr->child[0] != node_ptr)
+    if (node_ptr->child[0] == node_ptr)
     {
-        deleteSubtree(node_ptr->child[0]);
-        deleteSubtree(node_ptr->child[1]);
-        node_ptr->child[0] = node_ptr;
-        node_ptr->child[1] = node_ptr;
+        return 1;
     }
+    makeLeaf(root, node_ptr, report);
+    return 0;
 }
 
-void printIPv4(FILE *stream, ipv4_t ipv4)
+uint8_t insertIPv6Address(bnode_t *root, ipv6_t ip)
 {
-    char s[19];
-    ipv4tostring(s, ipv4);
-    fprintf(stream, "%s\n", s);
+    uint8_t result = insertIPv6Node(root, ip, NULL);
+    return (result == 3) ? 1 : result;
 }
 
-uint32_t walkIPv4Recursive(bnode_t **node, uint8_t depth, const uint32_t ip, const uint8_t printIPs)
+// See insertIPv4RangeNodes().
+static uint8_t insertIPv6RangeNodes(bnode_t *root, const uint16_t *first, const uint16_t *last, loadreport_t *report)
 {
-    uint32_t counter = 0;
-    ipv4_t ipv4;
-    
-    if (*node == NULL)
+    ipv6_t prefixes[IPV6_RANGE_MAX_PREFIXES];
+    uint8_t count = ipv6_range_to_prefixes(first, last, prefixes);
+    uint8_t result = 3;
+
+    for (uint8_t i = 0; i < count; i++)
     {
-        return 0;
+        uint8_t inserted = insertIPv6Node(root, prefixes[i], report);
+        if (inserted < result)
+        {
+            result = inserted;
+        }
+    }
+    return result;
+}
+
+static uint8_t insertIPv6EntryNode(bnode_t *root, const char *entry, size_t length, loadreport_t *report)
+{
+    uint16_t first[8];
+    uint16_t last[8];
+
+    if (memchr(entry, '-', length) == NULL)
+    {
+        return insertIPv6Node(root, read_ipv6_n(entry, length), report);
+    }
+    if (!read_ipv6_range_n(entry, length, first, last))
+    {
+        return 2;
+    }
+    return insertIPv6RangeNodes(root, first, last, report);
+}
+
+uint8_t insertIPv6Entry(bnode_t *root, const char *entry, size_t length)
+{
+    uint8_t result = insertIPv6EntryNode(root, entry, length, NULL);
+    return (result == 3) ? 1 : result;
+}
+
+uint8_t insertIPv6(bnode_t *root, const char *s)
+{
+    return insertIPv6Entry(root, s, strlen(s));
+}
+
+/*
+Removes the leaf at the end of a path of ps bits, then frees the inner
+nodes above it that are left without children. The root always stays.
+*/
+static uint8_t removeNode(bnode_t *root, const uint16_t *groups, uint8_t ps)
+{
+    bnode_t *path[BTREE_MAX_DEPTH + 1];
+    bnode_t *node = root;
+
+    if (ps == 0)
+    {
+        return 2;
+    }
+    for (uint8_t depth = 0; depth < ps; depth++)
+    {
+        if ((node == node->child[0]) || (node->child[group_bit(groups, depth)] == NULL))
+        {
+            return 1;
+        }
+        path[depth] = node;
+        node = node->child[group_bit(groups, depth)];
     }
-    
-    if (*node != (*node)->child[0])
+    if (node != node->child[0])
     {
-        counter += walkIPv4Recursive(&((*node)->child[0]), depth + 1, ip << 1, printIPs);
-        counter += walkIPv4Recursive(&((*node)->child[1]), depth + 1, (ip << 1) + 1, printIPs);
+        return 1;
     }
-    
-    if (counter == 0)
+    free(node);
+    for (uint8_t depth = ps; depth > 0; depth--)
     {
-        ipv4.ip = depth > 0 ? ip << (32 - depth) : 0;
-        ipv4.ps = depth;
-        if (printIPs)
+        bnode_t *parent = path[depth - 1];
+        parent->child[group_bit(groups, (uint8_t)(depth - 1))] = NULL;
+        if ((parent == root) || (parent->child[0] != NULL) || (parent->child[1] != NULL))
         {
-            printIPv4(stdout, ipv4);
+            break;
         }
-        counter = 1;
+        free(parent);
     }
-    return counter;
+    bumpGeneration(root);
+    return 0;
 }
 
-uint32_t dumpIPv4Tree(bnode_t *node)
+uint8_t removeIPv4Address(bnode_t *root, ipv4_t ip)
 {
-    return walkIPv4Recursive(&node, 0, 0, 1);
+    uint16_t groups[2] = {(uint16_t)(ip.ip >> 16), (uint16_t)ip.ip};
+
+    return removeNode(root, groups, ip.ps);
 }
 
-uint32_t countIPv4Tree(bnode_t *node)
+uint8_t removeIPv6Address(bnode_t *root, ipv6_t ip)
 {
-    return walkIPv4Recursive(&node, 0, 0, 0);
+    return removeNode(root, ip.ip, ip.ps);
 }
 
-bnode_t *createIPv4TreeFromFile(const char *filename)
+void printIPv4(FILE *stream, ipv4_t ipv4)
 {
-    const uint8_t MAX_IP_LEN = 44;
-    bnode_t *root = createNode();
-    FILE *fp = fopen(filename, "r");
-    char buffer[MAX_IP_LEN];
-    int c;
-    uint8_t buffer_index = 0;
+    char s[19];
+    ipv4tostring(s, ipv4);
+    fprintf(stream, "%s\n", s);
+}
 
-    if (fp == NULL)
+uint32_t dumpIPv4Tree(bnode_t *node)
+{
+    btreeiter_t it;
+    ipv4_t ip;
+    uint32_t counter = 0;
+
+    initIPv4Iterator(&it, node);
+    while (nextIPv4(&it, &ip))
     {
-        fprintf(stderr, "Error opening file %s\n", filename);
-        return root;
+        printIPv4(stdout, ip);
+        counter++;
+    }
+    return counter;
+}
+
+uint32_t countIPv4Tree(bnode_t *node)
+{
+    btreeiter_t it;
+    ipv4_t ip;
+    uint32_t counter = 0;
+
+    initIPv4Iterator(&it, node);
+    while (nextIPv4(&it, &ip))
+    {
+        counter++;
     }
+    return counter;
+}
 
-    while ((c = getc(fp)) != EOF)
+static uint8_t isSeparator(char c)
+{
+    return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+}
+
+/*
+Splits the stream at whitespace, as loadFileWithReport() does: a last
+entry without a line terminator is inserted too, and an entry too long
+for the buffer cannot be valid, so it is skipped whole rather than cut.
+*/
+static void loadEntries(bnode_t *root, FILE *fp, uint8_t (*insert)(bnode_t *, const char *, size_t))
+{
+    // Room for a start-end range of two full IPv6 addresses.
+    char buffer[96];
+    size_t length = 0;
+    uint8_t too_long = 0;
+    int c;
+
+    PERF_BATCH_BEGIN(PERF_LOAD);
+    do
     {
-        if ((c == ' ') || (c == '\n') || (c == '\r') || (c == '\t') || (c == EOF))
+        c = getc(fp);
+        if ((c == EOF) || isSeparator((char)c))
         {
-            buffer[buffer_index++] = '\0';
-            insertIPv4(root, buffer);
-            for (buffer_index = 0; buffer_index < MAX_IP_LEN; buffer_index++)
+            if ((length > 0) && !too_long)
             {
-                buffer[buffer_index] = '\0';
+                insert(root, buffer, length);
+                PERF_COUNT_OPERATION(PERF_LOAD);
             }
-            buffer_index = 0;
+            length = 0;
+            too_long = 0;
+        }
+        else if (length < sizeof(buffer))
+        {
+            buffer[length++] = (char)c;
         }
         else
         {
-            buffer[buffer_index++] = (char)c;
+            too_long = 1;
         }
-    }
+    } while (c != EOF);
+    PERF_BATCH_END(PERF_LOAD);
+}
+
+uint8_t loadIPv4File(bnode_t *root, const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
 
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return 1;
+    }
+    loadEntries(root, fp, insertIPv4Entry);
     fclose(fp);
+    return 0;
+}
+
+bnode_t *createIPv4TreeFromFile(const char *filename)
+{
+    bnode_t *root = createNode();
+    loadIPv4File(root, filename);
     return root;
 }
 
 uint8_t findIPv4(bnode_t *root, const char *ipv4_string)
 {
-    ipv4_t ipv4 = read_ipv4(ipv4_string);
-    if (ipv4.ps == 0)
-    {
-        return 0;
-    }
+    return findIPv4Address(root, read_ipv4(ipv4_string));
+}
 
+static uint8_t searchIPv4(bnode_t *root, ipv4_t ipv4, uint8_t *depth)
+{
+    const uint8_t ps = ipv4.ps;
     bnode_t **tree_ptr = &root;
     while ((*tree_ptr != NULL) && (*tree_ptr != (*tree_ptr)->child[0]) && (ipv4.ps > 0))
     {
@@ -200,9 +531,75 @@ uint8_t findIPv4(bnode_t *root, const char *ipv4_string)
         ipv4.ip <<= 1;
         ipv4.ps--;
     }
+    *depth = (uint8_t)(ps - ipv4.ps);
     return !((*tree_ptr == NULL) || (*tree_ptr != (*tree_ptr)->child[0]));
 }
 
+static void setIPv4Match(ipv4_t *match, ipv4_t ipv4, uint8_t found, uint8_t depth)
+{
+    if (match == NULL)
+    {
+        return;
+    }
+    match->ps = found ? depth : 0;
+    match->ip = ipv4.ip & ipv4_netmask(match->ps);
+}
+
+uint8_t matchIPv4Address(bnode_t *root, ipv4_t ipv4, ipv4_t *match)
+{
+    uint64_t start = 0;
+    uint8_t depth;
+    uint8_t found;
+
+    PERF_COUNT_OPERATION(PERF_FIND);
+    if (ipv4.ps == 0)
+    {
+        if (metricsEnabled())
+        {
+            recordParseFailure(METRICS_IPV4);
+        }
+        setIPv4Match(match, ipv4, 0, 0);
+        return 0;
+    }
+    if (!metricsEnabled())
+    {
+        found = searchIPv4(root, ipv4, &depth);
+    }
+    else
+    {
+        start = metricsClock();
+        found = searchIPv4(root, ipv4, &depth);
+        recordLookup(METRICS_IPV4, found, start);
+    }
+    setIPv4Match(match, ipv4, found, depth);
+    return found;
+}
+
+uint8_t matchIPv4(bnode_t *root, const char *ipv4_string, ipv4_t *match)
+{
+    return matchIPv4Address(root, read_ipv4(ipv4_string), match);
+}
+
+uint8_t findIPv4Address(bnode_t *root, ipv4_t ipv4)
+{
+    return matchIPv4Address(root, ipv4, NULL);
+}
+
+const bnode_t *findIPv4Leaf(const bnode_t *node, ipv4_t ipv4)
+{
+    if (ipv4.ps == 0)
+    {
+        return NULL;
+    }
+    while ((node != NULL) && (node != node->child[0]) && (ipv4.ps > 0))
+    {
+        node = node->child[ipv4.ip >> 31];
+        ipv4.ip <<= 1;
+        ipv4.ps--;
+    }
+    return ((node != NULL) && (node == node->child[0])) ? node : NULL;
+}
+
 void bitshiftLeft(uint16_t *lst, const uint8_t shift)
 {
     uint8_t groupShift = shift / 16;
@@ -235,127 +632,675 @@ void printIPv6(FILE *stream, ipv6_t ipv6)
     fprintf(stream, "%s\n", s);
 }
 
-uint32_t walkIPv6Recursive(bnode_t **node, const uint8_t depth, const uint16_t *ip, const uint8_t printIPs)
+uint32_t dumpIPv6Tree(bnode_t *node)
 {
+    btreeiter_t it;
+    ipv6_t ip;
     uint32_t counter = 0;
-    ipv6_t ipv6;
-    uint16_t ipShift0[8];
-    uint16_t ipShift1[8];
-    uint16_t ipCopy[8];
-    uint8_t i;
 
-    if (*node == NULL)
+    initIPv6Iterator(&it, node);
+    while (nextIPv6(&it, &ip))
     {
-        return 0;
+        printIPv6(stdout, ip);
+        counter++;
+    }
+    return counter;
+}
+
+uint32_t countIPv6Tree(bnode_t *node)
+{
+    btreeiter_t it;
+    ipv6_t ip;
+    uint32_t counter = 0;
+
+    initIPv6Iterator(&it, node);
+    while (nextIPv6(&it, &ip))
+    {
+        counter++;
+    }
+    return counter;
+}
+
+uint8_t loadIPv6File(bnode_t *root, const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return 1;
+    }
+    loadEntries(root, fp, insertIPv6Entry);
+    fclose(fp);
+    return 0;
+}
+
+bnode_t *createIPv6TreeFromFile(const char *filename)
+{
+    bnode_t *root = createNode();
+    loadIPv6File(root, filename);
+    return root;
+}
+
+uint8_t findIPv6(bnode_t *root, const char *ipv6_string)
+{
+    return findIPv6Address(root, read_ipv6(ipv6_string));
+}
+
+static uint8_t searchIPv6(bnode_t *root, ipv6_t ipv6, uint8_t *depth)
+{
+    const uint8_t ps = ipv6.ps;
+    bnode_t **tree_ptr = &root;
+    while ((*tree_ptr != NULL) && (*tree_ptr != (*tree_ptr)->child[0]) && (ipv6.ps > 0))
+    {
+        *tree_ptr = (*tree_ptr)->child[ipv6.ip[0] >> 15];
+        bitshiftLeft(ipv6.ip, 1);
+        ipv6.ps--;
+    }
+    *depth = (uint8_t)(ps - ipv6.ps);
+    return !((*tree_ptr == NULL) || (*tree_ptr != (*tree_ptr)->child[0]));
+}
+
+static void setIPv6Match(ipv6_t *match, ipv6_t ipv6, uint8_t found, uint8_t depth)
+{
+    if (match == NULL)
+    {
+        return;
+    }
+    match->ps = found ? depth : 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        match->ip[i] = ipv6.ip[i] & ipv6_group_mask(match->ps, i);
     }
-    
-    if (*node != (*node)->child[0])
+}
+
+uint8_t matchIPv6Address(bnode_t *root, ipv6_t ipv6, ipv6_t *match)
+{
+    uint64_t start = 0;
+    uint8_t depth;
+    uint8_t found;
+
+    PERF_COUNT_OPERATION(PERF_FIND);
+    if (ipv6.ps == 0)
     {
-        for (i = 0; i < 8; i++)
+        if (metricsEnabled())
         {
-            ipShift0[i] = ip[i];
-            ipShift1[i] = ip[i];
+            recordParseFailure(METRICS_IPV6);
         }
-        bitshiftLeft(ipShift0, 1);
-        bitshiftLeft(ipShift1, 1);
-        ipShift1[7] += 1;
-        counter += walkIPv6Recursive(&((*node)->child[0]), depth + 1, ipShift0, printIPs);
-        counter += walkIPv6Recursive(&((*node)->child[1]), depth + 1, ipShift1, printIPs);
+        setIPv6Match(match, ipv6, 0, 0);
+        return 0;
+    }
+    if (!metricsEnabled())
+    {
+        found = searchIPv6(root, ipv6, &depth);
+    }
+    else
+    {
+        start = metricsClock();
+        found = searchIPv6(root, ipv6, &depth);
+        recordLookup(METRICS_IPV6, found, start);
+    }
+    setIPv6Match(match, ipv6, found, depth);
+    return found;
+}
+
+uint8_t matchIPv6(bnode_t *root, const char *ipv6_string, ipv6_t *match)
+{
+    return matchIPv6Address(root, read_ipv6(ipv6_string), match);
+}
+
+uint8_t findIPv6Address(bnode_t *root, ipv6_t ipv6)
+{
+    return matchIPv6Address(root, ipv6, NULL);
+}
+
+const bnode_t *findIPv6Leaf(const bnode_t *node, ipv6_t ipv6)
+{
+    for (uint8_t depth = 0; (node != NULL) && (node != node->child[0]) && (depth < ipv6.ps); depth++)
+    {
+        node = node->child[group_bit(ipv6.ip, depth)];
+    }
+    return ((ipv6.ps > 0) && (node != NULL) && (node == node->child[0])) ? node : NULL;
+}
+
+void getTreeStats(const bnode_t *root, btreestats_t *stats)
+{
+    /*
+    Depth-first walk. Every level pushes at most one pending sibling,
+    so the stack never holds more than BTREE_MAX_DEPTH + 2 entries.
+    */
+    struct
+    {
+        const bnode_t *node;
+        uint8_t depth;
+    } stack[BTREE_MAX_DEPTH + 2];
+    uint16_t top = 0;
+    uint64_t leaf_depths = 0;
+    uint64_t inner_nodes = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    if (root == NULL)
+    {
+        return;
     }
-    
-    if (counter == 0)
+    stack[top].node = root;
+    stack[top++].depth = 0;
+
+    while (top > 0)
     {
-        for (i = 0; i < 8; i++)
+        const bnode_t *node = stack[--top].node;
+        uint8_t depth = stack[top].depth;
+
+        stats->nodes++;
+        stats->depth_histogram[depth]++;
+        if (depth > stats->max_depth)
         {
-            ipCopy[i] = ip[i];
+            stats->max_depth = depth;
         }
-        bitshiftLeft(ipCopy, 128 - depth);
-        for (i = 0; i < 8; i++)
+        if (node == node->child[0])
         {
-            ipv6.ip[i] = ipCopy[i];
+            stats->leaves++;
+            leaf_depths += depth;
+            continue;
         }
-        ipv6.ps = depth;
-        if (printIPs)
+        inner_nodes++;
+        if ((node->child[0] == NULL) != (node->child[1] == NULL))
         {
-            printIPv6(stdout, ipv6);
+            stats->single_child_nodes++;
+        }
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            if ((node->child[i] != NULL) && (depth < BTREE_MAX_DEPTH))
+            {
+                stack[top].node = node->child[i];
+                stack[top++].depth = (uint8_t)(depth + 1);
+            }
         }
-        counter = 1;
     }
-    return counter;
+    stats->bytes = stats->nodes * sizeof(bnode_t);
+    stats->average_leaf_depth = stats->leaves ? (double)leaf_depths / (double)stats->leaves : 0.0;
+    stats->single_child_fraction = inner_nodes ? (double)stats->single_child_nodes / (double)inner_nodes : 0.0;
 }
 
-uint32_t dumpIPv6Tree(bnode_t *node)
+#define LOAD_READ_SIZE (1 << 20)
+
+static void countInsert(loadreport_t *report, uint8_t result)
 {
-    uint16_t ip[8];
-    for (uint8_t i = 0; i < 8; i++)
+    switch (result)
     {
-        ip[i] = 0;
+    case 0:
+        report->added++;
+        break;
+    case 1:
+        report->duplicates++;
+        break;
+    case 3:
+        report->covered++;
+        break;
+    case 4:
+        report->other_family++;
+        break;
+    default:
+        report->invalid++;
     }
-    return walkIPv6Recursive(&node, 0, ip, 1);
 }
 
-uint32_t countIPv6Tree(bnode_t *node)
+/*
+Mixed lists hold both families, and each load skips the entries of the
+other one. Those are not invalid; this is only asked for entries that
+did not parse, so valid entries pay nothing for it.
+*/
+static uint8_t isOtherFamily(uint8_t family, const char *entry, size_t length)
 {
-    uint16_t ip[8];
-    for (uint8_t i = 0; i < 8; i++)
+    uint16_t first[8];
+    uint16_t last[8];
+    uint32_t first4;
+    uint32_t last4;
+
+    if (family == 4)
     {
-        ip[i] = 0;
+        return (memchr(entry, ':', length) != NULL) &&
+               ((read_ipv6_n(entry, length).ps > 0) || read_ipv6_range_n(entry, length, first, last));
     }
-    return walkIPv6Recursive(&node, 0, ip, 0);
+    return (memchr(entry, ':', length) == NULL) &&
+           ((read_ipv4_n(entry, length).ps > 0) || read_ipv4_range_n(entry, length, &first4, &last4));
 }
 
-bnode_t *createIPv6TreeFromFile(const char *filename)
+static void loadEntryWithReport(bnode_t *root, uint8_t family, const char *entry, size_t length, loadreport_t *report)
 {
-    const uint8_t MAX_IP_LEN = 44;
-    bnode_t *root = createNode();
-    FILE *fp = fopen(filename, "r");
-    char buffer[MAX_IP_LEN];
-    int c;
-    uint8_t buffer_index = 0;
+    uint64_t parsed;
+    uint64_t deleted = report->delete_ns;
+    uint64_t start = metricsClock();
+    uint8_t result;
 
-    if (fp == NULL)
+    report->lines++;
+    if (memchr(entry, '-', length) != NULL)
+    {
+        // A start-end range: parsing and splitting count as parse time.
+        uint16_t first[8];
+        uint16_t last[8];
+        uint32_t first4;
+        uint32_t last4;
+        uint8_t valid = (family == 4) ? read_ipv4_range_n(entry, length, &first4, &last4)
+                                      : read_ipv6_range_n(entry, length, first, last);
+        parsed = metricsClock();
+        if (!valid)
+        {
+            result = 2;
+        }
+        else if (family == 4)
+        {
+            result = insertIPv4RangeNodes(root, first4, last4, report);
+        }
+        else
+        {
+            result = insertIPv6RangeNodes(root, first, last, report);
+        }
+    }
+    else if (family == 4)
+    {
+        ipv4_t ip = read_ipv4_n(entry, length);
+        parsed = metricsClock();
+        result = insertIPv4Node(root, ip, report);
+    }
+    else
+    {
+        ipv6_t ip = read_ipv6_n(entry, length);
+        parsed = metricsClock();
+        result = insertIPv6Node(root, ip, report);
+    }
+    report->parse_ns += parsed - start;
+    report->insert_ns += (metricsClock() - parsed) - (report->delete_ns - deleted);
+    if ((result == 2) && isOtherFamily(family, entry, length))
+    {
+        result = 4;
+    }
+    countInsert(report, result);
+}
+
+/*
+Reads the file in large blocks, so that reading, splitting into entries,
+parsing and inserting can each be timed on their own.
+*/
+static uint8_t loadFileWithReport(bnode_t *root, const char *filename, uint8_t family, loadreport_t *report)
+{
+    uint64_t load_start = metricsClock();
+    int fd = open(filename, O_RDONLY);
+    char *buffer;
+    size_t kept = 0;
+    uint8_t status = 0;
+
+    memset(report, 0, sizeof(*report));
+    if (fd < 0)
     {
         fprintf(stderr, "Error opening file %s\n", filename);
-        return root;
+        return 1;
+    }
+    buffer = (char *)malloc(LOAD_READ_SIZE);
+    PERF_BATCH_BEGIN(PERF_LOAD);
+    for (;;)
+    {
+        uint64_t start = metricsClock();
+        ssize_t n = read(fd, buffer + kept, LOAD_READ_SIZE - kept);
+        size_t end = kept + (size_t)((n > 0) ? n : 0);
+        size_t position = 0;
+
+        report->io_ns += metricsClock() - start;
+        if (n < 0)
+        {
+            fprintf(stderr, "Error reading file %s\n", filename);
+            status = 1;
+            break;
+        }
+        for (;;)
+        {
+            size_t token;
+
+            start = metricsClock();
+            while ((position < end) && isSeparator(buffer[position]))
+            {
+                position++;
+            }
+            token = position;
+            while ((position < end) && !isSeparator(buffer[position]))
+            {
+                position++;
+            }
+            report->tokenize_ns += metricsClock() - start;
+            if (position == token)
+            {
+                break;
+            }
+            // An entry that runs to the end of the block may continue in the next one,
+            // unless it fills the whole buffer.
+            if ((position == end) && (n > 0) && ((token > 0) || (end < LOAD_READ_SIZE)))
+            {
+                position = token;
+                break;
+            }
+            PERF_COUNT_OPERATION(PERF_LOAD);
+            loadEntryWithReport(root, family, buffer + token, position - token, report);
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        kept = end - position;
+        memmove(buffer, buffer + position, kept);
+    }
+    PERF_BATCH_END(PERF_LOAD);
+    free(buffer);
+    close(fd);
+    report->total_ns = metricsClock() - load_start;
+    return status;
+}
+
+uint8_t loadIPv4FileWithReport(bnode_t *root, const char *filename, loadreport_t *report)
+{
+    return loadFileWithReport(root, filename, 4, report);
+}
+
+uint8_t loadIPv6FileWithReport(bnode_t *root, const char *filename, loadreport_t *report)
+{
+    return loadFileWithReport(root, filename, 6, report);
+}
+
+void printLoadReport(FILE *stream, const loadreport_t *report)
+{
+    const char *const phases[] = {"io", "tokenize", "parse", "insert", "delete"};
+    const uint64_t times[] = {report->io_ns, report->tokenize_ns, report->parse_ns, report->insert_ns, report->delete_ns};
+
+    fprintf(stream, "entries %llu: added %llu, duplicates %llu, covered %llu, invalid %llu, other family %llu, absorbed nodes %llu\n",
+            (unsigned long long)report->lines, (unsigned long long)report->added, (unsigned long long)report->duplicates,
+            (unsigned long long)report->covered, (unsigned long long)report->invalid, (unsigned long long)report->other_family,
+            (unsigned long long)report->absorbed_nodes);
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        fprintf(stream, "%-9s %10.3f ms %5.1f%%\n", phases[i], (double)times[i] / 1e6,
+                report->total_ns ? 100.0 * (double)times[i] / (double)report->total_ns : 0.0);
+    }
+    fprintf(stream, "%-9s %10.3f ms\n", "total", (double)report->total_ns / 1e6);
+}
+
+/*
+Iterator states: DESCEND continues down from path[depth] to the leftmost
+leaf below it, ASCEND looks for the next right sibling above path[depth].
+*/
+#define ITER_DESCEND 0
+#define ITER_ASCEND 1
+#define ITER_DONE 2
+
+static void setIterBit(btreeiter_t *it, uint8_t depth, uint8_t bit)
+{
+    uint16_t mask = (uint16_t)(1 << (15 - (depth & 15)));
+
+    if (bit)
+    {
+        it->ip[depth >> 4] |= mask;
     }
+    else
+    {
+        it->ip[depth >> 4] &= (uint16_t)~mask;
+    }
+}
+
+static void pushIter(btreeiter_t *it, uint8_t bit)
+{
+    setIterBit(it, it->depth, bit);
+    it->path[it->depth + 1] = it->path[it->depth]->child[bit];
+    it->depth++;
+}
+
+static void initIterator(btreeiter_t *it, const bnode_t *root, uint8_t max_depth)
+{
+    it->root = root;
+    it->max_depth = max_depth;
+    resetIterator(it);
+}
+
+void initIPv4Iterator(btreeiter_t *it, const bnode_t *root)
+{
+    initIterator(it, root, 32);
+}
+
+void initIPv6Iterator(btreeiter_t *it, const bnode_t *root)
+{
+    initIterator(it, root, 128);
+}
+
+void resetIterator(btreeiter_t *it)
+{
+    memset(it->ip, 0, sizeof(it->ip));
+    it->depth = 0;
+    it->path[0] = it->root;
+    it->state = (it->root == NULL) ? ITER_DONE : ITER_DESCEND;
+}
 
-    while ((c = getc(fp)) != EOF)
+/*
+Advances to the next leaf and leaves it at path[depth].
+Returns 0 at the end of the tree.
+*/
+static uint8_t advanceIterator(btreeiter_t *it)
+{
+    while (it->state != ITER_DONE)
     {
-        if ((c == ' ') || (c == '\n') || (c == '\r') || (c == '\t') || (c == EOF))
+        const bnode_t *node = it->path[it->depth];
+
+        if (it->state == ITER_DESCEND)
         {
-            buffer[buffer_index++] = '\0';
-            insertIPv6(root, buffer);
-            for (buffer_index = 0; buffer_index < MAX_IP_LEN; buffer_index++)
+            if (node == node->child[0])
+            {
+                it->state = ITER_ASCEND;
+                return 1;
+            }
+            if ((node->child[0] != NULL) && (it->depth < it->max_depth))
+            {
+                pushIter(it, 0);
+            }
+            else if ((node->child[1] != NULL) && (it->depth < it->max_depth))
             {
-                buffer[buffer_index] = '\0';
+                pushIter(it, 1);
             }
-            buffer_index = 0;
+            else
+            {
+                it->state = ITER_ASCEND;
+            }
+            continue;
+        }
+
+        if (it->depth == 0)
+        {
+            it->state = ITER_DONE;
+            break;
+        }
+        it->depth--;
+        if ((group_bit(it->ip, it->depth) == 0) && (it->path[it->depth]->child[1] != NULL))
+        {
+            pushIter(it, 1);
+            it->state = ITER_DESCEND;
         }
         else
         {
-            buffer[buffer_index++] = (char)c;
+            setIterBit(it, it->depth, 0);
         }
     }
+    return 0;
+}
 
-    fclose(fp);
-    return root;
+static void seekIterator(btreeiter_t *it, const uint16_t *groups)
+{
+    resetIterator(it);
+    while (it->state == ITER_DESCEND)
+    {
+        const bnode_t *node = it->path[it->depth];
+        uint8_t bit;
+
+        if ((node == node->child[0]) || (it->depth == it->max_depth))
+        {
+            // A leaf that contains the address, or nothing left to follow.
+            return;
+        }
+        bit = group_bit(groups, it->depth);
+        if (node->child[bit] != NULL)
+        {
+            pushIter(it, bit);
+        }
+        else if ((bit == 0) && (node->child[1] != NULL))
+        {
+            // Everything below child[1] follows the address.
+            pushIter(it, 1);
+            return;
+        }
+        else
+        {
+            // Everything below this node precedes the address.
+            it->state = ITER_ASCEND;
+        }
+    }
 }
 
-uint8_t findIPv6(bnode_t *root, const char *ipv6_string)
+void seekIPv4Iterator(btreeiter_t *it, ipv4_t ip)
 {
-    ipv6_t ipv6 = read_ipv6(ipv6_string);
+    uint16_t groups[2] = {(uint16_t)(ip.ip >> 16), (uint16_t)ip.ip};
 
-    if (ipv6.ps == 0)
+    seekIterator(it, groups);
+}
+
+void seekIPv6Iterator(btreeiter_t *it, ipv6_t ip)
+{
+    seekIterator(it, ip.ip);
+}
+
+uint8_t nextIPv4(btreeiter_t *it, ipv4_t *ip)
+{
+    if (!advanceIterator(it))
     {
         return 0;
     }
+    // Bits below the current depth are always 0.
+    ip->ip = ((uint32_t)it->ip[0] << 16) | it->ip[1];
+    ip->ps = it->depth;
+    return 1;
+}
 
-    bnode_t **tree_ptr = &root;
-    while ((*tree_ptr != NULL) && (*tree_ptr != (*tree_ptr)->child[0]) && (ipv6.ps > 0))
+uint8_t nextIPv6(btreeiter_t *it, ipv6_t *ip)
+{
+    if (!advanceIterator(it))
     {
-        *tree_ptr = (*tree_ptr)->child[ipv6.ip[0] >> 15];
-        bitshiftLeft(ipv6.ip, 1);
-        ipv6.ps--;
+        return 0;
     }
-    return !((*tree_ptr == NULL) || (*tree_ptr != (*tree_ptr)->child[0]));
+    memcpy(ip->ip, it->ip, sizeof(ip->ip));
+    ip->ps = it->depth;
+    return 1;
+}
+
+uint32_t nextIPv4Batch(btreeiter_t *it, ipv4_t *ips, uint32_t max)
+{
+    uint32_t count = 0;
+
+    while ((count < max) && nextIPv4(it, &ips[count]))
+    {
+        count++;
+    }
+    return count;
+}
+
+uint32_t nextIPv6Batch(btreeiter_t *it, ipv6_t *ips, uint32_t max)
+{
+    uint32_t count = 0;
+
+    while ((count < max) && nextIPv6(it, &ips[count]))
+    {
+        count++;
+    }
+    return count;
+}
+
+uint32_t findIPv4Overlaps(bnode_t *root, ipv4_t range, ipv4_t *matches, uint32_t max, double *covered)
+{
+    btreeiter_t it;
+    ipv4_t ip;
+    uint32_t mask;
+    uint32_t last;
+    uint32_t count = 0;
+    double addresses = 0.0;
+
+    if (range.ps == 0)
+    {
+        if (covered != NULL)
+        {
+            *covered = 0.0;
+        }
+        return 0;
+    }
+    mask = ipv4_netmask(range.ps);
+    range.ip &= mask;
+    last = range.ip | ~mask;
+
+    initIPv4Iterator(&it, root);
+    seekIPv4Iterator(&it, range);
+    while (nextIPv4(&it, &ip) && (ip.ip <= last))
+    {
+        if (count < max)
+        {
+            matches[count] = ip;
+        }
+        count++;
+        addresses += ldexp(1.0, 32 - ((ip.ps > range.ps) ? ip.ps : range.ps));
+    }
+    if (covered != NULL)
+    {
+        *covered = addresses;
+    }
+    return count;
+}
+
+uint32_t findIPv6Overlaps(bnode_t *root, ipv6_t range, ipv6_t *matches, uint32_t max, double *covered)
+{
+    btreeiter_t it;
+    ipv6_t ip;
+    uint16_t last[8];
+    uint32_t count = 0;
+    double addresses = 0.0;
+
+    if (range.ps == 0)
+    {
+        if (covered != NULL)
+        {
+            *covered = 0.0;
+        }
+        return 0;
+    }
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        uint16_t mask = ipv6_group_mask(range.ps, i);
+        range.ip[i] &= mask;
+        last[i] = range.ip[i] | (uint16_t)~mask;
+    }
+
+    initIPv6Iterator(&it, root);
+    seekIPv6Iterator(&it, range);
+    while (nextIPv6(&it, &ip))
+    {
+        uint8_t i = 0;
+        while ((i < 8) && (ip.ip[i] == last[i]))
+        {
+            i++;
+        }
+        if ((i < 8) && (ip.ip[i] > last[i]))
+        {
+            break;
+        }
+        if (count < max)
+        {
+            matches[count] = ip;
+        }
+        count++;
+        addresses += ldexp(1.0, 128 - ((ip.ps > range.ps) ? ip.ps : range.ps));
+    }
+    if (covered != NULL)
+    {
+        *covered = addresses;
+    }
+    return count;
 }
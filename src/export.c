@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "export.h"
+
+#define SINK_FILE 0
+#define SINK_FD 1
+#define SINK_MEMORY 2
+
+typedef struct
+{
+    uint8_t type;
+    FILE *fp;
+    int fd;
+    char *data;
+    size_t length;
+    size_t capacity;
+    char *buffer;
+    size_t used;
+    uint8_t failed;
+} exportsink_t;
+
+/*
+A prefix as 16-bit groups, most significant first, so IPv4 and IPv6
+share the code that merges siblings.
+*/
+typedef struct
+{
+    uint16_t ip[8];
+    uint8_t ps;
+} prefix_t;
+
+static void flushSink(exportsink_t *sink)
+{
+    size_t offset = 0;
+
+    if (sink->failed || (sink->used == 0))
+    {
+        sink->used = 0;
+        return;
+    }
+    switch (sink->type)
+    {
+    case SINK_FILE:
+        sink->failed = (fwrite(sink->buffer, 1, sink->used, sink->fp) != sink->used);
+        break;
+    case SINK_FD:
+        while (offset < sink->used)
+        {
+            ssize_t n = write(sink->fd, sink->buffer + offset, sink->used - offset);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                sink->failed = 1;
+                break;
+            }
+            offset += (size_t)n;
+        }
+        break;
+    default:
+        if (sink->length + sink->used + 1 > sink->capacity)
+        {
+            while (sink->length + sink->used + 1 > sink->capacity)
+            {
+                sink->capacity *= 2;
+            }
+            sink->data = (char *)realloc(sink->data, sink->capacity);
+        }
+        memcpy(sink->data + sink->length, sink->buffer, sink->used);
+        sink->length += sink->used;
+        sink->data[sink->length] = '\0';
+        break;
+    }
+    sink->used = 0;
+}
+
+// Makes room for at least one record of up to IPSTRLENV6 + 1 bytes.
+static char *reserve(exportsink_t *sink)
+{
+    if (sink->used + IPSTRLENV6 + 1 > EXPORT_BUFFER_SIZE)
+    {
+        flushSink(sink);
+    }
+    return sink->buffer + sink->used;
+}
+
+static void writePrefix(exportsink_t *sink, uint8_t family, uint8_t binary, const prefix_t *prefix)
+{
+    char *p = reserve(sink);
+
+    if (binary)
+    {
+        uint8_t groups = (family == 4) ? 2 : 8;
+        for (uint8_t i = 0; i < groups; i++)
+        {
+            *p++ = (char)(prefix->ip[i] >> 8);
+            *p++ = (char)prefix->ip[i];
+        }
+        *p = (char)prefix->ps;
+        sink->used += 2 * groups + 1;
+    }
+    else if (family == 4)
+    {
+        ipv4_t ip;
+        ip.ip = ((uint32_t)prefix->ip[0] << 16) | prefix->ip[1];
+        ip.ps = prefix->ps;
+        sink->used += format_ipv4(p, ip);
+        sink->buffer[sink->used++] = '\n';
+    }
+    else
+    {
+        ipv6_t ip;
+        memcpy(ip.ip, prefix->ip, sizeof(ip.ip));
+        ip.ps = prefix->ps;
+        sink->used += format_ipv6(p, ip);
+        sink->buffer[sink->used++] = '\n';
+    }
+}
+
+static void clearBit(prefix_t *prefix, uint8_t depth)
+{
+    prefix->ip[depth >> 4] &= (uint16_t)~(1 << (15 - (depth & 15)));
+}
+
+static uint8_t samePrefix(const prefix_t *a, const prefix_t *b, uint8_t bits)
+{
+    for (uint8_t depth = 0; depth < bits; depth++)
+    {
+        if (group_bit(a->ip, depth) != group_bit(b->ip, depth))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+Whether next starts exactly where the sibling of left starts, and lies
+inside it: only then can left still be merged with what follows.
+*/
+static uint8_t continuesSibling(const prefix_t *left, const prefix_t *next)
+{
+    if ((left->ps == 0) || (group_bit(left->ip, left->ps - 1) == 1) || (next->ps < left->ps))
+    {
+        return 0;
+    }
+    if (!samePrefix(left, next, left->ps - 1) || (group_bit(next->ip, left->ps - 1) == 0))
+    {
+        return 0;
+    }
+    for (uint8_t depth = left->ps; depth < next->ps; depth++)
+    {
+        if (group_bit(next->ip, depth))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+Merges runs of entries into the fewest covering CIDR ranges. Entries
+arrive in address order and never overlap, so the pending entries form
+a chain in which every entry starts the sibling of the one below it.
+The chain is at most one entry per prefix size deep.
+*/
+static void exportMinimized(exportsink_t *sink, btreeiter_t *it, uint8_t family)
+{
+    prefix_t stack[BTREE_MAX_DEPTH + 2];
+    uint16_t top = 0;
+    prefix_t next;
+    ipv4_t ipv4;
+    ipv6_t ipv6;
+
+    for (;;)
+    {
+        memset(&next, 0, sizeof(next));
+        if (family == 4)
+        {
+            if (!nextIPv4(it, &ipv4))
+            {
+                break;
+            }
+            next.ip[0] = (uint16_t)(ipv4.ip >> 16);
+            next.ip[1] = (uint16_t)ipv4.ip;
+            next.ps = ipv4.ps;
+        }
+        else
+        {
+            if (!nextIPv6(it, &ipv6))
+            {
+                break;
+            }
+            memcpy(next.ip, ipv6.ip, sizeof(next.ip));
+            next.ps = ipv6.ps;
+        }
+
+        if ((top > 0) && !continuesSibling(&stack[top - 1], &next))
+        {
+            for (uint16_t i = 0; i < top; i++)
+            {
+                writePrefix(sink, family, 0, &stack[i]);
+            }
+            top = 0;
+        }
+        stack[top++] = next;
+        while ((top > 1) && (stack[top - 1].ps == stack[top - 2].ps))
+        {
+            // The top is the complete sibling of the entry below it.
+            top--;
+            stack[top - 1].ps--;
+            clearBit(&stack[top - 1], stack[top - 1].ps);
+        }
+    }
+    for (uint16_t i = 0; i < top; i++)
+    {
+        writePrefix(sink, family, 0, &stack[i]);
+    }
+}
+
+static void exportEntries(exportsink_t *sink, const bnode_t *root, uint8_t family, uint8_t format)
+{
+    btreeiter_t it;
+    prefix_t prefix;
+    ipv4_t ipv4;
+    ipv6_t ipv6;
+
+    if (family == 4)
+    {
+        initIPv4Iterator(&it, root);
+    }
+    else
+    {
+        initIPv6Iterator(&it, root);
+    }
+    if (format == EXPORT_CIDR)
+    {
+        exportMinimized(sink, &it, family);
+        return;
+    }
+
+    memset(&prefix, 0, sizeof(prefix));
+    if (family == 4)
+    {
+        while (nextIPv4(&it, &ipv4))
+        {
+            prefix.ip[0] = (uint16_t)(ipv4.ip >> 16);
+            prefix.ip[1] = (uint16_t)ipv4.ip;
+            prefix.ps = ipv4.ps;
+            writePrefix(sink, family, format == EXPORT_BINARY, &prefix);
+        }
+    }
+    else
+    {
+        while (nextIPv6(&it, &ipv6))
+        {
+            memcpy(prefix.ip, ipv6.ip, sizeof(prefix.ip));
+            prefix.ps = ipv6.ps;
+            writePrefix(sink, family, format == EXPORT_BINARY, &prefix);
+        }
+    }
+}
+
+static uint8_t exportTree(exportsink_t *sink, const bnode_t *root, uint8_t family, uint8_t format)
+{
+    if (((family != 4) && (family != 6)) || (format > EXPORT_CIDR))
+    {
+        return 2;
+    }
+    sink->buffer = (char *)malloc(EXPORT_BUFFER_SIZE);
+    sink->used = 0;
+    sink->failed = 0;
+    exportEntries(sink, root, family, format);
+    flushSink(sink);
+    free(sink->buffer);
+    return sink->failed;
+}
+
+uint8_t exportTreeToFile(const bnode_t *root, uint8_t family, uint8_t format, FILE *fp)
+{
+    exportsink_t sink;
+    uint8_t result;
+
+    sink.type = SINK_FILE;
+    sink.fp = fp;
+    result = exportTree(&sink, root, family, format);
+    if ((result == 0) && (fflush(fp) != 0))
+    {
+        result = 1;
+    }
+    return result;
+}
+
+uint8_t exportTreeToFd(const bnode_t *root, uint8_t family, uint8_t format, int fd)
+{
+    exportsink_t sink;
+
+    sink.type = SINK_FD;
+    sink.fd = fd;
+    return exportTree(&sink, root, family, format);
+}
+
+uint8_t exportTreeToMemory(const bnode_t *root, uint8_t family, uint8_t format, char **data, size_t *length)
+{
+    exportsink_t sink;
+    uint8_t result;
+
+    sink.type = SINK_MEMORY;
+    sink.capacity = 4096;
+    sink.data = (char *)malloc(sink.capacity);
+    sink.data[0] = '\0';
+    sink.length = 0;
+    result = exportTree(&sink, root, family, format);
+    if (result != 0)
+    {
+        free(sink.data);
+        *data = NULL;
+        *length = 0;
+        return result;
+    }
+    *data = sink.data;
+    *length = sink.length;
+    return 0;
+}
@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "generator.h"
+#include "btree.h"
+#include "ip.h"
+
+// Random addresses tried per miss before the list is taken to cover everything.
+#define GENERATOR_MAX_MISS_ATTEMPTS 1000
+
+typedef struct
+{
+    uint64_t state;
+} genrandom_t;
+
+/*
+Zipf sampler over ranks 1..n, using rejection-inversion
+(W. Hormann, G. Derflinger, 1996). It needs no tables, so it works for
+lists of any size in constant memory and constant expected time.
+*/
+typedef struct
+{
+    double s;
+    uint64_t n;
+    double h_integral_x1;
+    double h_integral_n;
+    double threshold;
+} zipf_t;
+
+static uint64_t nextRandom(genrandom_t *random)
+{
+    // splitmix64
+    return mix_bits(random->state += 0x9E3779B97F4A7C15ULL);
+}
+
+static double nextUniform(genrandom_t *random)
+{
+    return (double)(nextRandom(random) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t nextBelow(genrandom_t *random, uint64_t n)
+{
+    return (n == 0) ? 0 : nextRandom(random) % n;
+}
+
+static double helper1(double x)
+{
+    return (fabs(x) > 1e-8) ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static double helper2(double x)
+{
+    return (fabs(x) > 1e-8) ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+static double zipfH(const zipf_t *zipf, double x)
+{
+    return exp(-zipf->s * log(x));
+}
+
+static double zipfHIntegral(const zipf_t *zipf, double x)
+{
+    double log_x = log(x);
+    return helper2((1.0 - zipf->s) * log_x) * log_x;
+}
+
+static double zipfHIntegralInverse(const zipf_t *zipf, double x)
+{
+    double t = x * (1.0 - zipf->s);
+    if (t < -1.0)
+    {
+        t = -1.0;
+    }
+    return exp(helper1(t) * x);
+}
+
+static void initZipf(zipf_t *zipf, uint64_t n, double s)
+{
+    zipf->s = s;
+    zipf->n = n;
+    zipf->h_integral_x1 = zipfHIntegral(zipf, 1.5) - 1.0;
+    zipf->h_integral_n = zipfHIntegral(zipf, (double)n + 0.5);
+    zipf->threshold = 2.0 - zipfHIntegralInverse(zipf, zipfHIntegral(zipf, 2.5) - zipfH(zipf, 2.0));
+}
+
+// Returns a rank between 0 and n - 1; rank 0 is the most frequent.
+static uint64_t nextZipf(const zipf_t *zipf, genrandom_t *random)
+{
+    if (zipf->s <= 0.0)
+    {
+        return nextBelow(random, zipf->n);
+    }
+    for (;;)
+    {
+        double u = zipf->h_integral_n + nextUniform(random) * (zipf->h_integral_x1 - zipf->h_integral_n);
+        double x = zipfHIntegralInverse(zipf, u);
+        double k = floor(x + 0.5);
+
+        if (k < 1.0)
+        {
+            k = 1.0;
+        }
+        else if (k > (double)zipf->n)
+        {
+            k = (double)zipf->n;
+        }
+        if ((k - x <= zipf->threshold) || (u >= zipfHIntegral(zipf, k + 0.5) - zipfH(zipf, k)))
+        {
+            return (uint64_t)k - 1;
+        }
+    }
+}
+
+static void maskIPv6(uint16_t *ip, uint8_t ps, uint16_t *mask)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        uint16_t m = ipv6_group_mask(ps, i);
+        if (mask != NULL)
+        {
+            mask[i] = m;
+        }
+        ip[i] &= m;
+    }
+}
+
+static void randomIPv6(genrandom_t *random, uint16_t *ip)
+{
+    uint64_t high = nextRandom(random);
+    uint64_t low = nextRandom(random);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        ip[i] = (uint16_t)(high >> (48 - 16 * i));
+        ip[i + 4] = (uint16_t)(low >> (48 - 16 * i));
+    }
+    // Global unicast, 2000::/3.
+    ip[0] = (uint16_t)(0x2000 | (ip[0] & 0x1FFF));
+}
+
+static uint32_t randomIPv4(genrandom_t *random)
+{
+    // Public-looking first octet, 1 to 223.
+    uint32_t ip = (uint32_t)nextRandom(random);
+    return (ip & 0x00FFFFFF) | ((1 + (uint32_t)nextBelow(random, 223)) << 24);
+}
+
+void generateIPv4List(ipv4_t *list, uint64_t count, uint64_t seed)
+{
+    genrandom_t random = {seed};
+    uint64_t cluster_count = count / 32 + 1;
+    uint32_t *clusters = (uint32_t *)malloc(cluster_count * sizeof(uint32_t));
+
+    for (uint64_t c = 0; c < cluster_count; c++)
+    {
+        clusters[c] = randomIPv4(&random) & ipv4_netmask(16);
+    }
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        double kind = nextUniform(&random);
+        uint8_t clustered = (kind < 0.95) && (nextUniform(&random) < 0.7);
+        uint32_t ip = randomIPv4(&random);
+        uint8_t ps;
+
+        if (clustered)
+        {
+            // Hosts and /24 networks fill in the bits below the cluster's /16.
+            ip = clusters[nextBelow(&random, cluster_count)] | (ip & 0xFFFF);
+        }
+        if (kind < 0.85)
+        {
+            ps = 32;
+        }
+        else if (kind < 0.95)
+        {
+            ps = 24;
+        }
+        else if (kind < 0.98)
+        {
+            ps = (uint8_t)(16 + nextBelow(&random, 8));
+        }
+        else
+        {
+            ps = (uint8_t)(25 + nextBelow(&random, 7));
+        }
+        list[i].ip = ip & ipv4_netmask(ps);
+        list[i].ps = ps;
+    }
+    free(clusters);
+}
+
+void generateIPv6List(ipv6_t *list, uint64_t count, uint64_t seed)
+{
+    genrandom_t random = {seed};
+    uint64_t cluster_count = count / 32 + 1;
+    uint16_t(*clusters)[8] = (uint16_t(*)[8])malloc(cluster_count * sizeof(*clusters));
+
+    for (uint64_t c = 0; c < cluster_count; c++)
+    {
+        randomIPv6(&random, clusters[c]);
+        maskIPv6(clusters[c], 32, NULL);
+    }
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        double kind = nextUniform(&random);
+        uint8_t clustered = (kind < 0.97) && (nextUniform(&random) < 0.7);
+        uint8_t ps;
+
+        randomIPv6(&random, list[i].ip);
+        if (clustered)
+        {
+            // Hosts, subnets and /48 networks fill in the bits below the cluster's /32.
+            const uint16_t *cluster = clusters[nextBelow(&random, cluster_count)];
+            list[i].ip[0] = cluster[0];
+            list[i].ip[1] = cluster[1];
+        }
+        if (kind < 0.80)
+        {
+            ps = 128;
+        }
+        else if (kind < 0.92)
+        {
+            ps = 48;
+        }
+        else if (kind < 0.97)
+        {
+            ps = 64;
+        }
+        else
+        {
+            ps = (uint8_t)(32 + nextBelow(&random, 16));
+        }
+        maskIPv6(list[i].ip, ps, NULL);
+        list[i].ps = ps;
+    }
+    free(clusters);
+}
+
+static genrandom_t rankRandom(uint64_t seed, uint64_t rank, uint64_t attempt)
+{
+    genrandom_t random = {seed ^ (rank * 0xD1B54A32D192ED03ULL) ^ (attempt * 0x8CB92BA72F3D8DD7ULL)};
+    nextRandom(&random);
+    return random;
+}
+
+uint8_t generateIPv4Queries(const ipv4_t *list, uint64_t list_count, ipv4_t *queries, uint64_t count, double hit_rate, double skew, uint64_t seed)
+{
+    genrandom_t random = {seed};
+    bnode_t *root = createNode();
+    zipf_t hit_zipf;
+    zipf_t miss_zipf;
+
+    for (uint64_t i = 0; i < list_count; i++)
+    {
+        insertIPv4Address(root, list[i]);
+    }
+    initZipf(&hit_zipf, list_count ? list_count : 1, skew);
+    initZipf(&miss_zipf, count ? count : 1, skew);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        queries[i].ps = 32;
+        if ((list_count > 0) && (nextUniform(&random) < hit_rate))
+        {
+            const ipv4_t *entry = &list[nextZipf(&hit_zipf, &random)];
+            uint32_t mask = ipv4_netmask(entry->ps);
+            queries[i].ip = (entry->ip & mask) | ((uint32_t)nextRandom(&random) & ~mask);
+        }
+        else
+        {
+            // A miss rank always maps to the same address, so skew repeats misses too.
+            uint64_t rank = nextZipf(&miss_zipf, &random);
+            uint64_t attempt = 0;
+            do
+            {
+                genrandom_t rank_random = rankRandom(seed, rank, attempt++);
+                queries[i].ip = randomIPv4(&rank_random);
+            } while (findIPv4Address(root, queries[i]) && (attempt < GENERATOR_MAX_MISS_ATTEMPTS));
+            if (findIPv4Address(root, queries[i]))
+            {
+                deleteSubtree(root);
+                return 1;
+            }
+        }
+    }
+    deleteSubtree(root);
+    return 0;
+}
+
+uint8_t generateIPv6Queries(const ipv6_t *list, uint64_t list_count, ipv6_t *queries, uint64_t count, double hit_rate, double skew, uint64_t seed)
+{
+    genrandom_t random = {seed};
+    bnode_t *root = createNode();
+    zipf_t hit_zipf;
+    zipf_t miss_zipf;
+
+    for (uint64_t i = 0; i < list_count; i++)
+    {
+        insertIPv6Address(root, list[i]);
+    }
+    initZipf(&hit_zipf, list_count ? list_count : 1, skew);
+    initZipf(&miss_zipf, count ? count : 1, skew);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        queries[i].ps = 128;
+        if ((list_count > 0) && (nextUniform(&random) < hit_rate))
+        {
+            const ipv6_t *entry = &list[nextZipf(&hit_zipf, &random)];
+            uint16_t mask[8];
+            uint16_t host[8];
+
+            memcpy(queries[i].ip, entry->ip, sizeof(queries[i].ip));
+            maskIPv6(queries[i].ip, entry->ps, mask);
+            randomIPv6(&random, host);
+            for (uint8_t g = 0; g < 8; g++)
+            {
+                queries[i].ip[g] |= (uint16_t)(host[g] & ~mask[g]);
+            }
+        }
+        else
+        {
+            uint64_t rank = nextZipf(&miss_zipf, &random);
+            uint64_t attempt = 0;
+            do
+            {
+                genrandom_t rank_random = rankRandom(seed, rank, attempt++);
+                randomIPv6(&rank_random, queries[i].ip);
+            } while (findIPv6Address(root, queries[i]) && (attempt < GENERATOR_MAX_MISS_ATTEMPTS));
+            if (findIPv6Address(root, queries[i]))
+            {
+                deleteSubtree(root);
+                return 1;
+            }
+        }
+    }
+    deleteSubtree(root);
+    return 0;
+}
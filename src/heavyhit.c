@@ -0,0 +1,298 @@
+#include <stdlib.h>
+#include <string.h>
+#include "heavyhit.h"
+
+#define HEAVY_MAX_DEPTH 8
+
+heavysketch_t *createHeavySketch(uint32_t width, uint8_t depth, uint64_t window, uint64_t now)
+{
+    heavysketch_t *sketch;
+    uint32_t columns = 1;
+
+    if ((width == 0) || (width > (1U << 30)) || (depth == 0) || (depth > HEAVY_MAX_DEPTH) || (window == 0))
+    {
+        return NULL;
+    }
+    while (columns < width)
+    {
+        columns *= 2;
+    }
+    sketch = (heavysketch_t *)calloc(1, sizeof(heavysketch_t));
+    sketch->width = columns;
+    sketch->depth = depth;
+    sketch->counts = (uint32_t *)calloc((size_t)columns * depth, sizeof(uint32_t));
+    sketch->window = window;
+    sketch->window_start = now;
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        sketch->reported_hosts[i] = createNode();
+        sketch->reported_networks[i] = createNode();
+    }
+    return sketch;
+}
+
+void deleteHeavySketch(heavysketch_t *sketch)
+{
+    if (sketch == NULL)
+    {
+        return;
+    }
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        deleteSubtree(sketch->reported_hosts[i]);
+        deleteSubtree(sketch->reported_networks[i]);
+    }
+    free(sketch->counts);
+    free(sketch);
+}
+
+void setHeavyThresholds(heavysketch_t *sketch, uint32_t host, uint32_t network)
+{
+    sketch->host_threshold = host;
+    sketch->network_threshold = network;
+}
+
+void setHeavyTargets(heavysketch_t *sketch, bnode_t *ipv4_target, bnode_t *ipv6_target)
+{
+    sketch->ipv4_target = ipv4_target;
+    sketch->ipv6_target = ipv6_target;
+}
+
+void setHeavyCallbacks(heavysketch_t *sketch, ipv4heavy_t ipv4_callback, ipv6heavy_t ipv6_callback, void *context)
+{
+    sketch->ipv4_callback = ipv4_callback;
+    sketch->ipv6_callback = ipv6_callback;
+    sketch->context = context;
+}
+
+/*
+A key is a masked prefix: its groups, prefix size and family. Two
+64-bit hashes of it give the column of every row as h1 + row * h2,
+which is as good as independent hashes per row for a count-min sketch.
+*/
+static void hashKey(const uint16_t *groups, uint8_t group_count, uint8_t ps, uint8_t family, uint64_t *h1, uint64_t *h2)
+{
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    for (uint8_t i = 0; i < group_count; i++)
+    {
+        if (i < 4)
+        {
+            high = (high << 16) | groups[i];
+        }
+        else
+        {
+            low = (low << 16) | groups[i];
+        }
+    }
+    *h1 = mix_bits(high ^ mix_bits(low ^ (((uint64_t)family << 8) | ps)));
+    *h2 = mix_bits(*h1 ^ 0x9E3779B97F4A7C15ULL) | 1;
+}
+
+static uint32_t *counterAt(const heavysketch_t *sketch, uint8_t row, uint64_t h1, uint64_t h2)
+{
+    return &sketch->counts[(size_t)row * sketch->width + ((h1 + row * h2) & (sketch->width - 1))];
+}
+
+static uint32_t estimate(const heavysketch_t *sketch, uint64_t h1, uint64_t h2)
+{
+    uint32_t minimum = UINT32_MAX;
+
+    for (uint8_t row = 0; row < sketch->depth; row++)
+    {
+        uint32_t count = *counterAt(sketch, row, h1, h2);
+        minimum = (count < minimum) ? count : minimum;
+    }
+    return minimum;
+}
+
+/*
+Conservative update: only the counters at the minimum grow, which keeps
+the estimate as low as the sketch allows. Returns the new estimate.
+*/
+static uint32_t increment(heavysketch_t *sketch, uint64_t h1, uint64_t h2)
+{
+    uint32_t target = estimate(sketch, h1, h2);
+
+    if (target == UINT32_MAX)
+    {
+        return target;
+    }
+    target++;
+    for (uint8_t row = 0; row < sketch->depth; row++)
+    {
+        uint32_t *count = counterAt(sketch, row, h1, h2);
+        if (*count < target)
+        {
+            *count = target;
+        }
+    }
+    return target;
+}
+
+static void clearTree(bnode_t **root)
+{
+    if (((*root)->child[0] != NULL) || ((*root)->child[1] != NULL))
+    {
+        deleteSubtree(*root);
+        *root = createNode();
+    }
+}
+
+static void advanceWindow(heavysketch_t *sketch, uint64_t now)
+{
+    if (now - sketch->window_start < sketch->window)
+    {
+        return;
+    }
+    sketch->window_start = now - (now - sketch->window_start) % sketch->window;
+    memset(sketch->counts, 0, (size_t)sketch->width * sketch->depth * sizeof(uint32_t));
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        clearTree(&sketch->reported_hosts[i]);
+        clearTree(&sketch->reported_networks[i]);
+    }
+}
+
+static uint32_t countIPv4(heavysketch_t *sketch, ipv4_t prefix)
+{
+    uint16_t groups[2] = {(uint16_t)(prefix.ip >> 16), (uint16_t)prefix.ip};
+    uint64_t h1;
+    uint64_t h2;
+
+    hashKey(groups, 2, prefix.ps, 4, &h1, &h2);
+    return increment(sketch, h1, h2);
+}
+
+static uint32_t countIPv6(heavysketch_t *sketch, ipv6_t prefix)
+{
+    uint64_t h1;
+    uint64_t h2;
+
+    hashKey(prefix.ip, 8, prefix.ps, 6, &h1, &h2);
+    return increment(sketch, h1, h2);
+}
+
+/*
+Reports a prefix whose estimate is at or above its threshold, unless it
+was reported before in this window. Hosts and networks are kept in
+separate trees, so a reported network does not hide its hosts. Returns
+1 if the prefix was reported now.
+*/
+static uint8_t reportIPv4(heavysketch_t *sketch, bnode_t *reported, ipv4_t prefix, uint32_t count)
+{
+    if (insertIPv4Address(reported, prefix) != 0)
+    {
+        return 0;
+    }
+    if (sketch->ipv4_target != NULL)
+    {
+        insertIPv4Address(sketch->ipv4_target, prefix);
+    }
+    if (sketch->ipv4_callback != NULL)
+    {
+        sketch->ipv4_callback(sketch->context, prefix, count);
+    }
+    return 1;
+}
+
+static uint8_t reportIPv6(heavysketch_t *sketch, bnode_t *reported, ipv6_t prefix, uint32_t count)
+{
+    if (insertIPv6Address(reported, prefix) != 0)
+    {
+        return 0;
+    }
+    if (sketch->ipv6_target != NULL)
+    {
+        insertIPv6Address(sketch->ipv6_target, prefix);
+    }
+    if (sketch->ipv6_callback != NULL)
+    {
+        sketch->ipv6_callback(sketch->context, prefix, count);
+    }
+    return 1;
+}
+
+uint8_t observeIPv4(heavysketch_t *sketch, ipv4_t ip, uint64_t now)
+{
+    ipv4_t network = mask_ipv4(ip, HEAVY_IPV4_NETWORK);
+    uint8_t crossed = 0;
+    uint32_t count;
+
+    if (ip.ps != 32)
+    {
+        return 0;
+    }
+    advanceWindow(sketch, now);
+    count = countIPv4(sketch, ip);
+    if ((sketch->host_threshold != 0) && (count >= sketch->host_threshold) &&
+        reportIPv4(sketch, sketch->reported_hosts[0], ip, count))
+    {
+        crossed |= 1;
+    }
+    count = countIPv4(sketch, network);
+    if ((sketch->network_threshold != 0) && (count >= sketch->network_threshold) &&
+        reportIPv4(sketch, sketch->reported_networks[0], network, count))
+    {
+        crossed |= 2;
+    }
+    return crossed;
+}
+
+uint8_t observeIPv6(heavysketch_t *sketch, ipv6_t ip, uint64_t now)
+{
+    ipv6_t network = mask_ipv6(ip, HEAVY_IPV6_NETWORK);
+    uint8_t crossed = 0;
+    uint32_t count;
+
+    if (ip.ps != 128)
+    {
+        return 0;
+    }
+    advanceWindow(sketch, now);
+    count = countIPv6(sketch, ip);
+    if ((sketch->host_threshold != 0) && (count >= sketch->host_threshold) &&
+        reportIPv6(sketch, sketch->reported_hosts[1], ip, count))
+    {
+        crossed |= 1;
+    }
+    count = countIPv6(sketch, network);
+    if ((sketch->network_threshold != 0) && (count >= sketch->network_threshold) &&
+        reportIPv6(sketch, sketch->reported_networks[1], network, count))
+    {
+        crossed |= 2;
+    }
+    return crossed;
+}
+
+uint32_t estimateIPv4(const heavysketch_t *sketch, ipv4_t ip)
+{
+    uint16_t groups[2];
+    uint64_t h1;
+    uint64_t h2;
+
+    if ((ip.ps != 32) && (ip.ps != HEAVY_IPV4_NETWORK))
+    {
+        return 0;
+    }
+    ip = mask_ipv4(ip, ip.ps);
+    groups[0] = (uint16_t)(ip.ip >> 16);
+    groups[1] = (uint16_t)ip.ip;
+    hashKey(groups, 2, ip.ps, 4, &h1, &h2);
+    return estimate(sketch, h1, h2);
+}
+
+uint32_t estimateIPv6(const heavysketch_t *sketch, ipv6_t ip)
+{
+    uint64_t h1;
+    uint64_t h2;
+
+    if ((ip.ps != 128) && (ip.ps != HEAVY_IPV6_NETWORK))
+    {
+        return 0;
+    }
+    ip = mask_ipv6(ip, ip.ps);
+    hashKey(ip.ip, 8, ip.ps, 6, &h1, &h2);
+    return estimate(sketch, h1, h2);
+}
@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hitcount.h"
+
+#define HIT_CACHE_LINE 64
+#define HIT_COUNTS_PER_LINE (HIT_CACHE_LINE / sizeof(uint64_t))
+
+static uint32_t hashLeaf(const bnode_t *leaf, uint32_t slot_count)
+{
+    // Nodes are at least 16 bytes apart, so the low bits carry nothing.
+    return (uint32_t)((((uintptr_t)leaf >> 4) * 0x9E3779B97F4A7C15ULL) >> 32) & (slot_count - 1);
+}
+
+static void addLeaf(hitcounter_t *counter, const bnode_t *leaf, uint32_t id)
+{
+    uint32_t slot = hashLeaf(leaf, counter->slot_count);
+
+    while (counter->leaves[slot] != NULL)
+    {
+        slot = (slot + 1) & (counter->slot_count - 1);
+    }
+    counter->leaves[slot] = leaf;
+    counter->ids[slot] = id;
+}
+
+hitcounter_t *createHitCounter(const bnode_t *root, uint8_t family, uint16_t shards)
+{
+    hitcounter_t *counter;
+    btreeiter_t it;
+    size_t count_size;
+
+    if (((family != 4) && (family != 6)) || (shards == 0))
+    {
+        return NULL;
+    }
+    counter = (hitcounter_t *)malloc(sizeof(hitcounter_t));
+    counter->root = root;
+    counter->family = family;
+
+    // One walk for the number of entries, one to number them.
+    counter->entry_count = (family == 4) ? countIPv4Tree((bnode_t *)root) : countIPv6Tree((bnode_t *)root);
+    counter->entries = (ipv6_t *)calloc(counter->entry_count ? counter->entry_count : 1, sizeof(ipv6_t));
+    counter->slot_count = 16;
+    while (counter->slot_count < 2 * counter->entry_count)
+    {
+        counter->slot_count *= 2;
+    }
+    counter->leaves = (const bnode_t **)calloc(counter->slot_count, sizeof(bnode_t *));
+    counter->ids = (uint32_t *)malloc(counter->slot_count * sizeof(uint32_t));
+
+    if (family == 4)
+    {
+        initIPv4Iterator(&it, root);
+    }
+    else
+    {
+        initIPv6Iterator(&it, root);
+    }
+    for (uint32_t id = 0; id < counter->entry_count; id++)
+    {
+        if (family == 4)
+        {
+            ipv4_t ip;
+            nextIPv4(&it, &ip);
+            counter->entries[id].ip[0] = (uint16_t)(ip.ip >> 16);
+            counter->entries[id].ip[1] = (uint16_t)ip.ip;
+            counter->entries[id].ps = ip.ps;
+        }
+        else
+        {
+            nextIPv6(&it, &counter->entries[id]);
+        }
+        // The iterator stops on the leaf of the entry it returns.
+        addLeaf(counter, it.path[it.depth], id);
+    }
+
+    // Whole cache lines per shard, so no two shards share one.
+    count_size = ((counter->entry_count + HIT_COUNTS_PER_LINE - 1) / HIT_COUNTS_PER_LINE) * HIT_CACHE_LINE;
+    if (count_size == 0)
+    {
+        count_size = HIT_CACHE_LINE;
+    }
+    counter->shard_count = shards;
+    counter->counts = (uint64_t **)malloc(shards * sizeof(uint64_t *));
+    for (uint16_t s = 0; s < shards; s++)
+    {
+        void *counts = NULL;
+        if (posix_memalign(&counts, HIT_CACHE_LINE, count_size) != 0)
+        {
+            // Only the shards allocated so far are freed.
+            counter->shard_count = s;
+            deleteHitCounter(counter);
+            return NULL;
+        }
+        counter->counts[s] = (uint64_t *)counts;
+        memset(counter->counts[s], 0, count_size);
+    }
+    return counter;
+}
+
+void deleteHitCounter(hitcounter_t *counter)
+{
+    if (counter == NULL)
+    {
+        return;
+    }
+    for (uint16_t s = 0; s < counter->shard_count; s++)
+    {
+        free(counter->counts[s]);
+    }
+    free(counter->counts);
+    free(counter->entries);
+    free(counter->leaves);
+    free(counter->ids);
+    free(counter);
+}
+
+static uint32_t leafId(const hitcounter_t *counter, const bnode_t *leaf)
+{
+    uint32_t slot;
+
+    if (leaf == NULL)
+    {
+        return HIT_NO_ID;
+    }
+    slot = hashLeaf(leaf, counter->slot_count);
+    while (counter->leaves[slot] != NULL)
+    {
+        if (counter->leaves[slot] == leaf)
+        {
+            return counter->ids[slot];
+        }
+        slot = (slot + 1) & (counter->slot_count - 1);
+    }
+    // A leaf added after the counter was created.
+    return HIT_NO_ID;
+}
+
+uint32_t getIPv4HitId(const hitcounter_t *counter, ipv4_t ip)
+{
+    return leafId(counter, findIPv4Leaf(counter->root, ip));
+}
+
+uint32_t getIPv6HitId(const hitcounter_t *counter, ipv6_t ip)
+{
+    return leafId(counter, findIPv6Leaf(counter->root, ip));
+}
+
+/*
+Only the thread of the shard writes its counters, so a plain increment
+suffices. The relaxed load and store compile to ordinary moves; they
+only keep readers in other threads from seeing torn values.
+*/
+static void countHit(hitcounter_t *counter, uint16_t shard, uint32_t id)
+{
+    uint64_t *count = &counter->counts[shard][id];
+
+    __atomic_store_n(count, __atomic_load_n(count, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+uint8_t findIPv4Counted(hitcounter_t *counter, uint16_t shard, ipv4_t ip)
+{
+    const bnode_t *leaf = findIPv4Leaf(counter->root, ip);
+    uint32_t id;
+
+    if (leaf == NULL)
+    {
+        return 0;
+    }
+    id = leafId(counter, leaf);
+    if ((id != HIT_NO_ID) && (shard < counter->shard_count))
+    {
+        countHit(counter, shard, id);
+    }
+    return 1;
+}
+
+uint8_t findIPv6Counted(hitcounter_t *counter, uint16_t shard, ipv6_t ip)
+{
+    const bnode_t *leaf = findIPv6Leaf(counter->root, ip);
+    uint32_t id;
+
+    if (leaf == NULL)
+    {
+        return 0;
+    }
+    id = leafId(counter, leaf);
+    if ((id != HIT_NO_ID) && (shard < counter->shard_count))
+    {
+        countHit(counter, shard, id);
+    }
+    return 1;
+}
+
+uint64_t getHitCount(const hitcounter_t *counter, uint32_t id)
+{
+    uint64_t hits = 0;
+
+    if (id >= counter->entry_count)
+    {
+        return 0;
+    }
+    for (uint16_t s = 0; s < counter->shard_count; s++)
+    {
+        hits += __atomic_load_n(&counter->counts[s][id], __ATOMIC_RELAXED);
+    }
+    return hits;
+}
+
+ipv4_t getHitIPv4Prefix(const hitcounter_t *counter, uint32_t id)
+{
+    ipv4_t ip = {0, 0};
+
+    if (id < counter->entry_count)
+    {
+        ip.ip = ((uint32_t)counter->entries[id].ip[0] << 16) | counter->entries[id].ip[1];
+        ip.ps = counter->entries[id].ps;
+    }
+    return ip;
+}
+
+ipv6_t getHitIPv6Prefix(const hitcounter_t *counter, uint32_t id)
+{
+    ipv6_t ip;
+
+    if (id < counter->entry_count)
+    {
+        return counter->entries[id];
+    }
+    memset(&ip, 0, sizeof(ip));
+    return ip;
+}
+
+// Orders the heap with the weakest entry on top: fewer hits, or a later ID.
+static uint8_t weaker(const hitentry_t *a, const hitentry_t *b)
+{
+    return (a->hits < b->hits) || ((a->hits == b->hits) && (a->id > b->id));
+}
+
+static void siftDown(hitentry_t *heap, uint32_t size, uint32_t i)
+{
+    for (;;)
+    {
+        uint32_t smallest = i;
+        uint32_t left = 2 * i + 1;
+        uint32_t right = left + 1;
+        hitentry_t swap;
+
+        if ((left < size) && weaker(&heap[left], &heap[smallest]))
+        {
+            smallest = left;
+        }
+        if ((right < size) && weaker(&heap[right], &heap[smallest]))
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+        swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+static void siftUp(hitentry_t *heap, uint32_t i)
+{
+    while (i > 0)
+    {
+        uint32_t parent = (i - 1) / 2;
+        hitentry_t swap;
+
+        if (!weaker(&heap[i], &heap[parent]))
+        {
+            return;
+        }
+        swap = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = swap;
+        i = parent;
+    }
+}
+
+uint32_t getTopHits(const hitcounter_t *counter, hitentry_t *top, uint32_t max)
+{
+    uint32_t size = 0;
+
+    if (max == 0)
+    {
+        return 0;
+    }
+    // A min-heap of the best max entries so far: O(n log max).
+    for (uint32_t id = 0; id < counter->entry_count; id++)
+    {
+        hitentry_t entry = {id, getHitCount(counter, id)};
+
+        if (entry.hits == 0)
+        {
+            continue;
+        }
+        if (size < max)
+        {
+            top[size] = entry;
+            siftUp(top, size++);
+        }
+        else if (weaker(&top[0], &entry))
+        {
+            top[0] = entry;
+            siftDown(top, size, 0);
+        }
+    }
+    // Take the weakest off the top until the heap is empty: best first.
+    for (uint32_t end = size; end > 1; end--)
+    {
+        hitentry_t swap = top[0];
+        top[0] = top[end - 1];
+        top[end - 1] = swap;
+        siftDown(top, end - 1, 0);
+    }
+    return size;
+}
+
+uint32_t printTopHits(FILE *stream, const hitcounter_t *counter, uint32_t max)
+{
+    hitentry_t *top = (hitentry_t *)malloc((max ? max : 1) * sizeof(hitentry_t));
+    uint32_t count = getTopHits(counter, top, max);
+    char s[IPSTRLENV6];
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (counter->family == 4)
+        {
+            format_ipv4(s, getHitIPv4Prefix(counter, top[i].id));
+        }
+        else
+        {
+            format_ipv6(s, getHitIPv6Prefix(counter, top[i].id));
+        }
+        fprintf(stream, "%s %llu\n", s, (unsigned long long)top[i].hits);
+    }
+    free(top);
+    return count;
+}
+
+void resetHitCounts(hitcounter_t *counter)
+{
+    for (uint16_t s = 0; s < counter->shard_count; s++)
+    {
+        for (uint32_t id = 0; id < counter->entry_count; id++)
+        {
+            __atomic_store_n(&counter->counts[s][id], 0, __ATOMIC_RELAXED);
+        }
+    }
+}
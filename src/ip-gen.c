@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "generator.h"
+#include "ip.h"
+
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+typedef struct
+{
+    uint8_t family;
+    uint64_t count;
+    uint64_t query_count;
+    uint64_t seed;
+    double hit_rate;
+    double skew;
+    const char *list_filename;
+    const char *query_filename;
+} genoptions_t;
+
+static FILE *openOutput(const char *filename)
+{
+    FILE *fp = (filename == NULL) ? stdout : fopen(filename, "w");
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return NULL;
+    }
+    setvbuf(fp, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+    return fp;
+}
+
+static int closeOutput(FILE *fp, const char *filename)
+{
+    int failed = ferror(fp);
+
+    failed |= (fp == stdout) ? fflush(fp) : fclose(fp);
+    if (failed)
+    {
+        fprintf(stderr, "Error writing file %s\n", (filename == NULL) ? "-" : filename);
+    }
+    return failed ? -1 : 0;
+}
+
+static int writeIPv4(const ipv4_t *ips, uint64_t count, const char *filename)
+{
+    FILE *fp = openOutput(filename);
+    char s[IPSTRLENV4];
+
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    for (uint64_t i = 0; i < count; i++)
+    {
+        ipv4tostring(s, ips[i]);
+        fputs(s, fp);
+        fputc('\n', fp);
+    }
+    return closeOutput(fp, filename);
+}
+
+static int writeIPv6(const ipv6_t *ips, uint64_t count, const char *filename)
+{
+    FILE *fp = openOutput(filename);
+    char s[IPSTRLENV6];
+
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    for (uint64_t i = 0; i < count; i++)
+    {
+        ipv6tostring(s, ips[i]);
+        fputs(s, fp);
+        fputc('\n', fp);
+    }
+    return closeOutput(fp, filename);
+}
+
+static int generate(const genoptions_t *options)
+{
+    int result = 0;
+
+    if (options->family == 4)
+    {
+        ipv4_t *list = (ipv4_t *)malloc((options->count + 1) * sizeof(ipv4_t));
+        ipv4_t *queries = (ipv4_t *)malloc((options->query_count + 1) * sizeof(ipv4_t));
+
+        generateIPv4List(list, options->count, options->seed);
+        result |= writeIPv4(list, options->count, options->list_filename);
+        if (options->query_count > 0)
+        {
+            if (generateIPv4Queries(list, options->count, queries, options->query_count, options->hit_rate, options->skew, options->seed + 1) != 0)
+            {
+                fprintf(stderr, "The list covers every address: no misses to generate\n");
+                result = 1;
+            }
+            else
+            {
+                result |= writeIPv4(queries, options->query_count, options->query_filename);
+            }
+        }
+        free(queries);
+        free(list);
+    }
+    else
+    {
+        ipv6_t *list = (ipv6_t *)malloc((options->count + 1) * sizeof(ipv6_t));
+        ipv6_t *queries = (ipv6_t *)malloc((options->query_count + 1) * sizeof(ipv6_t));
+
+        generateIPv6List(list, options->count, options->seed);
+        result |= writeIPv6(list, options->count, options->list_filename);
+        if (options->query_count > 0)
+        {
+            if (generateIPv6Queries(list, options->count, queries, options->query_count, options->hit_rate, options->skew, options->seed + 1) != 0)
+            {
+                fprintf(stderr, "The list covers every address: no misses to generate\n");
+                result = 1;
+            }
+            else
+            {
+                result |= writeIPv6(queries, options->query_count, options->query_filename);
+            }
+        }
+        free(queries);
+        free(list);
+    }
+    return result;
+}
+
+static void usage(FILE *stream)
+{
+    fprintf(stream,
+            "Usage: ip-gen [-4 | -6] [-n COUNT] [-s SEED] [-o LIST] [-q QCOUNT -Q QUERIES [-r RATE] [-z SKEW]]\n"
+            "Writes a synthetic blacklist and, optionally, a query stream against it.\n"
+            "The same options and seed always produce the same output.\n"
+            "\n"
+            "  -4         Generate IPv4 addresses (default).\n"
+            "  -6         Generate IPv6 addresses.\n"
+            "  -n COUNT   Number of list entries (default 100000).\n"
+            "  -s SEED    Random seed (default 1).\n"
+            "  -o LIST    Write the list to LIST instead of standard output.\n"
+            "  -q QCOUNT  Number of single-address queries to generate.\n"
+            "  -Q QUERIES Write the queries to QUERIES; required with -q.\n"
+            "  -r RATE    Fraction of queries that hit the list (default 0.01).\n"
+            "  -z SKEW    Zipf exponent of the query popularity; 0 is uniform (default 1.0).\n"
+            "  -h         Show this help.\n");
+}
+
+int main(int argc, char **argv)
+{
+    genoptions_t options = {4, 100000, 0, 1, 0.01, 1.0, NULL, NULL};
+    char *end;
+    int option;
+
+    while ((option = getopt(argc, argv, "46n:s:o:q:Q:r:z:h")) != -1)
+    {
+        switch (option)
+        {
+        case '4':
+        case '6':
+            options.family = (uint8_t)(option - '0');
+            break;
+        case 'n':
+        case 'q':
+        case 's':
+        {
+            uint64_t value = strtoull(optarg, &end, 0);
+            if ((optarg[0] == '\0') || (optarg[0] == '-') || (*end != '\0'))
+            {
+                fprintf(stderr, "Invalid number %s\n", optarg);
+                return 2;
+            }
+            *((option == 'n') ? &options.count : ((option == 'q') ? &options.query_count : &options.seed)) = value;
+            break;
+        }
+        case 'o':
+            options.list_filename = optarg;
+            break;
+        case 'Q':
+            options.query_filename = optarg;
+            break;
+        case 'r':
+            options.hit_rate = strtod(optarg, &end);
+            if ((*end != '\0') || !(options.hit_rate >= 0.0) || (options.hit_rate > 1.0))
+            {
+                fprintf(stderr, "The hit rate must be between 0 and 1\n");
+                return 2;
+            }
+            break;
+        case 'z':
+            options.skew = strtod(optarg, &end);
+            if ((*end != '\0') || !(options.skew >= 0.0))
+            {
+                fprintf(stderr, "The skew must be 0 or more\n");
+                return 2;
+            }
+            break;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+    if ((optind != argc) || ((options.query_count > 0) && (options.query_filename == NULL)))
+    {
+        usage(stderr);
+        return 2;
+    }
+    return (generate(&options) != 0) ? 2 : 0;
+}
@@ -0,0 +1,480 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "btree.h"
+#include "ip.h"
+#include "logfilter.h"
+#include "metrics.h"
+
+#define READ_BUFFER_SIZE (1 << 20)
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+typedef enum
+{
+    PRINT_MATCHES,
+    PRINT_NON_MATCHES,
+    PRINT_ANNOTATED,
+    PRINT_COUNT,
+    PRINT_OVERLAPS
+} printmode_t;
+
+typedef struct
+{
+    char *data;
+    size_t used;
+    int fd;
+    int failed;
+} outbuffer_t;
+
+typedef struct
+{
+    bnode_t *ipv4_root;
+    bnode_t *ipv6_root;
+    printmode_t mode;
+    uint8_t use_field;
+    uint8_t show_entry;
+    char delimiter;
+    uint16_t field;
+    uint64_t matches;
+    outbuffer_t out;
+} lookup_t;
+
+typedef void (*linehandler_t)(void *context, const char *line, size_t length);
+
+static void flushOutput(outbuffer_t *out)
+{
+    size_t written = 0;
+
+    while ((written < out->used) && !out->failed)
+    {
+        ssize_t n = write(out->fd, out->data + written, out->used - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("ip-lookup: write");
+            out->failed = 1;
+            break;
+        }
+        written += (size_t)n;
+    }
+    out->used = 0;
+}
+
+static void writeOutput(outbuffer_t *out, const char *s, size_t length)
+{
+    if (out->used + length > WRITE_BUFFER_SIZE)
+    {
+        flushOutput(out);
+    }
+    if (length > WRITE_BUFFER_SIZE)
+    {
+        // Longer than the whole buffer: hand it to write() directly.
+        char *data = out->data;
+        out->data = (char *)s;
+        out->used = length;
+        flushOutput(out);
+        out->data = data;
+        return;
+    }
+    memcpy(out->data + out->used, s, length);
+    out->used += length;
+}
+
+/*
+Calls the handler for every line read from a file descriptor, without
+the line terminator. Lines point into the read buffer and are only valid
+during the call.
+*/
+static int forEachLine(int fd, linehandler_t handler, void *context)
+{
+    size_t size = READ_BUFFER_SIZE;
+    char *buffer = (char *)malloc(size);
+    size_t kept = 0;
+
+    for (;;)
+    {
+        ssize_t n = read(fd, buffer + kept, size - kept);
+        size_t end;
+        size_t start = 0;
+        const char *newline;
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            free(buffer);
+            return -1;
+        }
+        if (n == 0)
+        {
+            if (kept > 0)
+            {
+                handler(context, buffer, kept);
+            }
+            break;
+        }
+
+        end = kept + (size_t)n;
+        while ((newline = (const char *)memchr(buffer + start, '\n', end - start)) != NULL)
+        {
+            handler(context, buffer + start, (size_t)(newline - buffer) - start);
+            start = (size_t)(newline - buffer) + 1;
+        }
+        kept = end - start;
+        memmove(buffer, buffer + start, kept);
+        if (kept == size)
+        {
+            size *= 2;
+            buffer = (char *)realloc(buffer, size);
+        }
+    }
+    free(buffer);
+    return 0;
+}
+
+static const char *trim(const char *s, size_t *length)
+{
+    while ((*length > 0) && ((*s == ' ') || (*s == '\t')))
+    {
+        s++;
+        (*length)--;
+    }
+    while ((*length > 0) && ((s[*length - 1] == ' ') || (s[*length - 1] == '\t') || (s[*length - 1] == '\r')))
+    {
+        (*length)--;
+    }
+    return s;
+}
+
+static void loadLine(void *context, const char *line, size_t length)
+{
+    lookup_t *lookup = (lookup_t *)context;
+    const char *s = trim(line, &length);
+
+    if (memchr(s, ':', length) != NULL)
+    {
+        insertIPv6Entry(lookup->ipv6_root, s, length);
+    }
+    else
+    {
+        insertIPv4Entry(lookup->ipv4_root, s, length);
+    }
+}
+
+static void classifyLine(void *context, const char *line, size_t length)
+{
+    lookup_t *lookup = (lookup_t *)context;
+    size_t address_length = length;
+    const char *s;
+    uint8_t found;
+    uint8_t print;
+    uint8_t is_ipv6 = 0;
+    ipv4_t ipv4_match;
+    ipv6_t ipv6_match;
+
+    if (lookup->use_field)
+    {
+        if ((length > 0) && (line[length - 1] == '\r'))
+        {
+            address_length--;
+        }
+        s = findLogField(line, address_length, lookup->delimiter, lookup->field, &address_length);
+    }
+    else
+    {
+        s = trim(line, &address_length);
+    }
+
+    if (s == NULL)
+    {
+        found = 0;
+    }
+    else if (memchr(s, ':', address_length) != NULL)
+    {
+        is_ipv6 = 1;
+        found = matchIPv6Address(lookup->ipv6_root, read_ipv6_n(s, address_length), &ipv6_match);
+    }
+    else
+    {
+        found = matchIPv4Address(lookup->ipv4_root, read_ipv4_n(s, address_length), &ipv4_match);
+    }
+    lookup->matches += found;
+
+    switch (lookup->mode)
+    {
+    case PRINT_MATCHES:
+        print = found;
+        break;
+    case PRINT_NON_MATCHES:
+        print = !found;
+        break;
+    case PRINT_ANNOTATED:
+        print = 1;
+        break;
+    default:
+        print = 0;
+    }
+    if (print)
+    {
+        if ((length > 0) && (line[length - 1] == '\r'))
+        {
+            length--;
+        }
+        writeOutput(&lookup->out, line, length);
+        if (lookup->mode == PRINT_ANNOTATED)
+        {
+            writeOutput(&lookup->out, found ? "\t1" : "\t0", 2);
+        }
+        if (found && lookup->show_entry)
+        {
+            char entry[IPSTRLENV6 + 1];
+            entry[0] = '\t';
+            if (is_ipv6)
+            {
+                ipv6tostring(entry + 1, ipv6_match);
+            }
+            else
+            {
+                ipv4tostring(entry + 1, ipv4_match);
+            }
+            writeOutput(&lookup->out, entry, strlen(entry));
+        }
+        writeOutput(&lookup->out, "\n", 1);
+    }
+}
+
+/*
+For -o: prints the query, the number of listed addresses in it, and every
+list entry that overlaps it, all separated by tabs.
+*/
+static void overlapLine(void *context, const char *line, size_t length)
+{
+    lookup_t *lookup = (lookup_t *)context;
+    const char *s = trim(line, &length);
+    char text[IPSTRLENV6 + 1];
+    uint32_t count;
+    double covered;
+    int text_length;
+
+    if (length == 0)
+    {
+        return;
+    }
+    if (memchr(s, ':', length) != NULL)
+    {
+        ipv6_t range = read_ipv6_n(s, length);
+        ipv6_t *matches;
+
+        count = findIPv6Overlaps(lookup->ipv6_root, range, NULL, 0, &covered);
+        matches = (ipv6_t *)malloc((count ? count : 1) * sizeof(ipv6_t));
+        findIPv6Overlaps(lookup->ipv6_root, range, matches, count, NULL);
+        writeOutput(&lookup->out, s, length);
+        text_length = snprintf(text, sizeof(text), "\t%.0f", covered);
+        writeOutput(&lookup->out, text, (size_t)text_length);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            text[0] = '\t';
+            writeOutput(&lookup->out, text, format_ipv6(text + 1, matches[i]) + 1);
+        }
+        free(matches);
+    }
+    else
+    {
+        ipv4_t range = read_ipv4_n(s, length);
+        ipv4_t *matches;
+
+        count = findIPv4Overlaps(lookup->ipv4_root, range, NULL, 0, &covered);
+        matches = (ipv4_t *)malloc((count ? count : 1) * sizeof(ipv4_t));
+        findIPv4Overlaps(lookup->ipv4_root, range, matches, count, NULL);
+        writeOutput(&lookup->out, s, length);
+        text_length = snprintf(text, sizeof(text), "\t%.0f", covered);
+        writeOutput(&lookup->out, text, (size_t)text_length);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            text[0] = '\t';
+            writeOutput(&lookup->out, text, format_ipv4(text + 1, matches[i]) + 1);
+        }
+        free(matches);
+    }
+    writeOutput(&lookup->out, "\n", 1);
+    lookup->matches += (count > 0);
+}
+
+static int processFile(const char *filename, linehandler_t handler, lookup_t *lookup)
+{
+    int fd = (strcmp(filename, "-") == 0) ? STDIN_FILENO : open(filename, O_RDONLY);
+    int result;
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return -1;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    result = forEachLine(fd, handler, lookup);
+    if (result != 0)
+    {
+        fprintf(stderr, "Error reading file %s\n", filename);
+    }
+    if (fd != STDIN_FILENO)
+    {
+        close(fd);
+    }
+    return result;
+}
+
+static void usage(FILE *stream)
+{
+    fprintf(stream,
+            "Usage: ip-lookup [-m | -n | -a | -c | -o] [-e] [-f FIELD [-d DELIM]] [-M METRICS] -l LIST [-l LIST ...] [FILE ...]\n"
+            "Classifies the IP address on every input line against the given lists.\n"
+            "\n"
+            "  -l LIST   Load a list of IPv4 and IPv6 addresses and ranges; may be repeated.\n"
+            "  -m        Print matching lines (default).\n"
+            "  -n        Print non-matching lines.\n"
+            "  -a        Print every line, followed by a tab and 1 (match) or 0.\n"
+            "  -c        Print only the number of matching lines.\n"
+            "  -o        For every input range, print the number of listed addresses in it\n"
+            "            and every list entry that overlaps it, separated by tabs.\n"
+            "  -e        After a matching line, print a tab and the list entry it matched.\n"
+            "  -f FIELD  Take the address from field FIELD (counting from 1) instead of\n"
+            "            the whole line; -f 1 filters Common/Combined Log Format logs.\n"
+            "  -d DELIM  Field delimiter for -f; defaults to a space.\n"
+            "  -M FILE   Count lookups and their latency, and write the counters to FILE\n"
+            "            in the Prometheus text format when done.\n"
+            "  -h        Show this help.\n"
+            "\n"
+            "With no FILE, or when FILE is -, read standard input.\n"
+            "Exit status is 0 if any line matched, 1 if none did, 2 on error.\n");
+}
+
+int main(int argc, char **argv)
+{
+    lookup_t lookup;
+    const char *metrics_filename = NULL;
+    linehandler_t handler;
+    int lists = 0;
+    int errors = 0;
+    int option;
+    int field;
+
+    lookup.ipv4_root = createNode();
+    lookup.ipv6_root = createNode();
+    lookup.mode = PRINT_MATCHES;
+    lookup.use_field = 0;
+    lookup.show_entry = 0;
+    lookup.delimiter = LOG_DELIMITER_CLF;
+    lookup.field = LOG_FIELD_CLF;
+    lookup.matches = 0;
+
+    while ((option = getopt(argc, argv, "l:mnacoef:d:M:h")) != -1)
+    {
+        switch (option)
+        {
+        case 'l':
+            if (processFile(optarg, loadLine, &lookup) != 0)
+            {
+                return 2;
+            }
+            lists++;
+            break;
+        case 'm':
+            lookup.mode = PRINT_MATCHES;
+            break;
+        case 'n':
+            lookup.mode = PRINT_NON_MATCHES;
+            break;
+        case 'a':
+            lookup.mode = PRINT_ANNOTATED;
+            break;
+        case 'c':
+            lookup.mode = PRINT_COUNT;
+            break;
+        case 'o':
+            lookup.mode = PRINT_OVERLAPS;
+            break;
+        case 'e':
+            lookup.show_entry = 1;
+            break;
+        case 'f':
+            field = atoi(optarg);
+            if ((field < 1) || (field > UINT16_MAX))
+            {
+                fprintf(stderr, "Invalid field number %s\n", optarg);
+                return 2;
+            }
+            lookup.use_field = 1;
+            lookup.field = (uint16_t)(field - 1);
+            break;
+        case 'd':
+            if ((optarg[0] == '\0') || (optarg[1] != '\0'))
+            {
+                fprintf(stderr, "The delimiter must be a single character\n");
+                return 2;
+            }
+            lookup.delimiter = optarg[0];
+            break;
+        case 'M':
+            metrics_filename = optarg;
+            setMetricsEnabled(1);
+            break;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+    if (lists == 0)
+    {
+        usage(stderr);
+        return 2;
+    }
+
+    lookup.out.data = (char *)malloc(WRITE_BUFFER_SIZE);
+    lookup.out.used = 0;
+    lookup.out.fd = STDOUT_FILENO;
+    lookup.out.failed = 0;
+
+    handler = (lookup.mode == PRINT_OVERLAPS) ? overlapLine : classifyLine;
+    if (optind == argc)
+    {
+        errors += (processFile("-", handler, &lookup) != 0);
+    }
+    for (int i = optind; i < argc; i++)
+    {
+        errors += (processFile(argv[i], handler, &lookup) != 0);
+    }
+
+    if (lookup.mode == PRINT_COUNT)
+    {
+        char count[24];
+        int length = snprintf(count, sizeof(count), "%llu\n", (unsigned long long)lookup.matches);
+        writeOutput(&lookup.out, count, (size_t)length);
+    }
+    flushOutput(&lookup.out);
+    free(lookup.out.data);
+    if (metrics_filename != NULL)
+    {
+        errors += writeMetricsFile(metrics_filename);
+    }
+    deleteSubtree(lookup.ipv4_root);
+    deleteSubtree(lookup.ipv6_root);
+
+    if (errors || lookup.out.failed)
+    {
+        return 2;
+    }
+    return lookup.matches ? 0 : 1;
+}
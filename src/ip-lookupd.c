@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include "btree.h"
+#include "lookupd.h"
+#include "metrics.h"
+
+static lookupd_t *server;
+
+static void handleSignal(int signal_number)
+{
+    (void)signal_number;
+    stopLookupd(server);
+}
+
+static uint8_t loadList(bnode_t *ipv4_root, bnode_t *ipv6_root, const char *filename, uint8_t verbose)
+{
+    loadreport_t report;
+
+    if (!verbose)
+    {
+        return (loadIPv4File(ipv4_root, filename) != 0) || (loadIPv6File(ipv6_root, filename) != 0);
+    }
+    if (loadIPv4FileWithReport(ipv4_root, filename, &report) != 0)
+    {
+        return 1;
+    }
+    fprintf(stderr, "%s, IPv4:\n", filename);
+    printLoadReport(stderr, &report);
+    if (loadIPv6FileWithReport(ipv6_root, filename, &report) != 0)
+    {
+        return 1;
+    }
+    fprintf(stderr, "%s, IPv6:\n", filename);
+    printLoadReport(stderr, &report);
+    return 0;
+}
+
+static void usage(FILE *stream)
+{
+    fprintf(stream,
+            "Usage: ip-lookupd [-m] [-v] -s SOCKET -l LIST [-l LIST ...]\n"
+            "Serves lookups against the given lists over a Unix domain socket.\n"
+            "\n"
+            "  -s SOCKET  Path of the socket to listen on.\n"
+            "  -l LIST    Load a list of IPv4 and IPv6 addresses and ranges; may be repeated.\n"
+            "  -m         Count lookups and their latency; clients fetch the counters\n"
+            "             with a LOOKUPD_METRICS request.\n"
+            "  -v         Print a load report per list to stderr: entry counts and\n"
+            "             the time spent reading, splitting, parsing and inserting.\n"
+            "  -h         Show this help.\n");
+}
+
+int main(int argc, char **argv)
+{
+    bnode_t *ipv4_root = createNode();
+    bnode_t *ipv6_root = createNode();
+    const char *socket_path = NULL;
+    struct sigaction action;
+    uint8_t verbose = 0;
+    int lists = 0;
+    int option;
+    int result;
+
+    while ((option = getopt(argc, argv, "s:l:mvh")) != -1)
+    {
+        switch (option)
+        {
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'l':
+            if (loadList(ipv4_root, ipv6_root, optarg, verbose) != 0)
+            {
+                return 2;
+            }
+            lists++;
+            break;
+        case 'm':
+            setMetricsEnabled(1);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+            usage(stdout);
+            return 0;
+        default:
+            usage(stderr);
+            return 2;
+        }
+    }
+    if ((socket_path == NULL) || (lists == 0))
+    {
+        usage(stderr);
+        return 2;
+    }
+
+    server = createLookupd(socket_path, ipv4_root, ipv6_root);
+    if (server == NULL)
+    {
+        return 1;
+    }
+
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    result = runLookupd(server);
+    deleteLookupd(server);
+    deleteSubtree(ipv4_root);
+    deleteSubtree(ipv6_root);
+    return (result == 0) ? 0 : 1;
+}
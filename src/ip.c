@@ -81,6 +81,104 @@ ipv6_t read_ipv6(const char *ipv6_string)
     return ip;
 }
 
+/*
+Reads a prefix size of known length. Unlike read_prefix_size(), this
+does not report errors on stderr, since it runs on the lookup path.
+*/
+static uint8_t read_prefix_size_n(const char *s, size_t length, uint8_t max_value)
+{
+    uint32_t prefix_size = 0;
+
+    if (length == 0)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        if ((s[i] < '0') || (s[i] > '9'))
+        {
+            return 0;
+        }
+        prefix_size = prefix_size * 10 + (uint32_t)(s[i] - '0');
+        if (prefix_size > max_value)
+        {
+            return 0;
+        }
+    }
+    return (uint8_t)prefix_size;
+}
+
+ipv4_t read_ipv4_n(const char *ipv4_string, size_t length)
+{
+    /*
+    Follows the rules of inet_pton(AF_INET): exactly four decimal groups
+    of at most 255, without leading zeroes.
+    */
+    uint32_t address = 0;
+    uint32_t group = 0;
+    uint8_t groups = 0;
+    uint8_t digits = 0;
+    size_t p = 0;
+    ipv4_t ip;
+
+    for (; (p < length) && (ipv4_string[p] != '/'); p++)
+    {
+        char c = ipv4_string[p];
+        if ((c >= '0') && (c <= '9'))
+        {
+            if ((digits > 0) && (group == 0))
+            {
+                return empty_ipv4();
+            }
+            group = group * 10 + (uint32_t)(c - '0');
+            if ((group > 255) || (++digits > 3))
+            {
+                return empty_ipv4();
+            }
+        }
+        else if ((c == '.') && (digits > 0) && (groups < 3))
+        {
+            address = (address << 8) | group;
+            groups++;
+            group = 0;
+            digits = 0;
+        }
+        else
+        {
+            return empty_ipv4();
+        }
+    }
+    if ((groups != 3) || (digits == 0))
+    {
+        return empty_ipv4();
+    }
+
+    ip.ip = (address << 8) | group;
+    ip.ps = 32;
+    if (p < length)
+    {
+        ip.ps = read_prefix_size_n(ipv4_string + p + 1, length - p - 1, 32);
+        if (ip.ps == 0)
+        {
+            return empty_ipv4();
+        }
+    }
+    return ip;
+}
+
+ipv6_t read_ipv6_n(const char *ipv6_string, size_t length)
+{
+    char string_buffer[IPSTRLENV6];
+
+    if (length >= IPSTRLENV6)
+    {
+        return empty_ipv6();
+    }
+    memcpy(string_buffer, ipv6_string, length);
+    string_buffer[length] = '\0';
+    return read_ipv6(string_buffer);
+}
+
 void ipv4tostring(char *string_buffer, ipv4_t ip)
 {
     uint32_t ip_reversed = reverseBytesIPv4(ip.ip);
@@ -98,6 +196,327 @@ void ipv6tostring(char *string_buffer, ipv6_t ip)
     append_prefix_size(string_buffer, ip.ps, 128);
 }
 
+uint8_t read_ipv4_range_n(const char *ipv4_string, size_t length, uint32_t *first, uint32_t *last)
+{
+    const char *dash = (const char *)memchr(ipv4_string, '-', length);
+    ipv4_t start;
+    ipv4_t end;
+
+    if (dash == NULL)
+    {
+        return 0;
+    }
+    start = read_ipv4_n(ipv4_string, (size_t)(dash - ipv4_string));
+    end = read_ipv4_n(dash + 1, length - (size_t)(dash - ipv4_string) - 1);
+    if ((start.ps != 32) || (end.ps != 32) || (start.ip > end.ip))
+    {
+        return 0;
+    }
+    *first = start.ip;
+    *last = end.ip;
+    return 1;
+}
+
+static int8_t compare_ipv6(const uint16_t *a, const uint16_t *b)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        if (a[i] != b[i])
+        {
+            return (a[i] < b[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t read_ipv6_range_n(const char *ipv6_string, size_t length, uint16_t *first, uint16_t *last)
+{
+    const char *dash = (const char *)memchr(ipv6_string, '-', length);
+    ipv6_t start;
+    ipv6_t end;
+
+    if (dash == NULL)
+    {
+        return 0;
+    }
+    start = read_ipv6_n(ipv6_string, (size_t)(dash - ipv6_string));
+    end = read_ipv6_n(dash + 1, length - (size_t)(dash - ipv6_string) - 1);
+    if ((start.ps != 128) || (end.ps != 128) || (compare_ipv6(start.ip, end.ip) > 0))
+    {
+        return 0;
+    }
+    memcpy(first, start.ip, sizeof(start.ip));
+    memcpy(last, end.ip, sizeof(end.ip));
+    return 1;
+}
+
+/*
+Both splits take, at every step, the largest block that starts at first
+(limited by its trailing zero bits) and does not run past last. The
+whole address space is returned as two halves, since a prefix size of 0
+means invalid.
+*/
+uint8_t ipv4_range_to_prefixes(uint32_t first, uint32_t last, ipv4_t *prefixes)
+{
+    uint64_t start = first;
+    uint8_t count = 0;
+
+    while (start <= last)
+    {
+        uint8_t bits = (start == 0) ? 31 : (uint8_t)__builtin_ctzll(start);
+
+        if (bits > 31)
+        {
+            bits = 31;
+        }
+        while (start + (1ULL << bits) - 1 > last)
+        {
+            bits--;
+        }
+        prefixes[count].ip = (uint32_t)start;
+        prefixes[count].ps = (uint8_t)(32 - bits);
+        count++;
+        start += 1ULL << bits;
+    }
+    return count;
+}
+
+// 128-bit values as two 64-bit halves, high half first.
+static void ipv6_to_halves(const uint16_t *groups, uint64_t *halves)
+{
+    for (uint8_t h = 0; h < 2; h++)
+    {
+        halves[h] = 0;
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            halves[h] = (halves[h] << 16) | groups[4 * h + i];
+        }
+    }
+}
+
+// Sets end to start + 2^bits - 1; returns 1 if that overflows 128 bits.
+static uint8_t block_end(const uint64_t *start, uint8_t bits, uint64_t *end)
+{
+    uint64_t add_high = (bits > 64) ? ((1ULL << (bits - 64)) - 1) : 0;
+    uint64_t add_low = (bits >= 64) ? UINT64_MAX : ((1ULL << bits) - 1);
+
+    end[1] = start[1] + add_low;
+    end[0] = start[0] + add_high + (end[1] < start[1]);
+    return end[0] < start[0];
+}
+
+static uint8_t halves_greater(const uint64_t *a, const uint64_t *b)
+{
+    return (a[0] > b[0]) || ((a[0] == b[0]) && (a[1] > b[1]));
+}
+
+uint8_t ipv6_range_to_prefixes(const uint16_t *first, const uint16_t *last, ipv6_t *prefixes)
+{
+    uint64_t start[2];
+    uint64_t stop[2];
+    uint64_t end[2];
+    uint8_t count = 0;
+
+    ipv6_to_halves(first, start);
+    ipv6_to_halves(last, stop);
+    if (halves_greater(start, stop))
+    {
+        return 0;
+    }
+    for (;;)
+    {
+        uint8_t bits = (start[1] != 0) ? (uint8_t)__builtin_ctzll(start[1])
+                       : (start[0] != 0) ? (uint8_t)(64 + __builtin_ctzll(start[0])) : 127;
+
+        if (bits > 127)
+        {
+            bits = 127;
+        }
+        while (block_end(start, bits, end) || halves_greater(end, stop))
+        {
+            bits--;
+        }
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            prefixes[count].ip[i] = (uint16_t)(start[i / 4] >> (16 * (3 - i % 4)));
+        }
+        prefixes[count].ps = (uint8_t)(128 - bits);
+        count++;
+        if ((end[0] == stop[0]) && (end[1] == stop[1]))
+        {
+            break;
+        }
+        start[1] = end[1] + 1;
+        start[0] = end[0] + (start[1] == 0);
+    }
+    return count;
+}
+
+uint8_t read_ipv4_entry_n(const char *entry, size_t length, ipv4_t *prefixes)
+{
+    uint32_t first;
+    uint32_t last;
+
+    if (memchr(entry, '-', length) == NULL)
+    {
+        prefixes[0] = read_ipv4_n(entry, length);
+        return prefixes[0].ps > 0;
+    }
+    if (!read_ipv4_range_n(entry, length, &first, &last))
+    {
+        return 0;
+    }
+    return ipv4_range_to_prefixes(first, last, prefixes);
+}
+
+uint8_t read_ipv6_entry_n(const char *entry, size_t length, ipv6_t *prefixes)
+{
+    uint16_t first[8];
+    uint16_t last[8];
+
+    if (memchr(entry, '-', length) == NULL)
+    {
+        prefixes[0] = read_ipv6_n(entry, length);
+        return prefixes[0].ps > 0;
+    }
+    if (!read_ipv6_range_n(entry, length, first, last))
+    {
+        return 0;
+    }
+    return ipv6_range_to_prefixes(first, last, prefixes);
+}
+
+static char *format_decimal(char *p, uint8_t value)
+{
+    if (value >= 100)
+    {
+        *p++ = (char)('0' + value / 100);
+        value %= 100;
+        *p++ = (char)('0' + value / 10);
+    }
+    else if (value >= 10)
+    {
+        *p++ = (char)('0' + value / 10);
+    }
+    *p++ = (char)('0' + value % 10);
+    return p;
+}
+
+static char *format_dotted(char *p, uint32_t address)
+{
+    for (int8_t shift = 24; shift >= 0; shift -= 8)
+    {
+        p = format_decimal(p, (uint8_t)(address >> shift));
+        *p++ = '.';
+    }
+    return p - 1;
+}
+
+static char *format_prefix_size(char *p, uint8_t prefix_size, uint8_t default_ps)
+{
+    if (prefix_size != default_ps)
+    {
+        *p++ = '/';
+        p = format_decimal(p, prefix_size);
+    }
+    *p = '\0';
+    return p;
+}
+
+size_t format_ipv4(char *string_buffer, ipv4_t ip)
+{
+    char *p = format_dotted(string_buffer, ip.ip);
+
+    return (size_t)(format_prefix_size(p, ip.ps, 32) - string_buffer);
+}
+
+size_t format_ipv6(char *string_buffer, ipv6_t ip)
+{
+    static const char hex[] = "0123456789abcdef";
+    char *p = string_buffer;
+    int8_t best_base = -1;
+    uint8_t best_length = 0;
+    uint8_t i = 0;
+
+    // Longest run of at least two zero groups; the first one wins a tie.
+    while (i < 8)
+    {
+        uint8_t length = 0;
+        while ((i + length < 8) && (ip.ip[i + length] == 0))
+        {
+            length++;
+        }
+        if ((length > 1) && (length > best_length))
+        {
+            best_base = (int8_t)i;
+            best_length = length;
+        }
+        i = (uint8_t)(i + (length ? length : 1));
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        uint16_t group = ip.ip[i];
+
+        if ((best_base >= 0) && (i == best_base))
+        {
+            *p++ = ':';
+            if (i + best_length == 8)
+            {
+                *p++ = ':';
+            }
+            i = (uint8_t)(i + best_length - 1);
+            continue;
+        }
+        if (i > 0)
+        {
+            *p++ = ':';
+        }
+        if ((i == 6) && (best_base == 0) && ((best_length == 6) || ((best_length == 5) && (ip.ip[5] == 0xffff))))
+        {
+            p = format_dotted(p, ((uint32_t)ip.ip[6] << 16) | ip.ip[7]);
+            break;
+        }
+        for (int8_t shift = 12; shift >= 0; shift -= 4)
+        {
+            if ((group >> shift) || (shift == 0))
+            {
+                *p++ = hex[(group >> shift) & 0xF];
+            }
+        }
+    }
+    return (size_t)(format_prefix_size(p, ip.ps, 128) - string_buffer);
+}
+
+uint32_t ipv4_netmask(uint8_t prefix_size)
+{
+    return (prefix_size == 0) ? 0 : 0xFFFFFFFFU << (32 - prefix_size);
+}
+
+uint16_t ipv6_group_mask(uint8_t prefix_size, uint8_t group)
+{
+    int16_t bits = (int16_t)(prefix_size - 16 * group);
+
+    return (bits >= 16) ? 0xFFFF : ((bits <= 0) ? 0 : (uint16_t)(0xFFFF << (16 - bits)));
+}
+
+ipv4_t mask_ipv4(ipv4_t ip, uint8_t prefix_size)
+{
+    ip.ip &= ipv4_netmask(prefix_size);
+    ip.ps = prefix_size;
+    return ip;
+}
+
+ipv6_t mask_ipv6(ipv6_t ip, uint8_t prefix_size)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        ip.ip[i] &= ipv6_group_mask(prefix_size, i);
+    }
+    ip.ps = prefix_size;
+    return ip;
+}
+
 uint8_t read_prefix_size(const char* ip_string, uint8_t *string_index, uint8_t max_value)
 {
     /*
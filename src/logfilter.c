@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "logfilter.h"
+#include "btree.h"
+#include "ip.h"
+
+/*
+Returns the position of the (n+1)-th occurrence of c, or NULL.
+With SSE2, each 16-byte block costs one compare and one popcount,
+so skipping over fields does not depend on their length.
+*/
+static const char *findNthByte(const char *s, size_t length, char c, uint16_t n)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i pattern = _mm_set1_epi8(c);
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+        uint16_t hits = (uint16_t)__builtin_popcount(mask);
+        if (hits > n)
+        {
+            while (n-- > 0)
+            {
+                mask &= mask - 1;
+            }
+            return s + i + __builtin_ctz(mask);
+        }
+        n -= hits;
+    }
+#endif
+    for (; i < length; i++)
+    {
+        if ((s[i] == c) && (n-- == 0))
+        {
+            return s + i;
+        }
+    }
+    return NULL;
+}
+
+const char *findLogField(const char *line, size_t length, char delimiter, uint16_t field, size_t *field_length)
+{
+    const char *start = line;
+    const char *end;
+
+    if (field > 0)
+    {
+        start = findNthByte(line, length, delimiter, field - 1);
+        if (start == NULL)
+        {
+            return NULL;
+        }
+        start++;
+    }
+    end = (const char *)memchr(start, delimiter, (size_t)(line + length - start));
+    if (end == NULL)
+    {
+        end = line + length;
+    }
+    *field_length = (size_t)(end - start);
+    return start;
+}
+
+static uint8_t matchField(bnode_t *ipv4_root, bnode_t *ipv6_root, const char *field, size_t length)
+{
+    if (memchr(field, ':', length) != NULL)
+    {
+        return (ipv6_root != NULL) && findIPv6Address(ipv6_root, read_ipv6_n(field, length));
+    }
+    return (ipv4_root != NULL) && findIPv4Address(ipv4_root, read_ipv4_n(field, length));
+}
+
+uint64_t filterAccessLog(bnode_t *ipv4_root, bnode_t *ipv6_root, const char *buffer, size_t size, char delimiter, uint16_t field, FILE *out)
+{
+    const char *line = buffer;
+    const char *end = buffer + size;
+    const char *run = NULL;
+    uint64_t matches = 0;
+
+    while (line < end)
+    {
+        const char *newline = (const char *)memchr(line, '\n', (size_t)(end - line));
+        const char *next = (newline != NULL) ? newline + 1 : end;
+        size_t length = (size_t)(next - line) - (newline != NULL);
+        size_t address_length;
+        const char *address;
+
+        if ((length > 0) && (line[length - 1] == '\r'))
+        {
+            length--;
+        }
+        address = findLogField(line, length, delimiter, field, &address_length);
+
+        if ((address != NULL) && matchField(ipv4_root, ipv6_root, address, address_length))
+        {
+            matches++;
+            if (run == NULL)
+            {
+                run = line;
+            }
+        }
+        else if (run != NULL)
+        {
+            if (out != NULL)
+            {
+                fwrite(run, 1, (size_t)(line - run), out);
+            }
+            run = NULL;
+        }
+        line = next;
+    }
+    if ((run != NULL) && (out != NULL))
+    {
+        fwrite(run, 1, (size_t)(end - run), out);
+        if (end[-1] != '\n')
+        {
+            fputc('\n', out);
+        }
+    }
+    return matches;
+}
+
+uint64_t filterAccessLogFile(bnode_t *ipv4_root, bnode_t *ipv6_root, const char *filename, char delimiter, uint16_t field, FILE *out)
+{
+    int fd = open(filename, O_RDONLY);
+    struct stat status;
+    uint64_t matches = 0;
+    void *buffer;
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return 0;
+    }
+    if (fstat(fd, &status) != 0)
+    {
+        fprintf(stderr, "Error reading file %s\n", filename);
+        close(fd);
+        return 0;
+    }
+    if (status.st_size > 0)
+    {
+        buffer = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (buffer == MAP_FAILED)
+        {
+            fprintf(stderr, "Error reading file %s\n", filename);
+        }
+        else
+        {
+            madvise(buffer, (size_t)status.st_size, MADV_SEQUENTIAL);
+            matches = filterAccessLog(ipv4_root, ipv6_root, (const char *)buffer, (size_t)status.st_size, delimiter, field, out);
+            munmap(buffer, (size_t)status.st_size);
+        }
+    }
+    close(fd);
+    return matches;
+}
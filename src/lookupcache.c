@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lookupcache.h"
+
+#define LOOKUP_CACHE_MAX_SETS (1U << 24)
+
+lookupcache_t *createLookupCache(bnode_t *ipv4_root, bnode_t *ipv6_root, uint32_t sets)
+{
+    lookupcache_t *cache;
+
+    if ((sets == 0) || (sets > LOOKUP_CACHE_MAX_SETS))
+    {
+        return NULL;
+    }
+    cache = (lookupcache_t *)malloc(sizeof(lookupcache_t));
+    cache->ipv4_root = ipv4_root;
+    cache->ipv6_root = ipv6_root;
+    cache->ipv4_watch = watchTree(ipv4_root);
+    cache->ipv6_watch = watchTree(ipv6_root);
+    if (((ipv4_root != NULL) && (cache->ipv4_watch == NULL)) || ((ipv6_root != NULL) && (cache->ipv6_watch == NULL)))
+    {
+        unwatchTree((cache->ipv4_watch != NULL) ? ipv4_root : NULL);
+        unwatchTree((cache->ipv6_watch != NULL) ? ipv6_root : NULL);
+        free(cache);
+        return NULL;
+    }
+    cache->set_count = 1;
+    cache->set_bits = 0;
+    while (cache->set_count < sets)
+    {
+        cache->set_count *= 2;
+        cache->set_bits++;
+    }
+    cache->ipv4_sets = (ipv4cacheentry_t(*)[2])calloc(cache->set_count, sizeof(*cache->ipv4_sets));
+    cache->ipv6_sets = (ipv6cacheentry_t(*)[2])calloc(cache->set_count, sizeof(*cache->ipv6_sets));
+    cache->ipv4_generation = getTreeGeneration(cache->ipv4_watch);
+    cache->ipv6_generation = getTreeGeneration(cache->ipv6_watch);
+    cache->hits = 0;
+    cache->misses = 0;
+    return cache;
+}
+
+void deleteLookupCache(lookupcache_t *cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+    unwatchTree(cache->ipv4_root);
+    unwatchTree(cache->ipv6_root);
+    free(cache->ipv4_sets);
+    free(cache->ipv6_sets);
+    free(cache);
+}
+
+void clearLookupCache(lookupcache_t *cache)
+{
+    memset(cache->ipv4_sets, 0, cache->set_count * sizeof(*cache->ipv4_sets));
+    memset(cache->ipv6_sets, 0, cache->set_count * sizeof(*cache->ipv6_sets));
+}
+
+// Empties the IPv4 half of the cache if its tree changed since the entries were stored.
+static void checkIPv4Generation(lookupcache_t *cache)
+{
+    uint64_t generation = getTreeGeneration(cache->ipv4_watch);
+
+    if (generation != cache->ipv4_generation)
+    {
+        memset(cache->ipv4_sets, 0, cache->set_count * sizeof(*cache->ipv4_sets));
+        cache->ipv4_generation = generation;
+    }
+}
+
+static void checkIPv6Generation(lookupcache_t *cache)
+{
+    uint64_t generation = getTreeGeneration(cache->ipv6_watch);
+
+    if (generation != cache->ipv6_generation)
+    {
+        memset(cache->ipv6_sets, 0, cache->set_count * sizeof(*cache->ipv6_sets));
+        cache->ipv6_generation = generation;
+    }
+}
+
+/*
+Multiplicative hashing: the top bits of the product depend on all bits
+of the key, so neighbouring addresses land in different sets.
+*/
+static uint32_t setIndex(uint64_t key, uint8_t set_bits)
+{
+    return (set_bits == 0) ? 0 : (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - set_bits));
+}
+
+uint8_t findIPv4Cached(lookupcache_t *cache, ipv4_t ip)
+{
+    ipv4cacheentry_t *set;
+    ipv4cacheentry_t entry;
+
+    if ((ip.ps != 32) || (cache->ipv4_root == NULL))
+    {
+        return (cache->ipv4_root != NULL) && findIPv4Address(cache->ipv4_root, ip);
+    }
+    checkIPv4Generation(cache);
+    set = cache->ipv4_sets[setIndex(ip.ip, cache->set_bits)];
+    if (set[0].valid && (set[0].ip == ip.ip))
+    {
+        cache->hits++;
+        return set[0].found;
+    }
+    if (set[1].valid && (set[1].ip == ip.ip))
+    {
+        // Keep the most recently used entry first.
+        entry = set[1];
+        set[1] = set[0];
+        set[0] = entry;
+        cache->hits++;
+        return entry.found;
+    }
+    cache->misses++;
+    entry.ip = ip.ip;
+    entry.valid = 1;
+    entry.found = findIPv4Address(cache->ipv4_root, ip);
+    set[1] = set[0];
+    set[0] = entry;
+    return entry.found;
+}
+
+uint8_t findIPv6Cached(lookupcache_t *cache, ipv6_t ip)
+{
+    ipv6cacheentry_t *set;
+    ipv6cacheentry_t entry;
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    if ((ip.ps != 128) || (cache->ipv6_root == NULL))
+    {
+        return (cache->ipv6_root != NULL) && findIPv6Address(cache->ipv6_root, ip);
+    }
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        high = (high << 16) | ip.ip[i];
+        low = (low << 16) | ip.ip[i + 4];
+    }
+    checkIPv6Generation(cache);
+    set = cache->ipv6_sets[setIndex(high ^ (low * 0xC2B2AE3D27D4EB4FULL), cache->set_bits)];
+    if (set[0].valid && (set[0].high == high) && (set[0].low == low))
+    {
+        cache->hits++;
+        return set[0].found;
+    }
+    if (set[1].valid && (set[1].high == high) && (set[1].low == low))
+    {
+        entry = set[1];
+        set[1] = set[0];
+        set[0] = entry;
+        cache->hits++;
+        return entry.found;
+    }
+    cache->misses++;
+    entry.high = high;
+    entry.low = low;
+    entry.valid = 1;
+    entry.found = findIPv6Address(cache->ipv6_root, ip);
+    set[1] = set[0];
+    set[0] = entry;
+    return entry.found;
+}
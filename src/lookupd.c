@@ -0,0 +1,617 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "lookupd.h"
+#include "metrics.h"
+#include "btree.h"
+#include "ip.h"
+
+#define LOOKUPD_MAX_EVENTS 64
+#define LOOKUPD_READ_SIZE 65536
+// Unsent output above which a connection is not read until the client catches up.
+#define LOOKUPD_MAX_PENDING_OUTPUT (1 << 20)
+
+typedef struct lookupdconn
+{
+    struct lookupdconn *prev;
+    struct lookupdconn *next;
+    int fd;
+    uint8_t *in;
+    size_t in_used;
+    size_t in_size;
+    uint8_t *out;
+    size_t out_used;
+    size_t out_sent;
+    size_t out_size;
+    uint8_t want_read;
+    uint8_t want_write;
+    uint8_t read_closed;         // The client shut down its sending side.
+} lookupdconn_t;
+
+static uint8_t wake_marker;
+
+static size_t addressWidth(uint8_t type)
+{
+    return (type == LOOKUPD_QUERY_IPV4) ? 4 : 16;
+}
+
+static size_t pendingOutput(const lookupdconn_t *conn)
+{
+    return conn->out_used - conn->out_sent;
+}
+
+static void reserve(uint8_t **buffer, size_t *size, size_t needed)
+{
+    if (*size >= needed)
+    {
+        return;
+    }
+    while (*size < needed)
+    {
+        *size = *size ? 2 * *size : LOOKUPD_READ_SIZE;
+    }
+    *buffer = (uint8_t *)realloc(*buffer, *size);
+}
+
+static void closeConnection(lookupd_t *server, lookupdconn_t *conn)
+{
+    if (conn->prev != NULL)
+    {
+        conn->prev->next = conn->next;
+    }
+    else
+    {
+        server->connections = conn->next;
+    }
+    if (conn->next != NULL)
+    {
+        conn->next->prev = conn->prev;
+    }
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn->in);
+    free(conn->out);
+    free(conn);
+}
+
+static void answerMetrics(lookupdconn_t *conn, const lookupd_header_t *header)
+{
+    lookupd_header_t response = *header;
+    char *text = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&text, &length);
+
+    if (stream != NULL)
+    {
+        writeMetrics(stream);
+        fclose(stream);
+    }
+    response.count = (uint32_t)length;
+    reserve(&conn->out, &conn->out_size, conn->out_used + sizeof(lookupd_header_t) + length);
+    memcpy(conn->out + conn->out_used, &response, sizeof(lookupd_header_t));
+    memcpy(conn->out + conn->out_used + sizeof(lookupd_header_t), text, length);
+    conn->out_used += sizeof(lookupd_header_t) + length;
+    free(text);
+}
+
+static void answerRequest(lookupd_t *server, lookupdconn_t *conn, const lookupd_header_t *header, const uint8_t *payload)
+{
+    size_t bitmap_size = (header->count + 7) / 8;
+    uint8_t *bitmap;
+
+    reserve(&conn->out, &conn->out_size, conn->out_used + sizeof(lookupd_header_t) + bitmap_size);
+    memcpy(conn->out + conn->out_used, header, sizeof(lookupd_header_t));
+    bitmap = conn->out + conn->out_used + sizeof(lookupd_header_t);
+    memset(bitmap, 0, bitmap_size);
+
+    if (header->type == LOOKUPD_QUERY_IPV4)
+    {
+        ipv4_t ip;
+        ip.ps = 32;
+        for (uint32_t i = 0; i < header->count; i++)
+        {
+            memcpy(&ip.ip, payload + 4 * (size_t)i, 4);
+            bitmap[i / 8] |= (uint8_t)(findIPv4Address(server->ipv4_root, ip) << (i % 8));
+        }
+    }
+    else
+    {
+        ipv6_t ip;
+        ip.ps = 128;
+        for (uint32_t i = 0; i < header->count; i++)
+        {
+            memcpy(ip.ip, payload + 16 * (size_t)i, 16);
+            bitmap[i / 8] |= (uint8_t)(findIPv6Address(server->ipv6_root, ip) << (i % 8));
+        }
+    }
+    conn->out_used += sizeof(lookupd_header_t) + bitmap_size;
+}
+
+/*
+Answers the complete requests in the input buffer, until the output
+waiting for the client reaches LOOKUPD_MAX_PENDING_OUTPUT; the rest
+stays buffered. Returns -1 if a request is malformed.
+*/
+static int processInput(lookupd_t *server, lookupdconn_t *conn)
+{
+    size_t offset = 0;
+    lookupd_header_t header;
+    size_t length;
+
+    while ((conn->in_used - offset >= sizeof(lookupd_header_t)) && (pendingOutput(conn) < LOOKUPD_MAX_PENDING_OUTPUT))
+    {
+        memcpy(&header, conn->in + offset, sizeof(header));
+        if ((header.magic != LOOKUPD_MAGIC) || (header.count > LOOKUPD_MAX_ADDRESSES))
+        {
+            return -1;
+        }
+        if (header.type == LOOKUPD_METRICS)
+        {
+            if (header.count != 0)
+            {
+                return -1;
+            }
+            answerMetrics(conn, &header);
+            offset += sizeof(header);
+            continue;
+        }
+        if ((header.type != LOOKUPD_QUERY_IPV4) && (header.type != LOOKUPD_QUERY_IPV6))
+        {
+            return -1;
+        }
+        length = sizeof(header) + header.count * addressWidth(header.type);
+        if (conn->in_used - offset < length)
+        {
+            reserve(&conn->in, &conn->in_size, length);
+            break;
+        }
+        answerRequest(server, conn, &header, conn->in + offset + sizeof(header));
+        offset += length;
+    }
+    memmove(conn->in, conn->in + offset, conn->in_used - offset);
+    conn->in_used -= offset;
+    return 0;
+}
+
+static int flushConnection(lookupd_t *server, lookupdconn_t *conn)
+{
+    struct epoll_event event;
+    uint8_t want_read;
+
+    for (;;)
+    {
+        size_t answered = conn->out_used;
+
+        while (conn->out_sent < conn->out_used)
+        {
+            ssize_t n = send(conn->fd, conn->out + conn->out_sent, conn->out_used - conn->out_sent, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                {
+                    break;
+                }
+                return -1;
+            }
+            conn->out_sent += (size_t)n;
+        }
+        if (conn->out_sent == conn->out_used)
+        {
+            conn->out_sent = conn->out_used = 0;
+            answered = 0;
+        }
+        // Answer requests held back by a full output buffer, now that it has room.
+        if (pendingOutput(conn) >= LOOKUPD_MAX_PENDING_OUTPUT)
+        {
+            break;
+        }
+        if (processInput(server, conn) != 0)
+        {
+            return -1;
+        }
+        if (conn->out_used == answered)
+        {
+            break;
+        }
+    }
+
+    // A client that sent all its requests is closed once it has every answer.
+    if (conn->read_closed && (conn->out_used == 0))
+    {
+        return -1;
+    }
+    // Only ask for EPOLLOUT while there is something left to send, and
+    // stop reading while the client does not take its answers.
+    want_read = !conn->read_closed && (pendingOutput(conn) < LOOKUPD_MAX_PENDING_OUTPUT);
+    if (((conn->out_used > 0) != conn->want_write) || (want_read != conn->want_read))
+    {
+        conn->want_write = (conn->out_used > 0);
+        conn->want_read = want_read;
+        event.events = (conn->want_read ? EPOLLIN : 0) | (conn->want_write ? EPOLLOUT : 0);
+        event.data.ptr = conn;
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    }
+    return 0;
+}
+
+static int readConnection(lookupd_t *server, lookupdconn_t *conn)
+{
+    for (;;)
+    {
+        ssize_t n;
+
+        if (pendingOutput(conn) >= LOOKUPD_MAX_PENDING_OUTPUT)
+        {
+            return 0;
+        }
+        reserve(&conn->in, &conn->in_size, conn->in_used + LOOKUPD_READ_SIZE);
+        n = recv(conn->fd, conn->in + conn->in_used, conn->in_size - conn->in_used, 0);
+        if (n == 0)
+        {
+            // End of requests, but answers held back may still have to be sent.
+            conn->read_closed = 1;
+            return 0;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+        }
+        conn->in_used += (size_t)n;
+        if (processInput(server, conn) != 0)
+        {
+            return -1;
+        }
+    }
+}
+
+static void acceptConnections(lookupd_t *server)
+{
+    struct epoll_event event;
+    int fd;
+
+    while ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        lookupdconn_t *conn = (lookupdconn_t *)calloc(1, sizeof(lookupdconn_t));
+        conn->fd = fd;
+        conn->want_read = 1;
+        event.events = EPOLLIN;
+        event.data.ptr = conn;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            close(fd);
+            free(conn);
+            continue;
+        }
+        conn->next = server->connections;
+        if (conn->next != NULL)
+        {
+            conn->next->prev = conn;
+        }
+        server->connections = conn;
+    }
+}
+
+/*
+Removes a stale socket file left by a server that is gone. Anything else
+at the path, a regular file or a live server, is left alone.
+Returns 0 if the path is free, -1 if not.
+*/
+static int claimSocketPath(const char *socket_path)
+{
+    struct stat status;
+    int fd;
+
+    if (lstat(socket_path, &status) != 0)
+    {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    if (!S_ISSOCK(status.st_mode))
+    {
+        fprintf(stderr, "Not a socket: %s\n", socket_path);
+        return -1;
+    }
+    fd = connectLookupd(socket_path);
+    if (fd >= 0)
+    {
+        close(fd);
+        fprintf(stderr, "Another server is listening on %s\n", socket_path);
+        return -1;
+    }
+    return unlink(socket_path);
+}
+
+lookupd_t *createLookupd(const char *socket_path, bnode_t *ipv4_root, bnode_t *ipv6_root)
+{
+    struct sockaddr_un address;
+    struct epoll_event event;
+    lookupd_t *server;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return NULL;
+    }
+    if (claimSocketPath(socket_path) != 0)
+    {
+        return NULL;
+    }
+
+    server = (lookupd_t *)calloc(1, sizeof(lookupd_t));
+    server->ipv4_root = ipv4_root;
+    server->ipv6_root = ipv6_root;
+    server->socket_path = strdup(socket_path);
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+
+    if ((server->listen_fd < 0) || (server->epoll_fd < 0) || (server->wake_fd < 0) ||
+        (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+        (listen(server->listen_fd, SOMAXCONN) != 0))
+    {
+        perror("lookupd");
+        deleteLookupd(server);
+        return NULL;
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event);
+    event.data.ptr = &wake_marker;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &event);
+    return server;
+}
+
+int runLookupd(lookupd_t *server)
+{
+    struct epoll_event events[LOOKUPD_MAX_EVENTS];
+
+    for (;;)
+    {
+        int n = epoll_wait(server->epoll_fd, events, LOOKUPD_MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            lookupdconn_t *conn = (lookupdconn_t *)events[i].data.ptr;
+            if (events[i].data.ptr == &wake_marker)
+            {
+                uint64_t value;
+                return (read(server->wake_fd, &value, sizeof(value)) == sizeof(value)) ? 0 : -1;
+            }
+            if (conn == NULL)
+            {
+                acceptConnections(server);
+                continue;
+            }
+            if ((events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN))
+            {
+                closeConnection(server, conn);
+                continue;
+            }
+            if ((events[i].events & EPOLLIN) && (readConnection(server, conn) != 0))
+            {
+                closeConnection(server, conn);
+                continue;
+            }
+            if (flushConnection(server, conn) != 0)
+            {
+                closeConnection(server, conn);
+            }
+        }
+    }
+}
+
+void stopLookupd(lookupd_t *server)
+{
+    uint64_t value = 1;
+    ssize_t written = write(server->wake_fd, &value, sizeof(value));
+    (void)written;
+}
+
+void deleteLookupd(lookupd_t *server)
+{
+    if (server == NULL)
+    {
+        return;
+    }
+    while (server->connections != NULL)
+    {
+        closeConnection(server, server->connections);
+    }
+    if (server->listen_fd >= 0)
+    {
+        close(server->listen_fd);
+        unlink(server->socket_path);
+    }
+    if (server->epoll_fd >= 0)
+    {
+        close(server->epoll_fd);
+    }
+    if (server->wake_fd >= 0)
+    {
+        close(server->wake_fd);
+    }
+    free(server->socket_path);
+    free(server);
+}
+
+int connectLookupd(const char *socket_path)
+{
+    struct sockaddr_un address;
+    int fd;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if ((fd >= 0) && (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static int sendAll(int fd, const uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+static int receiveAll(int fd, uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = recv(fd, data, length, 0);
+        if (n <= 0)
+        {
+            if ((n < 0) && (errno == EINTR))
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+static int query(int fd, uint8_t type, uint8_t *request, uint32_t count, uint8_t *bitmap)
+{
+    lookupd_header_t header;
+    int result;
+
+    header.magic = LOOKUPD_MAGIC;
+    header.type = type;
+    header.reserved = 0;
+    header.count = count;
+    memcpy(request, &header, sizeof(header));
+
+    result = sendAll(fd, request, sizeof(header) + count * addressWidth(type));
+    if (result == 0)
+    {
+        result = receiveAll(fd, (uint8_t *)&header, sizeof(header));
+    }
+    if ((result == 0) && ((header.magic != LOOKUPD_MAGIC) || (header.type != type) || (header.count != count)))
+    {
+        result = -1;
+    }
+    if (result == 0)
+    {
+        result = receiveAll(fd, bitmap, (count + 7) / 8);
+    }
+    free(request);
+    return result;
+}
+
+int queryLookupdIPv4(int fd, const ipv4_t *addresses, uint32_t count, uint8_t *bitmap)
+{
+    uint8_t *request;
+
+    if (count > LOOKUPD_MAX_ADDRESSES)
+    {
+        return -1;
+    }
+    request = (uint8_t *)malloc(sizeof(lookupd_header_t) + 4 * (size_t)count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(request + sizeof(lookupd_header_t) + 4 * (size_t)i, &addresses[i].ip, 4);
+    }
+    return query(fd, LOOKUPD_QUERY_IPV4, request, count, bitmap);
+}
+
+int queryLookupdIPv6(int fd, const ipv6_t *addresses, uint32_t count, uint8_t *bitmap)
+{
+    uint8_t *request;
+
+    if (count > LOOKUPD_MAX_ADDRESSES)
+    {
+        return -1;
+    }
+    request = (uint8_t *)malloc(sizeof(lookupd_header_t) + 16 * (size_t)count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(request + sizeof(lookupd_header_t) + 16 * (size_t)i, addresses[i].ip, 16);
+    }
+    return query(fd, LOOKUPD_QUERY_IPV6, request, count, bitmap);
+}
+
+int queryLookupdMetrics(int fd, char **text)
+{
+    lookupd_header_t header;
+    int result;
+
+    header.magic = LOOKUPD_MAGIC;
+    header.type = LOOKUPD_METRICS;
+    header.reserved = 0;
+    header.count = 0;
+    *text = NULL;
+
+    result = sendAll(fd, (const uint8_t *)&header, sizeof(header));
+    if (result == 0)
+    {
+        result = receiveAll(fd, (uint8_t *)&header, sizeof(header));
+    }
+    if ((result == 0) && ((header.magic != LOOKUPD_MAGIC) || (header.type != LOOKUPD_METRICS)))
+    {
+        result = -1;
+    }
+    if (result == 0)
+    {
+        *text = (char *)malloc((size_t)header.count + 1);
+        result = receiveAll(fd, (uint8_t *)*text, header.count);
+        (*text)[header.count] = '\0';
+    }
+    if (result != 0)
+    {
+        free(*text);
+        *text = NULL;
+    }
+    return result;
+}
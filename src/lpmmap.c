@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lpmmap.h"
+#include "ip.h"
+
+#define LPM_INITIAL_SLOTS 64
+
+static lnode_t *createLpmNode(void)
+{
+    lnode_t *node = (lnode_t *)malloc(sizeof(lnode_t));
+    node->child[0] = node->child[1] = NULL;
+    node->value = LPM_NO_VALUE;
+    return node;
+}
+
+static void deleteLpmTree(lnode_t *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    deleteLpmTree(node->child[0]);
+    deleteLpmTree(node->child[1]);
+    free(node);
+}
+
+lpmmap_t *createLpmMap(void)
+{
+    lpmmap_t *map = (lpmmap_t *)malloc(sizeof(lpmmap_t));
+
+    map->ipv4_root = createLpmNode();
+    map->ipv6_root = createLpmNode();
+    map->values = NULL;
+    map->value_count = 0;
+    map->value_capacity = 0;
+    map->slot_count = LPM_INITIAL_SLOTS;
+    map->slots = (uint32_t *)calloc(map->slot_count, sizeof(uint32_t));
+    return map;
+}
+
+void deleteLpmMap(lpmmap_t *map)
+{
+    if (map == NULL)
+    {
+        return;
+    }
+    deleteLpmTree(map->ipv4_root);
+    deleteLpmTree(map->ipv6_root);
+    for (uint32_t i = 0; i < map->value_count; i++)
+    {
+        free(map->values[i]);
+    }
+    free(map->values);
+    free(map->slots);
+    free(map);
+}
+
+static uint32_t hashValue(const char *value, size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)value[i]) * 16777619U;
+    }
+    return hash;
+}
+
+static void growSlots(lpmmap_t *map)
+{
+    uint32_t slot_count = map->slot_count * 2;
+    uint32_t *slots = (uint32_t *)calloc(slot_count, sizeof(uint32_t));
+
+    for (uint32_t id = 1; id <= map->value_count; id++)
+    {
+        const char *value = map->values[id - 1];
+        uint32_t slot = hashValue(value, strlen(value)) & (slot_count - 1);
+
+        while (slots[slot] != LPM_NO_VALUE)
+        {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = id;
+    }
+    free(map->slots);
+    map->slots = slots;
+    map->slot_count = slot_count;
+}
+
+uint32_t internLpmValue(lpmmap_t *map, const char *value, size_t length)
+{
+    uint32_t slot = hashValue(value, length) & (map->slot_count - 1);
+    char *copy;
+
+    // Linear probing; the table is kept at most half full.
+    while (map->slots[slot] != LPM_NO_VALUE)
+    {
+        const char *existing = map->values[map->slots[slot] - 1];
+        if ((strncmp(existing, value, length) == 0) && (existing[length] == '\0'))
+        {
+            return map->slots[slot];
+        }
+        slot = (slot + 1) & (map->slot_count - 1);
+    }
+
+    if (map->value_count == map->value_capacity)
+    {
+        map->value_capacity = map->value_capacity ? 2 * map->value_capacity : 16;
+        map->values = (char **)realloc(map->values, map->value_capacity * sizeof(char *));
+    }
+    copy = (char *)malloc(length + 1);
+    memcpy(copy, value, length);
+    copy[length] = '\0';
+    map->values[map->value_count++] = copy;
+    map->slots[slot] = map->value_count;
+
+    if (2 * map->value_count > map->slot_count)
+    {
+        growSlots(map);
+    }
+    return map->value_count;
+}
+
+const char *getLpmValue(const lpmmap_t *map, uint32_t id)
+{
+    if ((id == LPM_NO_VALUE) || (id > map->value_count))
+    {
+        return NULL;
+    }
+    return map->values[id - 1];
+}
+
+static uint8_t insertLpm(lnode_t *root, const uint16_t *groups, uint8_t ps, uint32_t value)
+{
+    lnode_t *node = root;
+    uint8_t result;
+
+    for (uint8_t depth = 0; depth < ps; depth++)
+    {
+        uint8_t b = group_bit(groups, depth);
+        if (node->child[b] == NULL)
+        {
+            node->child[b] = createLpmNode();
+        }
+        node = node->child[b];
+    }
+    result = (node->value != LPM_NO_VALUE);
+    node->value = value;
+    return result;
+}
+
+/*
+Remembers the last value on the path, so the most specific prefix is
+found in the same single walk as a plain membership test.
+*/
+static uint32_t lookupLpm(const lnode_t *node, const uint16_t *groups, uint8_t ps, uint8_t *match_ps)
+{
+    uint32_t value = LPM_NO_VALUE;
+
+    *match_ps = 0;
+    for (uint8_t depth = 0; node != NULL; depth++)
+    {
+        if (node->value != LPM_NO_VALUE)
+        {
+            value = node->value;
+            *match_ps = depth;
+        }
+        if (depth == ps)
+        {
+            break;
+        }
+        node = node->child[group_bit(groups, depth)];
+    }
+    return value;
+}
+
+uint8_t insertLpmIPv4(lpmmap_t *map, ipv4_t ip, uint32_t value)
+{
+    uint16_t groups[2] = {(uint16_t)(ip.ip >> 16), (uint16_t)ip.ip};
+
+    if ((ip.ps == 0) || (value == LPM_NO_VALUE) || (value > map->value_count))
+    {
+        return 2;
+    }
+    return insertLpm(map->ipv4_root, groups, ip.ps, value);
+}
+
+uint8_t insertLpmIPv6(lpmmap_t *map, ipv6_t ip, uint32_t value)
+{
+    if ((ip.ps == 0) || (value == LPM_NO_VALUE) || (value > map->value_count))
+    {
+        return 2;
+    }
+    return insertLpm(map->ipv6_root, ip.ip, ip.ps, value);
+}
+
+uint32_t lookupLpmIPv4(const lpmmap_t *map, ipv4_t ip, ipv4_t *match)
+{
+    uint16_t groups[2] = {(uint16_t)(ip.ip >> 16), (uint16_t)ip.ip};
+    uint32_t value = LPM_NO_VALUE;
+    uint8_t match_ps = 0;
+
+    if (ip.ps > 0)
+    {
+        value = lookupLpm(map->ipv4_root, groups, ip.ps, &match_ps);
+    }
+    if (match != NULL)
+    {
+        match->ps = match_ps;
+        match->ip = ip.ip & ipv4_netmask(match_ps);
+    }
+    return value;
+}
+
+uint32_t lookupLpmIPv6(const lpmmap_t *map, ipv6_t ip, ipv6_t *match)
+{
+    uint32_t value = LPM_NO_VALUE;
+    uint8_t match_ps = 0;
+
+    if (ip.ps > 0)
+    {
+        value = lookupLpm(map->ipv6_root, ip.ip, ip.ps, &match_ps);
+    }
+    if (match != NULL)
+    {
+        match->ps = match_ps;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            match->ip[i] = ip.ip[i] & ipv6_group_mask(match_ps, i);
+        }
+    }
+    return value;
+}
+
+static const char *trim(const char *s, size_t *length)
+{
+    while ((*length > 0) && ((*s == ' ') || (*s == '\t')))
+    {
+        s++;
+        (*length)--;
+    }
+    while ((*length > 0) && ((s[*length - 1] == ' ') || (s[*length - 1] == '\t') || (s[*length - 1] == '\r') || (s[*length - 1] == '\n')))
+    {
+        (*length)--;
+    }
+    return s;
+}
+
+static void loadLpmLine(lpmmap_t *map, const char *line, size_t length)
+{
+    const char *comma = (const char *)memchr(line, ',', length);
+    const char *prefix;
+    const char *value;
+    size_t prefix_length;
+    size_t value_length;
+
+    if ((comma == NULL) || (line[0] == '#'))
+    {
+        return;
+    }
+    prefix_length = (size_t)(comma - line);
+    value_length = length - prefix_length - 1;
+    prefix = trim(line, &prefix_length);
+    value = trim(comma + 1, &value_length);
+    if (value_length == 0)
+    {
+        return;
+    }
+
+    if (memchr(prefix, ':', prefix_length) != NULL)
+    {
+        ipv6_t prefixes[IPV6_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv6_entry_n(prefix, prefix_length, prefixes);
+        uint32_t id = (count > 0) ? internLpmValue(map, value, value_length) : 0;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            insertLpmIPv6(map, prefixes[i], id);
+        }
+    }
+    else
+    {
+        ipv4_t prefixes[IPV4_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv4_entry_n(prefix, prefix_length, prefixes);
+        uint32_t id = (count > 0) ? internLpmValue(map, value, value_length) : 0;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            insertLpmIPv4(map, prefixes[i], id);
+        }
+    }
+}
+
+uint8_t loadLpmMapFile(lpmmap_t *map, const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return 1;
+    }
+    while ((length = getline(&line, &size, fp)) != -1)
+    {
+        loadLpmLine(map, line, (size_t)length);
+    }
+    free(line);
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "metrics.h"
+
+typedef struct
+{
+    uint64_t hits[2];
+    uint64_t misses[2];
+    uint64_t parse_failures[2];
+    uint64_t latency_sum;
+    uint64_t histogram[METRICS_HISTOGRAM_BUCKETS];
+} __attribute__((aligned(64))) metricsshard_t;
+
+static metricsshard_t shards[METRICS_SHARDS];
+static uint8_t enabled;
+static uint32_t next_shard;
+static __thread metricsshard_t *thread_shard;
+
+static const char *const family_names[2] = {"ipv4", "ipv6"};
+
+// Histogram buckets exported to Prometheus, in nanoseconds.
+static const uint64_t export_buckets[] = {
+    25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 1000000};
+
+static const double export_quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+void setMetricsEnabled(uint8_t on)
+{
+    __atomic_store_n(&enabled, on ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+uint8_t metricsEnabled(void)
+{
+    return __atomic_load_n(&enabled, __ATOMIC_RELAXED);
+}
+
+uint64_t metricsClock(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static metricsshard_t *getShard(void)
+{
+    if (thread_shard == NULL)
+    {
+        thread_shard = &shards[__atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED) % METRICS_SHARDS];
+    }
+    return thread_shard;
+}
+
+static uint16_t bucketIndex(uint64_t value)
+{
+    uint8_t exponent;
+
+    if (value < METRICS_SUB_BUCKETS)
+    {
+        return (uint16_t)value;
+    }
+    exponent = (uint8_t)(63 - __builtin_clzll(value));
+    if (exponent >= METRICS_MAX_EXPONENT)
+    {
+        return METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+    return (uint16_t)(METRICS_SUB_BUCKETS * (exponent - METRICS_SUB_BUCKET_BITS + 1) +
+                      ((value >> (exponent - METRICS_SUB_BUCKET_BITS)) & (METRICS_SUB_BUCKETS - 1)));
+}
+
+static uint64_t bucketUpperBound(uint16_t index)
+{
+    uint8_t shift;
+
+    if (index < METRICS_SUB_BUCKETS)
+    {
+        return index;
+    }
+    shift = (uint8_t)(index / METRICS_SUB_BUCKETS - 1);
+    return ((uint64_t)(METRICS_SUB_BUCKETS + index % METRICS_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+void recordLookup(uint8_t family, uint8_t found, uint64_t start)
+{
+    metricsshard_t *shard = getShard();
+    uint64_t latency = metricsClock() - start;
+
+    /*
+    Relaxed atomic adds on a shard that other threads seldom share:
+    no locks, and no cache line bouncing between threads.
+    */
+    __atomic_fetch_add(found ? &shard->hits[family] : &shard->misses[family], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->latency_sum, latency, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->histogram[bucketIndex(latency)], 1, __ATOMIC_RELAXED);
+}
+
+void recordParseFailure(uint8_t family)
+{
+    __atomic_fetch_add(&getShard()->parse_failures[family], 1, __ATOMIC_RELAXED);
+}
+
+void getMetrics(metrics_t *metrics)
+{
+    memset(metrics, 0, sizeof(*metrics));
+    for (uint16_t s = 0; s < METRICS_SHARDS; s++)
+    {
+        const metricsshard_t *shard = &shards[s];
+
+        for (uint8_t family = 0; family < 2; family++)
+        {
+            metrics->hits[family] += __atomic_load_n(&shard->hits[family], __ATOMIC_RELAXED);
+            metrics->misses[family] += __atomic_load_n(&shard->misses[family], __ATOMIC_RELAXED);
+            metrics->parse_failures[family] += __atomic_load_n(&shard->parse_failures[family], __ATOMIC_RELAXED);
+        }
+        metrics->latency_sum += __atomic_load_n(&shard->latency_sum, __ATOMIC_RELAXED);
+        for (uint16_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+        {
+            metrics->histogram[i] += __atomic_load_n(&shard->histogram[i], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void resetMetrics(void)
+{
+    for (uint16_t s = 0; s < METRICS_SHARDS; s++)
+    {
+        metricsshard_t *shard = &shards[s];
+
+        for (uint8_t family = 0; family < 2; family++)
+        {
+            __atomic_store_n(&shard->hits[family], 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&shard->misses[family], 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&shard->parse_failures[family], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&shard->latency_sum, 0, __ATOMIC_RELAXED);
+        for (uint16_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+        {
+            __atomic_store_n(&shard->histogram[i], 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static uint64_t histogramCount(const metrics_t *metrics)
+{
+    uint64_t count = 0;
+
+    for (uint16_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        count += metrics->histogram[i];
+    }
+    return count;
+}
+
+uint64_t getMetricsQuantile(const metrics_t *metrics, double q)
+{
+    uint64_t count = histogramCount(metrics);
+    uint64_t rank;
+    uint64_t seen = 0;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+    rank = (uint64_t)(q * (double)count + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    for (uint16_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += metrics->histogram[i];
+        if (seen >= rank)
+        {
+            return bucketUpperBound(i);
+        }
+    }
+    return bucketUpperBound(METRICS_HISTOGRAM_BUCKETS - 1);
+}
+
+uint8_t writeMetrics(FILE *out)
+{
+    metrics_t *metrics = (metrics_t *)malloc(sizeof(metrics_t));
+    uint64_t count;
+    uint64_t cumulative = 0;
+    uint16_t bucket = 0;
+
+    getMetrics(metrics);
+    count = histogramCount(metrics);
+
+    fprintf(out, "# HELP iplookup_lookups_total Lookups by address family and result.\n");
+    fprintf(out, "# TYPE iplookup_lookups_total counter\n");
+    for (uint8_t family = 0; family < 2; family++)
+    {
+        fprintf(out, "iplookup_lookups_total{family=\"%s\",result=\"hit\"} %llu\n", family_names[family], (unsigned long long)metrics->hits[family]);
+        fprintf(out, "iplookup_lookups_total{family=\"%s\",result=\"miss\"} %llu\n", family_names[family], (unsigned long long)metrics->misses[family]);
+    }
+    fprintf(out, "# HELP iplookup_parse_failures_total Lookups of addresses that could not be parsed.\n");
+    fprintf(out, "# TYPE iplookup_parse_failures_total counter\n");
+    for (uint8_t family = 0; family < 2; family++)
+    {
+        fprintf(out, "iplookup_parse_failures_total{family=\"%s\"} %llu\n", family_names[family], (unsigned long long)metrics->parse_failures[family]);
+    }
+
+    // Bucket bounds follow the histogram's resolution of 1/16, not the exact le values.
+    fprintf(out, "# HELP iplookup_lookup_duration_seconds Lookup latency.\n");
+    fprintf(out, "# TYPE iplookup_lookup_duration_seconds histogram\n");
+    for (size_t b = 0; b < sizeof(export_buckets) / sizeof(export_buckets[0]); b++)
+    {
+        while ((bucket < METRICS_HISTOGRAM_BUCKETS) && (bucketUpperBound(bucket) <= export_buckets[b]))
+        {
+            cumulative += metrics->histogram[bucket++];
+        }
+        fprintf(out, "iplookup_lookup_duration_seconds_bucket{le=\"%g\"} %llu\n", (double)export_buckets[b] * 1e-9, (unsigned long long)cumulative);
+    }
+    fprintf(out, "iplookup_lookup_duration_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)count);
+    fprintf(out, "iplookup_lookup_duration_seconds_sum %.9f\n", (double)metrics->latency_sum * 1e-9);
+    fprintf(out, "iplookup_lookup_duration_seconds_count %llu\n", (unsigned long long)count);
+
+    fprintf(out, "# HELP iplookup_lookup_latency_seconds Lookup latency quantiles since start or reset.\n");
+    fprintf(out, "# TYPE iplookup_lookup_latency_seconds summary\n");
+    for (size_t q = 0; q < sizeof(export_quantiles) / sizeof(export_quantiles[0]); q++)
+    {
+        fprintf(out, "iplookup_lookup_latency_seconds{quantile=\"%g\"} %.9f\n", export_quantiles[q], (double)getMetricsQuantile(metrics, export_quantiles[q]) * 1e-9);
+    }
+    fprintf(out, "iplookup_lookup_latency_seconds_sum %.9f\n", (double)metrics->latency_sum * 1e-9);
+    fprintf(out, "iplookup_lookup_latency_seconds_count %llu\n", (unsigned long long)count);
+
+    free(metrics);
+    return (fflush(out) != 0) || ferror(out);
+}
+
+uint8_t writeMetricsFile(const char *filename)
+{
+    size_t length = strlen(filename);
+    char *temporary = (char *)malloc(length + 5);
+    FILE *fp;
+    uint8_t failed;
+
+    memcpy(temporary, filename, length);
+    memcpy(temporary + length, ".tmp", 5);
+    fp = fopen(temporary, "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", temporary);
+        free(temporary);
+        return 1;
+    }
+    failed = writeMetrics(fp);
+    failed |= (fclose(fp) != 0);
+    if (failed || (rename(temporary, filename) != 0))
+    {
+        fprintf(stderr, "Error writing file %s\n", filename);
+        remove(temporary);
+        failed = 1;
+    }
+    free(temporary);
+    return failed;
+}
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "multilist.h"
+#include "ip.h"
+
+#define MULTILIST_READ_SIZE 65536
+#define MULTILIST_MAX_ENTRY_LENGTH 96
+
+static void toGroupsIPv4(uint32_t ip, uint16_t *groups)
+{
+    groups[0] = (uint16_t)(ip >> 16);
+    groups[1] = (uint16_t)ip;
+}
+
+mnode_t *createMultiNode(void)
+{
+    mnode_t *node = (mnode_t *)malloc(sizeof(mnode_t));
+    node->child[0] = node->child[1] = NULL;
+    node->mask = 0;
+    return node;
+}
+
+void deleteMultiTree(mnode_t *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    deleteMultiTree(node->child[0]);
+    deleteMultiTree(node->child[1]);
+    free(node);
+}
+
+/*
+Clears a list bit below a new prefix of that list, freeing the nodes
+that no longer hold anything. Returns 1 if the node itself was freed.
+*/
+static uint8_t clearBelow(mnode_t *node, uint64_t bit)
+{
+    node->mask &= ~bit;
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        if ((node->child[i] != NULL) && clearBelow(node->child[i], bit))
+        {
+            node->child[i] = NULL;
+        }
+    }
+    if ((node->mask == 0) && (node->child[0] == NULL) && (node->child[1] == NULL))
+    {
+        free(node);
+        return 1;
+    }
+    return 0;
+}
+
+static uint8_t insertMulti(mnode_t *root, const uint16_t *groups, uint8_t ps, uint8_t list)
+{
+    uint64_t bit;
+    mnode_t *node = root;
+
+    if ((ps == 0) || (list >= MULTILIST_MAX_LISTS))
+    {
+        return 2;
+    }
+    bit = (uint64_t)1 << list;
+
+    for (uint8_t depth = 0; depth < ps; depth++)
+    {
+        uint8_t b = group_bit(groups, depth);
+
+        if (node->mask & bit)
+        {
+            return 1;
+        }
+        if (node->child[b] == NULL)
+        {
+            node->child[b] = createMultiNode();
+        }
+        node = node->child[b];
+    }
+    if (node->mask & bit)
+    {
+        return 1;
+    }
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        if ((node->child[i] != NULL) && clearBelow(node->child[i], bit))
+        {
+            node->child[i] = NULL;
+        }
+    }
+    node->mask |= bit;
+    return 0;
+}
+
+static uint64_t lookupMulti(const mnode_t *node, const uint16_t *groups, uint8_t ps)
+{
+    uint64_t mask = 0;
+
+    for (uint8_t depth = 0; node != NULL; depth++)
+    {
+        mask |= node->mask;
+        if (depth == ps)
+        {
+            break;
+        }
+        node = node->child[group_bit(groups, depth)];
+    }
+    return mask;
+}
+
+uint8_t insertMultiIPv4Address(mnode_t *root, ipv4_t ip, uint8_t list)
+{
+    uint16_t groups[2];
+
+    toGroupsIPv4(ip.ip, groups);
+    return insertMulti(root, groups, ip.ps, list);
+}
+
+uint8_t insertMultiIPv6Address(mnode_t *root, ipv6_t ip, uint8_t list)
+{
+    return insertMulti(root, ip.ip, ip.ps, list);
+}
+
+uint64_t lookupMultiIPv4Address(mnode_t *root, ipv4_t ip)
+{
+    uint16_t groups[2];
+
+    if (ip.ps == 0)
+    {
+        return 0;
+    }
+    toGroupsIPv4(ip.ip, groups);
+    return lookupMulti(root, groups, ip.ps);
+}
+
+uint64_t lookupMultiIPv4(mnode_t *root, const char *ipv4_string)
+{
+    return lookupMultiIPv4Address(root, read_ipv4(ipv4_string));
+}
+
+uint64_t lookupMultiIPv6Address(mnode_t *root, ipv6_t ip)
+{
+    if (ip.ps == 0)
+    {
+        return 0;
+    }
+    return lookupMulti(root, ip.ip, ip.ps);
+}
+
+uint64_t lookupMultiIPv6(mnode_t *root, const char *ipv6_string)
+{
+    return lookupMultiIPv6Address(root, read_ipv6(ipv6_string));
+}
+
+static uint8_t isSeparator(char c)
+{
+    return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+}
+
+static void loadEntry(mnode_t *root, uint8_t family, const char *entry, size_t length, uint8_t list)
+{
+    if (family == 4)
+    {
+        ipv4_t prefixes[IPV4_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv4_entry_n(entry, length, prefixes);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            insertMultiIPv4Address(root, prefixes[i], list);
+        }
+    }
+    else
+    {
+        ipv6_t prefixes[IPV6_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv6_entry_n(entry, length, prefixes);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            insertMultiIPv6Address(root, prefixes[i], list);
+        }
+    }
+}
+
+static uint8_t loadMultiFile(mnode_t *root, const char *filename, uint8_t family, uint8_t list)
+{
+    FILE *fp = fopen(filename, "r");
+    char *buffer;
+    char entry[MULTILIST_MAX_ENTRY_LENGTH];
+    size_t entry_length = 0;
+    size_t n;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return 1;
+    }
+    buffer = (char *)malloc(MULTILIST_READ_SIZE);
+    while ((n = fread(buffer, 1, MULTILIST_READ_SIZE, fp)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!isSeparator(buffer[i]))
+            {
+                // Overlong entries are cut short, which makes them invalid.
+                if (entry_length < MULTILIST_MAX_ENTRY_LENGTH)
+                {
+                    entry[entry_length++] = buffer[i];
+                }
+            }
+            else if (entry_length > 0)
+            {
+                loadEntry(root, family, entry, entry_length, list);
+                entry_length = 0;
+            }
+        }
+    }
+    if (entry_length > 0)
+    {
+        loadEntry(root, family, entry, entry_length, list);
+    }
+    free(buffer);
+    fclose(fp);
+    return 0;
+}
+
+uint8_t loadMultiIPv4File(mnode_t *root, const char *filename, uint8_t list)
+{
+    return loadMultiFile(root, filename, 4, list);
+}
+
+uint8_t loadMultiIPv6File(mnode_t *root, const char *filename, uint8_t list)
+{
+    return loadMultiFile(root, filename, 6, list);
+}
+
+mnode_t *createMultiIPv4TreeFromFiles(const char *const *filenames, uint8_t count)
+{
+    mnode_t *root = createMultiNode();
+
+    for (uint8_t i = 0; (i < count) && (i < MULTILIST_MAX_LISTS); i++)
+    {
+        loadMultiIPv4File(root, filenames[i], i);
+    }
+    return root;
+}
+
+mnode_t *createMultiIPv6TreeFromFiles(const char *const *filenames, uint8_t count)
+{
+    mnode_t *root = createMultiNode();
+
+    for (uint8_t i = 0; (i < count) && (i < MULTILIST_MAX_LISTS); i++)
+    {
+        loadMultiIPv6File(root, filenames[i], i);
+    }
+    return root;
+}
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include "perfcount.h"
+#ifdef IP_PERF_COUNTERS
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static perfstats_t totals[PERF_OPERATION_COUNT];
+
+static const char *const event_names[PERF_EVENT_COUNT] = {
+    "cycles",
+    "instructions",
+    "L1d-misses",
+    "LLC-misses",
+    "branch-misses"};
+
+#ifdef IP_PERF_COUNTERS
+
+typedef struct
+{
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+} perfreading_t;
+
+typedef struct
+{
+    uint8_t opened;
+    uint8_t available;
+    int fds[PERF_EVENT_COUNT];
+    uint32_t depth[PERF_OPERATION_COUNT];
+    uint64_t operations[PERF_OPERATION_COUNT];
+    perfreading_t start[PERF_OPERATION_COUNT][PERF_EVENT_COUNT];
+} perfthread_t;
+
+static __thread perfthread_t thread_counters;
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+static void closeThreadCounters(void *data)
+{
+    perfthread_t *counters = (perfthread_t *)data;
+
+    for (uint8_t i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        if (counters->fds[i] >= 0)
+        {
+            close(counters->fds[i]);
+        }
+    }
+    counters->opened = 0;
+}
+
+static void createThreadKey(void)
+{
+    pthread_key_create(&thread_key, closeThreadCounters);
+}
+
+static int openEvent(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+Opens the counters of the calling thread on first use. Events are opened
+one by one rather than as a group, so that an event the CPU or the
+hypervisor does not offer only disables itself.
+*/
+static perfthread_t *getThreadCounters(void)
+{
+    perfthread_t *counters = &thread_counters;
+
+    if (counters->opened)
+    {
+        return counters;
+    }
+    counters->fds[PERF_CYCLES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counters->fds[PERF_INSTRUCTIONS] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counters->fds[PERF_L1D_MISSES] = openEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counters->fds[PERF_LLC_MISSES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters->fds[PERF_BRANCH_MISSES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    counters->available = 0;
+    for (uint8_t i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        if (counters->fds[i] >= 0)
+        {
+            counters->available |= (uint8_t)(1 << i);
+        }
+    }
+    counters->opened = 1;
+    pthread_once(&thread_key_once, createThreadKey);
+    pthread_setspecific(thread_key, counters);
+    return counters;
+}
+
+static void readCounters(const perfthread_t *counters, perfreading_t *readings)
+{
+    for (uint8_t i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        if ((counters->fds[i] < 0) || (read(counters->fds[i], &readings[i], sizeof(perfreading_t)) != sizeof(perfreading_t)))
+        {
+            memset(&readings[i], 0, sizeof(perfreading_t));
+        }
+    }
+}
+
+uint8_t perfCountersAvailable(void)
+{
+    return getThreadCounters()->available != 0;
+}
+
+void perfBatchBegin(perfoperation_t operation)
+{
+    perfthread_t *counters = getThreadCounters();
+
+    if (counters->depth[operation]++ == 0)
+    {
+        counters->operations[operation] = 0;
+        readCounters(counters, counters->start[operation]);
+    }
+}
+
+void perfBatchEnd(perfoperation_t operation)
+{
+    perfthread_t *counters = &thread_counters;
+    perfstats_t *total = &totals[operation];
+    perfreading_t end[PERF_EVENT_COUNT];
+
+    if ((counters->depth[operation] == 0) || (--counters->depth[operation] > 0))
+    {
+        return;
+    }
+    readCounters(counters, end);
+    for (uint8_t i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        const perfreading_t *start = &counters->start[operation][i];
+        uint64_t value = end[i].value - start->value;
+        uint64_t enabled = end[i].time_enabled - start->time_enabled;
+        uint64_t running = end[i].time_running - start->time_running;
+
+        // The kernel multiplexes counters when there are too few; extrapolate.
+        if ((running > 0) && (running < enabled))
+        {
+            value = (uint64_t)((double)value * (double)enabled / (double)running);
+        }
+        __atomic_fetch_add(&total->events[i], value, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&total->operations, counters->operations[operation], __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total->batches, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&total->available, counters->available, __ATOMIC_RELAXED);
+}
+
+void perfCountOperation(perfoperation_t operation)
+{
+    // Outside a batch, the count is discarded by the next perfBatchBegin().
+    thread_counters.operations[operation]++;
+}
+
+#else
+
+uint8_t perfCountersAvailable(void)
+{
+    return 0;
+}
+
+void perfBatchBegin(perfoperation_t operation)
+{
+    (void)operation;
+}
+
+void perfBatchEnd(perfoperation_t operation)
+{
+    (void)operation;
+}
+
+void perfCountOperation(perfoperation_t operation)
+{
+    (void)operation;
+}
+
+#endif
+
+void getPerfStats(perfoperation_t operation, perfstats_t *stats)
+{
+    const perfstats_t *total = &totals[operation];
+
+    stats->batches = __atomic_load_n(&total->batches, __ATOMIC_RELAXED);
+    stats->operations = __atomic_load_n(&total->operations, __ATOMIC_RELAXED);
+    for (uint8_t i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        stats->events[i] = __atomic_load_n(&total->events[i], __ATOMIC_RELAXED);
+    }
+    stats->available = __atomic_load_n(&total->available, __ATOMIC_RELAXED);
+}
+
+void resetPerfStats(void)
+{
+    for (uint8_t operation = 0; operation < PERF_OPERATION_COUNT; operation++)
+    {
+        perfstats_t *total = &totals[operation];
+
+        __atomic_store_n(&total->batches, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&total->operations, 0, __ATOMIC_RELAXED);
+        for (uint8_t i = 0; i < PERF_EVENT_COUNT; i++)
+        {
+            __atomic_store_n(&total->events[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&total->available, 0, __ATOMIC_RELAXED);
+    }
+}
+
+const char *perfEventName(perfevent_t event)
+{
+    return (event < PERF_EVENT_COUNT) ? event_names[event] : "unknown";
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "policy.h"
+
+policy_t *createPolicy(uint8_t tie_break)
+{
+    policy_t *policy = (policy_t *)malloc(sizeof(policy_t));
+
+    policy->map = createLpmMap();
+    policy->tie_break = (tie_break == POLICY_ALLOW) ? POLICY_ALLOW : POLICY_DENY;
+
+    // Interned first, so the value IDs are the actions themselves.
+    internLpmValue(policy->map, "allow", 5);
+    internLpmValue(policy->map, "deny", 4);
+    return policy;
+}
+
+void deletePolicy(policy_t *policy)
+{
+    if (policy == NULL)
+    {
+        return;
+    }
+    deleteLpmMap(policy->map);
+    free(policy);
+}
+
+static uint8_t isAction(uint8_t action)
+{
+    return (action == POLICY_ALLOW) || (action == POLICY_DENY);
+}
+
+uint8_t insertPolicyIPv4(policy_t *policy, ipv4_t ip, uint8_t action)
+{
+    ipv4_t match;
+    uint32_t current;
+
+    if ((ip.ps == 0) || !isAction(action))
+    {
+        return 2;
+    }
+    current = lookupLpmIPv4(policy->map, ip, &match);
+    if ((current != POLICY_NONE) && (match.ps == ip.ps) && ((current == action) || (current == policy->tie_break)))
+    {
+        return 1;
+    }
+    insertLpmIPv4(policy->map, ip, action);
+    return 0;
+}
+
+uint8_t insertPolicyIPv6(policy_t *policy, ipv6_t ip, uint8_t action)
+{
+    ipv6_t match;
+    uint32_t current;
+
+    if ((ip.ps == 0) || !isAction(action))
+    {
+        return 2;
+    }
+    current = lookupLpmIPv6(policy->map, ip, &match);
+    if ((current != POLICY_NONE) && (match.ps == ip.ps) && ((current == action) || (current == policy->tie_break)))
+    {
+        return 1;
+    }
+    insertLpmIPv6(policy->map, ip, action);
+    return 0;
+}
+
+uint8_t checkPolicyIPv4Address(const policy_t *policy, ipv4_t ip, ipv4_t *match)
+{
+    return (uint8_t)lookupLpmIPv4(policy->map, ip, match);
+}
+
+uint8_t checkPolicyIPv4(const policy_t *policy, const char *ipv4_string)
+{
+    return checkPolicyIPv4Address(policy, read_ipv4(ipv4_string), NULL);
+}
+
+uint8_t checkPolicyIPv6Address(const policy_t *policy, ipv6_t ip, ipv6_t *match)
+{
+    return (uint8_t)lookupLpmIPv6(policy->map, ip, match);
+}
+
+uint8_t checkPolicyIPv6(const policy_t *policy, const char *ipv6_string)
+{
+    return checkPolicyIPv6Address(policy, read_ipv6(ipv6_string), NULL);
+}
+
+static uint8_t isBlank(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static uint8_t parseMarker(const char *marker, size_t length)
+{
+    if (((length == 1) && (marker[0] == '+')) || ((length == 5) && (strncmp(marker, "allow", 5) == 0)))
+    {
+        return POLICY_ALLOW;
+    }
+    if (((length == 1) && (marker[0] == '-')) || ((length == 4) && (strncmp(marker, "deny", 4) == 0)))
+    {
+        return POLICY_DENY;
+    }
+    return POLICY_NONE;
+}
+
+static void loadPolicyLine(policy_t *policy, const char *line, size_t length)
+{
+    size_t i = 0;
+    size_t start;
+    uint8_t action;
+
+    while ((i < length) && isBlank(line[i]))
+    {
+        i++;
+    }
+    if ((i == length) || (line[i] == '#'))
+    {
+        return;
+    }
+    start = i;
+    while ((i < length) && !isBlank(line[i]))
+    {
+        i++;
+    }
+    action = parseMarker(line + start, i - start);
+    if (action == POLICY_NONE)
+    {
+        return;
+    }
+
+    while ((i < length) && isBlank(line[i]))
+    {
+        i++;
+    }
+    start = i;
+    while ((i < length) && !isBlank(line[i]))
+    {
+        i++;
+    }
+    if (memchr(line + start, ':', i - start) != NULL)
+    {
+        ipv6_t prefixes[IPV6_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv6_entry_n(line + start, i - start, prefixes);
+
+        for (uint8_t p = 0; p < count; p++)
+        {
+            insertPolicyIPv6(policy, prefixes[p], action);
+        }
+    }
+    else
+    {
+        ipv4_t prefixes[IPV4_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv4_entry_n(line + start, i - start, prefixes);
+
+        for (uint8_t p = 0; p < count; p++)
+        {
+            insertPolicyIPv4(policy, prefixes[p], action);
+        }
+    }
+}
+
+uint8_t loadPolicyFile(policy_t *policy, const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return 1;
+    }
+    while ((length = getline(&line, &size, fp)) != -1)
+    {
+        loadPolicyLine(policy, line, (size_t)length);
+    }
+    free(line);
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "prefilter.h"
+
+#define PREFILTER_BLOCK_WORDS 8
+#define PREFILTER_BLOCK_BYTES (PREFILTER_BLOCK_WORDS * sizeof(uint64_t))
+#define PREFILTER_PROBES 6
+#define PREFILTER_GROUP_SPAN 8
+
+/*
+Both families are keyed as two 64-bit halves, high half first; an IPv4
+address is the top 32 bits of the high half.
+*/
+static void ipv4Halves(ipv4_t ip, uint64_t *halves)
+{
+    halves[0] = (uint64_t)ip.ip << 32;
+    halves[1] = 0;
+}
+
+static void ipv6Halves(const uint16_t *groups, uint64_t *halves)
+{
+    halves[0] = halves[1] = 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        halves[0] = (halves[0] << 16) | groups[i];
+        halves[1] = (halves[1] << 16) | groups[i + 4];
+    }
+}
+
+static uint64_t maskHalf(uint64_t half, int16_t bits)
+{
+    return (bits >= 64) ? half : ((bits <= 0) ? 0 : half & (UINT64_MAX << (64 - bits)));
+}
+
+// Hash of the address cut to ps bits, and ps.
+static uint64_t hashPrefix(const uint64_t *halves, uint8_t ps)
+{
+    uint64_t key = maskHalf(halves[0], ps) ^ ps;
+
+    if (ps > 64)
+    {
+        key = mix_bits(key) ^ maskHalf(halves[1], (int16_t)(ps - 64));
+    }
+    return mix_bits(key);
+}
+
+/*
+The prefix sizes that occur are split in at most two groups of sizes
+close together. Every key of a group goes to the block picked by its
+address cut to the shortest size of the group, so all the keys that one
+lookup probes in a group share a cache line: a lookup reads at most two.
+The hash of that short prefix is the seed of the group.
+*/
+static const uint64_t *blockOf(const prefilter_t *filter, uint64_t seed)
+{
+    return &filter->blocks[(size_t)(seed & (filter->block_count - 1)) * PREFILTER_BLOCK_WORDS];
+}
+
+/*
+Within its block, a key only has to differ from the other keys of the
+same short prefix, i.e. in its last bits and its size. The last 64 bits
+of the prefix are multiplied into the seed: one multiplication per size
+instead of a full hash.
+*/
+static uint64_t keyHash(uint64_t seed, const uint64_t *halves, uint8_t ps)
+{
+    uint64_t tail;
+
+    if (ps <= 64)
+    {
+        tail = halves[0] >> (64 - ps);
+    }
+    else
+    {
+        tail = (ps == 128) ? halves[1] : (halves[1] >> (128 - ps)) | (halves[0] << (ps - 64));
+    }
+    return ((tail ^ seed) + ps) * 0x9E3779B97F4A7C15ULL;
+}
+
+// PREFILTER_PROBES runs of 9 bits from the top of the key hash pick bits in a block of 512.
+static void addKey(uint64_t *block, uint64_t hash)
+{
+    for (uint8_t i = 0; i < PREFILTER_PROBES; i++)
+    {
+        uint16_t bit = (uint16_t)((hash >> (10 + 9 * i)) & 511);
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+// Without early exits: the block is in one cache line, and a miss would mispredict a branch.
+static uint8_t hasKey(const uint64_t *block, uint64_t hash)
+{
+    uint64_t found = 1;
+
+    for (uint8_t i = 0; i < PREFILTER_PROBES; i++)
+    {
+        uint16_t bit = (uint16_t)((hash >> (10 + 9 * i)) & 511);
+        found &= block[bit >> 6] >> (bit & 63);
+    }
+    return (uint8_t)(found & 1);
+}
+
+static void addEntry(prefilter_t *filter, const uint64_t *halves, uint8_t ps)
+{
+    uint64_t seed = hashPrefix(halves, filter->block_sizes[ps >= filter->split]);
+
+    addKey((uint64_t *)blockOf(filter, seed), keyHash(seed, halves, ps));
+}
+
+/*
+One group if all sizes lie within PREFILTER_GROUP_SPAN bits, e.g. /24
+networks and /32 hosts. Else the split that keeps the wider group
+narrowest, e.g. /16 to /23 and /24 to /32.
+*/
+static void groupLengths(prefilter_t *filter)
+{
+    uint8_t sizes[128];
+    uint8_t count = 0;
+    uint8_t best = UINT8_MAX;
+
+    for (uint8_t ps = 1; ps <= 128; ps++)
+    {
+        if (filter->lengths[(ps - 1) >> 6] & (1ULL << ((ps - 1) & 63)))
+        {
+            sizes[count++] = ps;
+        }
+    }
+    filter->split = UINT8_MAX;
+    filter->block_sizes[0] = (count > 0) ? sizes[0] : 0;
+    filter->block_sizes[1] = 0;
+    if ((count == 0) || (sizes[count - 1] - sizes[0] <= PREFILTER_GROUP_SPAN))
+    {
+        return;
+    }
+    for (uint8_t i = 1; i < count; i++)
+    {
+        uint8_t low_span = (uint8_t)(sizes[i - 1] - sizes[0]);
+        uint8_t high_span = (uint8_t)(sizes[count - 1] - sizes[i]);
+        uint8_t span = (low_span > high_span) ? low_span : high_span;
+
+        if (span < best)
+        {
+            best = span;
+            filter->split = sizes[i];
+            filter->block_sizes[1] = sizes[i];
+        }
+    }
+}
+
+/*
+Returns 1, and leaves the filter as it was, if the blocks cannot be
+allocated. The old filter is then still right for the tree it was built
+from, and lookups bypass it once the tree has changed.
+*/
+static uint8_t buildPrefilter(prefilter_t *filter)
+{
+    btreeiter_t it;
+    uint64_t bits;
+    uint64_t halves[2];
+    uint64_t lengths[2] = {0, 0};
+    uint64_t entry_count = 0;
+    uint32_t block_count = 1;
+    void *blocks = NULL;
+    // Read the generation first: a change during the build makes the filter stale, never wrong.
+    uint64_t generation = getTreeGeneration(filter->watch);
+
+    if (filter->family == 4)
+    {
+        ipv4_t ip;
+        initIPv4Iterator(&it, filter->root);
+        while (nextIPv4(&it, &ip))
+        {
+            lengths[0] |= 1ULL << (ip.ps - 1);
+            entry_count++;
+        }
+    }
+    else
+    {
+        ipv6_t ip;
+        initIPv6Iterator(&it, filter->root);
+        while (nextIPv6(&it, &ip))
+        {
+            lengths[(ip.ps - 1) >> 6] |= 1ULL << ((ip.ps - 1) & 63);
+            entry_count++;
+        }
+    }
+
+    bits = entry_count * filter->bits_per_entry;
+    while (((uint64_t)block_count * 512 < bits) && (block_count < (1U << 31)))
+    {
+        block_count *= 2;
+    }
+    if (posix_memalign(&blocks, PREFILTER_BLOCK_BYTES, block_count * PREFILTER_BLOCK_BYTES) != 0)
+    {
+        fprintf(stderr, "Cannot allocate a prefilter of %u blocks\n", block_count);
+        return 1;
+    }
+    memset(blocks, 0, block_count * PREFILTER_BLOCK_BYTES);
+    free(filter->blocks);
+    filter->blocks = (uint64_t *)blocks;
+    filter->block_count = block_count;
+    filter->lengths[0] = lengths[0];
+    filter->lengths[1] = lengths[1];
+    filter->entry_count = entry_count;
+    filter->generation = generation;
+    groupLengths(filter);
+
+    if (filter->family == 4)
+    {
+        ipv4_t ip;
+        initIPv4Iterator(&it, filter->root);
+        while (nextIPv4(&it, &ip))
+        {
+            ipv4Halves(ip, halves);
+            addEntry(filter, halves, ip.ps);
+        }
+    }
+    else
+    {
+        ipv6_t ip;
+        initIPv6Iterator(&it, filter->root);
+        while (nextIPv6(&it, &ip))
+        {
+            ipv6Halves(ip.ip, halves);
+            addEntry(filter, halves, ip.ps);
+        }
+    }
+    return 0;
+}
+
+prefilter_t *createPrefilter(bnode_t *root, uint8_t family, uint8_t bits_per_entry)
+{
+    prefilter_t *filter;
+
+    if ((root == NULL) || ((family != 4) && (family != 6)) || (bits_per_entry < 4) || (bits_per_entry > 32))
+    {
+        return NULL;
+    }
+    filter = (prefilter_t *)calloc(1, sizeof(prefilter_t));
+    filter->root = root;
+    filter->watch = watchTree(root);
+    if (filter->watch == NULL)
+    {
+        free(filter);
+        return NULL;
+    }
+    filter->family = family;
+    filter->bits_per_entry = bits_per_entry;
+    if (buildPrefilter(filter) != 0)
+    {
+        deletePrefilter(filter);
+        return NULL;
+    }
+    return filter;
+}
+
+void deletePrefilter(prefilter_t *filter)
+{
+    if (filter == NULL)
+    {
+        return;
+    }
+    unwatchTree(filter->root);
+    free(filter->blocks);
+    free(filter);
+}
+
+uint8_t rebuildPrefilter(prefilter_t *filter)
+{
+    return buildPrefilter(filter);
+}
+
+/*
+An address is in the tree if one of its prefixes is an entry, so every
+prefix size that occurs, up to the size of the query, gets a key probe.
+The blocks of both groups are fetched first, so that their cache misses
+overlap.
+*/
+static uint8_t mayContain(const prefilter_t *filter, const uint64_t *halves, uint8_t ps)
+{
+    const uint64_t *blocks[2] = {NULL, NULL};
+    uint64_t seeds[2] = {0, 0};
+
+    for (uint8_t group = 0; group < 2; group++)
+    {
+        if ((filter->block_sizes[group] != 0) && (filter->block_sizes[group] <= ps))
+        {
+            seeds[group] = hashPrefix(halves, filter->block_sizes[group]);
+            blocks[group] = blockOf(filter, seeds[group]);
+            __builtin_prefetch(blocks[group]);
+        }
+    }
+    for (uint8_t half = 0; half < 2; half++)
+    {
+        int16_t below = (int16_t)(ps - 64 * half);
+        uint64_t lengths = filter->lengths[half];
+
+        if (below <= 0)
+        {
+            break;
+        }
+        if (below < 64)
+        {
+            lengths &= (1ULL << below) - 1;
+        }
+        while (lengths != 0)
+        {
+            uint8_t size = (uint8_t)(__builtin_ctzll(lengths) + 1 + 64 * half);
+            uint8_t group = size >= filter->split;
+            if (hasKey(blocks[group], keyHash(seeds[group], halves, size)))
+            {
+                return 1;
+            }
+            lengths &= lengths - 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t mayContainIPv4(const prefilter_t *filter, ipv4_t ip)
+{
+    uint64_t halves[2];
+
+    if ((filter->family != 4) || (ip.ps == 0) || (ip.ps > 32))
+    {
+        return 0;
+    }
+    ipv4Halves(ip, halves);
+    return mayContain(filter, halves, ip.ps);
+}
+
+uint8_t mayContainIPv6(const prefilter_t *filter, ipv6_t ip)
+{
+    uint64_t halves[2];
+
+    if ((filter->family != 6) || (ip.ps == 0) || (ip.ps > 128))
+    {
+        return 0;
+    }
+    ipv6Halves(ip.ip, halves);
+    return mayContain(filter, halves, ip.ps);
+}
+
+uint8_t findIPv4Filtered(const prefilter_t *filter, ipv4_t ip)
+{
+    if ((getTreeGeneration(filter->watch) == filter->generation) && !mayContainIPv4(filter, ip))
+    {
+        return 0;
+    }
+    return findIPv4Address(filter->root, ip);
+}
+
+uint8_t findIPv6Filtered(const prefilter_t *filter, ipv6_t ip)
+{
+    if ((getTreeGeneration(filter->watch) == filter->generation) && !mayContainIPv6(filter, ip))
+    {
+        return 0;
+    }
+    return findIPv6Address(filter->root, ip);
+}
@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+#include "setops.h"
+
+/*
+In the walks below, NULL is an empty subtree and a leaf a full one.
+Because a leaf points back to itself, its children are full as well:
+walking into a leaf on one side while the other side still branches
+needs no special case.
+*/
+static uint8_t isLeaf(const bnode_t *node)
+{
+    return (node != NULL) && (node == node->child[0]);
+}
+
+static bnode_t *newLeaf(void)
+{
+    bnode_t *leaf = createNode();
+    leaf->child[0] = leaf->child[1] = leaf;
+    return leaf;
+}
+
+// Returns NULL instead of an inner node without children.
+static bnode_t *newInner(bnode_t *child0, bnode_t *child1)
+{
+    bnode_t *node;
+
+    if ((child0 == NULL) && (child1 == NULL))
+    {
+        return NULL;
+    }
+    node = createNode();
+    node->child[0] = child0;
+    node->child[1] = child1;
+    return node;
+}
+
+static bnode_t *copyNodes(const bnode_t *node)
+{
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    if (isLeaf(node))
+    {
+        return newLeaf();
+    }
+    return newInner(copyNodes(node->child[0]), copyNodes(node->child[1]));
+}
+
+static bnode_t *unionNodes(const bnode_t *a, const bnode_t *b)
+{
+    if (isLeaf(a) || isLeaf(b))
+    {
+        return newLeaf();
+    }
+    if (a == NULL)
+    {
+        return copyNodes(b);
+    }
+    if (b == NULL)
+    {
+        return copyNodes(a);
+    }
+    return newInner(unionNodes(a->child[0], b->child[0]), unionNodes(a->child[1], b->child[1]));
+}
+
+static bnode_t *intersectNodes(const bnode_t *a, const bnode_t *b)
+{
+    if ((a == NULL) || (b == NULL))
+    {
+        return NULL;
+    }
+    if (isLeaf(a))
+    {
+        return copyNodes(b);
+    }
+    if (isLeaf(b))
+    {
+        return copyNodes(a);
+    }
+    return newInner(intersectNodes(a->child[0], b->child[0]), intersectNodes(a->child[1], b->child[1]));
+}
+
+static bnode_t *subtractNodes(const bnode_t *a, const bnode_t *b)
+{
+    if ((a == NULL) || isLeaf(b))
+    {
+        return NULL;
+    }
+    if (b == NULL)
+    {
+        return copyNodes(a);
+    }
+    if (isLeaf(a) && (b->child[0] == NULL) && (b->child[1] == NULL))
+    {
+        return newLeaf();
+    }
+    return newInner(subtractNodes(a->child[0], b->child[0]), subtractNodes(a->child[1], b->child[1]));
+}
+
+// Public results always have a root, like a tree from createNode().
+static bnode_t *rootOf(bnode_t *node)
+{
+    return (node == NULL) ? createNode() : node;
+}
+
+bnode_t *unionTrees(const bnode_t *a, const bnode_t *b)
+{
+    return rootOf(unionNodes(a, b));
+}
+
+bnode_t *intersectTrees(const bnode_t *a, const bnode_t *b)
+{
+    return rootOf(intersectNodes(a, b));
+}
+
+bnode_t *subtractTrees(const bnode_t *a, const bnode_t *b)
+{
+    return rootOf(subtractNodes(a, b));
+}
+
+typedef struct
+{
+    uint16_t ip[8];    // Bits of the current path.
+    uint8_t family;
+    ipv4diff_t visit4;
+    ipv6diff_t visit6;
+    void *context;
+    uint32_t count;
+    uint8_t stop_at_first;
+} diffwalk_t;
+
+static void reportDiff(diffwalk_t *walk, uint8_t added, uint8_t depth)
+{
+    walk->count++;
+    if (walk->family == 4)
+    {
+        ipv4_t ip;
+        ip.ip = ((uint32_t)walk->ip[0] << 16) | walk->ip[1];
+        ip.ps = depth;
+        if (walk->visit4 != NULL)
+        {
+            walk->visit4(walk->context, added, ip);
+        }
+    }
+    else
+    {
+        ipv6_t ip;
+        memcpy(ip.ip, walk->ip, sizeof(ip.ip));
+        ip.ps = depth;
+        if (walk->visit6 != NULL)
+        {
+            walk->visit6(walk->context, added, ip);
+        }
+    }
+}
+
+/*
+Walks the old and the new tree side by side and reports the maximal
+ranges that only one of them covers. Returns 1 to end the walk early.
+*/
+static uint8_t diffNodes(diffwalk_t *walk, const bnode_t *a, const bnode_t *b, uint8_t depth)
+{
+    uint16_t mask;
+
+    if ((a == b) || (isLeaf(a) && isLeaf(b)))
+    {
+        return 0;
+    }
+    if ((a == NULL) && isLeaf(b))
+    {
+        reportDiff(walk, 1, depth);
+        return walk->stop_at_first;
+    }
+    if ((b == NULL) && isLeaf(a))
+    {
+        reportDiff(walk, 0, depth);
+        return walk->stop_at_first;
+    }
+    if (depth == BTREE_MAX_DEPTH)
+    {
+        return 0;
+    }
+
+    mask = (uint16_t)(1 << (15 - (depth & 15)));
+    if (diffNodes(walk, a ? a->child[0] : NULL, b ? b->child[0] : NULL, (uint8_t)(depth + 1)))
+    {
+        return 1;
+    }
+    walk->ip[depth >> 4] |= mask;
+    if (diffNodes(walk, a ? a->child[1] : NULL, b ? b->child[1] : NULL, (uint8_t)(depth + 1)))
+    {
+        walk->ip[depth >> 4] &= (uint16_t)~mask;
+        return 1;
+    }
+    walk->ip[depth >> 4] &= (uint16_t)~mask;
+    return 0;
+}
+
+static uint32_t diffTrees(diffwalk_t *walk, const bnode_t *old_tree, const bnode_t *new_tree)
+{
+    memset(walk->ip, 0, sizeof(walk->ip));
+    walk->count = 0;
+    diffNodes(walk, old_tree, new_tree, 0);
+    return walk->count;
+}
+
+uint8_t equalTrees(const bnode_t *a, const bnode_t *b)
+{
+    diffwalk_t walk;
+
+    walk.family = 6;
+    walk.visit4 = NULL;
+    walk.visit6 = NULL;
+    walk.context = NULL;
+    walk.stop_at_first = 1;
+    return diffTrees(&walk, a, b) == 0;
+}
+
+uint32_t diffIPv4Trees(const bnode_t *old_tree, const bnode_t *new_tree, ipv4diff_t visit, void *context)
+{
+    diffwalk_t walk;
+
+    walk.family = 4;
+    walk.visit4 = visit;
+    walk.visit6 = NULL;
+    walk.context = context;
+    walk.stop_at_first = 0;
+    return diffTrees(&walk, old_tree, new_tree);
+}
+
+uint32_t diffIPv6Trees(const bnode_t *old_tree, const bnode_t *new_tree, ipv6diff_t visit, void *context)
+{
+    diffwalk_t walk;
+
+    walk.family = 6;
+    walk.visit4 = NULL;
+    walk.visit6 = visit;
+    walk.context = context;
+    walk.stop_at_first = 0;
+    return diffTrees(&walk, old_tree, new_tree);
+}
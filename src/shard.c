@@ -0,0 +1,481 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "shard.h"
+#include "btree.h"
+#include "ip.h"
+
+/*
+Entries of both families are kept as ipv6_t while loading; an IPv4
+address occupies the top 32 bits (.ip[0] and .ip[1]).
+An entry with .ps == 0 inside a shard stands for the entire shard.
+*/
+typedef struct
+{
+    ipv6_t *entries;
+    uint32_t size;
+    uint32_t capacity;
+} shardbucket_t;
+
+typedef struct
+{
+    shardedtree_t *tree;
+    const shardbucket_t *buckets;
+    const uint32_t *dirty;
+    uint32_t dirty_count;
+    bnode_t **new_roots;
+    uint32_t next;
+} shardjob_t;
+
+static ipv6_t widenIPv4(ipv4_t ip)
+{
+    ipv6_t wide;
+    memset(&wide, 0, sizeof(wide));
+    wide.ip[0] = (uint16_t)(ip.ip >> 16);
+    wide.ip[1] = (uint16_t)(ip.ip & 0xFFFF);
+    wide.ps = ip.ps;
+    return wide;
+}
+
+static ipv4_t narrowIPv4(ipv6_t wide)
+{
+    ipv4_t ip;
+    ip.ip = ((uint32_t)wide.ip[0] << 16) | wide.ip[1];
+    ip.ps = wide.ps;
+    return ip;
+}
+
+static uint64_t hashEntry(const ipv6_t *entry)
+{
+    uint64_t h = entry->ps;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        h = (h ^ entry->ip[i]) * 0x100000001B3ULL;
+    }
+    // Mixed, so that summing hashes stays well distributed.
+    return mix_bits(h);
+}
+
+shardedtree_t *createShardedTree(uint8_t family, uint8_t bits)
+{
+    shardedtree_t *tree;
+
+    if (((family != 4) && (family != 6)) || (bits == 0) || (bits > SHARD_MAX_BITS))
+    {
+        return NULL;
+    }
+
+    tree = (shardedtree_t *)malloc(sizeof(shardedtree_t));
+    tree->family = family;
+    tree->bits = bits;
+    tree->count = (uint32_t)1 << bits;
+    tree->roots = (bnode_t **)malloc(tree->count * sizeof(bnode_t *));
+    tree->fingerprints = (uint64_t *)calloc(tree->count, sizeof(uint64_t));
+    for (uint32_t i = 0; i < tree->count; i++)
+    {
+        tree->roots[i] = createNode();
+    }
+    return tree;
+}
+
+void deleteShardedTree(shardedtree_t *tree)
+{
+    if (tree == NULL)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < tree->count; i++)
+    {
+        deleteSubtree(tree->roots[i]);
+    }
+    free(tree->fingerprints);
+    free(tree->roots);
+    free(tree);
+}
+
+static uint8_t insertIntoShard(const shardedtree_t *tree, bnode_t *root, ipv6_t local)
+{
+    if (local.ps == 0)
+    {
+        if (root->child[0] == root)
+        {
+            return 1;
+        }
+        deleteSubtree(root->child[0]);
+        deleteSubtree(root->child[1]);
+        root->child[0] = root;
+        root->child[1] = root;
+        return 0;
+    }
+    if (tree->family == 4)
+    {
+        return insertIPv4Address(root, narrowIPv4(local));
+    }
+    return insertIPv6Address(root, local);
+}
+
+/*
+Calls the visitor for every shard an entry touches, with the entry
+made local to that shard. Returns the number of shards touched.
+*/
+static uint32_t forEachShard(const shardedtree_t *tree, ipv6_t ip, void (*visit)(void *, uint32_t, ipv6_t), void *context)
+{
+    uint32_t first = ip.ip[0] >> (16 - tree->bits);
+    uint32_t n;
+
+    if (ip.ps > tree->bits)
+    {
+        bitshiftLeft(ip.ip, tree->bits);
+        ip.ps -= tree->bits;
+        visit(context, first, ip);
+        return 1;
+    }
+
+    n = (uint32_t)1 << (tree->bits - ip.ps);
+    first &= ~(n - 1);
+    memset(ip.ip, 0, sizeof(ip.ip));
+    ip.ps = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        visit(context, first + i, ip);
+    }
+    return n;
+}
+
+typedef struct
+{
+    shardedtree_t *tree;
+    uint8_t status;
+} insertcontext_t;
+
+static void visitInsert(void *context, uint32_t shard, ipv6_t local)
+{
+    insertcontext_t *c = (insertcontext_t *)context;
+    if (insertIntoShard(c->tree, c->tree->roots[shard], local) == 0)
+    {
+        c->status = 0;
+    }
+    c->tree->fingerprints[shard] += hashEntry(&local);
+}
+
+static uint8_t insertWide(shardedtree_t *tree, ipv6_t ip)
+{
+    insertcontext_t context;
+
+    if (ip.ps == 0)
+    {
+        return 2;
+    }
+    context.tree = tree;
+    context.status = 1;
+    forEachShard(tree, ip, visitInsert, &context);
+    return context.status;
+}
+
+// For a start-end range, 0 if any of its prefixes was added, as insertIPv4Entry() does.
+uint8_t insertShardedIPv4(shardedtree_t *tree, const char *s)
+{
+    ipv4_t prefixes[IPV4_RANGE_MAX_PREFIXES];
+    uint8_t count = read_ipv4_entry_n(s, strlen(s), prefixes);
+    uint8_t result = 2;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t inserted = insertWide(tree, widenIPv4(prefixes[i]));
+        result = (inserted < result) ? inserted : result;
+    }
+    return result;
+}
+
+uint8_t insertShardedIPv6(shardedtree_t *tree, const char *s)
+{
+    ipv6_t prefixes[IPV6_RANGE_MAX_PREFIXES];
+    uint8_t count = read_ipv6_entry_n(s, strlen(s), prefixes);
+    uint8_t result = 2;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t inserted = insertWide(tree, prefixes[i]);
+        result = (inserted < result) ? inserted : result;
+    }
+    return result;
+}
+
+static uint8_t coversShards(const shardedtree_t *tree, ipv6_t ip)
+{
+    uint32_t n = (uint32_t)1 << (tree->bits - ip.ps);
+    uint32_t first = (ip.ip[0] >> (16 - tree->bits)) & ~(n - 1);
+
+    for (uint32_t i = first; i < first + n; i++)
+    {
+        if (tree->roots[i]->child[0] != tree->roots[i])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint8_t findShardedIPv4Address(shardedtree_t *tree, ipv4_t ip)
+{
+    uint32_t shard;
+
+    if (ip.ps == 0)
+    {
+        return 0;
+    }
+    if (ip.ps > tree->bits)
+    {
+        shard = ip.ip >> (32 - tree->bits);
+        ip.ip <<= tree->bits;
+        ip.ps -= tree->bits;
+        return findIPv4Address(tree->roots[shard], ip);
+    }
+    return coversShards(tree, widenIPv4(ip));
+}
+
+uint8_t findShardedIPv4(shardedtree_t *tree, const char *s)
+{
+    return findShardedIPv4Address(tree, read_ipv4(s));
+}
+
+uint8_t findShardedIPv6Address(shardedtree_t *tree, ipv6_t ip)
+{
+    uint32_t shard;
+
+    if (ip.ps == 0)
+    {
+        return 0;
+    }
+    if (ip.ps > tree->bits)
+    {
+        shard = ip.ip[0] >> (16 - tree->bits);
+        bitshiftLeft(ip.ip, tree->bits);
+        ip.ps -= tree->bits;
+        return findIPv6Address(tree->roots[shard], ip);
+    }
+    return coversShards(tree, ip);
+}
+
+uint8_t findShardedIPv6(shardedtree_t *tree, const char *s)
+{
+    return findShardedIPv6Address(tree, read_ipv6(s));
+}
+
+uint32_t countShardedTree(shardedtree_t *tree)
+{
+    uint32_t counter = 0;
+
+    for (uint32_t i = 0; i < tree->count; i++)
+    {
+        bnode_t *root = tree->roots[i];
+        if ((root->child[0] == NULL) && (root->child[1] == NULL))
+        {
+            continue;
+        }
+        counter += (tree->family == 4) ? countIPv4Tree(root) : countIPv6Tree(root);
+    }
+    return counter;
+}
+
+static void visitBucket(void *context, uint32_t shard, ipv6_t local)
+{
+    shardbucket_t *bucket = (shardbucket_t *)context + shard;
+
+    if (bucket->size == bucket->capacity)
+    {
+        bucket->capacity = bucket->capacity ? 2 * bucket->capacity : 16;
+        bucket->entries = (ipv6_t *)realloc(bucket->entries, bucket->capacity * sizeof(ipv6_t));
+    }
+    bucket->entries[bucket->size++] = local;
+}
+
+static void freeBuckets(shardbucket_t *buckets, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        free(buckets[i].entries);
+    }
+    free(buckets);
+}
+
+// Sorts the prefixes of one list entry into the buckets of their shards.
+static void bucketEntry(const shardedtree_t *tree, const char *entry, size_t length, shardbucket_t *buckets)
+{
+    if (tree->family == 4)
+    {
+        ipv4_t prefixes[IPV4_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv4_entry_n(entry, length, prefixes);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            forEachShard(tree, widenIPv4(prefixes[i]), visitBucket, buckets);
+        }
+    }
+    else
+    {
+        ipv6_t prefixes[IPV6_RANGE_MAX_PREFIXES];
+        uint8_t count = read_ipv6_entry_n(entry, length, prefixes);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            forEachShard(tree, prefixes[i], visitBucket, buckets);
+        }
+    }
+}
+
+static shardbucket_t *readBuckets(const shardedtree_t *tree, const char *filename)
+{
+    const uint8_t MAX_IP_LEN = 96;
+    FILE *fp = fopen(filename, "r");
+    char buffer[MAX_IP_LEN];
+    shardbucket_t *buckets;
+    int c;
+    uint8_t buffer_index = 0;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error opening file %s\n", filename);
+        return NULL;
+    }
+
+    buckets = (shardbucket_t *)calloc(tree->count, sizeof(shardbucket_t));
+    do
+    {
+        c = getc(fp);
+        if ((c == ' ') || (c == '\n') || (c == '\r') || (c == '\t') || (c == EOF))
+        {
+            if (buffer_index > 0)
+            {
+                bucketEntry(tree, buffer, buffer_index, buckets);
+            }
+            buffer_index = 0;
+        }
+        else if (buffer_index < MAX_IP_LEN - 1)
+        {
+            buffer[buffer_index++] = (char)c;
+        }
+    } while (c != EOF);
+
+    fclose(fp);
+    return buckets;
+}
+
+static void *buildShards(void *arg)
+{
+    shardjob_t *job = (shardjob_t *)arg;
+    uint32_t i;
+
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->dirty_count)
+    {
+        const shardbucket_t *bucket = &job->buckets[job->dirty[i]];
+        bnode_t *root = createNode();
+        for (uint32_t e = 0; e < bucket->size; e++)
+        {
+            insertIntoShard(job->tree, root, bucket->entries[e]);
+        }
+        job->new_roots[i] = root;
+    }
+    return NULL;
+}
+
+static void runBuilders(shardjob_t *job, uint16_t threads)
+{
+    pthread_t *thread_ids;
+    uint8_t *started;
+    uint16_t t;
+
+    if (threads == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cores > 0) ? (uint16_t)cores : 1;
+    }
+    if (threads > job->dirty_count)
+    {
+        threads = (uint16_t)job->dirty_count;
+    }
+    if (threads == 0)
+    {
+        return;
+    }
+
+    thread_ids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+    started = (uint8_t *)calloc(threads, sizeof(uint8_t));
+    for (t = 1; t < threads; t++)
+    {
+        started[t] = (pthread_create(&thread_ids[t], NULL, buildShards, job) == 0);
+    }
+    buildShards(job);
+    for (t = 1; t < threads; t++)
+    {
+        if (started[t])
+        {
+            pthread_join(thread_ids[t], NULL);
+        }
+    }
+    free(started);
+    free(thread_ids);
+}
+
+uint32_t reloadShardedTreeFromFile(shardedtree_t *tree, const char *filename, uint16_t threads)
+{
+    shardbucket_t *buckets = readBuckets(tree, filename);
+    uint64_t *fingerprints;
+    uint32_t *dirty;
+    shardjob_t job;
+    uint32_t i;
+
+    if (buckets == NULL)
+    {
+        return 0;
+    }
+
+    fingerprints = (uint64_t *)calloc(tree->count, sizeof(uint64_t));
+    dirty = (uint32_t *)malloc(tree->count * sizeof(uint32_t));
+    job.tree = tree;
+    job.buckets = buckets;
+    job.dirty = dirty;
+    job.dirty_count = 0;
+    job.next = 0;
+    for (i = 0; i < tree->count; i++)
+    {
+        for (uint32_t e = 0; e < buckets[i].size; e++)
+        {
+            fingerprints[i] += hashEntry(&buckets[i].entries[e]);
+        }
+        if (fingerprints[i] != tree->fingerprints[i])
+        {
+            dirty[job.dirty_count++] = i;
+        }
+    }
+
+    job.new_roots = (bnode_t **)calloc(job.dirty_count + 1, sizeof(bnode_t *));
+    runBuilders(&job, threads);
+
+    for (i = 0; i < job.dirty_count; i++)
+    {
+        uint32_t shard = dirty[i];
+        deleteSubtree(tree->roots[shard]);
+        tree->roots[shard] = job.new_roots[i];
+        tree->fingerprints[shard] = fingerprints[shard];
+    }
+
+    free(job.new_roots);
+    free(dirty);
+    free(fingerprints);
+    freeBuckets(buckets, tree->count);
+    return job.dirty_count;
+}
+
+shardedtree_t *createShardedTreeFromFile(const char *filename, uint8_t family, uint8_t bits, uint16_t threads)
+{
+    shardedtree_t *tree = createShardedTree(family, bits);
+
+    if (tree != NULL)
+    {
+        reloadShardedTreeFromFile(tree, filename, threads);
+    }
+    return tree;
+}
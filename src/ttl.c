@@ -0,0 +1,408 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ttl.h"
+
+#define TTL_INITIAL_BUCKETS 64
+
+ttltree_t *createTtlTree(uint64_t now)
+{
+    ttltree_t *ttl = (ttltree_t *)malloc(sizeof(ttltree_t));
+
+    ttl->ipv4_root = createNode();
+    ttl->ipv6_root = createNode();
+    memset(ttl->wheel, 0, sizeof(ttl->wheel));
+    ttl->bucket_count = TTL_INITIAL_BUCKETS;
+    ttl->buckets = (ttlentry_t **)calloc(ttl->bucket_count, sizeof(ttlentry_t *));
+    ttl->entry_count = 0;
+    ttl->timed_count = 0;
+    ttl->now = now;
+    return ttl;
+}
+
+void deleteTtlTree(ttltree_t *ttl)
+{
+    if (ttl == NULL)
+    {
+        return;
+    }
+    for (uint32_t b = 0; b < ttl->bucket_count; b++)
+    {
+        ttlentry_t *entry = ttl->buckets[b];
+        while (entry != NULL)
+        {
+            ttlentry_t *next = entry->hash_next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(ttl->buckets);
+    deleteSubtree(ttl->ipv4_root);
+    deleteSubtree(ttl->ipv6_root);
+    free(ttl);
+}
+
+/*
+Prefixes are kept as 8 groups with the host bits cleared, so that an
+IPv4 and an IPv6 entry only differ in .family.
+*/
+static ipv6_t fromIPv4(ipv4_t ip)
+{
+    ipv6_t key;
+    uint32_t address = ip.ip & ipv4_netmask(ip.ps);
+
+    memset(&key, 0, sizeof(key));
+    key.ip[0] = (uint16_t)(address >> 16);
+    key.ip[1] = (uint16_t)address;
+    key.ps = ip.ps;
+    return key;
+}
+
+static ipv4_t toIPv4(const ipv6_t *key)
+{
+    ipv4_t ip;
+
+    ip.ip = ((uint32_t)key->ip[0] << 16) | key->ip[1];
+    ip.ps = key->ps;
+    return ip;
+}
+
+static uint32_t hashKey(uint8_t family, const ipv6_t *key)
+{
+    // FNV-1a over the groups, the prefix size and the family.
+    uint32_t hash = 2166136261U;
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        hash = (hash ^ key->ip[i]) * 16777619U;
+    }
+    hash = (hash ^ key->ps) * 16777619U;
+    return (hash ^ family) * 16777619U;
+}
+
+static ttlentry_t **findSlot(ttltree_t *ttl, uint8_t family, const ipv6_t *key)
+{
+    ttlentry_t **slot = &ttl->buckets[hashKey(family, key) & (ttl->bucket_count - 1)];
+
+    while ((*slot != NULL) &&
+           (((*slot)->family != family) || ((*slot)->ip.ps != key->ps) || (memcmp((*slot)->ip.ip, key->ip, sizeof(key->ip)) != 0)))
+    {
+        slot = &(*slot)->hash_next;
+    }
+    return slot;
+}
+
+static void growBuckets(ttltree_t *ttl)
+{
+    uint32_t bucket_count = 2 * ttl->bucket_count;
+    ttlentry_t **buckets = (ttlentry_t **)calloc(bucket_count, sizeof(ttlentry_t *));
+
+    for (uint32_t b = 0; b < ttl->bucket_count; b++)
+    {
+        ttlentry_t *entry = ttl->buckets[b];
+        while (entry != NULL)
+        {
+            ttlentry_t *next = entry->hash_next;
+            uint32_t index = hashKey(entry->family, &entry->ip) & (bucket_count - 1);
+            entry->hash_next = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+    free(ttl->buckets);
+    ttl->buckets = buckets;
+    ttl->bucket_count = bucket_count;
+}
+
+/*
+Puts an entry in the lowest level whose slots still reach its expiry
+time, as seen from the next second to expire. Slots are indexed by the
+expiry time itself, so an entry moves down a level whenever the level
+below wraps around (see cascade()).
+*/
+static void schedule(ttltree_t *ttl, ttlentry_t *entry)
+{
+    uint64_t next = ttl->now + 1;
+    uint64_t delta = (entry->expires > next) ? entry->expires - next : 0;
+    uint8_t level = 0;
+    ttlentry_t **slot;
+
+    while ((level < TTL_WHEEL_LEVELS - 1) && (delta >> (TTL_WHEEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+    slot = &ttl->wheel[level][((entry->expires > next ? entry->expires : next) >> (TTL_WHEEL_BITS * level)) & (TTL_WHEEL_SLOTS - 1)];
+    entry->prev = NULL;
+    entry->next = *slot;
+    entry->wheel_slot = slot;
+    if (*slot != NULL)
+    {
+        (*slot)->prev = entry;
+    }
+    *slot = entry;
+}
+
+static void unschedule(ttlentry_t *entry)
+{
+    if (entry->prev != NULL)
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        *entry->wheel_slot = entry->next;
+    }
+    if (entry->next != NULL)
+    {
+        entry->next->prev = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+    entry->wheel_slot = NULL;
+}
+
+static uint8_t insertIntoTree(ttltree_t *ttl, const ttlentry_t *entry)
+{
+    if (entry->family == 4)
+    {
+        return insertIPv4Address(ttl->ipv4_root, toIPv4(&entry->ip));
+    }
+    return insertIPv6Address(ttl->ipv6_root, entry->ip);
+}
+
+static uint8_t insertTtl(ttltree_t *ttl, uint8_t family, ipv6_t key, uint32_t seconds)
+{
+    ttlentry_t **slot = findSlot(ttl, family, &key);
+    ttlentry_t *entry = *slot;
+    uint64_t expires = (seconds == TTL_PERMANENT) ? 0 : ttl->now + seconds;
+
+    if (entry != NULL)
+    {
+        // Refresh: keep the later expiry time; permanent beats everything.
+        if ((entry->expires != 0) && ((expires == 0) || (expires > entry->expires)))
+        {
+            unschedule(entry);
+            entry->expires = expires;
+            if (expires != 0)
+            {
+                schedule(ttl, entry);
+            }
+            else
+            {
+                ttl->timed_count--;
+            }
+        }
+        return 1;
+    }
+
+    entry = (ttlentry_t *)malloc(sizeof(ttlentry_t));
+    entry->ip = key;
+    entry->family = family;
+    entry->expires = expires;
+    entry->prev = entry->next = NULL;
+    entry->wheel_slot = NULL;
+    entry->hash_next = NULL;
+    *slot = entry;
+    if (expires != 0)
+    {
+        schedule(ttl, entry);
+        ttl->timed_count++;
+    }
+    insertIntoTree(ttl, entry);
+    if (++ttl->entry_count > ttl->bucket_count)
+    {
+        growBuckets(ttl);
+    }
+    return 0;
+}
+
+uint8_t insertTtlIPv4(ttltree_t *ttl, ipv4_t ip, uint32_t seconds)
+{
+    if (ip.ps == 0)
+    {
+        return 2;
+    }
+    return insertTtl(ttl, 4, fromIPv4(ip), seconds);
+}
+
+uint8_t insertTtlIPv6(ttltree_t *ttl, ipv6_t ip, uint32_t seconds)
+{
+    if (ip.ps == 0)
+    {
+        return 2;
+    }
+    return insertTtl(ttl, 6, mask_ipv6(ip, ip.ps), seconds);
+}
+
+/*
+Takes an entry out of the hash table and its tree. A range may have
+absorbed narrower entries, or kept them out; those are added to the
+removed tree of its family so that restoreCovered() can put them back.
+*/
+static void dropEntry(ttltree_t *ttl, ttlentry_t *entry, bnode_t *removed[2])
+{
+    ttlentry_t **slot = findSlot(ttl, entry->family, &entry->ip);
+    uint8_t full = (entry->family == 4) ? 32 : 128;
+
+    *slot = entry->hash_next;
+    ttl->entry_count--;
+    if (entry->expires != 0)
+    {
+        ttl->timed_count--;
+    }
+    if (entry->family == 4)
+    {
+        removeIPv4Address(ttl->ipv4_root, toIPv4(&entry->ip));
+    }
+    else
+    {
+        removeIPv6Address(ttl->ipv6_root, entry->ip);
+    }
+    if (entry->ip.ps < full)
+    {
+        bnode_t **root = &removed[entry->family == 6];
+        if (*root == NULL)
+        {
+            *root = createNode();
+        }
+        if (entry->family == 4)
+        {
+            insertIPv4Address(*root, toIPv4(&entry->ip));
+        }
+        else
+        {
+            insertIPv6Address(*root, entry->ip);
+        }
+    }
+    free(entry);
+}
+
+/*
+Puts back every remaining entry inside a removed range. This scans all
+entries, but only after ranges were removed: expiring single addresses,
+the common case, never needs it.
+*/
+static void restoreCovered(ttltree_t *ttl, bnode_t *removed[2])
+{
+    if ((removed[0] == NULL) && (removed[1] == NULL))
+    {
+        return;
+    }
+    for (uint32_t b = 0; b < ttl->bucket_count; b++)
+    {
+        for (ttlentry_t *entry = ttl->buckets[b]; entry != NULL; entry = entry->hash_next)
+        {
+            uint8_t covered;
+            if (entry->family == 4)
+            {
+                covered = (removed[0] != NULL) && findIPv4Address(removed[0], toIPv4(&entry->ip));
+            }
+            else
+            {
+                covered = (removed[1] != NULL) && findIPv6Address(removed[1], entry->ip);
+            }
+            if (covered)
+            {
+                insertIntoTree(ttl, entry);
+            }
+        }
+    }
+    deleteSubtree(removed[0]);
+    deleteSubtree(removed[1]);
+}
+
+static uint8_t removeTtl(ttltree_t *ttl, uint8_t family, ipv6_t key)
+{
+    ttlentry_t *entry = *findSlot(ttl, family, &key);
+    bnode_t *removed[2] = {NULL, NULL};
+
+    if (entry == NULL)
+    {
+        return 1;
+    }
+    if (entry->expires != 0)
+    {
+        unschedule(entry);
+    }
+    dropEntry(ttl, entry, removed);
+    restoreCovered(ttl, removed);
+    return 0;
+}
+
+uint8_t removeTtlIPv4(ttltree_t *ttl, ipv4_t ip)
+{
+    if (ip.ps == 0)
+    {
+        return 2;
+    }
+    return removeTtl(ttl, 4, fromIPv4(ip));
+}
+
+uint8_t removeTtlIPv6(ttltree_t *ttl, ipv6_t ip)
+{
+    if (ip.ps == 0)
+    {
+        return 2;
+    }
+    return removeTtl(ttl, 6, mask_ipv6(ip, ip.ps));
+}
+
+// Moves the entries of one slot of a higher level to the levels below.
+static void cascade(ttltree_t *ttl, uint8_t level, uint8_t index)
+{
+    ttlentry_t *entry = ttl->wheel[level][index];
+
+    ttl->wheel[level][index] = NULL;
+    while (entry != NULL)
+    {
+        ttlentry_t *next = entry->next;
+        schedule(ttl, entry);
+        entry = next;
+    }
+}
+
+uint32_t expireTtlTree(ttltree_t *ttl, uint64_t now)
+{
+    bnode_t *removed[2] = {NULL, NULL};
+    uint32_t expired = 0;
+
+    while (ttl->now < now)
+    {
+        uint64_t second = ttl->now + 1;
+        uint8_t index = (uint8_t)(second & (TTL_WHEEL_SLOTS - 1));
+        ttlentry_t *entry;
+        uint8_t top = 0;
+
+        // Slots are indexed by expiry time, so an empty wheel can skip to now.
+        if (ttl->timed_count == 0)
+        {
+            ttl->now = now;
+            break;
+        }
+
+        /*
+        When a level wraps around, the current slot of the next level comes
+        due. Higher levels go first, so that their entries still reach the
+        current slots of the levels below.
+        */
+        while ((top < TTL_WHEEL_LEVELS - 1) && ((second & ((1ULL << (TTL_WHEEL_BITS * (top + 1))) - 1)) == 0))
+        {
+            top++;
+        }
+        for (uint8_t level = top; level > 0; level--)
+        {
+            cascade(ttl, level, (uint8_t)((second >> (TTL_WHEEL_BITS * level)) & (TTL_WHEEL_SLOTS - 1)));
+        }
+        ttl->now = second;
+
+        entry = ttl->wheel[0][index];
+        ttl->wheel[0][index] = NULL;
+        while (entry != NULL)
+        {
+            ttlentry_t *next = entry->next;
+            dropEntry(ttl, entry, removed);
+            expired++;
+            entry = next;
+        }
+    }
+    restoreCovered(ttl, removed);
+    return expired;
+}
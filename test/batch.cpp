@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "batch.h"
+}
+
+TEST(BatchSuite, ClassifyIPv4BatchBitmap)
+{
+    const char *ips[] = {"1.2.3.4", "1.2.3.3", "10.20.30.40", "1.2.3.", "50.60.70.80"};
+    uint8_t bitmap[1] = {0xff};
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt");
+
+    EXPECT_EQ(classifyIPv4Batch(tree, ips, 5, bitmap, 2), 3);
+    EXPECT_EQ(bitmap[0], 0x15);
+}
+
+TEST(BatchSuite, ClassifyIPv4BatchEmpty)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt");
+    EXPECT_EQ(classifyIPv4Batch(tree, nullptr, 0, nullptr, 0), 0);
+}
+
+TEST(BatchSuite, ClassifyIPv4BatchMatchesSequentialLookup)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    std::vector<std::string> strings;
+    std::vector<const char *> ips;
+    uint64_t expected = 0;
+
+    for (int i = 0; i < 5 * BATCH_CHUNK_SIZE + 3; i++)
+    {
+        strings.push_back(std::to_string(1 + i % 7) + "." + std::to_string(2 + i % 3) + "." + std::to_string(i % 16) + "." + std::to_string(i % 256));
+    }
+    for (const std::string &s : strings)
+    {
+        ips.push_back(s.c_str());
+        expected += findIPv4(tree, s.c_str());
+    }
+
+    for (uint16_t threads = 1; threads <= 4; threads++)
+    {
+        std::vector<uint8_t> bitmap((ips.size() + 7) / 8);
+        EXPECT_EQ(classifyIPv4Batch(tree, ips.data(), ips.size(), bitmap.data(), threads), expected);
+        for (size_t i = 0; i < ips.size(); i++)
+        {
+            EXPECT_EQ((bitmap[i / 8] >> (i % 8)) & 1, findIPv4(tree, ips[i]));
+        }
+    }
+}
+
+TEST(BatchSuite, ClassifyIPv6BatchBitmap)
+{
+    const char *ips[] = {"1:2:3:4:5:6:7:0", "1:2:3:4:5:6:7:10", "2:3:4:5:6:7:8:ff", "4:5:6:7:8:9:a:b"};
+    uint8_t bitmap[1] = {0};
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
+
+    EXPECT_EQ(classifyIPv6Batch(tree, ips, 4, bitmap, 0), 3);
+    EXPECT_EQ(bitmap[0], 0x0d);
+}
+
+TEST(BatchSuite, FilterIPv4File)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    FILE *out = tmpfile();
+    char buffer[64] = {0};
+
+    insertIPv4(tree, "1.0.0.0/24");
+    EXPECT_EQ(filterIPv4File(tree, TEST_DATA_DIR "outbound.txt", out, 0), 2);
+    rewind(out);
+    EXPECT_EQ(fread(buffer, 1, sizeof(buffer) - 1, out), 20);
+    EXPECT_STREQ(buffer, "1.0.0.104\n1.0.0.229\n");
+    fclose(out);
+}
+
+TEST(BatchSuite, FilterIPv6File)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6list.txt");
+    EXPECT_EQ(filterIPv6File(tree, TEST_DATA_DIR "ipv6list.txt", nullptr, 3), 10);
+}
+
+TEST(BatchSuite, FilterNonExistentFile)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt");
+    EXPECT_EQ(filterIPv4File(tree, TEST_DATA_DIR "non-existent.txt", nullptr, 0), 0);
+}
@@ -1,4 +1,8 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unistd.h>
 
 extern "C"
 {
@@ -235,25 +239,25 @@ TEST(BTreeSuite, CountIPv4TreeOverlappingRanges)
 
 TEST(BTreeSuite, CreateIPv4TreeFromTinyFile)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4single.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4single.txt");
     EXPECT_EQ(countIPv4Tree(tree), 1);
 }
 
 TEST(BTreeSuite, CreateIPv4TreeFromSmallFile)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4list.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt");
     EXPECT_EQ(countIPv4Tree(tree), 10);
 }
 
 TEST(BTreeSuite, CreateIPv4TreeFromLargeFile)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/inbound_v4.txt");
+    bnode_t *tree = createIPv4TreeFromFile(GENERATED_DATA_DIR "inbound_v4.txt");
     EXPECT_GT(countIPv4Tree(tree), 1000000);
 }
 
 TEST(BTreeSuite, FindIPv4InSmallFile)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4list.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt");
     EXPECT_EQ(findIPv4(tree, "1.2.3.4"), 1);
     EXPECT_EQ(findIPv4(tree, "2.3.4.5"), 1);
     EXPECT_EQ(findIPv4(tree, "3.4.5.6"), 1);
@@ -271,7 +275,7 @@ TEST(BTreeSuite, FindIPv4InSmallFile)
 
 TEST(BTreeSuite, FindIPv4InRange)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4range.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
     EXPECT_EQ(findIPv4(tree, "1.2.3.0"), 1);
     EXPECT_EQ(findIPv4(tree, "1.2.3.15"), 1);
     EXPECT_EQ(findIPv4(tree, "1.2.3.16"), 0);
@@ -282,7 +286,7 @@ TEST(BTreeSuite, FindIPv4InRange)
 
 TEST(BTreeSuite, FindIPv4InRangeWithMask24)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4range.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
     EXPECT_EQ(findIPv4(tree, "3.4.5.0"), 1);
     EXPECT_EQ(findIPv4(tree, "3.4.5.127"), 1);
     EXPECT_EQ(findIPv4(tree, "3.4.5.255"), 1);
@@ -292,7 +296,7 @@ TEST(BTreeSuite, FindIPv4InRangeWithMask24)
 
 TEST(BTreeSuite, FindIPv4InRangeWithMask31)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4range.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
     EXPECT_EQ(findIPv4(tree, "6.7.8.7"), 0);
     EXPECT_EQ(findIPv4(tree, "6.7.8.8"), 1);
     EXPECT_EQ(findIPv4(tree, "6.7.8.9"), 1);
@@ -301,7 +305,7 @@ TEST(BTreeSuite, FindIPv4InRangeWithMask31)
 
 TEST(BTreeSuite, FindIPv4Range)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4range.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
     EXPECT_EQ(findIPv4(tree, "1.2.3.4/28"), 1);
     EXPECT_EQ(findIPv4(tree, "1.2.3.0"), 1);
     EXPECT_EQ(findIPv4(tree, "1.2.3.4/29"), 1);
@@ -310,13 +314,13 @@ TEST(BTreeSuite, FindIPv4Range)
 
 TEST(BTreeSuite, FindInvalidIPv4)
 {
-    bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv4list.txt");
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt");
     EXPECT_EQ(findIPv4(tree, "1.2.3."), 0);
 }
 
 TEST(BTreeSuite, InvalidIPv4InputFile)
 {
-    const bnode_t *tree = createIPv4TreeFromFile("/home/aldo/git/non-existent.txt");
+    const bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "non-existent.txt");
     EXPECT_TRUE(tree->child[0] == nullptr);
     EXPECT_TRUE(tree->child[1] == nullptr);
 }
@@ -632,25 +636,25 @@ TEST(BTreeSuite, CountIPv6TreeOverlappingRanges)
 
 TEST(BTreeSuite, CreateIPv6TreeFromTinyFile)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6single.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6single.txt");
     EXPECT_EQ(countIPv6Tree(tree), 1);
 }
 
 TEST(BTreeSuite, CreateIPv6TreeFromSmallFile)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6list.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6list.txt");
     EXPECT_EQ(countIPv6Tree(tree), 10);
 }
 
 TEST(BTreeSuite, CreateIPv6TreeFromLargeFile)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/inbound_v6.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
     EXPECT_GT(countIPv6Tree(tree), 1800);
 }
 
 TEST(BTreeSuite, FindIPv6InSmallFile)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6list.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6list.txt");
     EXPECT_EQ(findIPv6(tree, "1:2:3:4:5:6:7:8"), 1);
     EXPECT_EQ(findIPv6(tree, "2:3:4:5:6:7:8:9"), 1);
     EXPECT_EQ(findIPv6(tree, "3:4:5:6:7:8:9:a"), 1);
@@ -668,7 +672,7 @@ TEST(BTreeSuite, FindIPv6InSmallFile)
 
 TEST(BTreeSuite, FindIPv6InRange)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6range.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
     EXPECT_EQ(findIPv6(tree, "1:2:3:4:5:6:7:8"), 1);
     EXPECT_EQ(findIPv6(tree, "1:2:3:4:5:6:7:0"), 1);
     EXPECT_EQ(findIPv6(tree, "1:2:3:4:5:6:7:10"), 0);
@@ -679,7 +683,7 @@ TEST(BTreeSuite, FindIPv6InRange)
 
 TEST(BTreeSuite, FindIPv6InRangeWithMask120)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6range.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
     EXPECT_EQ(findIPv6(tree, "2:3:4:5:6:7:8:0"), 1);
     EXPECT_EQ(findIPv6(tree, "2:3:4:5:6:7:8:ff"), 1);
     EXPECT_EQ(findIPv6(tree, "2:3:4:5:6:7:8:100"), 0);
@@ -689,7 +693,7 @@ TEST(BTreeSuite, FindIPv6InRangeWithMask120)
 
 TEST(BTreeSuite, FindIPv6InRangeWithMask127)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6range.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
     EXPECT_EQ(findIPv6(tree, "4:5:6:7:8:9:a:9"), 0);
     EXPECT_EQ(findIPv6(tree, "4:5:6:7:8:9:a:a"), 1);
     EXPECT_EQ(findIPv6(tree, "4:5:6:7:8:9:a:b"), 1);
@@ -698,7 +702,7 @@ TEST(BTreeSuite, FindIPv6InRangeWithMask127)
 
 TEST(BTreeSuite, FindIPv6Range)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6range.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
     EXPECT_EQ(findIPv6(tree, "2:3:4:5:6:7:8:9/120"), 1);
     EXPECT_EQ(findIPv6(tree, "2:3:4:5:6:7:8:0"), 1);
     EXPECT_EQ(findIPv6(tree, "2:3:4:5:6:7:8:0/121"), 1);
@@ -707,13 +711,446 @@ TEST(BTreeSuite, FindIPv6Range)
 
 TEST(BTreeSuite, FindInvalidIPv6)
 {
-    bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/ip-lookup/test/data/ipv6list.txt");
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6list.txt");
     EXPECT_EQ(findIPv6(tree, "1:2:3:4:5:6:7:"), 0);
 }
 
 TEST(BTreeSuite, InvalidIPv6InputFile)
 {
-    const bnode_t *tree = createIPv6TreeFromFile("/home/aldo/git/non-existent.txt");
+    const bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "non-existent.txt");
     EXPECT_TRUE(tree->child[0] == nullptr);
     EXPECT_TRUE(tree->child[1] == nullptr);
 }
+
+TEST(BTreeSuite, StatsOfEmptyTree)
+{
+    bnode_t *tree = createNode();
+    btreestats_t stats;
+    getTreeStats(tree, &stats);
+    EXPECT_EQ(stats.nodes, 1);
+    EXPECT_EQ(stats.bytes, sizeof(bnode_t));
+    EXPECT_EQ(stats.leaves, 0);
+    EXPECT_EQ(stats.max_depth, 0);
+    EXPECT_EQ(stats.single_child_nodes, 0);
+    EXPECT_EQ(stats.average_leaf_depth, 0.0);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, StatsOfIPv4Tree)
+{
+    bnode_t *tree = createNode();
+    btreestats_t stats;
+    insertIPv4(tree, "1.2.3.4");
+    insertIPv4(tree, "1.2.3.5");
+    insertIPv4(tree, "1.2.4.0/24");
+    getTreeStats(tree, &stats);
+    EXPECT_EQ(stats.leaves, countIPv4Tree(tree));
+    EXPECT_EQ(stats.nodes, 34 + 3);
+    EXPECT_EQ(stats.bytes, stats.nodes * sizeof(bnode_t));
+    EXPECT_EQ(stats.max_depth, 32);
+    EXPECT_EQ(stats.depth_histogram[0], 1);
+    EXPECT_EQ(stats.depth_histogram[24], 2);
+    EXPECT_EQ(stats.depth_histogram[32], 2);
+    EXPECT_DOUBLE_EQ(stats.average_leaf_depth, (32.0 + 32.0 + 24.0) / 3.0);
+    EXPECT_EQ(stats.single_child_nodes, stats.nodes - stats.leaves - 2);
+    EXPECT_DOUBLE_EQ(stats.single_child_fraction, (double)stats.single_child_nodes / (stats.nodes - stats.leaves));
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, StatsOfIPv6Tree)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+    btreestats_t stats;
+    uint64_t histogram_total = 0;
+    getTreeStats(tree, &stats);
+    EXPECT_EQ(stats.leaves, countIPv6Tree(tree));
+    EXPECT_EQ(stats.max_depth, 128);
+    for (uint16_t depth = 0; depth <= BTREE_MAX_DEPTH; depth++)
+    {
+        histogram_total += stats.depth_histogram[depth];
+    }
+    EXPECT_EQ(histogram_total, stats.nodes);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, LoadIPv4FileWithReport)
+{
+    char filename[] = "/tmp/ip-report-XXXXXX";
+    int fd = mkstemp(filename);
+    const char contents[] = "1.2.3.4\n1.2.3.4\r\n\n1.2.3.0/24\n1.2.3.9 1.2.3.10\tbogus\n5.6.7.8";
+    bnode_t *tree = createNode();
+    loadreport_t report;
+
+    ASSERT_EQ(write(fd, contents, sizeof(contents) - 1), (ssize_t)(sizeof(contents) - 1));
+    close(fd);
+    EXPECT_EQ(loadIPv4FileWithReport(tree, filename, &report), 0);
+    remove(filename);
+    EXPECT_EQ(report.lines, 7);
+    EXPECT_EQ(report.added, 3);
+    EXPECT_EQ(report.duplicates, 1);
+    EXPECT_EQ(report.covered, 2);
+    EXPECT_EQ(report.invalid, 1);
+    EXPECT_EQ(report.absorbed_nodes, 8);
+    EXPECT_GE(report.total_ns, report.parse_ns + report.insert_ns + report.delete_ns);
+    EXPECT_EQ(countIPv4Tree(tree), 2);
+    EXPECT_EQ(findIPv4(tree, "5.6.7.8"), 1);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, LoadMatchesLoadWithReport)
+{
+    char filename[] = "/tmp/ip-plain-XXXXXX";
+    int fd = mkstemp(filename);
+    std::string contents = "1.2.3.4\n" + std::string(100, '1') + "1.2.3.0/24\n10.0.0.1-10.0.0.9\n5.6.7.8";
+    bnode_t *plain = createNode();
+    bnode_t *reported = createNode();
+    loadreport_t report;
+
+    ASSERT_EQ(write(fd, contents.data(), contents.size()), (ssize_t)contents.size());
+    close(fd);
+    EXPECT_EQ(loadIPv4File(plain, filename), 0);
+    EXPECT_EQ(loadIPv4FileWithReport(reported, filename, &report), 0);
+    remove(filename);
+    EXPECT_EQ(report.invalid, 1);
+    EXPECT_EQ(findIPv4(plain, "5.6.7.8"), 1);
+    EXPECT_EQ(findIPv4(plain, "1.2.3.9"), 0);
+    EXPECT_EQ(findIPv4(plain, "10.0.0.9"), 1);
+    EXPECT_EQ(countIPv4Tree(plain), 6);
+    EXPECT_EQ(countIPv4Tree(reported), 6);
+    deleteSubtree(plain);
+    deleteSubtree(reported);
+}
+
+TEST(BTreeSuite, LoadMixedFileWithReport)
+{
+    char filename[] = "/tmp/ip-mixed-XXXXXX";
+    int fd = mkstemp(filename);
+    const char contents[] = "1.2.3.4\n2001:db8::/32\n10.0.0.1-10.0.0.9\n2001:db9::1-2001:db9::9\nbogus\n1.2.3\n::zz\n";
+    bnode_t *tree = createNode();
+    loadreport_t report;
+
+    ASSERT_EQ(write(fd, contents, sizeof(contents) - 1), (ssize_t)(sizeof(contents) - 1));
+    close(fd);
+    EXPECT_EQ(loadIPv4FileWithReport(tree, filename, &report), 0);
+    EXPECT_EQ(report.lines, 7);
+    EXPECT_EQ(report.added, 2);
+    EXPECT_EQ(report.other_family, 2);
+    EXPECT_EQ(report.invalid, 3);
+    deleteSubtree(tree);
+
+    tree = createNode();
+    EXPECT_EQ(loadIPv6FileWithReport(tree, filename, &report), 0);
+    EXPECT_EQ(report.added, 2);
+    EXPECT_EQ(report.other_family, 2);
+    EXPECT_EQ(report.invalid, 3);
+    remove(filename);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, LoadIPv6FileWithReportMatchesLoad)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+    bnode_t *reported = createNode();
+    loadreport_t report;
+
+    EXPECT_EQ(loadIPv6FileWithReport(reported, TEST_DATA_DIR "inbound_v6.txt", &report), 0);
+    EXPECT_EQ(countIPv6Tree(reported), countIPv6Tree(tree));
+    EXPECT_EQ(report.lines, report.added + report.duplicates + report.covered + report.invalid + report.other_family);
+    EXPECT_EQ(loadIPv6FileWithReport(reported, TEST_DATA_DIR "non-existent.txt", &report), 1);
+    EXPECT_EQ(report.lines, 0);
+    deleteSubtree(tree);
+    deleteSubtree(reported);
+}
+
+TEST(BTreeSuite, MatchIPv4ReturnsEntry)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    ipv4_t match;
+    char s[IPSTRLENV4];
+
+    EXPECT_EQ(matchIPv4(tree, "2.3.15.200", &match), 1);
+    ipv4tostring(s, match);
+    EXPECT_STREQ(s, "2.3.0.0/20");
+    EXPECT_EQ(matchIPv4(tree, "6.7.8.8", &match), 1);
+    EXPECT_EQ(match.ps, 31);
+    EXPECT_EQ(match.ip, read_ipv4("6.7.8.8").ip);
+    EXPECT_EQ(matchIPv4(tree, "6.7.8.10", &match), 0);
+    EXPECT_EQ(match.ps, 0);
+    EXPECT_EQ(matchIPv4(tree, "bogus", &match), 0);
+    EXPECT_EQ(matchIPv4Address(tree, read_ipv4("1.2.3.15"), nullptr), 1);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, MatchIPv6ReturnsEntry)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
+    ipv6_t match;
+    char s[IPSTRLENV6];
+
+    EXPECT_EQ(matchIPv6(tree, "3:4:5:6:7:8:9:ffff", &match), 1);
+    ipv6tostring(s, match);
+    EXPECT_STREQ(s, "3:4:5:6:7:8:9:0/112");
+    EXPECT_EQ(matchIPv6(tree, "4:5:6:7:8:9:a:a", &match), 1);
+    EXPECT_EQ(match.ps, 127);
+    EXPECT_EQ(matchIPv6(tree, "4:5:6:7:8:9:a:c", &match), 0);
+    EXPECT_EQ(match.ps, 0);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, IterateEmptyTree)
+{
+    bnode_t *tree = createNode();
+    btreeiter_t it;
+    ipv4_t ip;
+
+    initIPv4Iterator(&it, tree);
+    EXPECT_EQ(nextIPv4(&it, &ip), 0);
+    EXPECT_EQ(nextIPv4(&it, &ip), 0);
+    EXPECT_EQ(countIPv4Tree(tree), 0);
+    initIPv4Iterator(&it, nullptr);
+    EXPECT_EQ(nextIPv4(&it, &ip), 0);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, IterateIPv4InOrder)
+{
+    bnode_t *tree = createNode();
+    const char *const entries[] = {"9.9.9.9", "1.2.3.0/24", "1.2.4.5", "200.0.0.0/8", "1.2.3.7", "0.0.0.1"};
+    const char *const expected[] = {"0.0.0.1", "1.2.3.0/24", "1.2.4.5", "9.9.9.9", "200.0.0.0/8"};
+    btreeiter_t it;
+    ipv4_t ips[8];
+    char s[IPSTRLENV4];
+
+    for (const char *entry : entries)
+    {
+        insertIPv4(tree, entry);
+    }
+    initIPv4Iterator(&it, tree);
+    EXPECT_EQ(nextIPv4Batch(&it, ips, 2), 2);
+    EXPECT_EQ(nextIPv4Batch(&it, ips + 2, 8), 3);
+    EXPECT_EQ(nextIPv4Batch(&it, ips, 8), 0);
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        ipv4tostring(s, ips[i]);
+        EXPECT_STREQ(s, expected[i]);
+    }
+
+    // Restart from the beginning.
+    resetIterator(&it);
+    EXPECT_EQ(nextIPv4Batch(&it, ips, 8), 5);
+
+    // Seek into a range, between entries and past the end.
+    seekIPv4Iterator(&it, read_ipv4("1.2.3.200"));
+    EXPECT_EQ(nextIPv4(&it, ips), 1);
+    ipv4tostring(s, ips[0]);
+    EXPECT_STREQ(s, "1.2.3.0/24");
+    seekIPv4Iterator(&it, read_ipv4("1.2.4.6"));
+    EXPECT_EQ(nextIPv4(&it, ips), 1);
+    ipv4tostring(s, ips[0]);
+    EXPECT_STREQ(s, "9.9.9.9");
+    seekIPv4Iterator(&it, read_ipv4("0.0.0.0"));
+    EXPECT_EQ(nextIPv4(&it, ips), 1);
+    ipv4tostring(s, ips[0]);
+    EXPECT_STREQ(s, "0.0.0.1");
+    seekIPv4Iterator(&it, read_ipv4("201.0.0.0"));
+    EXPECT_EQ(nextIPv4(&it, ips), 0);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, IterateIPv6MatchesCount)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+    btreeiter_t it;
+    ipv6_t previous;
+    ipv6_t ip;
+    uint32_t count = 0;
+
+    initIPv6Iterator(&it, tree);
+    while (nextIPv6(&it, &ip))
+    {
+        EXPECT_EQ(findIPv6Address(tree, ip), 1);
+        if (count > 0)
+        {
+            EXPECT_TRUE(std::lexicographical_compare(previous.ip, previous.ip + 8, ip.ip, ip.ip + 8));
+        }
+        previous = ip;
+        count++;
+    }
+    EXPECT_EQ(count, countIPv6Tree(tree));
+    EXPECT_GT(count, 1800);
+
+    // Seeking to an entry returns that entry.
+    seekIPv6Iterator(&it, previous);
+    EXPECT_EQ(nextIPv6(&it, &ip), 1);
+    EXPECT_EQ(memcmp(ip.ip, previous.ip, sizeof(ip.ip)), 0);
+    EXPECT_EQ(ip.ps, previous.ps);
+    EXPECT_EQ(nextIPv6(&it, &ip), 0);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, FindIPv4Overlaps)
+{
+    bnode_t *tree = createNode();
+    const char *const entries[] = {"1.2.3.4", "1.2.3.128/25", "1.2.200.0/24", "1.3.0.1", "1.1.255.255", "10.0.0.0/8"};
+    ipv4_t matches[8];
+    double covered;
+    char s[IPSTRLENV4];
+
+    for (const char *entry : entries)
+    {
+        insertIPv4(tree, entry);
+    }
+    EXPECT_EQ(findIPv4Overlaps(tree, read_ipv4("1.2.0.0/16"), matches, 8, &covered), 3);
+    EXPECT_EQ(covered, 1 + 128 + 256);
+    ipv4tostring(s, matches[0]);
+    EXPECT_STREQ(s, "1.2.3.4");
+    ipv4tostring(s, matches[2]);
+    EXPECT_STREQ(s, "1.2.200.0/24");
+
+    // Only max entries are stored, but all are counted.
+    EXPECT_EQ(findIPv4Overlaps(tree, read_ipv4("1.2.3.77/16"), matches, 1, &covered), 3);
+    EXPECT_EQ(covered, 385);
+
+    // A wider entry that contains the range covers all of it.
+    EXPECT_EQ(findIPv4Overlaps(tree, read_ipv4("10.1.2.0/24"), matches, 8, &covered), 1);
+    EXPECT_EQ(covered, 256);
+    EXPECT_EQ(matches[0].ps, 8);
+
+    EXPECT_EQ(findIPv4Overlaps(tree, read_ipv4("1.2.3.5"), matches, 8, &covered), 0);
+    EXPECT_EQ(covered, 0);
+    EXPECT_EQ(findIPv4Overlaps(tree, read_ipv4("bogus"), matches, 8, &covered), 0);
+    EXPECT_EQ(findIPv4Overlaps(tree, read_ipv4("128.0.0.0/1"), NULL, 0, NULL), 0);
+    EXPECT_EQ(findIPv4Overlaps(tree, read_ipv4("0.0.0.0/1"), NULL, 0, &covered), 6);
+    EXPECT_EQ(covered, 1 + 128 + 256 + 1 + 1 + 16777216);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, FindIPv6Overlaps)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
+    ipv6_t matches[8];
+    double covered;
+    char s[IPSTRLENV6];
+
+    EXPECT_EQ(findIPv6Overlaps(tree, read_ipv6("::/8"), matches, 8, &covered), 4);
+    EXPECT_EQ(covered, 16 + 256 + 65536 + 2);
+    ipv6tostring(s, matches[3]);
+    EXPECT_STREQ(s, "4:5:6:7:8:9:a:a/127");
+    EXPECT_EQ(findIPv6Overlaps(tree, read_ipv6("3:4:5:6:7:8:9:0/120"), matches, 8, &covered), 1);
+    EXPECT_EQ(covered, 256);
+    EXPECT_EQ(findIPv6Overlaps(tree, read_ipv6("2:3:4:5:6:7:8:100/120"), matches, 8, &covered), 0);
+    EXPECT_EQ(findIPv6Overlaps(tree, read_ipv6("8000::/1"), matches, 8, &covered), 0);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, InsertStartEndRanges)
+{
+    bnode_t *tree = createNode();
+
+    EXPECT_EQ(insertIPv4(tree, "1.2.3.4-1.2.5.200"), 0);
+    EXPECT_EQ(insertIPv4(tree, "1.2.4.0-1.2.4.255"), 1);
+    EXPECT_EQ(insertIPv4(tree, "1.2.5.200-1.2.5.201"), 0);
+    EXPECT_EQ(insertIPv4(tree, "1.2.3.9-1.2.3.4"), 2);
+    EXPECT_EQ(insertIPv4Entry(tree, "8.8.8.8-8.8.8.9 junk", 15), 0);
+    EXPECT_EQ(findIPv4(tree, "1.2.3.3"), 0);
+    EXPECT_EQ(findIPv4(tree, "1.2.3.4"), 1);
+    EXPECT_EQ(findIPv4(tree, "1.2.4.77"), 1);
+    EXPECT_EQ(findIPv4(tree, "1.2.5.201"), 1);
+    EXPECT_EQ(findIPv4(tree, "1.2.5.202"), 0);
+    EXPECT_EQ(findIPv4(tree, "8.8.8.9"), 1);
+    EXPECT_EQ(countIPv4Tree(tree), 12);
+    deleteSubtree(tree);
+
+    tree = createNode();
+    EXPECT_EQ(insertIPv6(tree, "2001:db8::5-2001:db8::1:0"), 0);
+    EXPECT_EQ(findIPv6(tree, "2001:db8::4"), 0);
+    EXPECT_EQ(findIPv6(tree, "2001:db8::8000"), 1);
+    EXPECT_EQ(findIPv6(tree, "2001:db8::1:1"), 0);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, LoadStartEndRanges)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4startend.txt");
+    bnode_t *reported = createNode();
+    loadreport_t report;
+
+    EXPECT_EQ(findIPv4(tree, "1.2.4.4"), 1);
+    EXPECT_EQ(findIPv4(tree, "10.0.0.200"), 1);
+    EXPECT_EQ(findIPv4(tree, "9.9.9.9"), 0);
+    EXPECT_EQ(findIPv4(tree, "192.168.0.2"), 0);
+
+    EXPECT_EQ(loadIPv4FileWithReport(reported, TEST_DATA_DIR "ipv4startend.txt", &report), 0);
+    EXPECT_EQ(countIPv4Tree(reported), countIPv4Tree(tree));
+    EXPECT_EQ(report.lines, 5);
+    EXPECT_EQ(report.added, 2);
+    EXPECT_EQ(report.covered, 1);
+    EXPECT_EQ(report.invalid, 2);
+    deleteSubtree(tree);
+    deleteSubtree(reported);
+
+    tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6startend.txt");
+    EXPECT_EQ(findIPv6(tree, "2001:db8::ffff"), 1);
+    EXPECT_EQ(findIPv6(tree, "1::1"), 1);
+    EXPECT_EQ(findIPv6(tree, "8000::1"), 0);
+    EXPECT_EQ(countIPv6Tree(tree), 1);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, RemoveEntries)
+{
+    bnode_t *tree = createNode();
+
+    insertIPv4(tree, "1.2.3.4");
+    insertIPv4(tree, "1.2.4.0/24");
+    insertIPv4(tree, "10.0.0.0/8");
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("1.2.3.4")), 0);
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("1.2.3.4")), 1);
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("1.2.4.7")), 1);
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("1.2.0.0/16")), 1);
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("1.2.4.0/24")), 0);
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("junk")), 2);
+    EXPECT_EQ(findIPv4(tree, "1.2.3.4"), 0);
+    EXPECT_EQ(findIPv4(tree, "1.2.4.1"), 0);
+    EXPECT_EQ(findIPv4(tree, "10.1.2.3"), 1);
+    EXPECT_EQ(countIPv4Tree(tree), 1);
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("10.0.0.0/8")), 0);
+    EXPECT_EQ(tree->child[0], (bnode_t *)NULL);
+    EXPECT_EQ(tree->child[1], (bnode_t *)NULL);
+    EXPECT_EQ(countIPv4Tree(tree), 0);
+    deleteSubtree(tree);
+
+    tree = createNode();
+    insertIPv6(tree, "2001:db8::/32");
+    insertIPv6(tree, "2001:db9::1");
+    EXPECT_EQ(removeIPv6Address(tree, read_ipv6("2001:db8::1")), 1);
+    EXPECT_EQ(removeIPv6Address(tree, read_ipv6("2001:db8::/32")), 0);
+    EXPECT_EQ(findIPv6(tree, "2001:db8::1"), 0);
+    EXPECT_EQ(findIPv6(tree, "2001:db9::1"), 1);
+    deleteSubtree(tree);
+}
+
+TEST(BTreeSuite, FindLeaves)
+{
+    bnode_t *tree = createNode();
+
+    insertIPv4(tree, "10.0.0.0/8");
+    insertIPv4(tree, "1.2.3.4");
+    const bnode_t *leaf = findIPv4Leaf(tree, read_ipv4("10.1.2.3"));
+    ASSERT_NE(leaf, (const bnode_t *)NULL);
+    EXPECT_EQ(leaf, leaf->child[0]);
+    EXPECT_EQ(findIPv4Leaf(tree, read_ipv4("10.200.0.1")), leaf);
+    EXPECT_NE(findIPv4Leaf(tree, read_ipv4("1.2.3.4")), leaf);
+    EXPECT_EQ(findIPv4Leaf(tree, read_ipv4("1.2.3.5")), (const bnode_t *)NULL);
+    EXPECT_EQ(findIPv4Leaf(tree, read_ipv4("junk")), (const bnode_t *)NULL);
+    deleteSubtree(tree);
+
+    tree = createNode();
+    insertIPv6(tree, "2001:db8::/32");
+    leaf = findIPv6Leaf(tree, read_ipv6("2001:db8:1::1"));
+    ASSERT_NE(leaf, (const bnode_t *)NULL);
+    EXPECT_EQ(findIPv6Leaf(tree, read_ipv6("2001:db8::/48")), leaf);
+    EXPECT_EQ(findIPv6Leaf(tree, read_ipv6("2001::/16")), (const bnode_t *)NULL);
+    EXPECT_EQ(findIPv6Leaf(tree, read_ipv6("2001:db9::1")), (const bnode_t *)NULL);
+    deleteSubtree(tree);
+}
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+extern "C"
+{
+#include "export.h"
+}
+
+static std::string exportToString(const bnode_t *tree, uint8_t family, uint8_t format)
+{
+    char *data;
+    size_t length;
+
+    EXPECT_EQ(exportTreeToMemory(tree, family, format, &data, &length), 0);
+    std::string result(data, length);
+    free(data);
+    return result;
+}
+
+TEST(ExportSuite, EmptyTree)
+{
+    bnode_t *tree = createNode();
+    EXPECT_EQ(exportToString(tree, 4, EXPORT_TEXT), "");
+    EXPECT_EQ(exportToString(tree, 6, EXPORT_BINARY), "");
+    EXPECT_EQ(exportToString(tree, 6, EXPORT_CIDR), "");
+    deleteSubtree(tree);
+}
+
+TEST(ExportSuite, InvalidArguments)
+{
+    bnode_t *tree = createNode();
+    char *data;
+    size_t length;
+    EXPECT_EQ(exportTreeToMemory(tree, 5, EXPORT_TEXT, &data, &length), 2);
+    EXPECT_EQ(exportTreeToFile(tree, 4, 3, stdout), 2);
+    EXPECT_EQ(exportTreeToFd(tree, 4, EXPORT_TEXT, -1), 0);
+    insertIPv4(tree, "1.2.3.4");
+    EXPECT_EQ(exportTreeToFd(tree, 4, EXPORT_TEXT, -1), 1);
+    deleteSubtree(tree);
+}
+
+TEST(ExportSuite, TextMatchesDump)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+    std::string text = exportToString(tree, 6, EXPORT_TEXT);
+
+    testing::internal::CaptureStdout();
+    uint32_t count = dumpIPv6Tree(tree);
+    EXPECT_EQ(text, testing::internal::GetCapturedStdout());
+    EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), count);
+    deleteSubtree(tree);
+}
+
+TEST(ExportSuite, LargeTreeThroughFileAndFd)
+{
+    bnode_t *tree = createNode();
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        ipv4_t ip = {i * 2654435761U, 32};
+        insertIPv4Address(tree, ip);
+    }
+    std::string text = exportToString(tree, 4, EXPORT_TEXT);
+    char *data;
+    size_t length;
+    FILE *fp = tmpfile();
+    int fds[2];
+
+    EXPECT_GT(text.size(), 10 * EXPORT_BUFFER_SIZE);
+    EXPECT_EQ(exportTreeToFile(tree, 4, EXPORT_TEXT, fp), 0);
+    EXPECT_EQ((size_t)ftell(fp), text.size());
+    rewind(fp);
+    data = (char *)malloc(text.size());
+    EXPECT_EQ(fread(data, 1, text.size(), fp), text.size());
+    EXPECT_EQ(memcmp(data, text.data(), text.size()), 0);
+    free(data);
+    fclose(fp);
+
+    // Binary records through a pipe, read back by a forked writer.
+    ASSERT_EQ(pipe(fds), 0);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        _exit(exportTreeToFd(tree, 4, EXPORT_BINARY, fds[1]));
+    }
+    close(fds[1]);
+    std::string binary;
+    char block[4096];
+    ssize_t n;
+    while ((n = read(fds[0], block, sizeof(block))) > 0)
+    {
+        binary.append(block, (size_t)n);
+    }
+    close(fds[0]);
+    EXPECT_EQ(exportTreeToMemory(tree, 4, EXPORT_BINARY, &data, &length), 0);
+    EXPECT_EQ(binary, std::string(data, length));
+    EXPECT_EQ(length, 5 * 200000);
+    free(data);
+    deleteSubtree(tree);
+}
+
+TEST(ExportSuite, BinaryRecords)
+{
+    bnode_t *tree = createNode();
+    insertIPv4(tree, "1.2.3.4");
+    insertIPv4(tree, "10.0.0.0/8");
+    std::string binary = exportToString(tree, 4, EXPORT_BINARY);
+    EXPECT_EQ(binary, std::string("\x01\x02\x03\x04\x20\x0a\x00\x00\x00\x08", 10));
+    deleteSubtree(tree);
+
+    tree = createNode();
+    insertIPv6(tree, "2001:db8::/32");
+    binary = exportToString(tree, 6, EXPORT_BINARY);
+    EXPECT_EQ(binary, std::string("\x20\x01\x0d\xb8\0\0\0\0\0\0\0\0\0\0\0\0\x20", 17));
+    deleteSubtree(tree);
+}
+
+TEST(ExportSuite, MinimizedCIDR)
+{
+    bnode_t *tree = createNode();
+    const char *const entries[] = {"1.2.3.0/25", "1.2.3.128/26", "1.2.3.192/27", "1.2.3.224/28", "1.2.3.240/28",
+                                   "1.2.4.0", "1.2.4.2", "1.2.4.3", "1.2.5.128/25", "1.2.6.0/25", "1.2.7.0/24"};
+    for (const char *entry : entries)
+    {
+        insertIPv4(tree, entry);
+    }
+    EXPECT_EQ(exportToString(tree, 4, EXPORT_CIDR),
+              "1.2.3.0/24\n1.2.4.0\n1.2.4.2/31\n1.2.5.128/25\n1.2.6.0/25\n1.2.7.0/24\n");
+    EXPECT_EQ(countIPv4Tree(tree), 11);
+    deleteSubtree(tree);
+
+    tree = createNode();
+    insertIPv6(tree, "::/1");
+    insertIPv6(tree, "8000::/2");
+    insertIPv6(tree, "c000::/2");
+    EXPECT_EQ(exportToString(tree, 6, EXPORT_CIDR), "::/0\n");
+    deleteSubtree(tree);
+}
+
+TEST(ExportSuite, MinimizedCIDRCoversSameAddresses)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+    bnode_t *rebuilt = createNode();
+    size_t start = 0;
+    size_t end;
+
+    // Split a few entries in halves, which the export must merge again.
+    insertIPv6(tree, "abcd:1::/33");
+    insertIPv6(tree, "abcd:1:8000::/33");
+    insertIPv6(tree, "abcd:2::/64");
+    insertIPv6(tree, "abcd:2:0:1::/64");
+    insertIPv6(tree, "abcd:2:0:2::/63");
+    std::string cidr = exportToString(tree, 6, EXPORT_CIDR);
+    EXPECT_NE(cidr.find("\nabcd:1::/32\nabcd:2::/62\n"), std::string::npos);
+
+    while ((end = cidr.find('\n', start)) != std::string::npos)
+    {
+        EXPECT_EQ(insertIPv6(rebuilt, cidr.substr(start, end - start).c_str()), 0);
+        start = end + 1;
+    }
+    EXPECT_LT(countIPv6Tree(rebuilt), countIPv6Tree(tree));
+    EXPECT_EQ(exportToString(rebuilt, 6, EXPORT_CIDR), cidr);
+
+    btreeiter_t it;
+    ipv6_t ip;
+    initIPv6Iterator(&it, tree);
+    while (nextIPv6(&it, &ip))
+    {
+        EXPECT_EQ(findIPv6Address(rebuilt, ip), 1);
+    }
+    deleteSubtree(tree);
+    deleteSubtree(rebuilt);
+}
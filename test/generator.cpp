@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <set>
+#include <vector>
+
+extern "C"
+{
+#include "generator.h"
+#include "btree.h"
+}
+
+TEST(GeneratorSuite, IPv4ListIsDeterministic)
+{
+    std::vector<ipv4_t> a(1000), b(1000), c(1000);
+    generateIPv4List(a.data(), a.size(), 7);
+    generateIPv4List(b.data(), b.size(), 7);
+    generateIPv4List(c.data(), c.size(), 8);
+    EXPECT_EQ(memcmp(a.data(), b.data(), a.size() * sizeof(ipv4_t)), 0);
+    EXPECT_NE(memcmp(a.data(), c.data(), a.size() * sizeof(ipv4_t)), 0);
+}
+
+TEST(GeneratorSuite, IPv4ListDistribution)
+{
+    std::vector<ipv4_t> list(100000);
+    uint64_t hosts = 0;
+    uint64_t networks = 0;
+
+    generateIPv4List(list.data(), list.size(), 1);
+    for (const ipv4_t &entry : list)
+    {
+        uint32_t host_mask = (entry.ps == 32) ? 0 : (0xFFFFFFFFU >> entry.ps);
+        EXPECT_EQ(entry.ip & host_mask, 0);
+        EXPECT_GE(entry.ps, 16);
+        hosts += (entry.ps == 32);
+        networks += (entry.ps == 24);
+    }
+    EXPECT_NEAR((double)hosts / list.size(), 0.85, 0.01);
+    EXPECT_NEAR((double)networks / list.size(), 0.10, 0.01);
+}
+
+TEST(GeneratorSuite, IPv6ListDistribution)
+{
+    std::vector<ipv6_t> list(100000);
+    uint64_t hosts = 0;
+    uint64_t networks = 0;
+
+    generateIPv6List(list.data(), list.size(), 1);
+    for (const ipv6_t &entry : list)
+    {
+        EXPECT_EQ(entry.ip[0] & 0xE000, 0x2000);
+        if (entry.ps <= 64)
+        {
+            EXPECT_EQ(entry.ip[4] | entry.ip[5] | entry.ip[6] | entry.ip[7], 0);
+        }
+        hosts += (entry.ps == 128);
+        networks += (entry.ps == 48);
+    }
+    EXPECT_NEAR((double)hosts / list.size(), 0.80, 0.01);
+    EXPECT_NEAR((double)networks / list.size(), 0.12, 0.01);
+}
+
+TEST(GeneratorSuite, IPv4QueriesHitRate)
+{
+    std::vector<ipv4_t> list(10000);
+    std::vector<ipv4_t> queries(100000);
+    bnode_t *tree = createNode();
+    uint64_t hits = 0;
+
+    generateIPv4List(list.data(), list.size(), 3);
+    EXPECT_EQ(generateIPv4Queries(list.data(), list.size(), queries.data(), queries.size(), 0.25, 1.0, 3), 0);
+    for (const ipv4_t &entry : list)
+    {
+        insertIPv4Address(tree, entry);
+    }
+    for (const ipv4_t &query : queries)
+    {
+        EXPECT_EQ(query.ps, 32);
+        hits += findIPv4Address(tree, query);
+    }
+    EXPECT_NEAR((double)hits / queries.size(), 0.25, 0.01);
+    deleteSubtree(tree);
+}
+
+TEST(GeneratorSuite, IPv6QueriesMissOnly)
+{
+    std::vector<ipv6_t> list(10000);
+    std::vector<ipv6_t> queries(10000);
+    bnode_t *tree = createNode();
+
+    generateIPv6List(list.data(), list.size(), 5);
+    EXPECT_EQ(generateIPv6Queries(list.data(), list.size(), queries.data(), queries.size(), 0.0, 0.0, 5), 0);
+    for (const ipv6_t &entry : list)
+    {
+        insertIPv6Address(tree, entry);
+    }
+    for (const ipv6_t &query : queries)
+    {
+        EXPECT_FALSE(findIPv6Address(tree, query));
+    }
+    deleteSubtree(tree);
+}
+
+TEST(GeneratorSuite, QueriesAreSkewed)
+{
+    std::vector<ipv4_t> uniform(10000), skewed(10000);
+    std::set<uint32_t> uniform_distinct, skewed_distinct;
+
+    generateIPv4Queries(nullptr, 0, uniform.data(), uniform.size(), 0.0, 0.0, 9);
+    generateIPv4Queries(nullptr, 0, skewed.data(), skewed.size(), 0.0, 1.2, 9);
+    for (size_t i = 0; i < uniform.size(); i++)
+    {
+        uniform_distinct.insert(uniform[i].ip);
+        skewed_distinct.insert(skewed[i].ip);
+    }
+    EXPECT_GT(uniform_distinct.size(), 5000u);
+    EXPECT_LT(skewed_distinct.size(), uniform_distinct.size() / 2);
+}
+
+TEST(GeneratorSuite, NoMissesInFullList)
+{
+    ipv4_t list[2] = {read_ipv4("0.0.0.0/1"), read_ipv4("128.0.0.0/1")};
+    ipv6_t list6[2] = {read_ipv6("::/1"), read_ipv6("8000::/1")};
+    std::vector<ipv4_t> queries(100);
+    std::vector<ipv6_t> queries6(100);
+
+    EXPECT_EQ(generateIPv4Queries(list, 2, queries.data(), queries.size(), 0.5, 0.0, 1), 1);
+    EXPECT_EQ(generateIPv6Queries(list6, 2, queries6.data(), queries6.size(), 0.5, 0.0, 1), 1);
+    EXPECT_EQ(generateIPv4Queries(list, 2, queries.data(), queries.size(), 1.0, 0.0, 1), 0);
+}
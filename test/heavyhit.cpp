@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "heavyhit.h"
+}
+
+static void collectIPv4(void *context, ipv4_t prefix, uint32_t count)
+{
+    char s[IPSTRLENV4];
+
+    ipv4tostring(s, prefix);
+    ((std::vector<std::string> *)context)->push_back(std::string(s) + " " + std::to_string(count));
+}
+
+static void collectIPv6(void *context, ipv6_t prefix, uint32_t count)
+{
+    char s[IPSTRLENV6];
+
+    ipv6tostring(s, prefix);
+    ((std::vector<std::string> *)context)->push_back(std::string(s) + " " + std::to_string(count));
+}
+
+TEST(HeavyHitSuite, CreateChecksParameters)
+{
+    heavysketch_t *sketch = createHeavySketch(1000, 4, 60, 0);
+
+    ASSERT_NE(sketch, (heavysketch_t *)NULL);
+    EXPECT_EQ(sketch->width, 1024);
+    deleteHeavySketch(sketch);
+    EXPECT_EQ(createHeavySketch(0, 4, 60, 0), (heavysketch_t *)NULL);
+    EXPECT_EQ(createHeavySketch(1024, 0, 60, 0), (heavysketch_t *)NULL);
+    EXPECT_EQ(createHeavySketch(1024, 9, 60, 0), (heavysketch_t *)NULL);
+    EXPECT_EQ(createHeavySketch(1024, 4, 0, 0), (heavysketch_t *)NULL);
+}
+
+TEST(HeavyHitSuite, ReportsOncePerWindow)
+{
+    heavysketch_t *sketch = createHeavySketch(4096, 4, 10, 100);
+    std::vector<std::string> reports;
+    uint8_t crossed = 0;
+
+    setHeavyThresholds(sketch, 5, 8);
+    setHeavyCallbacks(sketch, collectIPv4, collectIPv6, &reports);
+    for (int i = 0; i < 20; i++)
+    {
+        crossed |= observeIPv4(sketch, read_ipv4("1.2.3.4"), 100);
+    }
+    EXPECT_EQ(crossed, 3);
+    EXPECT_EQ(estimateIPv4(sketch, read_ipv4("1.2.3.4")), 20);
+    EXPECT_EQ(estimateIPv4(sketch, read_ipv4("1.2.3.0/24")), 20);
+    EXPECT_EQ(estimateIPv4(sketch, read_ipv4("1.2.3.0/16")), 0);
+    EXPECT_EQ(observeIPv4(sketch, read_ipv4("1.2.3.0/24"), 100), 0);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[0], "1.2.3.4 5");
+    EXPECT_EQ(reports[1], "1.2.3.0/24 8");
+
+    // A new window starts from 0.
+    reports.clear();
+    EXPECT_EQ(observeIPv4(sketch, read_ipv4("1.2.3.4"), 110), 0);
+    EXPECT_EQ(estimateIPv4(sketch, read_ipv4("1.2.3.4")), 1);
+    for (int i = 0; i < 4; i++)
+    {
+        observeIPv4(sketch, read_ipv4("1.2.3.4"), 115);
+    }
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0], "1.2.3.4 5");
+    deleteHeavySketch(sketch);
+}
+
+TEST(HeavyHitSuite, CollisionsPastThreshold)
+{
+    // 16 counters in one row: most hosts start out above the threshold.
+    heavysketch_t *sketch = createHeavySketch(16, 1, 60, 0);
+    std::vector<std::string> reports;
+
+    setHeavyThresholds(sketch, 10, 0);
+    setHeavyCallbacks(sketch, collectIPv4, collectIPv6, &reports);
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        ipv4_t ip = {0x0A000000U + i * 256, 32};
+        observeIPv4(sketch, ip, 1);
+    }
+    EXPECT_GT(reports.size(), 16u);
+    EXPECT_EQ(std::set<std::string>(reports.begin(), reports.end()).size(), reports.size());
+    for (const std::string &report : reports)
+    {
+        ipv4_t ip = read_ipv4(report.substr(0, report.find(' ')).c_str());
+        EXPECT_EQ(observeIPv4(sketch, ip, 2), 0) << report;
+    }
+    deleteHeavySketch(sketch);
+}
+
+TEST(HeavyHitSuite, NetworksFromManyHosts)
+{
+    heavysketch_t *sketch = createHeavySketch(4096, 4, 60, 0);
+    std::vector<std::string> reports;
+
+    setHeavyThresholds(sketch, 100, 50);
+    setHeavyCallbacks(sketch, collectIPv4, collectIPv6, &reports);
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        ipv4_t ip = {0xC0A80100U + i, 32};
+        ipv6_t ip6 = read_ipv6("2001:db8:1:2::");
+        ip6.ip[7] = (uint16_t)i;
+        observeIPv4(sketch, ip, 1);
+        observeIPv6(sketch, ip6, 1);
+    }
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[0], "192.168.1.0/24 50");
+    EXPECT_EQ(reports[1], "2001:db8:1:2::/64 50");
+    EXPECT_EQ(estimateIPv6(sketch, read_ipv6("2001:db8:1:2::7")), 1);
+    EXPECT_EQ(estimateIPv6(sketch, read_ipv6("2001:db8:1:2:ffff::/64")), 50);
+    deleteHeavySketch(sketch);
+}
+
+TEST(HeavyHitSuite, InsertsIntoTarget)
+{
+    heavysketch_t *sketch = createHeavySketch(1 << 16, 4, 60, 0);
+    bnode_t *ipv4_target = createNode();
+    bnode_t *ipv6_target = createNode();
+
+    setHeavyThresholds(sketch, 100, 0);
+    setHeavyTargets(sketch, ipv4_target, ipv6_target);
+
+    // Background traffic from many sources stays below the threshold.
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        ipv4_t ip = {(i * 2654435761U) | 1, 32};
+        observeIPv4(sketch, ip, 5);
+        if (i % 2000 == 0)
+        {
+            observeIPv4(sketch, read_ipv4("6.6.6.6"), 5);
+            observeIPv6(sketch, read_ipv6("2001:db8::6"), 5);
+        }
+    }
+    EXPECT_EQ(findIPv4(ipv4_target, "6.6.6.6"), 0);
+    for (int i = 0; i < 50; i++)
+    {
+        observeIPv4(sketch, read_ipv4("6.6.6.6"), 6);
+    }
+    EXPECT_EQ(findIPv4(ipv4_target, "6.6.6.6"), 1);
+    EXPECT_EQ(countIPv4Tree(ipv4_target), 1);
+    EXPECT_EQ(countIPv6Tree(ipv6_target), 0);
+    EXPECT_EQ(observeIPv6(sketch, read_ipv6("2001:db8::6"), 6), 0);
+    deleteHeavySketch(sketch);
+    deleteSubtree(ipv4_target);
+    deleteSubtree(ipv6_target);
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include "hitcount.h"
+}
+
+TEST(HitCountSuite, CountsPerEntry)
+{
+    bnode_t *tree = createNode();
+    hitcounter_t *counter;
+
+    insertIPv4(tree, "10.0.0.0/8");
+    insertIPv4(tree, "1.2.3.4");
+    insertIPv4(tree, "192.168.1.0/24");
+    counter = createHitCounter(tree, 4, 2);
+    ASSERT_NE(counter, (hitcounter_t *)NULL);
+    EXPECT_EQ(counter->entry_count, 3);
+
+    // IDs follow address order.
+    EXPECT_EQ(getIPv4HitId(counter, read_ipv4("1.2.3.4")), 0);
+    EXPECT_EQ(getIPv4HitId(counter, read_ipv4("10.20.30.40")), 1);
+    EXPECT_EQ(getIPv4HitId(counter, read_ipv4("192.168.1.77")), 2);
+    EXPECT_EQ(getIPv4HitId(counter, read_ipv4("192.168.2.1")), HIT_NO_ID);
+
+    for (int i = 0; i < 5; i++)
+    {
+        EXPECT_EQ(findIPv4Counted(counter, 0, read_ipv4("10.1.1.1")), 1);
+    }
+    EXPECT_EQ(findIPv4Counted(counter, 1, read_ipv4("10.9.9.9")), 1);
+    EXPECT_EQ(findIPv4Counted(counter, 1, read_ipv4("192.168.1.1")), 1);
+    EXPECT_EQ(findIPv4Counted(counter, 1, read_ipv4("8.8.8.8")), 0);
+    EXPECT_EQ(findIPv4Counted(counter, 0, read_ipv4("junk")), 0);
+    EXPECT_EQ(getHitCount(counter, 0), 0);
+    EXPECT_EQ(getHitCount(counter, 1), 6);
+    EXPECT_EQ(getHitCount(counter, 2), 1);
+    EXPECT_EQ(getHitCount(counter, 3), 0);
+
+    ipv4_t prefix = getHitIPv4Prefix(counter, 1);
+    EXPECT_EQ(prefix.ip, 0x0A000000U);
+    EXPECT_EQ(prefix.ps, 8);
+
+    resetHitCounts(counter);
+    EXPECT_EQ(getHitCount(counter, 1), 0);
+    deleteHitCounter(counter);
+    deleteSubtree(tree);
+
+    EXPECT_EQ(createHitCounter(tree, 5, 1), (hitcounter_t *)NULL);
+    EXPECT_EQ(createHitCounter(tree, 4, 0), (hitcounter_t *)NULL);
+}
+
+TEST(HitCountSuite, TopHits)
+{
+    bnode_t *tree = createNode();
+    hitcounter_t *counter;
+    hitentry_t top[3];
+    char *text = NULL;
+    size_t size = 0;
+    FILE *stream;
+
+    insertIPv6(tree, "2001:db8::/32");
+    insertIPv6(tree, "2001:db9::1");
+    insertIPv6(tree, "2001:dba::/48");
+    insertIPv6(tree, "::1");
+    counter = createHitCounter(tree, 6, 1);
+    for (int i = 0; i < 3; i++)
+    {
+        findIPv6Counted(counter, 0, read_ipv6("2001:db9::1"));
+        findIPv6Counted(counter, 0, read_ipv6("2001:dba::5"));
+    }
+    findIPv6Counted(counter, 0, read_ipv6("2001:db8::5"));
+    findIPv6Counted(counter, 0, read_ipv6("2001:dba::7"));
+
+    EXPECT_EQ(getTopHits(counter, top, 3), 3);
+    EXPECT_EQ(top[0].hits, 4);
+    EXPECT_EQ(top[1].hits, 3);
+    EXPECT_EQ(top[2].hits, 1);
+    EXPECT_EQ(top[0].id, getIPv6HitId(counter, read_ipv6("2001:dba::")));
+    EXPECT_EQ(top[2].id, getIPv6HitId(counter, read_ipv6("2001:db8::")));
+    EXPECT_EQ(getTopHits(counter, top, 0), 0);
+
+    stream = open_memstream(&text, &size);
+    EXPECT_EQ(printTopHits(stream, counter, 2), 2);
+    fclose(stream);
+    EXPECT_STREQ(text, "2001:dba::/48 4\n2001:db9::1 3\n");
+    free(text);
+
+    deleteHitCounter(counter);
+    deleteSubtree(tree);
+}
+
+TEST(HitCountSuite, ShardsPerThread)
+{
+    bnode_t *tree = createNode();
+    hitcounter_t *counter;
+    std::vector<std::thread> threads;
+    const uint16_t shards = 4;
+    const uint32_t lookups = 100000;
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        ipv4_t ip = {0x0A000000U + (i << 8), 24};
+        insertIPv4Address(tree, ip);
+    }
+    counter = createHitCounter(tree, 4, shards);
+    for (uint16_t s = 0; s < shards; s++)
+    {
+        threads.emplace_back([counter, s, lookups]()
+                             {
+            for (uint32_t i = 0; i < lookups; i++)
+            {
+                ipv4_t ip = {0x0A000000U + ((i % 256) << 8) + 1, 32};
+                findIPv4Counted(counter, s, ip);
+            } });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    uint64_t total = 0;
+    for (uint32_t id = 0; id < counter->entry_count; id++)
+    {
+        total += getHitCount(counter, id);
+    }
+    EXPECT_EQ(total, (uint64_t)shards * lookups);
+    EXPECT_EQ(getHitCount(counter, 0), (uint64_t)shards * ((lookups + 255) / 256));
+    deleteHitCounter(counter);
+    deleteSubtree(tree);
+}
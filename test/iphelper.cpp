@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <arpa/inet.h>
+#include <cstring>
+#include <string>
 
 extern "C"
 {
@@ -185,3 +187,156 @@ TEST(IPHelperSuite, AppendPrefixSizeToNonIPString)
     append_prefix_size(s, 100, 128);
     EXPECT_STREQ(s, "non-ip-string/100");
 }
+
+TEST(IPHelperSuite, FormatIPv4MatchesToString)
+{
+    const char *const addresses[] = {"0.0.0.0/1", "1.2.3.4", "10.0.0.0/8", "255.255.255.255", "100.20.3.0/24", "99.199.9.1/31"};
+    char expected[IPSTRLENV4];
+    char s[IPSTRLENV4];
+
+    for (const char *address : addresses)
+    {
+        ipv4_t ip = read_ipv4(address);
+        ipv4tostring(expected, ip);
+        EXPECT_EQ(format_ipv4(s, ip), strlen(expected));
+        EXPECT_STREQ(s, expected);
+    }
+    srand(42);
+    for (int i = 0; i < 10000; i++)
+    {
+        ipv4_t ip;
+        ip.ip = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        ip.ps = (uint8_t)(1 + rand() % 32);
+        ipv4tostring(expected, ip);
+        format_ipv4(s, ip);
+        EXPECT_STREQ(s, expected);
+    }
+}
+
+TEST(IPHelperSuite, FormatIPv6MatchesToString)
+{
+    const char *const addresses[] = {"::/1", "::1", "1::", "2001:db8::/32", "1:0:0:2:0:0:0:3", "1:0:0:2:0:0:3:4",
+                                     "0:0:1:2:3:4:5:6", "1:2:3:4:5:6:7:0", "1:0:2:0:3:0:4:0", "::ffff:1.2.3.4",
+                                     "::1.2.3.4", "::ffff:0:1.2.3.4", "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff", "abcd:ef01::/127"};
+    char expected[IPSTRLENV6];
+    char s[IPSTRLENV6];
+
+    for (const char *address : addresses)
+    {
+        ipv6_t ip = read_ipv6(address);
+        ASSERT_GT(ip.ps, 0) << address;
+        ipv6tostring(expected, ip);
+        EXPECT_EQ(format_ipv6(s, ip), strlen(expected));
+        EXPECT_STREQ(s, expected);
+    }
+    srand(42);
+    for (int i = 0; i < 10000; i++)
+    {
+        ipv6_t ip;
+        for (uint8_t g = 0; g < 8; g++)
+        {
+            // Plenty of zero groups, to exercise the compression.
+            ip.ip[g] = (rand() % 3) ? 0 : (uint16_t)(rand() >> (rand() % 16));
+        }
+        ip.ps = (uint8_t)(1 + rand() % 128);
+        ipv6tostring(expected, ip);
+        format_ipv6(s, ip);
+        EXPECT_STREQ(s, expected);
+    }
+}
+
+TEST(IPHelperSuite, ReadIPv4Range)
+{
+    const char *range = "1.2.3.4-1.2.5.200 trailing";
+    uint32_t first;
+    uint32_t last;
+
+    EXPECT_EQ(read_ipv4_range_n(range, 17, &first, &last), 1);
+    EXPECT_EQ(first, read_ipv4("1.2.3.4").ip);
+    EXPECT_EQ(last, read_ipv4("1.2.5.200").ip);
+    EXPECT_EQ(read_ipv4_range_n("1.2.3.4-1.2.3.4", 15, &first, &last), 1);
+    EXPECT_EQ(read_ipv4_range_n("1.2.3.5-1.2.3.4", 15, &first, &last), 0);
+    EXPECT_EQ(read_ipv4_range_n("1.2.3.0/24-1.2.4.0", 18, &first, &last), 0);
+    EXPECT_EQ(read_ipv4_range_n("1.2.3.4 - 1.2.3.5", 17, &first, &last), 0);
+    EXPECT_EQ(read_ipv4_range_n("1.2.3.4", 7, &first, &last), 0);
+}
+
+TEST(IPHelperSuite, IPv4RangeToPrefixes)
+{
+    ipv4_t prefixes[IPV4_RANGE_MAX_PREFIXES];
+    char s[IPSTRLENV4];
+    std::string joined;
+
+    uint8_t count = ipv4_range_to_prefixes(read_ipv4("1.2.3.4").ip, read_ipv4("1.2.5.200").ip, prefixes);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        ipv4tostring(s, prefixes[i]);
+        joined += std::string(i ? " " : "") + s;
+    }
+    EXPECT_EQ(joined, "1.2.3.4/30 1.2.3.8/29 1.2.3.16/28 1.2.3.32/27 1.2.3.64/26 1.2.3.128/25 1.2.4.0/24 "
+                      "1.2.5.0/25 1.2.5.128/26 1.2.5.192/29 1.2.5.200");
+
+    EXPECT_EQ(ipv4_range_to_prefixes(0, UINT32_MAX, prefixes), 2);
+    EXPECT_EQ(prefixes[1].ip, 0x80000000U);
+    EXPECT_EQ(prefixes[1].ps, 1);
+    EXPECT_EQ(ipv4_range_to_prefixes(1, UINT32_MAX - 1, prefixes), IPV4_RANGE_MAX_PREFIXES);
+    EXPECT_EQ(ipv4_range_to_prefixes(UINT32_MAX, UINT32_MAX, prefixes), 1);
+    EXPECT_EQ(prefixes[0].ps, 32);
+    EXPECT_EQ(ipv4_range_to_prefixes(5, 4, prefixes), 0);
+}
+
+TEST(IPHelperSuite, IPv6RangeToPrefixes)
+{
+    ipv6_t prefixes[IPV6_RANGE_MAX_PREFIXES];
+    uint16_t first[8];
+    uint16_t last[8];
+    char s[IPSTRLENV6];
+    std::string joined;
+    const char *range = "2001:db8::5-2001:db8::1:0";
+
+    ASSERT_EQ(read_ipv6_range_n(range, strlen(range), first, last), 1);
+    uint8_t count = ipv6_range_to_prefixes(first, last, prefixes);
+    EXPECT_EQ(count, 16);
+    ipv6tostring(s, prefixes[0]);
+    EXPECT_STREQ(s, "2001:db8::5");
+    ipv6tostring(s, prefixes[1]);
+    EXPECT_STREQ(s, "2001:db8::6/127");
+    ipv6tostring(s, prefixes[15]);
+    EXPECT_STREQ(s, "2001:db8::1:0");
+
+    range = "::-ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff";
+    ASSERT_EQ(read_ipv6_range_n(range, strlen(range), first, last), 1);
+    EXPECT_EQ(ipv6_range_to_prefixes(first, last, prefixes), 2);
+    EXPECT_EQ(prefixes[1].ip[0], 0x8000);
+    EXPECT_EQ(prefixes[1].ps, 1);
+
+    range = "::1-ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe";
+    ASSERT_EQ(read_ipv6_range_n(range, strlen(range), first, last), 1);
+    EXPECT_EQ(ipv6_range_to_prefixes(first, last, prefixes), IPV6_RANGE_MAX_PREFIXES);
+
+    range = "::1:0-::ffff";
+    EXPECT_EQ(read_ipv6_range_n(range, strlen(range), first, last), 0);
+}
+
+TEST(IPHelperSuite, MaskPrefixes)
+{
+    char s[IPSTRLENV6];
+
+    EXPECT_EQ(ipv4_netmask(0), 0u);
+    EXPECT_EQ(ipv4_netmask(20), 0xFFFFF000u);
+    EXPECT_EQ(ipv4_netmask(32), 0xFFFFFFFFu);
+    ipv4tostring(s, mask_ipv4(read_ipv4("1.2.3.4"), 22));
+    EXPECT_STREQ(s, "1.2.0.0/22");
+
+    EXPECT_EQ(ipv6_group_mask(20, 0), 0xFFFF);
+    EXPECT_EQ(ipv6_group_mask(20, 1), 0xF000);
+    EXPECT_EQ(ipv6_group_mask(20, 2), 0);
+    EXPECT_EQ(ipv6_group_mask(128, 7), 0xFFFF);
+    ipv6tostring(s, mask_ipv6(read_ipv6("2001:db8:abcd::1"), 36));
+    EXPECT_STREQ(s, "2001:db8:a000::/36");
+
+    uint16_t groups[2] = {0x8000, 0x0001};
+    EXPECT_EQ(group_bit(groups, 0), 1);
+    EXPECT_EQ(group_bit(groups, 1), 0);
+    EXPECT_EQ(group_bit(groups, 31), 1);
+}
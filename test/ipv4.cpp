@@ -188,3 +188,31 @@ TEST(IPv4Suite, IPv4ToStringPrefix32)
     ipv4tostring(t, ip);
     EXPECT_STREQ(t, "111.222.111.222");
 }
+
+TEST(IPv4Suite, ReadIPv4WithLengthMatchesReadIPv4)
+{
+    const char *strings[] = {"1.2.3.4", "100.200.100.200/24", "100.200.100.300/24", "100.200.100",
+                             "100.200.100.200.100", "100.200.100.200/40", "100.200.100.200/", "100.200.100.200/0",
+                             ".200.100.200", "100..100.200", "100.200.100./24", "a.200.100.200", "100:200:100:200",
+                             "100.0200.100.200", "100.0.1.200", "100.200.100.200/4-", "0.0.0.0", "255.255.255.255/32",
+                             "1.2.3.4/1", "00.1.2.3", "1.2.3.4 ", ""};
+
+    for (const char *s : strings)
+    {
+        ipv4_t expected = read_ipv4(s);
+        ipv4_t ip = read_ipv4_n(s, strlen(s));
+        EXPECT_EQ(ip.ip, expected.ip) << s;
+        EXPECT_EQ(ip.ps, expected.ps) << s;
+    }
+}
+
+TEST(IPv4Suite, ReadIPv4WithLengthStopsAtLength)
+{
+    ipv4_t ip = read_ipv4_n("1.2.3.45 trailing", 7);
+    EXPECT_EQ(ip.ip, 16909060);
+    EXPECT_EQ(ip.ps, 32);
+
+    ip = read_ipv4_n("1.2.3.4/245", 10);
+    EXPECT_EQ(ip.ip, 16909060);
+    EXPECT_EQ(ip.ps, 24);
+}
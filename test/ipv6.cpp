@@ -399,3 +399,17 @@ TEST(IPv6Suite, InvalidIPv6TripleColon)
     EXPECT_EQ(ip.ip[7], 0);
     EXPECT_EQ(ip.ps, 0);
 }
+
+TEST(IPv6Suite, ReadIPv6WithLength)
+{
+    ipv6_t ip = read_ipv6_n("1:2:3:4:5:6:7:8/120 trailing", 19);
+    EXPECT_EQ(ip.ip[0], 1);
+    EXPECT_EQ(ip.ip[7], 8);
+    EXPECT_EQ(ip.ps, 120);
+
+    ip = read_ipv6_n("1:2:3:4:5:6:7:8/120", 18);
+    EXPECT_EQ(ip.ps, 12);
+
+    ip = read_ipv6_n("1:2:3:4:5:6:7:8:9:10:11:12:13:14:15:16:17:18:19:20", 50);
+    EXPECT_EQ(ip.ps, 0);
+}
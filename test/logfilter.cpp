@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+
+extern "C"
+{
+#include "logfilter.h"
+}
+
+TEST(LogFilterSuite, FindFirstField)
+{
+    const char line[] = "1.2.3.4 - - [10/Oct/2025:13:55:36 +0200] \"GET / HTTP/1.1\" 200 2326";
+    size_t length;
+    const char *field = findLogField(line, strlen(line), ' ', 0, &length);
+    EXPECT_EQ(field, line);
+    EXPECT_EQ(length, 7);
+}
+
+TEST(LogFilterSuite, FindLaterFields)
+{
+    std::string line = "a;bb;;" + std::string(40, 'x') + ";1.2.3.4;" + std::string(20, ';') + "last";
+    size_t length;
+    const char *field;
+
+    field = findLogField(line.c_str(), line.size(), ';', 1, &length);
+    EXPECT_EQ(std::string(field, length), "bb");
+    field = findLogField(line.c_str(), line.size(), ';', 2, &length);
+    EXPECT_EQ(length, 0);
+    field = findLogField(line.c_str(), line.size(), ';', 4, &length);
+    EXPECT_EQ(std::string(field, length), "1.2.3.4");
+    field = findLogField(line.c_str(), line.size(), ';', 25, &length);
+    EXPECT_EQ(std::string(field, length), "last");
+    EXPECT_TRUE(findLogField(line.c_str(), line.size(), ';', 26, &length) == nullptr);
+}
+
+TEST(LogFilterSuite, FieldDoesNotReadPastLength)
+{
+    const char line[] = "1.2.3.4 5.6.7.8";
+    size_t length;
+    const char *field = findLogField(line, 7, ' ', 0, &length);
+    EXPECT_EQ(length, 7);
+    EXPECT_TRUE(findLogField(line, 7, ' ', 1, &length) == nullptr);
+    (void)field;
+}
+
+TEST(LogFilterSuite, FilterCombinedLog)
+{
+    const char log[] =
+        "1.2.3.4 - - [10/Oct/2025:13:55:36 +0200] \"GET / HTTP/1.1\" 200 2326 \"-\" \"curl\"\n"
+        "1.2.3.5 - - [10/Oct/2025:13:55:37 +0200] \"GET / HTTP/1.1\" 200 2326 \"-\" \"curl\"\r\n"
+        "1:2:3:4:5:6:7:8 - - [10/Oct/2025:13:55:38 +0200] \"GET /a HTTP/1.1\" 404 0 \"-\" \"curl\"\n"
+        "garbage\n"
+        "\n"
+        "10.20.30.40 - - [10/Oct/2025:13:55:39 +0200] \"GET /b HTTP/1.1\" 200 12 \"-\" \"curl\"";
+    bnode_t *ipv4_root = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt");
+    bnode_t *ipv6_root = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6list.txt");
+    char *output;
+    size_t output_size;
+    FILE *out = open_memstream(&output, &output_size);
+
+    EXPECT_EQ(filterAccessLog(ipv4_root, ipv6_root, log, strlen(log), LOG_DELIMITER_CLF, LOG_FIELD_CLF, out), 3);
+    fclose(out);
+    EXPECT_STREQ(output,
+                 "1.2.3.4 - - [10/Oct/2025:13:55:36 +0200] \"GET / HTTP/1.1\" 200 2326 \"-\" \"curl\"\n"
+                 "1:2:3:4:5:6:7:8 - - [10/Oct/2025:13:55:38 +0200] \"GET /a HTTP/1.1\" 404 0 \"-\" \"curl\"\n"
+                 "10.20.30.40 - - [10/Oct/2025:13:55:39 +0200] \"GET /b HTTP/1.1\" 200 12 \"-\" \"curl\"\n");
+    free(output);
+}
+
+TEST(LogFilterSuite, FilterLogFileWithoutIPv6Tree)
+{
+    bnode_t *ipv4_root = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    EXPECT_EQ(filterAccessLogFile(ipv4_root, nullptr, TEST_DATA_DIR "ipv4list.txt", ' ', 0, nullptr), 3);
+    EXPECT_EQ(filterAccessLogFile(ipv4_root, nullptr, TEST_DATA_DIR "non-existent.txt", ' ', 0, nullptr), 0);
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C"
+{
+#include "lookupcache.h"
+}
+
+TEST(LookupCacheSuite, CachesResults)
+{
+    bnode_t *tree = createNode();
+    lookupcache_t *cache;
+
+    insertIPv4(tree, "10.0.0.0/8");
+    cache = createLookupCache(tree, NULL, 1000);
+    ASSERT_NE(cache, (lookupcache_t *)NULL);
+    EXPECT_EQ(cache->set_count, 1024);
+
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("10.1.2.3")), 1);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("11.1.2.3")), 0);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("10.1.2.3")), 1);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("11.1.2.3")), 0);
+    EXPECT_EQ(cache->misses, 2);
+    EXPECT_EQ(cache->hits, 2);
+
+    // Ranges and invalid addresses go to the tree.
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("10.1.0.0/16")), 1);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("junk")), 0);
+    EXPECT_EQ(cache->misses + cache->hits, 4);
+
+    // Without an IPv6 tree nothing is found.
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("::1")), 0);
+
+    deleteLookupCache(cache);
+    deleteSubtree(tree);
+    EXPECT_EQ(createLookupCache(NULL, NULL, 0), (lookupcache_t *)NULL);
+}
+
+TEST(LookupCacheSuite, TreeChangesInvalidate)
+{
+    bnode_t *tree = createNode();
+    bnode_t *tree6 = createNode();
+    bnode_t *other = createNode();
+    lookupcache_t *cache = createLookupCache(tree, tree6, 64);
+    const uint64_t *watch = watchTree(tree);
+    uint64_t generation = getTreeGeneration(watch);
+
+    EXPECT_EQ(watch, cache->ipv4_watch);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("1.2.3.4")), 0);
+    EXPECT_EQ(insertIPv4(tree, "1.2.3.0/24"), 0);
+    EXPECT_GT(getTreeGeneration(watch), generation);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("1.2.3.4")), 1);
+
+    // An insert that changes nothing keeps the cache.
+    generation = getTreeGeneration(watch);
+    EXPECT_EQ(insertIPv4(tree, "1.2.3.9"), 1);
+    EXPECT_EQ(getTreeGeneration(watch), generation);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("1.2.3.4")), 1);
+    EXPECT_EQ(cache->hits, 1);
+
+    EXPECT_EQ(removeIPv4Address(tree, read_ipv4("1.2.3.0/24")), 0);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("1.2.3.4")), 0);
+
+    // Changes to other trees keep the cache, and so do changes to the other family.
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("2001:db8::1")), 0);
+    insertIPv6(other, "::1");
+    insertIPv4(tree, "9.9.9.9");
+    EXPECT_EQ(getTreeGeneration(cache->ipv6_watch), cache->ipv6_generation);
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("2001:db8::1")), 0);
+    EXPECT_EQ(cache->hits, 2);
+    insertIPv6(tree6, "2001:db8::/32");
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("2001:db8::1")), 1);
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("2001:db8::1")), 1);
+    EXPECT_EQ(cache->hits, 3);
+
+    unwatchTree(tree);
+    deleteLookupCache(cache);
+    deleteSubtree(tree);
+    deleteSubtree(tree6);
+    deleteSubtree(other);
+}
+
+TEST(LookupCacheSuite, WatchLimit)
+{
+    std::vector<bnode_t *> trees;
+    lookupcache_t *cache;
+
+    for (int i = 0; i < BTREE_MAX_WATCHED_TREES; i++)
+    {
+        trees.push_back(createNode());
+        ASSERT_NE(watchTree(trees.back()), (const uint64_t *)NULL);
+    }
+    cache = createLookupCache(trees[0], trees[1], 16);
+    EXPECT_NE(cache, (lookupcache_t *)NULL);
+    deleteLookupCache(cache);
+    trees.push_back(createNode());
+    EXPECT_EQ(watchTree(trees.back()), (const uint64_t *)NULL);
+    EXPECT_EQ(createLookupCache(trees.back(), NULL, 16), (lookupcache_t *)NULL);
+    EXPECT_EQ(watchTree(NULL), (const uint64_t *)NULL);
+    for (bnode_t *tree : trees)
+    {
+        unwatchTree(tree);
+        deleteSubtree(tree);
+    }
+}
+
+TEST(LookupCacheSuite, TwoWaysPerSet)
+{
+    bnode_t *tree = createNode();
+    lookupcache_t *cache;
+
+    insertIPv4(tree, "1.0.0.0/8");
+    insertIPv6(tree, "2001:db8::/32");
+    // One set: three addresses compete for two ways.
+    cache = createLookupCache(tree, tree, 1);
+    findIPv4Cached(cache, read_ipv4("1.0.0.1"));
+    findIPv4Cached(cache, read_ipv4("2.0.0.1"));
+    findIPv4Cached(cache, read_ipv4("1.0.0.1"));
+    EXPECT_EQ(cache->hits, 1);
+    findIPv4Cached(cache, read_ipv4("3.0.0.1"));
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("1.0.0.1")), 1);
+    EXPECT_EQ(cache->hits, 2);
+    EXPECT_EQ(findIPv4Cached(cache, read_ipv4("2.0.0.1")), 0);
+    EXPECT_EQ(cache->misses, 4);
+
+    findIPv6Cached(cache, read_ipv6("2001:db8::1"));
+    findIPv6Cached(cache, read_ipv6("2001:db8::2"));
+    findIPv6Cached(cache, read_ipv6("2001:db9::1"));
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("2001:db8::2")), 1);
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("2001:db9::1")), 0);
+    EXPECT_EQ(findIPv6Cached(cache, read_ipv6("2001:db8::1")), 1);
+    EXPECT_EQ(cache->hits, 4);
+    EXPECT_EQ(cache->misses, 8);
+    deleteLookupCache(cache);
+    deleteSubtree(tree);
+}
+
+TEST(LookupCacheSuite, MatchesTree)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "outbound.txt");
+    lookupcache_t *cache = createLookupCache(tree, NULL, 256);
+
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        // Skewed: a few addresses often, many rarely.
+        uint32_t n = (i % 4 == 0) ? i * 2654435761U : 0x01000000U + (i * 2654435761U) % 64;
+        ipv4_t ip = {n, 32};
+        ASSERT_EQ(findIPv4Cached(cache, ip), findIPv4Address(tree, ip)) << i;
+    }
+    EXPECT_GT(cache->hits, cache->misses);
+    deleteLookupCache(cache);
+    deleteSubtree(tree);
+}
@@ -0,0 +1,257 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <poll.h>
+
+extern "C"
+{
+#include "lookupd.h"
+#include "metrics.h"
+}
+
+class LookupdSuite : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        snprintf(socket_path, sizeof(socket_path), "/tmp/lookupd-test-%d.sock", (int)getpid());
+        ipv4_root = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+        ipv6_root = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
+        server = createLookupd(socket_path, ipv4_root, ipv6_root);
+        ASSERT_TRUE(server != nullptr);
+        server_thread = std::thread([this] { result = runLookupd(server); });
+    }
+
+    void TearDown() override
+    {
+        stopLookupd(server);
+        server_thread.join();
+        EXPECT_EQ(result, 0);
+        deleteLookupd(server);
+        EXPECT_NE(access(socket_path, F_OK), 0);
+        deleteSubtree(ipv4_root);
+        deleteSubtree(ipv6_root);
+    }
+
+    char socket_path[64];
+    bnode_t *ipv4_root;
+    bnode_t *ipv6_root;
+    lookupd_t *server;
+    std::thread server_thread;
+    int result = -1;
+};
+
+TEST_F(LookupdSuite, QueryIPv4Batch)
+{
+    ipv4_t ips[] = {read_ipv4("1.2.3.0"), read_ipv4("1.2.3.16"), read_ipv4("2.3.15.0"), read_ipv4("6.7.8.9"),
+                    read_ipv4("6.7.8.10"), read_ipv4("3.4.5.6"), read_ipv4("3.4.6.0"), read_ipv4("1.2.3.15"),
+                    read_ipv4("9.9.9.9")};
+    uint8_t bitmap[2] = {0, 0};
+    int fd = connectLookupd(socket_path);
+
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(queryLookupdIPv4(fd, ips, 9, bitmap), 0);
+    EXPECT_EQ(bitmap[0], 0xAD);
+    EXPECT_EQ(bitmap[1], 0x00);
+    close(fd);
+}
+
+TEST_F(LookupdSuite, QueryIPv6BatchAndPipelining)
+{
+    ipv6_t ips[] = {read_ipv6("1:2:3:4:5:6:7:8"), read_ipv6("1:2:3:4:5:6:7:10"), read_ipv6("4:5:6:7:8:9:a:b")};
+    uint8_t bitmap = 0;
+    int fd = connectLookupd(socket_path);
+
+    ASSERT_GE(fd, 0);
+    for (int i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(queryLookupdIPv6(fd, ips, 3, &bitmap), 0);
+        EXPECT_EQ(bitmap, 0x05);
+    }
+    EXPECT_EQ(queryLookupdIPv4(fd, nullptr, 0, &bitmap), 0);
+    close(fd);
+}
+
+TEST_F(LookupdSuite, QueryMetrics)
+{
+    ipv4_t ips[] = {read_ipv4("1.2.3.0"), read_ipv4("9.9.9.9")};
+    uint8_t bitmap = 0;
+    char *text = nullptr;
+    int fd = connectLookupd(socket_path);
+
+    ASSERT_GE(fd, 0);
+    resetMetrics();
+    setMetricsEnabled(1);
+    EXPECT_EQ(queryLookupdIPv4(fd, ips, 2, &bitmap), 0);
+    EXPECT_EQ(queryLookupdMetrics(fd, &text), 0);
+    setMetricsEnabled(0);
+    ASSERT_TRUE(text != nullptr);
+    EXPECT_NE(strstr(text, "iplookup_lookups_total{family=\"ipv4\",result=\"hit\"} 1\n"), nullptr);
+    EXPECT_NE(strstr(text, "iplookup_lookups_total{family=\"ipv4\",result=\"miss\"} 1\n"), nullptr);
+    free(text);
+    close(fd);
+}
+
+TEST_F(LookupdSuite, LargeBatch)
+{
+    std::vector<ipv4_t> ips(LOOKUPD_MAX_ADDRESSES, read_ipv4("2.3.4.5"));
+    std::vector<uint8_t> bitmap(LOOKUPD_MAX_ADDRESSES / 8);
+    int fd = connectLookupd(socket_path);
+
+    ips.back() = read_ipv4("5.5.5.5");
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(queryLookupdIPv4(fd, ips.data(), ips.size(), bitmap.data()), 0);
+    EXPECT_EQ(bitmap.front(), 0xFF);
+    EXPECT_EQ(bitmap.back(), 0x7F);
+    EXPECT_EQ(queryLookupdIPv4(fd, ips.data(), LOOKUPD_MAX_ADDRESSES + 1, bitmap.data()), -1);
+    close(fd);
+}
+
+TEST_F(LookupdSuite, MalformedRequestClosesConnection)
+{
+    lookupd_header_t header = {0x1234, LOOKUPD_QUERY_IPV4, 0, 1};
+    uint8_t reply;
+    int fd = connectLookupd(socket_path);
+
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(send(fd, &header, sizeof(header), 0), (ssize_t)sizeof(header));
+    EXPECT_EQ(recv(fd, &reply, 1, 0), 0);
+    close(fd);
+}
+
+TEST_F(LookupdSuite, SlowReaderStopsReading)
+{
+    lookupd_header_t request = {LOOKUPD_MAGIC, LOOKUPD_METRICS, 0, 0};
+    const size_t max_requests = 200000;
+    size_t sent = 0;
+    int fd = connectLookupd(socket_path);
+
+    ASSERT_GE(fd, 0);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    // Pipeline requests without reading: the server must stop taking them.
+    while (sent < max_requests)
+    {
+        if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) == (ssize_t)sizeof(request))
+        {
+            sent++;
+            continue;
+        }
+        struct pollfd writable = {fd, POLLOUT, 0};
+        if (poll(&writable, 1, 500) == 0)
+        {
+            break;
+        }
+    }
+    EXPECT_LT(sent, max_requests);
+
+    // Once the client reads, every request is answered in order.
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    for (size_t i = 0; i < sent; i++)
+    {
+        lookupd_header_t response;
+        std::vector<char> text;
+        ASSERT_EQ(recv(fd, &response, sizeof(response), MSG_WAITALL), (ssize_t)sizeof(response)) << i;
+        ASSERT_EQ(response.type, LOOKUPD_METRICS);
+        text.resize(response.count);
+        ASSERT_EQ(recv(fd, text.data(), text.size(), MSG_WAITALL), (ssize_t)text.size());
+    }
+    ipv4_t ip = read_ipv4("1.2.3.0");
+    uint8_t bitmap = 0;
+    EXPECT_EQ(queryLookupdIPv4(fd, &ip, 1, &bitmap), 0);
+    EXPECT_EQ(bitmap, 1);
+    close(fd);
+}
+
+TEST_F(LookupdSuite, HalfClosedClientGetsEveryAnswer)
+{
+    lookupd_header_t request = {LOOKUPD_MAGIC, LOOKUPD_METRICS, 0, 0};
+    const size_t max_requests = 200000;
+    size_t sent = 0;
+    char end;
+    int fd = connectLookupd(socket_path);
+
+    ASSERT_GE(fd, 0);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    // Enough requests that the server holds answers back, then no more.
+    while (sent < max_requests)
+    {
+        if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) == (ssize_t)sizeof(request))
+        {
+            sent++;
+            continue;
+        }
+        struct pollfd writable = {fd, POLLOUT, 0};
+        if (poll(&writable, 1, 500) == 0)
+        {
+            break;
+        }
+    }
+    ASSERT_EQ(shutdown(fd, SHUT_WR), 0);
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    for (size_t i = 0; i < sent; i++)
+    {
+        lookupd_header_t response;
+        std::vector<char> text;
+        ASSERT_EQ(recv(fd, &response, sizeof(response), MSG_WAITALL), (ssize_t)sizeof(response)) << i;
+        text.resize(response.count);
+        ASSERT_EQ(recv(fd, text.data(), text.size(), MSG_WAITALL), (ssize_t)text.size());
+    }
+    EXPECT_EQ(recv(fd, &end, 1, 0), 0);
+    close(fd);
+}
+
+TEST_F(LookupdSuite, PathInUseIsKept)
+{
+    EXPECT_EQ(createLookupd(socket_path, ipv4_root, ipv6_root), nullptr);
+    EXPECT_EQ(access(socket_path, F_OK), 0);
+
+    int fd = connectLookupd(socket_path);
+    EXPECT_GE(fd, 0);
+    close(fd);
+}
+
+TEST(LookupdClientSuite, RegularFileIsKept)
+{
+    char path[64];
+    bnode_t *tree = createNode();
+
+    snprintf(path, sizeof(path), "/tmp/lookupd-file-%d.txt", (int)getpid());
+    FILE *fp = fopen(path, "w");
+    ASSERT_NE(fp, nullptr);
+    fputs("1.2.3.4\n", fp);
+    fclose(fp);
+    EXPECT_EQ(createLookupd(path, tree, tree), nullptr);
+    EXPECT_EQ(access(path, F_OK), 0);
+    remove(path);
+    deleteSubtree(tree);
+}
+
+TEST(LookupdClientSuite, StaleSocketIsReplaced)
+{
+    char path[64];
+    bnode_t *tree = createNode();
+    lookupd_t *server;
+
+    snprintf(path, sizeof(path), "/tmp/lookupd-stale-%d.sock", (int)getpid());
+    server = createLookupd(path, tree, tree);
+    ASSERT_NE(server, nullptr);
+    // Leave the socket file behind, as a crashed server would.
+    close(server->listen_fd);
+    server->listen_fd = -1;
+    deleteLookupd(server);
+    EXPECT_EQ(access(path, F_OK), 0);
+
+    server = createLookupd(path, tree, tree);
+    EXPECT_NE(server, nullptr);
+    deleteLookupd(server);
+    EXPECT_NE(access(path, F_OK), 0);
+    deleteSubtree(tree);
+}
+
+TEST(LookupdClientSuite, ConnectWithoutServer)
+{
+    EXPECT_EQ(connectLookupd("/tmp/non-existent-lookupd.sock"), -1);
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <cstring>
+
+extern "C"
+{
+#include "lpmmap.h"
+}
+
+TEST(LpmMapSuite, NewEmptyMap)
+{
+    lpmmap_t *map = createLpmMap();
+    ipv4_t match4;
+    ipv6_t match6;
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.2.3.4"), &match4), LPM_NO_VALUE);
+    EXPECT_EQ(match4.ps, 0);
+    EXPECT_EQ(lookupLpmIPv6(map, read_ipv6("1:2:3:4:5:6:7:8"), &match6), LPM_NO_VALUE);
+    EXPECT_EQ(match6.ps, 0);
+    EXPECT_EQ(getLpmValue(map, LPM_NO_VALUE), nullptr);
+    EXPECT_EQ(getLpmValue(map, 1), nullptr);
+    deleteLpmMap(map);
+    deleteLpmMap(NULL);
+}
+
+TEST(LpmMapSuite, InternValues)
+{
+    lpmmap_t *map = createLpmMap();
+    EXPECT_EQ(internLpmValue(map, "AS100", 5), 1);
+    EXPECT_EQ(internLpmValue(map, "AS200,", 5), 2);
+    EXPECT_EQ(internLpmValue(map, "AS100", 5), 1);
+    EXPECT_EQ(internLpmValue(map, "AS10", 4), 3);
+    EXPECT_STREQ(getLpmValue(map, 2), "AS200");
+    EXPECT_STREQ(getLpmValue(map, 3), "AS10");
+
+    // Growing the hash table keeps every ID.
+    char value[16];
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        snprintf(value, sizeof(value), "v%u", i);
+        EXPECT_EQ(internLpmValue(map, value, strlen(value)), i + 4);
+    }
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        snprintf(value, sizeof(value), "v%u", i);
+        EXPECT_EQ(internLpmValue(map, value, strlen(value)), i + 4);
+    }
+    EXPECT_EQ(internLpmValue(map, "AS100", 5), 1);
+    deleteLpmMap(map);
+}
+
+TEST(LpmMapSuite, MostSpecificValueWins)
+{
+    lpmmap_t *map = createLpmMap();
+    uint32_t wide = internLpmValue(map, "wide", 4);
+    uint32_t narrow = internLpmValue(map, "narrow", 6);
+    uint32_t host = internLpmValue(map, "host", 4);
+    ipv4_t match;
+
+    EXPECT_EQ(insertLpmIPv4(map, read_ipv4("1.2.3.4"), host), 0);
+    EXPECT_EQ(insertLpmIPv4(map, read_ipv4("1.2.0.0/16"), wide), 0);
+    EXPECT_EQ(insertLpmIPv4(map, read_ipv4("1.2.3.0/24"), wide), 0);
+    EXPECT_EQ(insertLpmIPv4(map, read_ipv4("1.2.3.0/24"), narrow), 1);
+    EXPECT_EQ(insertLpmIPv4(map, read_ipv4("1.2.3.256"), narrow), 2);
+    EXPECT_EQ(insertLpmIPv4(map, read_ipv4("1.2.3.0/24"), LPM_NO_VALUE), 2);
+    EXPECT_EQ(insertLpmIPv4(map, read_ipv4("1.2.3.0/24"), 4), 2);
+
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.2.3.4"), &match), host);
+    EXPECT_EQ(match.ip, read_ipv4("1.2.3.4").ip);
+    EXPECT_EQ(match.ps, 32);
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.2.3.5"), &match), narrow);
+    EXPECT_EQ(match.ip, read_ipv4("1.2.3.0").ip);
+    EXPECT_EQ(match.ps, 24);
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.2.200.1"), &match), wide);
+    EXPECT_EQ(match.ip, read_ipv4("1.2.0.0").ip);
+    EXPECT_EQ(match.ps, 16);
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.3.0.0"), &match), LPM_NO_VALUE);
+    EXPECT_EQ(match.ps, 0);
+
+    // A range query matches only prefixes that contain the whole range.
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.2.3.0/25"), NULL), narrow);
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.2.0.0/20"), NULL), wide);
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("1.0.0.0/8"), NULL), LPM_NO_VALUE);
+    deleteLpmMap(map);
+}
+
+TEST(LpmMapSuite, IPv6)
+{
+    lpmmap_t *map = createLpmMap();
+    uint32_t wide = internLpmValue(map, "wide", 4);
+    uint32_t narrow = internLpmValue(map, "narrow", 6);
+    ipv6_t match;
+
+    EXPECT_EQ(insertLpmIPv6(map, read_ipv6("2001:db8::/32"), wide), 0);
+    EXPECT_EQ(insertLpmIPv6(map, read_ipv6("2001:db8:1:8000::/49"), narrow), 0);
+    EXPECT_EQ(lookupLpmIPv6(map, read_ipv6("2001:db8:1:8000::1"), &match), narrow);
+    EXPECT_EQ(match.ps, 49);
+    EXPECT_EQ(match.ip[3], 0x8000);
+    EXPECT_EQ(match.ip[7], 0);
+    EXPECT_EQ(lookupLpmIPv6(map, read_ipv6("2001:db8:1:7fff::1"), &match), wide);
+    EXPECT_EQ(match.ps, 32);
+    EXPECT_EQ(match.ip[0], 0x2001);
+    EXPECT_EQ(match.ip[1], 0xdb8);
+    EXPECT_EQ(match.ip[2], 0);
+    EXPECT_EQ(lookupLpmIPv6(map, read_ipv6("2001:db9::1"), NULL), LPM_NO_VALUE);
+    deleteLpmMap(map);
+}
+
+TEST(LpmMapSuite, LoadFile)
+{
+    lpmmap_t *map = createLpmMap();
+    EXPECT_EQ(loadLpmMapFile(map, TEST_DATA_DIR "prefixmap.csv"), 0);
+
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv4(map, read_ipv4("1.2.3.4"), NULL)), "AS300");
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv4(map, read_ipv4("1.2.3.5"), NULL)), "AS201");
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv4(map, read_ipv4("1.2.4.5"), NULL)), "AS100");
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv4(map, read_ipv4("10.20.30.40"), NULL)), "AS100");
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("5.6.7.8"), NULL), LPM_NO_VALUE);
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv6(map, read_ipv6("2001:db8:1::1"), NULL)), "AS64497");
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv6(map, read_ipv6("2001:db8:2::1"), NULL)), "AS64496");
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv4(map, read_ipv4("5.6.8.10"), NULL)), "AS400");
+    EXPECT_STREQ(getLpmValue(map, lookupLpmIPv4(map, read_ipv4("5.6.8.20"), NULL)), "AS400");
+    EXPECT_EQ(lookupLpmIPv4(map, read_ipv4("5.6.8.21"), NULL), LPM_NO_VALUE);
+    EXPECT_EQ(map->value_count, 7);
+
+    EXPECT_EQ(loadLpmMapFile(map, TEST_DATA_DIR "non-existent.csv"), 1);
+    deleteLpmMap(map);
+}
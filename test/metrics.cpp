@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include "metrics.h"
+#include "btree.h"
+}
+
+class MetricsSuite : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        resetMetrics();
+        setMetricsEnabled(1);
+    }
+
+    void TearDown() override
+    {
+        setMetricsEnabled(0);
+        resetMetrics();
+    }
+};
+
+TEST_F(MetricsSuite, DisabledByDefault)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    metrics_t metrics;
+
+    setMetricsEnabled(0);
+    EXPECT_EQ(metricsEnabled(), 0);
+    findIPv4(tree, "1.2.3.4");
+    getMetrics(&metrics);
+    EXPECT_EQ(metrics.hits[METRICS_IPV4], 0);
+    deleteSubtree(tree);
+}
+
+TEST_F(MetricsSuite, CountLookups)
+{
+    bnode_t *ipv4_tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    bnode_t *ipv6_tree = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
+    metrics_t metrics;
+    uint64_t histogram_total = 0;
+
+    EXPECT_EQ(findIPv4(ipv4_tree, "1.2.3.4"), 1);
+    EXPECT_EQ(findIPv4(ipv4_tree, "9.9.9.9"), 0);
+    EXPECT_EQ(findIPv4(ipv4_tree, "9.9.9.999"), 0);
+    EXPECT_EQ(findIPv6(ipv6_tree, "1:2:3:4:5:6:7:8"), 1);
+    EXPECT_EQ(findIPv6(ipv6_tree, "1:2:3:4:5:6:7:"), 0);
+    getMetrics(&metrics);
+    EXPECT_EQ(metrics.hits[METRICS_IPV4], 1);
+    EXPECT_EQ(metrics.misses[METRICS_IPV4], 1);
+    EXPECT_EQ(metrics.parse_failures[METRICS_IPV4], 1);
+    EXPECT_EQ(metrics.hits[METRICS_IPV6], 1);
+    EXPECT_EQ(metrics.misses[METRICS_IPV6], 0);
+    EXPECT_EQ(metrics.parse_failures[METRICS_IPV6], 1);
+    for (uint16_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++)
+    {
+        histogram_total += metrics.histogram[i];
+    }
+    EXPECT_EQ(histogram_total, 3);
+    deleteSubtree(ipv4_tree);
+    deleteSubtree(ipv6_tree);
+}
+
+TEST_F(MetricsSuite, Quantiles)
+{
+    metrics_t metrics;
+    uint64_t now = metricsClock();
+
+    /*
+    Latencies of 1 to 1000 us: recordLookup() subtracts start from the current
+    time, so they come out slightly longer, by the time the loop takes.
+    */
+    for (uint64_t latency = 1; latency <= 1000; latency++)
+    {
+        recordLookup(METRICS_IPV4, 1, now - latency * 1000);
+    }
+    getMetrics(&metrics);
+    EXPECT_EQ(metrics.hits[METRICS_IPV4], 1000);
+    EXPECT_GE(getMetricsQuantile(&metrics, 0.5), 500000);
+    EXPECT_LE(getMetricsQuantile(&metrics, 0.5), 500000 * 17 / 16 + 100000);
+    EXPECT_GE(getMetricsQuantile(&metrics, 0.999), getMetricsQuantile(&metrics, 0.99));
+    EXPECT_GE(getMetricsQuantile(&metrics, 1.0), getMetricsQuantile(&metrics, 0.999));
+
+    resetMetrics();
+    getMetrics(&metrics);
+    EXPECT_EQ(getMetricsQuantile(&metrics, 0.99), 0);
+}
+
+TEST_F(MetricsSuite, CountFromThreads)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    std::vector<std::thread> threads;
+    metrics_t metrics;
+
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([tree] {
+            for (int i = 0; i < 1000; i++)
+            {
+                findIPv4(tree, "1.2.3.4");
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    getMetrics(&metrics);
+    EXPECT_EQ(metrics.hits[METRICS_IPV4], 4000);
+    deleteSubtree(tree);
+}
+
+TEST_F(MetricsSuite, WritePrometheusFile)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    char filename[] = "/tmp/ip-metrics-XXXXXX";
+    char buffer[8192];
+    size_t length;
+    FILE *fp;
+
+    findIPv4(tree, "1.2.3.4");
+    close(mkstemp(filename));
+    EXPECT_EQ(writeMetricsFile(filename), 0);
+    fp = fopen(filename, "r");
+    ASSERT_TRUE(fp != nullptr);
+    length = fread(buffer, 1, sizeof(buffer) - 1, fp);
+    buffer[length] = '\0';
+    fclose(fp);
+    remove(filename);
+
+    std::string text(buffer);
+    EXPECT_NE(text.find("# TYPE iplookup_lookups_total counter\n"), std::string::npos);
+    EXPECT_NE(text.find("iplookup_lookups_total{family=\"ipv4\",result=\"hit\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("iplookup_lookup_duration_seconds_bucket{le=\"+Inf\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("iplookup_lookup_latency_seconds{quantile=\"0.999\"}"), std::string::npos);
+    EXPECT_EQ(writeMetricsFile("/non-existent/metrics.prom"), 1);
+    deleteSubtree(tree);
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+extern "C"
+{
+#include "multilist.h"
+#include "btree.h"
+}
+
+TEST(MultiListSuite, NewEmptyTree)
+{
+    mnode_t *tree = createMultiNode();
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.2.3.4"), 0);
+    EXPECT_EQ(lookupMultiIPv6(tree, "1:2:3:4:5:6:7:8"), 0);
+    deleteMultiTree(tree);
+}
+
+TEST(MultiListSuite, InsertIntoSeveralLists)
+{
+    mnode_t *tree = createMultiNode();
+    EXPECT_EQ(insertMultiIPv4Address(tree, read_ipv4("1.2.3.0/24"), 0), 0);
+    EXPECT_EQ(insertMultiIPv4Address(tree, read_ipv4("1.2.3.4"), 1), 0);
+    EXPECT_EQ(insertMultiIPv4Address(tree, read_ipv4("1.2.0.0/16"), 63), 0);
+    EXPECT_EQ(insertMultiIPv4Address(tree, read_ipv4("1.2.3.4"), 0), 1);
+    EXPECT_EQ(insertMultiIPv4Address(tree, read_ipv4("1.2.3.0/24"), 0), 1);
+    EXPECT_EQ(insertMultiIPv4Address(tree, read_ipv4("1.2.3.4"), 64), 2);
+    EXPECT_EQ(insertMultiIPv4Address(tree, read_ipv4("1.2.3.256"), 0), 2);
+
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.2.3.4"), 0x8000000000000003ULL);
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.2.3.5"), 0x8000000000000001ULL);
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.2.4.5"), 0x8000000000000000ULL);
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.3.0.0"), 0);
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.2.3.0/24"), 0x8000000000000001ULL);
+    EXPECT_EQ(lookupMultiIPv4(tree, "bogus"), 0);
+    deleteMultiTree(tree);
+}
+
+TEST(MultiListSuite, WiderRangeAbsorbsSameList)
+{
+    mnode_t *tree = createMultiNode();
+    insertMultiIPv6Address(tree, read_ipv6("2001:db8::1"), 2);
+    insertMultiIPv6Address(tree, read_ipv6("2001:db8::2"), 3);
+    EXPECT_EQ(insertMultiIPv6Address(tree, read_ipv6("2001:db8::/32"), 2), 0);
+    EXPECT_EQ(lookupMultiIPv6(tree, "2001:db8::1"), 0x4);
+    EXPECT_EQ(lookupMultiIPv6(tree, "2001:db8::2"), 0xC);
+    EXPECT_EQ(lookupMultiIPv6(tree, "2001:db9::2"), 0);
+    deleteMultiTree(tree);
+}
+
+TEST(MultiListSuite, CreateFromFilesMatchesSeparateTrees)
+{
+    const char *const files[] = {TEST_DATA_DIR "ipv4list.txt", TEST_DATA_DIR "ipv4range.txt",
+                                 TEST_DATA_DIR "outbound.txt", TEST_DATA_DIR "non-existent.txt"};
+    const char *const queries[] = {"1.2.3.4", "1.2.3.15", "2.3.4.5", "6.7.8.9", "9.9.9.9", "50.60.70.80"};
+    mnode_t *tree = createMultiIPv4TreeFromFiles(files, 4);
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        bnode_t *single = createIPv4TreeFromFile(files[i]);
+        for (const char *query : queries)
+        {
+            EXPECT_EQ((lookupMultiIPv4(tree, query) >> i) & 1, findIPv4(single, query)) << query << " in list " << (int)i;
+        }
+        deleteSubtree(single);
+    }
+    for (const char *query : queries)
+    {
+        EXPECT_EQ(lookupMultiIPv4(tree, query) >> 3, 0);
+    }
+    deleteMultiTree(tree);
+}
+
+TEST(MultiListSuite, CreateIPv6FromFiles)
+{
+    const char *const files[] = {TEST_DATA_DIR "ipv6list.txt", TEST_DATA_DIR "ipv6range.txt"};
+    mnode_t *tree = createMultiIPv6TreeFromFiles(files, 2);
+    EXPECT_EQ(lookupMultiIPv6(tree, "1:2:3:4:5:6:7:8"), 0x3);
+    EXPECT_EQ(lookupMultiIPv6(tree, "1:2:3:4:5:6:7:9"), 0x2);
+    EXPECT_EQ(lookupMultiIPv6(tree, "5:6:7:8:9:a:b:c"), 0x1);
+    deleteMultiTree(tree);
+}
+
+TEST(MultiListSuite, StartEndRanges)
+{
+    const char *const files[] = {TEST_DATA_DIR "ipv4list.txt", TEST_DATA_DIR "ipv4startend.txt"};
+    const char *const files6[] = {TEST_DATA_DIR "ipv6startend.txt"};
+    mnode_t *tree = createMultiIPv4TreeFromFiles(files, 2);
+    mnode_t *tree6 = createMultiIPv6TreeFromFiles(files6, 1);
+
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.2.4.100") >> 1, 1);
+    EXPECT_EQ(lookupMultiIPv4(tree, "10.0.0.255") >> 1, 1);
+    EXPECT_EQ(lookupMultiIPv4(tree, "1.2.5.201") >> 1, 0);
+    EXPECT_EQ(lookupMultiIPv6(tree6, "2001:db8::1:0"), 0x1);
+    EXPECT_EQ(lookupMultiIPv6(tree6, "ffff::"), 0);
+    deleteMultiTree(tree);
+    deleteMultiTree(tree6);
+}
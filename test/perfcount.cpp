@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+extern "C"
+{
+#include "perfcount.h"
+#include "btree.h"
+}
+
+TEST(PerfCountSuite, EventNames)
+{
+    EXPECT_STREQ(perfEventName(PERF_CYCLES), "cycles");
+    EXPECT_STREQ(perfEventName(PERF_BRANCH_MISSES), "branch-misses");
+    EXPECT_STREQ(perfEventName(PERF_EVENT_COUNT), "unknown");
+}
+
+TEST(PerfCountSuite, CountFindBatch)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    perfstats_t stats;
+
+    resetPerfStats();
+    // Not inside a batch: not counted.
+    findIPv4(tree, "1.2.3.4");
+    PERF_BATCH_BEGIN(PERF_FIND);
+    PERF_BATCH_BEGIN(PERF_FIND);
+    for (int i = 0; i < 100; i++)
+    {
+        findIPv4(tree, "1.2.3.4");
+    }
+    PERF_BATCH_END(PERF_FIND);
+    PERF_BATCH_END(PERF_FIND);
+    getPerfStats(PERF_FIND, &stats);
+
+#ifdef IP_PERF_COUNTERS
+    EXPECT_EQ(stats.batches, 1);
+    EXPECT_EQ(stats.operations, 100);
+    if (perfCountersAvailable() && (stats.available & (1 << PERF_INSTRUCTIONS)))
+    {
+        EXPECT_GT(stats.events[PERF_INSTRUCTIONS], 100);
+    }
+#else
+    EXPECT_EQ(perfCountersAvailable(), 0);
+    EXPECT_EQ(stats.batches, 0);
+    EXPECT_EQ(stats.operations, 0);
+    EXPECT_EQ(stats.available, 0);
+#endif
+    deleteSubtree(tree);
+}
+
+TEST(PerfCountSuite, CountLoad)
+{
+    perfstats_t stats;
+
+    resetPerfStats();
+    deleteSubtree(createIPv4TreeFromFile(TEST_DATA_DIR "ipv4list.txt"));
+    getPerfStats(PERF_LOAD, &stats);
+#ifdef IP_PERF_COUNTERS
+    EXPECT_EQ(stats.batches, 1);
+    EXPECT_GE(stats.operations, 10);
+#else
+    EXPECT_EQ(stats.operations, 0);
+#endif
+    resetPerfStats();
+    getPerfStats(PERF_LOAD, &stats);
+    EXPECT_EQ(stats.batches, 0);
+}
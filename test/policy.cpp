@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+extern "C"
+{
+#include "policy.h"
+}
+
+TEST(PolicySuite, NewEmptyPolicy)
+{
+    policy_t *policy = createPolicy(POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "1.2.3.4"), POLICY_NONE);
+    EXPECT_EQ(checkPolicyIPv6(policy, "1:2:3:4:5:6:7:8"), POLICY_NONE);
+    deletePolicy(policy);
+    deletePolicy(NULL);
+}
+
+TEST(PolicySuite, MostSpecificWins)
+{
+    policy_t *policy = createPolicy(POLICY_DENY);
+    ipv4_t match;
+
+    EXPECT_EQ(insertPolicyIPv4(policy, read_ipv4("10.0.0.0/8"), POLICY_DENY), 0);
+    EXPECT_EQ(insertPolicyIPv4(policy, read_ipv4("10.1.2.0/24"), POLICY_ALLOW), 0);
+    EXPECT_EQ(insertPolicyIPv4(policy, read_ipv4("10.1.2.3"), POLICY_DENY), 0);
+    EXPECT_EQ(insertPolicyIPv4(policy, read_ipv4("10.1.2.0/24"), POLICY_NONE), 2);
+    EXPECT_EQ(insertPolicyIPv4(policy, read_ipv4("10.1.2.300"), POLICY_ALLOW), 2);
+
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.9.9.9"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.1.2.4"), POLICY_ALLOW);
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.1.2.3"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "11.0.0.1"), POLICY_NONE);
+    EXPECT_EQ(checkPolicyIPv4(policy, "bogus"), POLICY_NONE);
+
+    EXPECT_EQ(checkPolicyIPv4Address(policy, read_ipv4("10.1.2.4"), &match), POLICY_ALLOW);
+    EXPECT_EQ(match.ip, read_ipv4("10.1.2.0").ip);
+    EXPECT_EQ(match.ps, 24);
+    deletePolicy(policy);
+}
+
+TEST(PolicySuite, TieBreak)
+{
+    policy_t *deny_wins = createPolicy(POLICY_DENY);
+    policy_t *allow_wins = createPolicy(POLICY_ALLOW);
+
+    for (policy_t *policy : {deny_wins, allow_wins})
+    {
+        insertPolicyIPv6(policy, read_ipv6("2001:db8::/32"), POLICY_ALLOW);
+        insertPolicyIPv6(policy, read_ipv6("2001:db8::/32"), POLICY_DENY);
+        insertPolicyIPv6(policy, read_ipv6("2001:db8::/32"), POLICY_ALLOW);
+    }
+    EXPECT_EQ(checkPolicyIPv6(deny_wins, "2001:db8::1"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv6(allow_wins, "2001:db8::1"), POLICY_ALLOW);
+
+    // The outcome does not depend on the order of the entries.
+    EXPECT_EQ(insertPolicyIPv4(deny_wins, read_ipv4("1.2.3.0/24"), POLICY_DENY), 0);
+    EXPECT_EQ(insertPolicyIPv4(deny_wins, read_ipv4("1.2.3.0/24"), POLICY_ALLOW), 1);
+    EXPECT_EQ(insertPolicyIPv4(deny_wins, read_ipv4("1.2.4.0/24"), POLICY_ALLOW), 0);
+    EXPECT_EQ(insertPolicyIPv4(deny_wins, read_ipv4("1.2.4.0/24"), POLICY_DENY), 0);
+    EXPECT_EQ(insertPolicyIPv4(deny_wins, read_ipv4("1.2.4.0/24"), POLICY_DENY), 1);
+    EXPECT_EQ(checkPolicyIPv4(deny_wins, "1.2.3.4"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(deny_wins, "1.2.4.4"), POLICY_DENY);
+    deletePolicy(deny_wins);
+    deletePolicy(allow_wins);
+}
+
+TEST(PolicySuite, LoadFile)
+{
+    policy_t *policy = createPolicy(POLICY_DENY);
+    EXPECT_EQ(loadPolicyFile(policy, TEST_DATA_DIR "policy.txt"), 0);
+
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.200.0.1"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.1.2.65"), POLICY_ALLOW);
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.1.2.66"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "192.168.1.1"), POLICY_ALLOW);
+    EXPECT_EQ(checkPolicyIPv4(policy, "172.16.0.1"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "1.2.3.4"), POLICY_NONE);
+    EXPECT_EQ(checkPolicyIPv6(policy, "2001:db8::1"), POLICY_ALLOW);
+    EXPECT_EQ(checkPolicyIPv6(policy, "2001:db8:bad::1"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.1.2.70"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.1.2.80"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv4(policy, "10.1.2.81"), POLICY_ALLOW);
+    EXPECT_EQ(checkPolicyIPv6(policy, "2001:db8::1ff"), POLICY_DENY);
+    EXPECT_EQ(checkPolicyIPv6(policy, "2001:db8::200"), POLICY_ALLOW);
+
+    EXPECT_EQ(loadPolicyFile(policy, TEST_DATA_DIR "non-existent.txt"), 1);
+    deletePolicy(policy);
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+extern "C"
+{
+#include "prefilter.h"
+}
+
+TEST(PrefilterSuite, CreateChecksParameters)
+{
+    bnode_t *tree = createNode();
+    prefilter_t *filter = createPrefilter(tree, 4, PREFILTER_DEFAULT_BITS);
+
+    ASSERT_NE(filter, (prefilter_t *)NULL);
+    EXPECT_EQ(filter->entry_count, 0);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("1.2.3.4")), 0);
+    deletePrefilter(filter);
+    EXPECT_EQ(createPrefilter(NULL, 4, 10), (prefilter_t *)NULL);
+    EXPECT_EQ(createPrefilter(tree, 5, 10), (prefilter_t *)NULL);
+    EXPECT_EQ(createPrefilter(tree, 4, 3), (prefilter_t *)NULL);
+    EXPECT_EQ(createPrefilter(tree, 4, 33), (prefilter_t *)NULL);
+    deleteSubtree(tree);
+}
+
+TEST(PrefilterSuite, NoFalseNegativesIPv4)
+{
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "outbound.txt");
+    prefilter_t *filter = createPrefilter(tree, 4, PREFILTER_DEFAULT_BITS);
+    btreeiter_t it;
+    ipv4_t ip;
+    uint32_t passed = 0;
+    uint32_t misses = 0;
+
+    initIPv4Iterator(&it, tree);
+    while (nextIPv4(&it, &ip))
+    {
+        ASSERT_EQ(mayContainIPv4(filter, ip), 1);
+        ip.ip |= (ip.ps == 32) ? 0 : (0xFFFFFFFFU >> ip.ps);
+        ip.ps = 32;
+        ASSERT_EQ(mayContainIPv4(filter, ip), 1);
+    }
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        ipv4_t query = {i * 2654435761U, 32};
+        uint8_t found = findIPv4Address(tree, query);
+        ASSERT_EQ(findIPv4Filtered(filter, query), found) << i;
+        if (!found)
+        {
+            misses++;
+            passed += mayContainIPv4(filter, query);
+        }
+    }
+    // A few probes of about 1% each.
+    EXPECT_LT(passed, misses / 20);
+    EXPECT_EQ(mayContainIPv6(filter, read_ipv6("::1")), 0);
+    deletePrefilter(filter);
+    deleteSubtree(tree);
+}
+
+TEST(PrefilterSuite, NoFalseNegativesIPv6)
+{
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+    prefilter_t *filter = createPrefilter(tree, 6, 16);
+    btreeiter_t it;
+    ipv6_t ip;
+
+    initIPv6Iterator(&it, tree);
+    while (nextIPv6(&it, &ip))
+    {
+        ASSERT_EQ(mayContainIPv6(filter, ip), 1);
+        if (ip.ps < 128)
+        {
+            ip.ip[7] |= 1;
+            ip.ps = 128;
+        }
+        ASSERT_EQ(findIPv6Filtered(filter, ip), 1);
+    }
+    for (uint32_t i = 0; i < 50000; i++)
+    {
+        ipv6_t query;
+        for (uint8_t g = 0; g < 8; g++)
+        {
+            query.ip[g] = (uint16_t)((i * 2654435761U) >> (2 * g));
+        }
+        query.ps = 128;
+        ASSERT_EQ(findIPv6Filtered(filter, query), findIPv6Address(tree, query)) << i;
+    }
+    deletePrefilter(filter);
+    deleteSubtree(tree);
+}
+
+TEST(PrefilterSuite, RangeQueries)
+{
+    bnode_t *tree = createNode();
+    prefilter_t *filter;
+
+    insertIPv4(tree, "10.0.0.0/8");
+    insertIPv4(tree, "1.2.3.4");
+    filter = createPrefilter(tree, 4, PREFILTER_DEFAULT_BITS);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("10.1.0.0/16")), 1);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("10.0.0.0/7")), 0);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("1.2.3.0/24")), 0);
+    EXPECT_EQ(mayContainIPv4(filter, read_ipv4("10.0.0.0/7")), 0);
+    EXPECT_EQ(mayContainIPv4(filter, read_ipv4("junk")), 0);
+    deletePrefilter(filter);
+    deleteSubtree(tree);
+}
+
+TEST(PrefilterSuite, GroupsPrefixSizes)
+{
+    bnode_t *tree = createNode();
+    prefilter_t *filter;
+
+    // Sizes within 8 bits of each other share one group and one block per address.
+    insertIPv4(tree, "10.1.2.0/24");
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        ipv4_t host = {0x0A010300U + i, 32};
+        insertIPv4Address(tree, host);
+    }
+    filter = createPrefilter(tree, 4, PREFILTER_DEFAULT_BITS);
+    EXPECT_EQ(filter->block_sizes[0], 24);
+    EXPECT_EQ(filter->block_sizes[1], 0);
+    // All hosts of 10.1.3.0/24 fill one block, but none is lost.
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        ipv4_t host = {0x0A010300U + i, 32};
+        ASSERT_EQ(findIPv4Filtered(filter, host), 1) << i;
+    }
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("10.1.2.9")), 1);
+
+    insertIPv4(tree, "172.16.0.0/16");
+    insertIPv4(tree, "192.168.0.0/20");
+    EXPECT_EQ(rebuildPrefilter(filter), 0);
+    EXPECT_EQ(filter->block_sizes[0], 16);
+    EXPECT_EQ(filter->block_sizes[1], 24);
+    EXPECT_EQ(filter->split, 24);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("172.16.5.5")), 1);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("192.168.15.1")), 1);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("10.1.3.7")), 1);
+    EXPECT_EQ(mayContainIPv4(filter, read_ipv4("172.16.0.0/12")), 0);
+    deletePrefilter(filter);
+    deleteSubtree(tree);
+}
+
+TEST(PrefilterSuite, TreeChangesBypassFilter)
+{
+    bnode_t *tree = createNode();
+    prefilter_t *filter;
+
+    insertIPv4(tree, "1.2.3.4");
+    filter = createPrefilter(tree, 4, PREFILTER_DEFAULT_BITS);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("5.6.7.8")), 0);
+
+    insertIPv4(tree, "5.6.7.0/24");
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("5.6.7.8")), 1);
+    EXPECT_EQ(rebuildPrefilter(filter), 0);
+    EXPECT_EQ(filter->entry_count, 2);
+    EXPECT_EQ(mayContainIPv4(filter, read_ipv4("5.6.7.8")), 1);
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("5.6.7.8")), 1);
+
+    removeIPv4Address(tree, read_ipv4("5.6.7.0/24"));
+    EXPECT_EQ(findIPv4Filtered(filter, read_ipv4("5.6.7.8")), 0);
+    deletePrefilter(filter);
+    deleteSubtree(tree);
+}
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "setops.h"
+}
+
+static bnode_t *treeOf(std::initializer_list<const char *> entries)
+{
+    bnode_t *tree = createNode();
+    for (const char *entry : entries)
+    {
+        if (strchr(entry, ':') != NULL)
+        {
+            insertIPv6(tree, entry);
+        }
+        else
+        {
+            insertIPv4(tree, entry);
+        }
+    }
+    return tree;
+}
+
+static std::string listOf(const bnode_t *tree)
+{
+    btreeiter_t it;
+    ipv4_t ip;
+    char s[IPSTRLENV4];
+    std::string list;
+
+    initIPv4Iterator(&it, tree);
+    while (nextIPv4(&it, &ip))
+    {
+        ipv4tostring(s, ip);
+        list += list.empty() ? "" : " ";
+        list += s;
+    }
+    return list;
+}
+
+static void collectIPv4(void *context, uint8_t added, ipv4_t ip)
+{
+    char s[IPSTRLENV4];
+    ipv4tostring(s, ip);
+    ((std::vector<std::string> *)context)->push_back(std::string(added ? "+" : "-") + s);
+}
+
+static void collectIPv6(void *context, uint8_t added, ipv6_t ip)
+{
+    char s[IPSTRLENV6];
+    ipv6tostring(s, ip);
+    ((std::vector<std::string> *)context)->push_back(std::string(added ? "+" : "-") + s);
+}
+
+TEST(SetOpsSuite, Union)
+{
+    bnode_t *a = treeOf({"1.2.3.0/24", "5.6.7.8", "9.9.9.9"});
+    bnode_t *b = treeOf({"1.2.3.4", "1.2.0.0/16", "5.6.7.9"});
+    bnode_t *result = unionTrees(a, b);
+
+    EXPECT_EQ(listOf(result), "1.2.0.0/16 5.6.7.8 5.6.7.9 9.9.9.9");
+    EXPECT_EQ(listOf(a), "1.2.3.0/24 5.6.7.8 9.9.9.9");
+    deleteSubtree(result);
+
+    bnode_t *empty = createNode();
+    result = unionTrees(empty, a);
+    EXPECT_TRUE(equalTrees(result, a));
+    deleteSubtree(result);
+    result = unionTrees(empty, empty);
+    EXPECT_EQ(countIPv4Tree(result), 0);
+    deleteSubtree(result);
+    deleteSubtree(empty);
+    deleteSubtree(a);
+    deleteSubtree(b);
+}
+
+TEST(SetOpsSuite, Intersection)
+{
+    bnode_t *a = treeOf({"1.2.3.0/24", "5.6.7.8", "10.0.0.0/8"});
+    bnode_t *b = treeOf({"1.2.3.4", "1.2.4.0/24", "5.6.7.9", "10.1.0.0/16", "11.0.0.1"});
+    bnode_t *result = intersectTrees(a, b);
+
+    EXPECT_EQ(listOf(result), "1.2.3.4 10.1.0.0/16");
+    deleteSubtree(result);
+
+    bnode_t *c = treeOf({"200.0.0.0/8"});
+    result = intersectTrees(a, c);
+    EXPECT_EQ(countIPv4Tree(result), 0);
+    EXPECT_EQ(findIPv4(result, "200.1.1.1"), 0);
+    deleteSubtree(result);
+    deleteSubtree(a);
+    deleteSubtree(b);
+    deleteSubtree(c);
+}
+
+TEST(SetOpsSuite, Difference)
+{
+    bnode_t *a = treeOf({"1.2.3.0/24", "5.6.7.8", "10.0.0.0/8"});
+    bnode_t *b = treeOf({"1.2.3.0/25", "1.2.3.255", "5.6.7.8", "11.0.0.0/8"});
+    bnode_t *result = subtractTrees(a, b);
+
+    EXPECT_EQ(listOf(result), "1.2.3.128/26 1.2.3.192/27 1.2.3.224/28 1.2.3.240/29 1.2.3.248/30 1.2.3.252/31 1.2.3.254 10.0.0.0/8");
+    EXPECT_EQ(findIPv4(result, "1.2.3.200"), 1);
+    EXPECT_EQ(findIPv4(result, "1.2.3.255"), 0);
+    EXPECT_EQ(findIPv4(result, "1.2.3.1"), 0);
+    deleteSubtree(result);
+
+    result = subtractTrees(a, a);
+    EXPECT_EQ(countIPv4Tree(result), 0);
+    deleteSubtree(result);
+    deleteSubtree(a);
+    deleteSubtree(b);
+}
+
+TEST(SetOpsSuite, EqualIgnoresShape)
+{
+    bnode_t *a = treeOf({"1.2.3.0/24", "9.9.9.9"});
+    bnode_t *b = treeOf({"9.9.9.9", "1.2.3.128/25", "1.2.3.0/25"});
+    bnode_t *c = treeOf({"1.2.3.0/24", "9.9.9.8"});
+    bnode_t *empty = createNode();
+
+    EXPECT_TRUE(equalTrees(a, a));
+    EXPECT_TRUE(equalTrees(a, b));
+    EXPECT_TRUE(equalTrees(b, a));
+    EXPECT_FALSE(equalTrees(a, c));
+    EXPECT_FALSE(equalTrees(a, empty));
+    EXPECT_TRUE(equalTrees(empty, empty));
+    deleteSubtree(a);
+    deleteSubtree(b);
+    deleteSubtree(c);
+    deleteSubtree(empty);
+}
+
+TEST(SetOpsSuite, DiffIPv4)
+{
+    bnode_t *old_tree = treeOf({"1.2.3.0/24", "5.6.7.8", "9.9.9.9"});
+    bnode_t *new_tree = treeOf({"1.2.3.0/25", "1.2.3.128/25", "5.6.7.0/30", "20.0.0.0/8"});
+    std::vector<std::string> diff;
+
+    EXPECT_EQ(diffIPv4Trees(old_tree, new_tree, collectIPv4, &diff), 4);
+    EXPECT_EQ(diff, (std::vector<std::string>{"+5.6.7.0/30", "-5.6.7.8", "-9.9.9.9", "+20.0.0.0/8"}));
+
+    // Parts of a range that shrank are reported as removed.
+    insertIPv4(new_tree, "9.9.9.8/31");
+    insertIPv4(old_tree, "9.9.9.8/30");
+    diff.clear();
+    diffIPv4Trees(old_tree, new_tree, collectIPv4, &diff);
+    EXPECT_EQ(diff, (std::vector<std::string>{"+5.6.7.0/30", "-5.6.7.8", "-9.9.9.10/31", "+20.0.0.0/8"}));
+    deleteSubtree(old_tree);
+    deleteSubtree(new_tree);
+}
+
+TEST(SetOpsSuite, DiffIPv6)
+{
+    bnode_t *old_tree = treeOf({"2001:db8::/32", "3::1"});
+    bnode_t *new_tree = treeOf({"2001:db8::/33", "3::1", "4::/16"});
+    std::vector<std::string> diff;
+
+    EXPECT_EQ(diffIPv6Trees(old_tree, new_tree, collectIPv6, &diff), 2);
+    EXPECT_EQ(diff, (std::vector<std::string>{"+4::/16", "-2001:db8:8000::/33"}));
+    EXPECT_EQ(diffIPv6Trees(old_tree, old_tree, collectIPv6, &diff), 0);
+    deleteSubtree(old_tree);
+    deleteSubtree(new_tree);
+}
+
+TEST(SetOpsSuite, LargeListsAgreeWithLookups)
+{
+    bnode_t *a = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+    bnode_t *b = createIPv6TreeFromFile(TEST_DATA_DIR "ipv6range.txt");
+    bnode_t *both = unionTrees(a, b);
+    bnode_t *common = intersectTrees(a, both);
+    bnode_t *only_a = subtractTrees(both, b);
+    bnode_t *rebuilt = unionTrees(only_a, b);
+
+    EXPECT_TRUE(equalTrees(common, a));
+    EXPECT_TRUE(equalTrees(rebuilt, both));
+    EXPECT_EQ(diffIPv6Trees(both, rebuilt, NULL, NULL), 0);
+
+    btreeiter_t it;
+    ipv6_t ip;
+    initIPv6Iterator(&it, a);
+    while (nextIPv6(&it, &ip))
+    {
+        EXPECT_EQ(findIPv6Address(both, ip), 1);
+        EXPECT_EQ(findIPv6Address(only_a, ip), !findIPv6Address(b, ip));
+    }
+    deleteSubtree(a);
+    deleteSubtree(b);
+    deleteSubtree(both);
+    deleteSubtree(common);
+    deleteSubtree(only_a);
+    deleteSubtree(rebuilt);
+}
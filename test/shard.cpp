@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+
+extern "C"
+{
+#include "shard.h"
+}
+
+TEST(ShardSuite, InvalidParameters)
+{
+    EXPECT_TRUE(createShardedTree(5, 8) == nullptr);
+    EXPECT_TRUE(createShardedTree(4, 0) == nullptr);
+    EXPECT_TRUE(createShardedTree(6, SHARD_MAX_BITS + 1) == nullptr);
+}
+
+TEST(ShardSuite, NewEmptyShardedTree)
+{
+    shardedtree_t *tree = createShardedTree(4, 8);
+    EXPECT_EQ(tree->count, 256);
+    EXPECT_EQ(countShardedTree(tree), 0);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.3.4"), 0);
+    deleteShardedTree(tree);
+}
+
+TEST(ShardSuite, InsertAndFindIPv4)
+{
+    shardedtree_t *tree = createShardedTree(4, 8);
+
+    EXPECT_EQ(insertShardedIPv4(tree, "1.2.3.4"), 0);
+    EXPECT_EQ(insertShardedIPv4(tree, "1.2.3.4"), 1);
+    EXPECT_EQ(insertShardedIPv4(tree, "1.2.3."), 2);
+    EXPECT_EQ(insertShardedIPv4(tree, "2.3.4.5/20"), 0);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.3.4"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.3.5"), 0);
+    EXPECT_EQ(findShardedIPv4(tree, "2.3.15.0"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "2.3.16.0"), 0);
+    EXPECT_TRUE(tree->roots[1]->child[0] != nullptr);
+    EXPECT_TRUE(tree->roots[3]->child[0] == nullptr);
+    EXPECT_EQ(countShardedTree(tree), 2);
+    deleteShardedTree(tree);
+}
+
+TEST(ShardSuite, RangeSpanningShards)
+{
+    shardedtree_t *tree = createShardedTree(4, 8);
+
+    EXPECT_EQ(insertShardedIPv4(tree, "10.0.0.0/7"), 0);
+    EXPECT_TRUE(tree->roots[10]->child[0] == tree->roots[10]);
+    EXPECT_TRUE(tree->roots[11]->child[0] == tree->roots[11]);
+    EXPECT_EQ(insertShardedIPv4(tree, "11.1.2.3"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "10.200.0.1"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "11.0.0.0/8"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "10.0.0.0/7"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "8.0.0.0/6"), 0);
+    EXPECT_EQ(findShardedIPv4(tree, "12.0.0.0"), 0);
+    EXPECT_EQ(countShardedTree(tree), 2);
+    deleteShardedTree(tree);
+}
+
+TEST(ShardSuite, CreateIPv4ShardedTreeMatchesTree)
+{
+    shardedtree_t *sharded = createShardedTreeFromFile(TEST_DATA_DIR "ipv4range.txt", 4, 8, 3);
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4range.txt");
+    const char *ips[] = {"1.2.3.0", "1.2.3.15", "1.2.3.16", "2.3.1.0", "2.3.16.0", "3.4.5.255", "6.7.8.9", "6.7.8.10", "1.2.3.4/28", "1.2.3.4/27"};
+
+    for (const char *ip : ips)
+    {
+        EXPECT_EQ(findShardedIPv4(sharded, ip), findIPv4(tree, ip)) << ip;
+    }
+    EXPECT_EQ(countShardedTree(sharded), countIPv4Tree(tree));
+    deleteShardedTree(sharded);
+}
+
+TEST(ShardSuite, CreateIPv6ShardedTreeMatchesTree)
+{
+    shardedtree_t *sharded = createShardedTreeFromFile(TEST_DATA_DIR "inbound_v6.txt", 6, 12, 0);
+    bnode_t *tree = createIPv6TreeFromFile(TEST_DATA_DIR "inbound_v6.txt");
+
+    EXPECT_EQ(countShardedTree(sharded), countIPv6Tree(tree));
+    EXPECT_EQ(findShardedIPv6(sharded, "2001:470:1:908::9001"), 1);
+    EXPECT_EQ(findShardedIPv6(sharded, "2001:470:1:908::9002"), findIPv6(tree, "2001:470:1:908::9002"));
+    deleteShardedTree(sharded);
+}
+
+TEST(ShardSuite, StartEndRangesMatchTree)
+{
+    shardedtree_t *sharded = createShardedTreeFromFile(TEST_DATA_DIR "ipv4startend.txt", 4, 8, 2);
+    bnode_t *tree = createIPv4TreeFromFile(TEST_DATA_DIR "ipv4startend.txt");
+    const char *ips[] = {"1.2.3.3", "1.2.3.4", "1.2.4.100", "1.2.5.200", "1.2.5.201", "10.0.0.128", "9.9.9.9"};
+
+    for (const char *ip : ips)
+    {
+        EXPECT_EQ(findShardedIPv4(sharded, ip), findIPv4(tree, ip)) << ip;
+    }
+    EXPECT_EQ(findShardedIPv4(sharded, "1.2.4.100"), 1);
+    EXPECT_EQ(countShardedTree(sharded), countIPv4Tree(tree));
+    deleteShardedTree(sharded);
+    deleteSubtree(tree);
+
+    sharded = createShardedTreeFromFile(TEST_DATA_DIR "ipv6startend.txt", 6, 4, 2);
+    EXPECT_EQ(findShardedIPv6(sharded, "2001:db8::ffff"), 1);
+    EXPECT_EQ(findShardedIPv6(sharded, "8000::"), 0);
+    deleteShardedTree(sharded);
+}
+
+TEST(ShardSuite, InsertStartEndRanges)
+{
+    shardedtree_t *tree = createShardedTree(4, 8);
+    shardedtree_t *tree6 = createShardedTree(6, 4);
+
+    EXPECT_EQ(insertShardedIPv4(tree, "1.2.3.250-1.2.4.5"), 0);
+    EXPECT_EQ(insertShardedIPv4(tree, "1.2.3.250-1.2.4.5"), 1);
+    EXPECT_EQ(insertShardedIPv4(tree, "1.2.4.9-1.2.4.1"), 2);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.3.250"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.4.5"), 1);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.4.6"), 0);
+    EXPECT_EQ(insertShardedIPv6(tree6, "2001:db8::ff-2001:db8::1ff"), 0);
+    EXPECT_EQ(findShardedIPv6(tree6, "2001:db8::1ff"), 1);
+    EXPECT_EQ(findShardedIPv6(tree6, "2001:db8::fe"), 0);
+    deleteShardedTree(tree);
+    deleteShardedTree(tree6);
+}
+
+TEST(ShardSuite, ReloadOnlyRebuildsChangedShards)
+{
+    char filename[] = "/tmp/shard-reload-XXXXXX";
+    int fd = mkstemp(filename);
+    FILE *fp = fdopen(fd, "w");
+    shardedtree_t *tree = createShardedTree(4, 8);
+
+    fputs("1.2.3.4\n1.2.3.5\n2.3.4.5/20\n", fp);
+    fflush(fp);
+    EXPECT_EQ(reloadShardedTreeFromFile(tree, filename, 2), 2);
+    EXPECT_EQ(reloadShardedTreeFromFile(tree, filename, 2), 0);
+
+    bnode_t *untouched = tree->roots[2];
+    freopen(filename, "w", fp);
+    fputs("1.2.3.5\n2.3.4.5/20\n1.2.3.6\n", fp);
+    fclose(fp);
+    EXPECT_EQ(reloadShardedTreeFromFile(tree, filename, 2), 1);
+    EXPECT_EQ(tree->roots[2], untouched);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.3.4"), 0);
+    EXPECT_EQ(findShardedIPv4(tree, "1.2.3.6"), 1);
+    EXPECT_EQ(reloadShardedTreeFromFile(tree, TEST_DATA_DIR "non-existent.txt", 2), 0);
+    EXPECT_EQ(countShardedTree(tree), 3);
+
+    remove(filename);
+    deleteShardedTree(tree);
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+extern "C"
+{
+#include "ttl.h"
+}
+
+static uint8_t listed(ttltree_t *ttl, const char *ip)
+{
+    if (strchr(ip, ':') != NULL)
+    {
+        return findIPv6(ttl->ipv6_root, ip);
+    }
+    return findIPv4(ttl->ipv4_root, ip);
+}
+
+TEST(TtlSuite, EntriesExpire)
+{
+    ttltree_t *ttl = createTtlTree(1000);
+
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.4"), 10), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("5.6.7.8"), 100), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("9.9.9.9"), TTL_PERMANENT), 0);
+    EXPECT_EQ(insertTtlIPv6(ttl, read_ipv6("2001:db8::1"), 5000), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("junk"), 10), 2);
+    EXPECT_EQ(ttl->entry_count, 4);
+
+    EXPECT_EQ(expireTtlTree(ttl, 1009), 0);
+    EXPECT_EQ(listed(ttl, "1.2.3.4"), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 1010), 1);
+    EXPECT_EQ(listed(ttl, "1.2.3.4"), 0);
+    EXPECT_EQ(listed(ttl, "5.6.7.8"), 1);
+
+    // Going back in time changes nothing.
+    EXPECT_EQ(expireTtlTree(ttl, 500), 0);
+    EXPECT_EQ(expireTtlTree(ttl, 1099), 0);
+    EXPECT_EQ(expireTtlTree(ttl, 1100), 1);
+    EXPECT_EQ(listed(ttl, "5.6.7.8"), 0);
+
+    EXPECT_EQ(expireTtlTree(ttl, 5999), 0);
+    EXPECT_EQ(listed(ttl, "2001:db8::1"), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 1000000), 1);
+    EXPECT_EQ(listed(ttl, "2001:db8::1"), 0);
+    EXPECT_EQ(listed(ttl, "9.9.9.9"), 1);
+    EXPECT_EQ(ttl->entry_count, 1);
+    deleteTtlTree(ttl);
+}
+
+TEST(TtlSuite, IdleClockJumps)
+{
+    const uint64_t epoch = 1700000000;
+    ttltree_t *ttl = createTtlTree(0);
+
+    // Only a permanent entry: nothing to step through.
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("9.9.9.9"), TTL_PERMANENT), 0);
+    EXPECT_EQ(expireTtlTree(ttl, epoch), 0);
+    EXPECT_EQ(ttl->now, epoch);
+
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.4"), 10), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.5"), 10), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.5"), TTL_PERMANENT), 1);
+    EXPECT_EQ(ttl->timed_count, 1);
+    EXPECT_EQ(expireTtlTree(ttl, epoch + 9), 0);
+    EXPECT_EQ(expireTtlTree(ttl, 2 * epoch), 1);
+    EXPECT_EQ(ttl->now, 2 * epoch);
+    EXPECT_EQ(ttl->timed_count, 0);
+    EXPECT_EQ(listed(ttl, "1.2.3.4"), 0);
+    EXPECT_EQ(listed(ttl, "1.2.3.5"), 1);
+
+    // Scheduling still works after the jump.
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.6"), 70), 0);
+    EXPECT_EQ(expireTtlTree(ttl, 2 * epoch + 69), 0);
+    EXPECT_EQ(expireTtlTree(ttl, 2 * epoch + 70), 1);
+    deleteTtlTree(ttl);
+}
+
+TEST(TtlSuite, RefreshKeepsLaterExpiry)
+{
+    ttltree_t *ttl = createTtlTree(0);
+
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.4"), 10), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.4"), 300), 1);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.4"), 20), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 299), 0);
+    EXPECT_EQ(listed(ttl, "1.2.3.4"), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 300), 1);
+
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.4/24"), 10), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.99/24"), TTL_PERMANENT), 1);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("1.2.3.0/24"), 10), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 100000), 0);
+    EXPECT_EQ(listed(ttl, "1.2.3.200"), 1);
+    deleteTtlTree(ttl);
+}
+
+TEST(TtlSuite, CoveredEntriesReturn)
+{
+    ttltree_t *ttl = createTtlTree(0);
+
+    insertTtlIPv4(ttl, read_ipv4("10.0.0.1"), 1000);
+    insertTtlIPv4(ttl, read_ipv4("10.0.0.0/8"), 60);
+    insertTtlIPv4(ttl, read_ipv4("10.2.0.0/16"), 5000);
+    insertTtlIPv6(ttl, read_ipv6("2001:db8::/32"), 60);
+    insertTtlIPv6(ttl, read_ipv6("2001:db8::1"), TTL_PERMANENT);
+    EXPECT_EQ(listed(ttl, "10.9.9.9"), 1);
+    EXPECT_EQ(countIPv4Tree(ttl->ipv4_root), 1);
+
+    EXPECT_EQ(expireTtlTree(ttl, 60), 2);
+    EXPECT_EQ(listed(ttl, "10.9.9.9"), 0);
+    EXPECT_EQ(listed(ttl, "10.0.0.1"), 1);
+    EXPECT_EQ(listed(ttl, "10.2.3.4"), 1);
+    EXPECT_EQ(listed(ttl, "2001:db8::2"), 0);
+    EXPECT_EQ(listed(ttl, "2001:db8::1"), 1);
+
+    EXPECT_EQ(expireTtlTree(ttl, 1000), 1);
+    EXPECT_EQ(listed(ttl, "10.0.0.1"), 0);
+    EXPECT_EQ(listed(ttl, "10.2.3.4"), 1);
+    deleteTtlTree(ttl);
+}
+
+TEST(TtlSuite, RemoveBeforeExpiry)
+{
+    ttltree_t *ttl = createTtlTree(0);
+
+    insertTtlIPv4(ttl, read_ipv4("192.168.0.0/16"), 100);
+    insertTtlIPv4(ttl, read_ipv4("192.168.1.1"), 200);
+    EXPECT_EQ(removeTtlIPv4(ttl, read_ipv4("192.168.0.0/16")), 0);
+    EXPECT_EQ(removeTtlIPv4(ttl, read_ipv4("192.168.0.0/16")), 1);
+    EXPECT_EQ(removeTtlIPv4(ttl, read_ipv4("junk")), 2);
+    EXPECT_EQ(listed(ttl, "192.168.2.2"), 0);
+    EXPECT_EQ(listed(ttl, "192.168.1.1"), 1);
+    EXPECT_EQ(removeTtlIPv6(ttl, read_ipv6("::1")), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 100), 0);
+    EXPECT_EQ(expireTtlTree(ttl, 200), 1);
+    EXPECT_EQ(ttl->entry_count, 0);
+    deleteTtlTree(ttl);
+}
+
+TEST(TtlSuite, RemoveFromSharedSlot)
+{
+    ttltree_t *ttl = createTtlTree(0);
+
+    // Same expiry, so one slot; the last one inserted heads its list.
+    insertTtlIPv4(ttl, read_ipv4("1.1.1.1"), 5000);
+    insertTtlIPv4(ttl, read_ipv4("2.2.2.2"), 5000);
+    insertTtlIPv4(ttl, read_ipv4("3.3.3.3"), 5000);
+    EXPECT_EQ(removeTtlIPv4(ttl, read_ipv4("3.3.3.3")), 0);
+    EXPECT_EQ(expireTtlTree(ttl, 4100), 0);
+    // Cascaded to a lower level by now; remove the new head and refresh the rest.
+    EXPECT_EQ(removeTtlIPv4(ttl, read_ipv4("1.1.1.1")), 0);
+    EXPECT_EQ(insertTtlIPv4(ttl, read_ipv4("2.2.2.2"), 1000), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 5000), 0);
+    EXPECT_EQ(listed(ttl, "2.2.2.2"), 1);
+    EXPECT_EQ(expireTtlTree(ttl, 5100), 1);
+    EXPECT_EQ(ttl->entry_count, 0);
+    deleteTtlTree(ttl);
+}
+
+TEST(TtlSuite, ManyEntries)
+{
+    ttltree_t *ttl = createTtlTree(0);
+    uint32_t expired = 0;
+
+    // Expiry times spread over all wheel levels; each expires on time.
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        ipv4_t ip = {0x0A000000U + i, 32};
+        ASSERT_EQ(insertTtlIPv4(ttl, ip, 1 + (i * 7919U) % 300000U), 0);
+    }
+    for (uint64_t now = 0; now <= 300000; now += 997)
+    {
+        expired += expireTtlTree(ttl, now);
+        for (uint32_t i = 0; i < 20000; i += 97)
+        {
+            ipv4_t ip = {0x0A000000U + i, 32};
+            ASSERT_EQ(findIPv4Address(ttl->ipv4_root, ip), (1 + (i * 7919U) % 300000U) > now) << i << " at " << now;
+        }
+    }
+    expired += expireTtlTree(ttl, 300000);
+    EXPECT_EQ(expired, 20000);
+    EXPECT_EQ(countIPv4Tree(ttl->ipv4_root), 0);
+    deleteTtlTree(ttl);
+}